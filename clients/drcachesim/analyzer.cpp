@@ -32,6 +32,7 @@
 
 #include "analysis_tool.h"
 #include "analyzer.h"
+#include "fanout.h"
 #include "common/options.h"
 #include "common/utils.h"
 #include "reader/file_reader.h"
@@ -40,11 +41,14 @@
 #include "simulator/tlb_simulator.h"
 #include "tools/histogram.h"
 #include "tools/reuse_distance.h"
+#include "tools/sharing.h"
+#include "tools/working_set.h"
 #include "tracer/raw2trace.h"
 #include <fstream>
+#include <iostream>
 
 analyzer_t::analyzer_t() :
-    success(true), trace_iter(NULL), trace_end(NULL), num_tools(0)
+    success(true), trace_iter(NULL), trace_end(NULL), num_tools(0), fanout(NULL)
 {
     if (!create_analysis_tools()) {
         success = false;
@@ -73,7 +77,8 @@ analyzer_t::analyzer_t() :
         }
         trace_end = new file_reader_t();
     } else if (op_infile.get_value().empty()) {
-        trace_iter = new ipc_reader_t(op_ipc_name.get_value().c_str());
+        trace_iter = new ipc_reader_t(op_ipc_name.get_value().c_str(),
+                                      op_ipc_compact.get_value());
         trace_end = new ipc_reader_t();
     } else {
         trace_iter = new file_reader_t(op_infile.get_value().c_str());
@@ -86,6 +91,7 @@ analyzer_t::~analyzer_t()
 {
     delete trace_iter;
     delete trace_end;
+    delete fanout;
     destroy_analysis_tools();
 }
 
@@ -102,21 +108,34 @@ analyzer_t::run()
     if (!start_reading())
         return false;
 
-    for (; *trace_iter != *trace_end; ++(*trace_iter)) {
-        for (int i = 0; i < num_tools; i++) {
+    if (num_tools == 1) {
+        for (; *trace_iter != *trace_end; ++(*trace_iter)) {
             memref_t memref = **trace_iter;
-            res = tools[i]->process_memref(memref) && res;
+            res = tools[0]->process_memref(memref) && res;
         }
+        return res;
     }
-    return res;
+
+    // Each tool consumes the trace concurrently on its own thread.
+    fanout = new fanout_t(tools, num_tools, op_fanout_drop.get_value());
+    if (!*fanout)
+        return false;
+    for (; *trace_iter != *trace_end; ++(*trace_iter))
+        fanout->push(**trace_iter);
+    return fanout->finish();
 }
 
 bool
 analyzer_t::print_stats()
 {
     bool res = true;
-    for (int i = 0; i < num_tools; i++)
+    for (int i = 0; i < num_tools; i++) {
         res = tools[i]->print_results() && res;
+        if (fanout != NULL && fanout->get_dropped(i) > 0) {
+            std::cerr << "Analysis tool #" << i << " dropped "
+                      << fanout->get_dropped(i) << " memory references" << std::endl;
+        }
+    }
     return res;
 }
 
@@ -131,30 +150,52 @@ analyzer_t::start_reading()
     return true;
 }
 
+analysis_tool_t *
+analyzer_t::create_analysis_tool(const std::string &type)
+{
+    if (type == CPU_CACHE)
+        return new cache_simulator_t;
+    else if (type == TLB)
+        return new tlb_simulator_t;
+    else if (type == HISTOGRAM)
+        return new histogram_t;
+    else if (type == REUSE_DIST)
+        return new reuse_distance_t;
+    else if (type == SHARING)
+        return new sharing_t;
+    else if (type == WORKING_SET)
+        return new working_set_t;
+    ERRMSG("Usage error: unsupported analyzer type \"%s\". "
+           "Please choose " CPU_CACHE ", " TLB ", "
+           HISTOGRAM ", " REUSE_DIST ", " SHARING ", or " WORKING_SET ".\n",
+           type.c_str());
+    return NULL;
+}
+
 bool
 analyzer_t::create_analysis_tools()
 {
-    /* FIXME i#2006: add multiple tool support. */
     /* FIXME i#2006: create a single top-level tool for multi-component
      * tools.
      */
-    if (op_simulator_type.get_value() == CPU_CACHE)
-        tools[0] = new cache_simulator_t;
-    else if (op_simulator_type.get_value() == TLB)
-        tools[0] = new tlb_simulator_t;
-    else if (op_simulator_type.get_value() == HISTOGRAM)
-        tools[0] = new histogram_t;
-    else if (op_simulator_type.get_value() == REUSE_DIST)
-        tools[0] = new reuse_distance_t;
-    else {
-        ERRMSG("Usage error: unsupported analyzer type. "
-               "Please choose " CPU_CACHE ", " TLB ", "
-               HISTOGRAM ", or " REUSE_DIST ".\n");
-        return false;
+    std::string types = op_simulator_type.get_value();
+    size_t start = 0;
+    while (true) {
+        size_t end = types.find(TOOL_TYPE_SEPARATOR, start);
+        if (num_tools >= max_num_tools) {
+            ERRMSG("Usage error: at most %d analyzer types are supported.\n",
+                   max_num_tools);
+            return false;
+        }
+        tools[num_tools] = create_analysis_tool
+            (types.substr(start, end == std::string::npos ? end : end - start));
+        if (!tools[num_tools])
+            return false;
+        num_tools++;
+        if (end == std::string::npos)
+            break;
+        start = end + 1;
     }
-    if (!tools[0])
-        return false;
-    num_tools = 1;
     return true;
 }
 
@@ -36,7 +36,9 @@
 #ifndef _ANALYZER_H_
 #define _ANALYZER_H_ 1
 
+#include <string>
 #include "analysis_tool.h"
+#include "fanout.h"
 #include "reader/reader.h"
 
 class analyzer_t
@@ -52,6 +54,7 @@ class analyzer_t
 
  protected:
     bool create_analysis_tools();
+    analysis_tool_t *create_analysis_tool(const std::string &type);
     void destroy_analysis_tools();
     // This finalizes the trace_iter setup.  It can block and is meant to be
     // called at the top of run().
@@ -64,6 +67,8 @@ class analyzer_t
     reader_t *trace_end;
     int num_tools;
     analysis_tool_t *tools[max_num_tools];
+    // Multiple tools each run on their own thread, fed through this.
+    fanout_t *fanout;
 };
 
 #endif /* _ANALYZER_H_ */
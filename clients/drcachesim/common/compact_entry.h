@@ -0,0 +1,223 @@
+/* **********************************************************
+ * Copyright (c) 2017 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* compact_entry: an optional variable-length encoding of trace_entry_t used
+ * to reduce the bandwidth of the online tracer-to-simulator pipe.
+ */
+
+#ifndef _COMPACT_ENTRY_H_
+#define _COMPACT_ENTRY_H_ 1
+
+#include <stddef.h>
+#include "trace_entry.h"
+
+// Each atomic pipe write becomes one packet: a 2-byte little-endian payload
+// length followed by a sequence of records.  Since writes from different
+// threads and processes interleave in the pipe, all delta state is reset at
+// the start of each packet.
+//
+// Each record starts with a one-byte header holding the trace_type_t in its
+// low 5 bits and a size code in its top 3 bits.  The rest of the record
+// depends on the type:
+// + Data references: if the size code is non-zero the size is
+//   1 << (code - 1); otherwise a varint size follows.  The address is a
+//   zigzag varint delta from the prior data address in the packet.
+// + Instruction fetches: a varint size followed by a zigzag varint delta of
+//   the pc from the end of the prior instruction in the packet, which is
+//   zero for sequential instructions within a block.
+// + Instruction bundles: a varint count followed by one length byte per
+//   instruction.  The pc is implicit, as it is for trace_entry_t.
+// + All others: a varint size and a varint address.
+#define COMPACT_PACKET_HEADER_SIZE 2
+#define COMPACT_TYPE_BITS 5
+#define COMPACT_TYPE_MASK ((1 << COMPACT_TYPE_BITS) - 1)
+#define COMPACT_MAX_SIZE_CODE 7
+// The largest possible record: a header, a 16-bit size, and a full address.
+#define COMPACT_ENTRY_MAX_SIZE (1 + 3 + (sizeof(addr_t) * 8 + 6) / 7)
+// The smallest possible record is 2 bytes, which bounds the number of
+// trace_entry_t a payload can expand into.
+#define COMPACT_MAX_ENTRIES(payload_len) ((payload_len) / 2)
+
+static inline unsigned char *
+compact_put_varint(unsigned char *dst, addr_t val)
+{
+    while (val >= 0x80) {
+        *dst++ = (unsigned char)(val | 0x80);
+        val >>= 7;
+    }
+    *dst++ = (unsigned char)val;
+    return dst;
+}
+
+static inline const unsigned char *
+compact_get_varint(const unsigned char *src, const unsigned char *end, addr_t *val)
+{
+    addr_t res = 0;
+    unsigned int shift = 0;
+    while (src < end && shift < sizeof(addr_t) * 8) {
+        unsigned char byte = *src++;
+        res |= (addr_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            *val = res;
+            return src;
+        }
+        shift += 7;
+    }
+    return NULL;
+}
+
+// Maps a signed delta to an unsigned value with small magnitudes first.
+static inline addr_t
+compact_zigzag(addr_t delta)
+{
+    return (delta << 1) ^ (addr_t)((intptr_t)delta >> (sizeof(addr_t) * 8 - 1));
+}
+
+static inline addr_t
+compact_unzigzag(addr_t val)
+{
+    return (val >> 1) ^ (addr_t)-(intptr_t)(val & 1);
+}
+
+static inline bool
+compact_type_is_data(unsigned short type)
+{
+    return type_is_prefetch((trace_type_t)type) || type == TRACE_TYPE_READ ||
+        type == TRACE_TYPE_WRITE || type == TRACE_TYPE_DATA_FLUSH;
+}
+
+// Encodes num entries into a single packet at dst, which must have room for
+// COMPACT_PACKET_HEADER_SIZE + num * COMPACT_ENTRY_MAX_SIZE bytes.
+// Returns the total size of the packet.
+static inline size_t
+compact_encode_packet(const trace_entry_t *src, size_t num, unsigned char *dst)
+{
+    unsigned char *out = dst + COMPACT_PACKET_HEADER_SIZE;
+    addr_t prev_addr = 0, next_pc = 0;
+    for (size_t i = 0; i < num; i++) {
+        const trace_entry_t *entry = &src[i];
+        unsigned char *hdr = out++;
+        *hdr = (unsigned char)(entry->type & COMPACT_TYPE_MASK);
+        if (compact_type_is_data(entry->type)) {
+            int code = 0;
+            if (IS_POWER_OF_2(entry->size)) {
+                code = compute_log2(entry->size) + 1;
+                if (code > COMPACT_MAX_SIZE_CODE)
+                    code = 0;
+            }
+            if (code != 0)
+                *hdr |= (unsigned char)(code << COMPACT_TYPE_BITS);
+            else
+                out = compact_put_varint(out, entry->size);
+            out = compact_put_varint(out, compact_zigzag(entry->addr - prev_addr));
+            prev_addr = entry->addr;
+        } else if (type_is_instr((trace_type_t)entry->type) &&
+                   entry->type != TRACE_TYPE_INSTR_BUNDLE) {
+            out = compact_put_varint(out, entry->size);
+            out = compact_put_varint(out, compact_zigzag(entry->addr - next_pc));
+            next_pc = entry->addr + entry->size;
+        } else if (entry->type == TRACE_TYPE_INSTR_BUNDLE) {
+            out = compact_put_varint(out, entry->size);
+            for (unsigned short j = 0; j < entry->size; j++) {
+                *out++ = entry->length[j];
+                next_pc += entry->length[j];
+            }
+        } else {
+            out = compact_put_varint(out, entry->size);
+            out = compact_put_varint(out, entry->addr);
+        }
+    }
+    size_t payload = out - dst - COMPACT_PACKET_HEADER_SIZE;
+    dst[0] = (unsigned char)(payload & 0xff);
+    dst[1] = (unsigned char)(payload >> 8);
+    return out - dst;
+}
+
+// Returns the payload length of the packet starting at src.
+static inline size_t
+compact_packet_payload_size(const unsigned char *src)
+{
+    return src[0] | ((size_t)src[1] << 8);
+}
+
+// Decodes a packet payload of len bytes into dst, which must have room for
+// COMPACT_MAX_ENTRIES(len) entries.  Returns the number of entries decoded,
+// or -1 if the payload is malformed.
+static inline int
+compact_decode_payload(const unsigned char *src, size_t len, trace_entry_t *dst)
+{
+    const unsigned char *end = src + len;
+    addr_t prev_addr = 0, next_pc = 0;
+    int num = 0;
+    while (src < end) {
+        trace_entry_t *entry = &dst[num++];
+        unsigned char hdr = *src++;
+        addr_t val = 0;
+        int code = hdr >> COMPACT_TYPE_BITS;
+        entry->type = hdr & COMPACT_TYPE_MASK;
+        if (code != 0) {
+            if (!compact_type_is_data(entry->type))
+                return -1;
+            entry->size = (unsigned short)(1 << (code - 1));
+        } else {
+            src = compact_get_varint(src, end, &val);
+            if (src == NULL)
+                return -1;
+            entry->size = (unsigned short)val;
+        }
+        if (entry->type == TRACE_TYPE_INSTR_BUNDLE) {
+            if (entry->size > sizeof(entry->length) ||
+                src + entry->size > end)
+                return -1;
+            entry->addr = 0;
+            for (unsigned short j = 0; j < entry->size; j++) {
+                entry->length[j] = *src++;
+                next_pc += entry->length[j];
+            }
+            continue;
+        }
+        src = compact_get_varint(src, end, &val);
+        if (src == NULL)
+            return -1;
+        if (compact_type_is_data(entry->type)) {
+            entry->addr = prev_addr + compact_unzigzag(val);
+            prev_addr = entry->addr;
+        } else if (type_is_instr((trace_type_t)entry->type)) {
+            entry->addr = next_pc + compact_unzigzag(val);
+            next_pc = entry->addr + entry->size;
+        } else
+            entry->addr = val;
+    }
+    return num;
+}
+
+#endif /* _COMPACT_ENTRY_H_ */
@@ -50,6 +50,14 @@ droption_t<std::string> op_ipc_name
  "for each instance of the simulator being run at any one time.  On Windows, the name "
  "is limited to 247 characters.");
 
+droption_t<bool> op_ipc_compact
+(DROPTION_SCOPE_ALL, "ipc_compact", false, "Use a compact encoding for online traces",
+ "For online tracing and simulation, sends trace entries through the named pipe in "
+ "a variable-length encoding that omits implicit sizes and represents addresses as "
+ "deltas, rather than as fixed-size records.  This reduces the pipe bandwidth "
+ "needed at the cost of encoding and decoding time.  Run with -verbose 1 to see "
+ "the resulting number of bytes sent per trace entry.");
+
 droption_t<std::string> op_outdir
 (DROPTION_SCOPE_ALL, "outdir", ".", "Target directory for offline trace files",
  "For the offline analysis mode (when -offline is requested), specifies the path "
@@ -168,7 +176,10 @@ droption_t<std::string> op_TLB_replace_policy
 droption_t<std::string> op_simulator_type
 (DROPTION_SCOPE_FRONTEND, "simulator_type", CPU_CACHE,
  "Simulator type", "Specifies the type of the simulator. "
- "Supported types: " CPU_CACHE", " TLB".");
+ "Supported types: " CPU_CACHE", " TLB", " HISTOGRAM", " REUSE_DIST", " SHARING", "
+ WORKING_SET".  Several types may be listed, separated by ':', to analyze the same "
+ "trace with each of them: each analysis runs concurrently on its own thread.  "
+ "See also -fanout_drop.");
 
 droption_t<unsigned int> op_verbose
 (DROPTION_SCOPE_ALL, "verbose", 0, 0, 64, "Verbosity level",
@@ -227,3 +238,43 @@ droption_t<unsigned int> op_reuse_distance_threshold
  "Specifies the reuse distance threshold for reporting the distant repeated references. "
  "A reference is a distant repeated reference if the distance to the previous reference"
  " on the same cache line exceeds the threshold.");
+
+droption_t<bytesize_t> op_working_set_window
+(DROPTION_SCOPE_FRONTEND, "working_set_window", 10000000,
+ "Number of instructions per working set window",
+ "For the working set analysis (-simulator_type " WORKING_SET "), specifies the "
+ "number of instructions in each window for which the unique cache lines and pages "
+ "touched are reported.  A value of 0 reports only the whole-trace footprint.");
+
+droption_t<unsigned int> op_working_set_precision
+(DROPTION_SCOPE_FRONTEND, "working_set_precision", 12, 4, 16,
+ "Precision of the working set estimates",
+ "For the working set analysis (-simulator_type " WORKING_SET "), specifies the "
+ "log2 of the number of registers in each cardinality sketch.  Each sketch uses "
+ "2^precision bytes and has a standard error of about 1.04/sqrt(2^precision), "
+ "regardless of the footprint size.");
+
+droption_t<bool> op_miss_pcs
+(DROPTION_SCOPE_FRONTEND, "miss_pcs", false, "Attribute cache misses to instructions",
+ "For the CPU cache simulator, counts the misses in each cache by the address of the "
+ "instruction responsible: the instruction itself for an instruction fetch and the "
+ "instruction performing the access for a data reference.  The -report_top "
+ "instructions with the most misses are reported for the L1 instruction caches, the "
+ "L1 data caches, and the last-level cache.  If a module list is available (see "
+ "-module_file), each instruction is described by its module, function, and source "
+ "line.");
+
+droption_t<std::string> op_module_file
+(DROPTION_SCOPE_FRONTEND, "module_file", "", "Module list for symbolization",
+ "Specifies the module list file written by the tracer, used to symbolize the "
+ "instructions reported by -miss_pcs.  For offline traces passed via -indir, the "
+ "module list in that directory is used by default.");
+
+droption_t<bool> op_fanout_drop
+(DROPTION_SCOPE_FRONTEND, "fanout_drop", false,
+ "Drop trace data for slow analyses",
+ "When several analyzer types are given to -simulator_type, each consumes the trace "
+ "from a shared buffer, and by default the slowest one limits the rate at which "
+ "the trace is read.  If this option is enabled, an analysis that falls a full "
+ "buffer behind instead misses that buffer's memory references, and the number it "
+ "missed is reported at the end.");
@@ -43,12 +43,16 @@
 #define TLB                                     "TLB"
 #define HISTOGRAM                               "histogram"
 #define REUSE_DIST                              "reuse_distance"
+#define SHARING                                 "sharing"
+#define WORKING_SET                             "working_set"
+#define TOOL_TYPE_SEPARATOR                     ':'
 
 #include <string>
 #include "droption.h"
 
 extern droption_t<bool> op_offline;
 extern droption_t<std::string> op_ipc_name;
+extern droption_t<bool> op_ipc_compact;
 extern droption_t<std::string> op_outdir;
 extern droption_t<std::string> op_infile;
 extern droption_t<std::string> op_indir;
@@ -85,4 +89,9 @@ extern droption_t<bytesize_t> op_warmup_refs;
 extern droption_t<bytesize_t> op_sim_refs;
 extern droption_t<unsigned int> op_report_top;
 extern droption_t<unsigned int> op_reuse_distance_threshold;
+extern droption_t<bytesize_t> op_working_set_window;
+extern droption_t<unsigned int> op_working_set_precision;
+extern droption_t<bool> op_miss_pcs;
+extern droption_t<std::string> op_module_file;
+extern droption_t<bool> op_fanout_drop;
 #endif /* _OPTIONS_H_ */
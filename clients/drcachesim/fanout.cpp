@@ -0,0 +1,280 @@
+/* **********************************************************
+ * Copyright (c) 2017 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <string.h>
+#include "fanout.h"
+#include "common/utils.h"
+
+fanout_t::fanout_t(analysis_tool_t **tools, int num_tools_, bool drop_when_full_) :
+    success(true), drop_when_full(drop_when_full_), done(false), filling(NULL),
+    produced(0), num_tools(num_tools_), num_consumers(0)
+{
+#ifdef WINDOWS
+    InitializeCriticalSection(&mutex);
+    InitializeConditionVariable(&data_cond);
+    InitializeConditionVariable(&space_cond);
+#else
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&data_cond, NULL);
+    pthread_cond_init(&space_cond, NULL);
+#endif
+    ring = new chunk_t[NUM_CHUNKS];
+    consumers = new consumer_t[num_tools];
+    for (int i = 0; i < num_tools; i++) {
+        consumer_t *consumer = &consumers[i];
+        consumer->fanout = this;
+        consumer->tool = tools[i];
+        consumer->index = i;
+        consumer->next = 0;
+        consumer->local = drop_when_full ? new chunk_t : NULL;
+        consumer->result = true;
+        consumer->dropped = 0;
+#ifdef WINDOWS
+        consumer->thread = CreateThread(NULL, 0, consumer_main, consumer, 0, NULL);
+        if (consumer->thread == NULL) {
+#else
+        if (pthread_create(&consumer->thread, NULL, consumer_main, consumer) != 0) {
+#endif
+            ERRMSG("Failed to create analysis tool thread\n");
+            success = false;
+            break;
+        }
+        num_consumers++;
+    }
+}
+
+fanout_t::~fanout_t()
+{
+    if (!done)
+        finish();
+    for (int i = 0; i < num_tools; i++)
+        delete consumers[i].local;
+    delete [] consumers;
+    delete [] ring;
+#ifdef WINDOWS
+    DeleteCriticalSection(&mutex);
+#else
+    pthread_cond_destroy(&space_cond);
+    pthread_cond_destroy(&data_cond);
+    pthread_mutex_destroy(&mutex);
+#endif
+}
+
+void
+fanout_t::lock()
+{
+#ifdef WINDOWS
+    EnterCriticalSection(&mutex);
+#else
+    pthread_mutex_lock(&mutex);
+#endif
+}
+
+void
+fanout_t::unlock()
+{
+#ifdef WINDOWS
+    LeaveCriticalSection(&mutex);
+#else
+    pthread_mutex_unlock(&mutex);
+#endif
+}
+
+void
+fanout_t::wait_for_data()
+{
+#ifdef WINDOWS
+    SleepConditionVariableCS(&data_cond, &mutex, INFINITE);
+#else
+    pthread_cond_wait(&data_cond, &mutex);
+#endif
+}
+
+void
+fanout_t::wait_for_space()
+{
+#ifdef WINDOWS
+    SleepConditionVariableCS(&space_cond, &mutex, INFINITE);
+#else
+    pthread_cond_wait(&space_cond, &mutex);
+#endif
+}
+
+void
+fanout_t::signal_data()
+{
+#ifdef WINDOWS
+    WakeAllConditionVariable(&data_cond);
+#else
+    pthread_cond_broadcast(&data_cond);
+#endif
+}
+
+void
+fanout_t::signal_space()
+{
+    // There is only one producer.
+#ifdef WINDOWS
+    WakeConditionVariable(&space_cond);
+#else
+    pthread_cond_signal(&space_cond);
+#endif
+}
+
+#ifdef WINDOWS
+DWORD WINAPI
+fanout_t::consumer_main(LPVOID arg)
+#else
+void *
+fanout_t::consumer_main(void *arg)
+#endif
+{
+    consumer_t *consumer = (consumer_t *) arg;
+    consumer->fanout->consume(consumer);
+    return 0;
+}
+
+void
+fanout_t::consume(consumer_t *consumer)
+{
+    lock();
+    while (true) {
+        while (consumer->next >= produced && !done)
+            wait_for_data();
+        if (consumer->next >= produced)
+            break;
+        chunk_t *chunk = &ring[consumer->next % NUM_CHUNKS];
+        if (drop_when_full) {
+            // The producer may refill the chunk as soon as we move past it.
+            consumer->local->count = chunk->count;
+            memcpy(consumer->local->refs, chunk->refs, chunk->count * sizeof(memref_t));
+            chunk = consumer->local;
+            consumer->next++;
+        }
+        // Otherwise, the producer will not refill the chunk until we move
+        // past it, so we can drop the lock while we process it.
+        unlock();
+        for (int i = 0; i < chunk->count; i++)
+            consumer->result = consumer->tool->process_memref(chunk->refs[i]) &&
+                consumer->result;
+        lock();
+        if (!drop_when_full) {
+            consumer->next++;
+            signal_space();
+        }
+    }
+    unlock();
+}
+
+// Must be called with the lock held.
+bool
+fanout_t::chunk_is_free(uint64_t seq)
+{
+    if (seq < NUM_CHUNKS)
+        return true;
+    // Every consumer has processed everything older than this chunk's
+    // previous contents, so a consumer that still needs those contents is
+    // exactly one ring behind.
+    uint64_t prior = seq - NUM_CHUNKS;
+    bool is_free = true;
+    for (int i = 0; i < num_consumers; i++) {
+        consumer_t *consumer = &consumers[i];
+        if (consumer->next > prior)
+            continue;
+        if (drop_when_full) {
+            consumer->dropped += ring[prior % NUM_CHUNKS].count;
+            consumer->next = prior + 1;
+        } else
+            is_free = false;
+    }
+    return is_free;
+}
+
+void
+fanout_t::claim_chunk()
+{
+    lock();
+    while (!chunk_is_free(produced))
+        wait_for_space();
+    unlock();
+    filling = &ring[produced % NUM_CHUNKS];
+    filling->count = 0;
+}
+
+void
+fanout_t::publish_chunk()
+{
+    lock();
+    produced++;
+    signal_data();
+    unlock();
+    filling = NULL;
+}
+
+void
+fanout_t::push(const memref_t &memref)
+{
+    if (filling == NULL)
+        claim_chunk();
+    filling->refs[filling->count++] = memref;
+    if (filling->count == CHUNK_SIZE)
+        publish_chunk();
+}
+
+bool
+fanout_t::finish()
+{
+    bool res = true;
+    if (filling != NULL && filling->count > 0)
+        publish_chunk();
+    lock();
+    done = true;
+    signal_data();
+    unlock();
+    for (int i = 0; i < num_consumers; i++) {
+#ifdef WINDOWS
+        WaitForSingleObject(consumers[i].thread, INFINITE);
+        CloseHandle(consumers[i].thread);
+#else
+        pthread_join(consumers[i].thread, NULL);
+#endif
+        res = consumers[i].result && res;
+    }
+    num_consumers = 0;
+    return res;
+}
+
+uint64_t
+fanout_t::get_dropped(int tool) const
+{
+    return consumers[tool].dropped;
+}
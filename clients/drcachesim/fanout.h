@@ -0,0 +1,135 @@
+/* **********************************************************
+ * Copyright (c) 2017 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* fanout: distributes a single memref stream to multiple analysis tools that
+ * each run on their own thread.
+ */
+
+#ifndef _FANOUT_H_
+#define _FANOUT_H_ 1
+
+#ifdef WINDOWS
+# define WIN32_LEAN_AND_MEAN
+# include <windows.h>
+#else
+# include <pthread.h>
+#endif
+#include "analysis_tool.h"
+#include "common/memref.h"
+
+// The producer copies memrefs into fixed-size chunks in a ring shared by all
+// consumers.  Each consumer tracks the next chunk it will process.  A chunk
+// can only be refilled once every consumer is past it, so by default the
+// slowest consumer throttles the producer.  If drop_when_full is set, each
+// consumer instead works on a private copy of its chunk so that the producer
+// never waits: a consumer that is a full ring behind loses the chunk the
+// producer needs, and the number of memrefs it missed is counted.
+class fanout_t
+{
+ public:
+    // Usage: errors encountered during the constructor will set a flag that should
+    // be queried via operator!.
+    fanout_t(analysis_tool_t **tools, int num_tools, bool drop_when_full);
+    virtual ~fanout_t();
+    virtual bool operator!() { return !success; }
+
+    // Hands one memref to every tool.  May block on the slowest tool unless
+    // drop_when_full was requested.
+    void push(const memref_t &memref);
+    // Delivers any remaining memrefs and waits for the tools to finish.
+    // Returns the combined result of the tools' process_memref() calls.
+    bool finish();
+    // Returns the number of memrefs the given tool never saw.
+    uint64_t get_dropped(int tool) const;
+
+ protected:
+    static const int CHUNK_SIZE = 1024;
+    static const int NUM_CHUNKS = 64;
+
+    struct chunk_t {
+        memref_t refs[CHUNK_SIZE];
+        int count;
+    };
+
+    struct consumer_t {
+        fanout_t *fanout;
+        analysis_tool_t *tool;
+        int index;
+        uint64_t next;   // The sequence number of the next chunk to process.
+        chunk_t *local;  // The private copy used with drop_when_full.
+        bool result;
+        uint64_t dropped;
+#ifdef WINDOWS
+        HANDLE thread;
+#else
+        pthread_t thread;
+#endif
+    };
+
+#ifdef WINDOWS
+    static DWORD WINAPI consumer_main(LPVOID arg);
+#else
+    static void *consumer_main(void *arg);
+#endif
+    void consume(consumer_t *consumer);
+    bool chunk_is_free(uint64_t seq);
+    void claim_chunk();
+    void publish_chunk();
+
+    void lock();
+    void unlock();
+    void wait_for_data();
+    void wait_for_space();
+    void signal_data();
+    void signal_space();
+
+    bool success;
+    bool drop_when_full;
+    bool done;
+    chunk_t *ring;
+    chunk_t *filling;
+    uint64_t produced;  // The number of chunks published so far.
+    int num_tools;
+    int num_consumers;  // The number of consumer threads started.
+    consumer_t *consumers;
+#ifdef WINDOWS
+    CRITICAL_SECTION mutex;
+    CONDITION_VARIABLE data_cond;
+    CONDITION_VARIABLE space_cond;
+#else
+    pthread_mutex_t mutex;
+    pthread_cond_t data_cond;
+    pthread_cond_t space_cond;
+#endif
+};
+
+#endif /* _FANOUT_H_ */
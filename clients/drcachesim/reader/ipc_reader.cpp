@@ -32,7 +32,9 @@
 
 #include <assert.h>
 #include <map>
+#include <string.h>
 #include "ipc_reader.h"
+#include "../common/compact_entry.h"
 #include "../common/memref.h"
 #include "../common/utils.h"
 
@@ -40,15 +42,16 @@
 # include <iostream>
 #endif
 
-ipc_reader_t::ipc_reader_t()
+ipc_reader_t::ipc_reader_t() : compact(false), raw_buf(NULL), raw_len(0)
 {
     /* Empty. */
 }
 
-ipc_reader_t::ipc_reader_t(const char *ipc_name) :
-    pipe(ipc_name)
+ipc_reader_t::ipc_reader_t(const char *ipc_name, bool compact_) :
+    pipe(ipc_name), compact(compact_), raw_buf(NULL), raw_len(0)
 {
-    /* Empty. */
+    if (compact)
+        raw_buf = new unsigned char[RAW_BUF_SIZE];
 }
 
 bool
@@ -69,13 +72,67 @@ ipc_reader_t::~ipc_reader_t()
 {
     pipe.close();
     pipe.destroy();
+    delete [] raw_buf;
+}
+
+// Fills buf with the entries from as many complete packets as fit.
+bool
+ipc_reader_t::read_compact_packets()
+{
+    trace_entry_t *buf_end = buf + BUF_SIZE;
+    size_t pos = 0;
+    end_buf = buf;
+    while (true) {
+        if (raw_len - pos >= COMPACT_PACKET_HEADER_SIZE) {
+            size_t payload = compact_packet_payload_size(raw_buf + pos);
+            if (COMPACT_PACKET_HEADER_SIZE + payload > RAW_BUF_SIZE) {
+                ERRMSG("Invalid compact trace packet size %d\n", (int)payload);
+                return false;
+            }
+            if (raw_len - pos >= COMPACT_PACKET_HEADER_SIZE + payload) {
+                if (buf_end - end_buf < (ssize_t)COMPACT_MAX_ENTRIES(payload))
+                    break;
+                int num = compact_decode_payload
+                    (raw_buf + pos + COMPACT_PACKET_HEADER_SIZE, payload, end_buf);
+                if (num < 0) {
+                    ERRMSG("Invalid compact trace packet\n");
+                    return false;
+                }
+                end_buf += num;
+                pos += COMPACT_PACKET_HEADER_SIZE + payload;
+                continue;
+            }
+        }
+        // We only block for more data if we have nothing to return yet.
+        if (end_buf > buf)
+            break;
+        memmove(raw_buf, raw_buf + pos, raw_len - pos);
+        raw_len -= pos;
+        pos = 0;
+        ssize_t sz = pipe.read(raw_buf + raw_len, RAW_BUF_SIZE - raw_len); // blocking
+        if (sz <= 0)
+            return false;
+        raw_len += sz;
+    }
+    memmove(raw_buf, raw_buf + pos, raw_len - pos);
+    raw_len -= pos;
+    return true;
 }
 
 trace_entry_t *
 ipc_reader_t::read_next_entry()
 {
     ++cur_buf;
-    if (cur_buf >= end_buf) {
+    if (cur_buf >= end_buf && compact) {
+        if (!read_compact_packets()) {
+            cur_buf = buf;
+            cur_buf->type = TRACE_TYPE_FOOTER;
+            cur_buf->size = 0;
+            cur_buf->addr = 0;
+            return cur_buf;
+        }
+        cur_buf = buf;
+    } else if (cur_buf >= end_buf) {
         ssize_t sz = pipe.read(buf, sizeof(buf)); // blocking read
         if (sz < 0 || sz % sizeof(*end_buf) != 0) {
             // We aren't able to easily distinguish truncation from a clean
@@ -47,7 +47,9 @@ class ipc_reader_t : public reader_t
 {
  public:
     ipc_reader_t();
-    explicit ipc_reader_t(const char *ipc_name);
+    // If compact is set, the stream is expected to use the encoding in
+    // compact_entry.h.
+    explicit ipc_reader_t(const char *ipc_name, bool compact = false);
     virtual ~ipc_reader_t();
     // This potentially blocks.
     virtual bool init();
@@ -56,7 +58,10 @@ class ipc_reader_t : public reader_t
     virtual trace_entry_t * read_next_entry();
 
  private:
+    bool read_compact_packets();
+
     named_pipe_t pipe;
+    bool compact;
 
     // For efficiency we want to read large chunks at a time.
     // The atomic write size for a pipe on Linux is 4096 bytes but
@@ -66,6 +71,13 @@ class ipc_reader_t : public reader_t
     trace_entry_t buf[BUF_SIZE];
     trace_entry_t *cur_buf;
     trace_entry_t *end_buf;
+
+    // For a compact stream, we read raw packets here and decode them into buf.
+    // A single read may end in the middle of a packet, so we keep any partial
+    // packet at the start of raw_buf for the next read.
+    static const int RAW_BUF_SIZE = 64*1024;
+    unsigned char *raw_buf;
+    size_t raw_len;
 };
 
 #endif /* _IPC_READER_H_ */
@@ -47,6 +47,9 @@
 #include "cache_fifo.h"
 #include "cache_simulator.h"
 #include "droption.h"
+#include "../tracer/raw2trace.h"
+#include <algorithm>
+#include <iomanip>
 
 cache_simulator_t::cache_simulator_t()
 {
@@ -61,7 +64,8 @@ cache_simulator_t::cache_simulator_t()
     }
 
     if (!llcache->init(op_LL_assoc.get_value(), (int)op_line_size.get_value(),
-                       (int)op_LL_size.get_value(), NULL, new cache_stats_t)) {
+                       (int)op_LL_size.get_value(), NULL,
+                       new cache_stats_t(op_miss_pcs.get_value()))) {
         ERRMSG("Usage error: failed to initialize LL cache.  Ensure sizes and "
                "associativity are powers of 2 "
                "and that the total size is a multiple of the line size.\n");
@@ -84,9 +88,11 @@ cache_simulator_t::cache_simulator_t()
         }
 
         if (!icaches[i]->init(op_L1I_assoc.get_value(), (int)op_line_size.get_value(),
-                              (int)op_L1I_size.get_value(), llcache, new cache_stats_t) ||
+                              (int)op_L1I_size.get_value(), llcache,
+                              new cache_stats_t(op_miss_pcs.get_value())) ||
             !dcaches[i]->init(op_L1D_assoc.get_value(), (int)op_line_size.get_value(),
-                              (int)op_L1D_size.get_value(), llcache, new cache_stats_t)) {
+                              (int)op_L1D_size.get_value(), llcache,
+                              new cache_stats_t(op_miss_pcs.get_value()))) {
             ERRMSG("Usage error: failed to initialize L1 caches.  Ensure sizes and "
                    "associativity are powers of 2 "
                    "and that the total sizes are multiples of the line size.\n");
@@ -211,9 +217,66 @@ cache_simulator_t::print_results()
     }
     std::cerr << "LL stats:" << std::endl;
     llcache->get_stats()->print_stats("    ");
+
+    if (op_miss_pcs.get_value()) {
+        // Offline traces have a module list we can use to symbolize.
+        std::string module_file = op_module_file.get_value();
+        if (module_file.empty() && !op_indir.get_value().empty()) {
+            module_file = op_indir.get_value();
+            if (module_file.find(OUTFILE_SUBDIR) == std::string::npos)
+                module_file += std::string(DIRSEP) + OUTFILE_SUBDIR;
+            module_file += std::string(DIRSEP) + DRMEMTRACE_MODULE_LIST_FILENAME;
+        }
+        pc_symbolizer_t *symbolizer = NULL;
+        if (!module_file.empty()) {
+            symbolizer = new pc_symbolizer_t(module_file);
+            if (!*symbolizer) {
+                delete symbolizer;
+                symbolizer = NULL;
+            }
+        }
+        print_miss_pcs("L1I", icaches, num_cores, symbolizer);
+        print_miss_pcs("L1D", dcaches, num_cores, symbolizer);
+        print_miss_pcs("LL", &llcache, 1, symbolizer);
+        delete symbolizer;
+    }
     return true;
 }
 
+static bool
+cmp_misses(const std::pair<addr_t, int_least64_t> &l,
+           const std::pair<addr_t, int_least64_t> &r)
+{
+    return l.second > r.second;
+}
+
+void
+cache_simulator_t::print_miss_pcs(const std::string &name, cache_t **caches,
+                                  int num_caches, pc_symbolizer_t *symbolizer)
+{
+    std::map<addr_t, int_least64_t> combined;
+    for (int i = 0; i < num_caches; i++) {
+        const std::map<addr_t, int_least64_t> &pcs =
+            caches[i]->get_stats()->get_miss_pcs();
+        for (std::map<addr_t, int_least64_t>::const_iterator it = pcs.begin();
+             it != pcs.end(); ++it)
+            combined[it->first] += it->second;
+    }
+    std::vector<std::pair<addr_t, int_least64_t> > top(op_report_top.get_value());
+    std::vector<std::pair<addr_t, int_least64_t> >::iterator end =
+        std::partial_sort_copy(combined.begin(), combined.end(),
+                               top.begin(), top.end(), cmp_misses);
+    std::cerr << name << " top " << (end - top.begin()) << " miss pcs:" << std::endl;
+    for (std::vector<std::pair<addr_t, int_least64_t> >::iterator it = top.begin();
+         it != end; ++it) {
+        std::cerr << std::setw(18) << std::hex << std::showbase << it->first << ": "
+                  << std::setw(12) << std::dec << it->second;
+        if (symbolizer != NULL)
+            std::cerr << "  " << symbolizer->describe(it->first);
+        std::cerr << std::endl;
+    }
+}
+
 cache_t*
 cache_simulator_t::create_cache(std::string policy)
 {
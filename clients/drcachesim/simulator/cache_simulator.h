@@ -40,6 +40,7 @@
 #include "simulator.h"
 #include "cache_stats.h"
 #include "cache.h"
+#include "pc_symbolizer.h"
 
 class cache_simulator_t : public simulator_t
 {
@@ -53,6 +54,11 @@ class cache_simulator_t : public simulator_t
     // Create a cache_t object with a specific replacement policy.
     virtual cache_t *create_cache(std::string policy);
 
+    // Prints the instructions responsible for the most misses in the
+    // given caches, combined.
+    virtual void print_miss_pcs(const std::string &name, cache_t **caches,
+                                int num_caches, pc_symbolizer_t *symbolizer);
+
     // Currently we only support a simple 2-level hierarchy.
     // XXX i#1715: add support for arbitrary cache layouts.
 
@@ -34,8 +34,9 @@
 #include <iomanip>
 #include "cache_stats.h"
 
-cache_stats_t::cache_stats_t() :
-    num_flushes(0), num_prefetch_hits(0), num_prefetch_misses(0)
+cache_stats_t::cache_stats_t(bool record_miss_pcs) :
+    caching_device_stats_t(record_miss_pcs), num_flushes(0), num_prefetch_hits(0),
+    num_prefetch_misses(0)
 {
 }
 
@@ -41,7 +41,7 @@
 class cache_stats_t : public caching_device_stats_t
 {
  public:
-    cache_stats_t();
+    cache_stats_t(bool record_miss_pcs = false);
 
     // In addition to caching_device_stats_t::access,
     // cache_stats_t::access processes prefetching requests.
@@ -34,8 +34,8 @@
 #include <iomanip>
 #include "caching_device_stats.h"
 
-caching_device_stats_t::caching_device_stats_t() :
-    num_hits(0), num_misses(0), num_child_hits(0)
+caching_device_stats_t::caching_device_stats_t(bool record_miss_pcs_) :
+    num_hits(0), num_misses(0), num_child_hits(0), record_miss_pcs(record_miss_pcs_)
 {
 }
 
@@ -48,10 +48,15 @@ caching_device_stats_t::access(const memref_t &memref, bool hit)
 {
     // We assume we're single-threaded.
     // We're only computing miss rate so we just inc counters here.
-    if (hit)
+    if (hit) {
         num_hits++;
-    else
+    } else {
         num_misses++;
+        if (record_miss_pcs) {
+            miss_pcs[type_is_instr(memref.instr.type) ?
+                     memref.instr.addr : memref.data.pc]++;
+        }
+    }
 }
 
 void
@@ -112,4 +117,5 @@ caching_device_stats_t::reset()
     num_hits = 0;
     num_misses = 0;
     num_child_hits = 0;
+    miss_pcs.clear();
 }
@@ -36,6 +36,7 @@
 #ifndef _CACHING_DEVICE_STATS_H_
 #define _CACHING_DEVICE_STATS_H_ 1
 
+#include <map>
 #include <string>
 #include <stdint.h>
 #include "../common/memref.h"
@@ -43,7 +44,10 @@
 class caching_device_stats_t
 {
  public:
-    caching_device_stats_t();
+    // If record_miss_pcs is set, misses are also counted per instruction
+    // address: the instruction's own address for a fetch and the address of
+    // the instruction performing the access for data.
+    caching_device_stats_t(bool record_miss_pcs = false);
     virtual ~caching_device_stats_t();
 
     // Called on each access.
@@ -58,6 +62,8 @@ class caching_device_stats_t
 
     virtual void reset();
 
+    const std::map<addr_t, int_least64_t> &get_miss_pcs() const { return miss_pcs; }
+
  protected:
     // print different groups of information, beneficial for code reuse
     virtual void print_counts(std::string prefix); // hit/miss numbers
@@ -67,6 +73,10 @@ class caching_device_stats_t
     int_least64_t num_hits;
     int_least64_t num_misses;
     int_least64_t num_child_hits;
+
+    bool record_miss_pcs;
+    /* XXX i#2020: use unsorted_map (C++11) for faster lookup */
+    std::map<addr_t, int_least64_t> miss_pcs;
 };
 
 #endif /* _CACHING_DEVICE_STATS_H_ */
@@ -0,0 +1,131 @@
+/* **********************************************************
+ * Copyright (c) 2017 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include "dr_api.h"
+#include "drcovlib.h"
+#include "drsyms.h"
+#include "pc_symbolizer.h"
+#include "../common/utils.h"
+#include <algorithm>
+#include <sstream>
+
+pc_symbolizer_t::pc_symbolizer_t(const std::string &module_file) :
+    success(true), syms_initialized(false)
+{
+    void *modhandle;
+    uint num_mods;
+    dr_standalone_init();
+    file_t modfile = dr_open_file(module_file.c_str(), DR_FILE_READ);
+    if (modfile == INVALID_FILE) {
+        ERRMSG("Failed to open module file %s\n", module_file.c_str());
+        success = false;
+        return;
+    }
+    if (drmodtrack_offline_read(modfile, NULL, &modhandle, &num_mods) !=
+        DRCOVLIB_SUCCESS) {
+        ERRMSG("Failed to parse module file %s\n", module_file.c_str());
+        dr_close_file(modfile);
+        success = false;
+        return;
+    }
+    for (uint i = 0; i < num_mods; i++) {
+        drmodtrack_info_t info = {sizeof(info),};
+        if (drmodtrack_offline_lookup(modhandle, i, &info) != DRCOVLIB_SUCCESS) {
+            success = false;
+            break;
+        }
+        segment_t seg;
+        seg.start = (addr_t)info.start;
+        seg.end = (addr_t)info.start + info.size;
+        seg.module_base = (addr_t)info.start;
+        seg.path = info.path;
+        // Later segments of a module are offset from its first segment.
+        if (info.containing_index != i && info.containing_index < segments.size())
+            seg.module_base = segments[info.containing_index].module_base;
+        segments.push_back(seg);
+    }
+    drmodtrack_offline_exit(modhandle);
+    dr_close_file(modfile);
+    std::sort(segments.begin(), segments.end(), segment_less);
+    if (drsym_init(IF_WINDOWS_ELSE(NULL, 0)) == DRSYM_SUCCESS)
+        syms_initialized = true;
+}
+
+pc_symbolizer_t::~pc_symbolizer_t()
+{
+    if (syms_initialized)
+        drsym_exit();
+}
+
+bool
+pc_symbolizer_t::segment_less(const segment_t &l, const segment_t &r)
+{
+    return l.start < r.start;
+}
+
+std::string
+pc_symbolizer_t::describe(addr_t pc)
+{
+    segment_t key;
+    key.start = pc;
+    std::vector<segment_t>::iterator it =
+        std::upper_bound(segments.begin(), segments.end(), key, segment_less);
+    if (it == segments.begin())
+        return "";
+    --it;
+    if (pc >= it->end)
+        return "";
+    size_t modoffs = (size_t)(pc - it->module_base);
+    std::ostringstream desc;
+    size_t slash = it->path.find_last_of("/\\");
+    desc << (slash == std::string::npos ? it->path : it->path.substr(slash + 1));
+    if (!syms_initialized)
+        return desc.str();
+    char name[256];
+    char file[MAXIMUM_PATH];
+    drsym_info_t sym;
+    sym.struct_size = sizeof(sym);
+    sym.name = name;
+    sym.name_size = BUFFER_SIZE_ELEMENTS(name);
+    sym.file = file;
+    sym.file_size = BUFFER_SIZE_ELEMENTS(file);
+    drsym_error_t res = drsym_lookup_address(it->path.c_str(), modoffs, &sym,
+                                             DRSYM_DEFAULT_FLAGS);
+    if (res == DRSYM_SUCCESS || res == DRSYM_ERROR_LINE_NOT_AVAILABLE) {
+        desc << "!" << name << "+0x" << std::hex << (modoffs - sym.start_offs)
+             << std::dec;
+        if (res == DRSYM_SUCCESS && sym.file != NULL && sym.file[0] != '\0')
+            desc << " " << file << ":" << sym.line;
+    } else
+        desc << "+0x" << std::hex << modoffs << std::dec;
+    return desc.str();
+}
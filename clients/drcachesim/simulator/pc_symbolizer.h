@@ -0,0 +1,71 @@
+/* **********************************************************
+ * Copyright (c) 2017 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* pc_symbolizer: maps program counters from a trace to modules, symbols, and
+ * source lines using the module list written by the tracer.
+ */
+
+#ifndef _PC_SYMBOLIZER_H_
+#define _PC_SYMBOLIZER_H_ 1
+
+#include <string>
+#include <vector>
+#include "../common/trace_entry.h"
+
+class pc_symbolizer_t
+{
+ public:
+    // Usage: errors encountered during the constructor will set a flag that should
+    // be queried via operator!.
+    pc_symbolizer_t(const std::string &module_file);
+    virtual ~pc_symbolizer_t();
+    virtual bool operator!() { return !success; }
+    // Returns a description of the form "module!symbol+offs file:line" with
+    // as much of that information as is available, or an empty string if pc
+    // is not inside any module.
+    virtual std::string describe(addr_t pc);
+
+ protected:
+    struct segment_t {
+        addr_t start;
+        addr_t end;
+        addr_t module_base; // The start of the module's first segment.
+        std::string path;
+    };
+    static bool segment_less(const segment_t &l, const segment_t &r);
+
+    bool success;
+    bool syms_initialized;
+    std::vector<segment_t> segments;
+};
+
+#endif /* _PC_SYMBOLIZER_H_ */
@@ -0,0 +1,137 @@
+/* **********************************************************
+ * Copyright (c) 2017 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* hyperloglog: a fixed-size sketch estimating the number of distinct values
+ * inserted into it.
+ */
+
+#ifndef _HYPERLOGLOG_H_
+#define _HYPERLOGLOG_H_ 1
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include "../common/trace_entry.h"
+
+// The sketch uses 2^precision one-byte registers and has a standard error of
+// about 1.04/sqrt(2^precision): 1.6% for the default precision of 12.
+// Sketches with the same precision can be merged, which yields the sketch of
+// the union of their inputs.
+class hyperloglog_t
+{
+ public:
+    hyperloglog_t(unsigned int precision_bits) :
+        precision(precision_bits), registers((size_t)1 << precision_bits, 0)
+    {
+    }
+
+    void
+    insert(addr_t value)
+    {
+        uint64_t hash = mix((uint64_t)value);
+        size_t idx = (size_t)(hash >> (64 - precision));
+        // Count the leading zeros of the remaining bits, plus one.  A sentinel
+        // bit bounds the result when those bits are all zero.
+        uint64_t rest = (hash << precision) | ((uint64_t)1 << (precision - 1));
+        unsigned char rank = 1;
+        while ((rest & ((uint64_t)1 << 63)) == 0) {
+            rank++;
+            rest <<= 1;
+        }
+        if (rank > registers[idx])
+            registers[idx] = rank;
+    }
+
+    void
+    merge(const hyperloglog_t &other)
+    {
+        for (size_t i = 0; i < registers.size() && i < other.registers.size(); i++) {
+            if (other.registers[i] > registers[i])
+                registers[i] = other.registers[i];
+        }
+    }
+
+    void
+    clear()
+    {
+        memset(&registers[0], 0, registers.size());
+    }
+
+    uint64_t
+    estimate() const
+    {
+        double m = (double)registers.size();
+        double sum = 0;
+        size_t zeroes = 0;
+        for (size_t i = 0; i < registers.size(); i++) {
+            sum += ldexp(1.0, -(int)registers[i]);
+            if (registers[i] == 0)
+                zeroes++;
+        }
+        // The bias correction constant: the closed form only holds from 128
+        // registers up.
+        double alpha;
+        if (registers.size() == 16)
+            alpha = 0.673;
+        else if (registers.size() == 32)
+            alpha = 0.697;
+        else if (registers.size() == 64)
+            alpha = 0.709;
+        else
+            alpha = 0.7213 / (1 + 1.079 / m);
+        double est = alpha * m * m / sum;
+        // Use linear counting for small cardinalities where the raw estimate
+        // is biased.
+        if (est <= 2.5 * m && zeroes > 0)
+            est = m * log(m / (double)zeroes);
+        return (uint64_t)(est + 0.5);
+    }
+
+ private:
+    // A 64-bit finalizer with good avalanche behavior, so that nearby
+    // addresses spread over all registers.
+    static inline uint64_t
+    mix(uint64_t x)
+    {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return x;
+    }
+
+    unsigned int precision;
+    std::vector<unsigned char> registers;
+};
+
+#endif /* _HYPERLOGLOG_H_ */
@@ -0,0 +1,310 @@
+/* **********************************************************
+ * Copyright (c) 2017 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "droption.h"
+#include "sharing.h"
+#include "../common/options.h"
+#include "../common/utils.h"
+
+const std::string sharing_t::TOOL_NAME = "Cache line sharing";
+
+static inline unsigned int
+count_bits(uint64_t set)
+{
+    unsigned int count = 0;
+    for (; set != 0; set &= set - 1)
+        count++;
+    return count;
+}
+
+sharing_t::sharing_t() :
+    total_refs(0), total_true_shares(0), total_false_shares(0)
+{
+    line_size = op_line_size.get_value();
+    line_size_bits = compute_log2((int)line_size);
+    // Each line's byte masks are a single 64-bit word: for lines larger than
+    // 64 bytes each bit covers several bytes.
+    granule_bits = line_size_bits > 6 ? line_size_bits - 6 : 0;
+    report_top = op_report_top.get_value();
+    if (op_verbose.get_value() >= 2) {
+        std::cerr << "cache line size " << line_size << ", "
+                  << "sharing granule " << (1 << granule_bits) << std::endl;
+    }
+}
+
+sharing_t::~sharing_t()
+{
+}
+
+unsigned int
+sharing_t::thread_index(memref_tid_t tid)
+{
+    std::map<memref_tid_t, unsigned int>::iterator it = tid2idx.find(tid);
+    if (it != tid2idx.end())
+        return it->second;
+    unsigned int idx = (unsigned int)tid2idx.size();
+    if (idx >= SHARING_MAX_THREAD_BITS)
+        idx = SHARING_MAX_THREAD_BITS - 1;
+    tid2idx[tid] = idx;
+    return idx;
+}
+
+// Returns the mask of granules covering the line offsets [start, end].
+uint64_t
+sharing_t::granule_mask(addr_t start, addr_t end)
+{
+    addr_t first = start >> granule_bits;
+    addr_t last = end >> granule_bits;
+    if (last - first + 1 >= 64)
+        return ~(uint64_t)0;
+    return (((uint64_t)1 << (last - first + 1)) - 1) << first;
+}
+
+void
+sharing_t::record_share(line_sharing_t &line, bool is_true, addr_t pc)
+{
+    if (is_true) {
+        line.true_shares++;
+        total_true_shares++;
+        pc_map[pc].true_shares++;
+        if (line.last_write_pc != pc && line.last_write_pc != 0)
+            pc_map[line.last_write_pc].true_shares++;
+    } else {
+        line.false_shares++;
+        total_false_shares++;
+        pc_map[pc].false_shares++;
+        if (line.last_write_pc != pc && line.last_write_pc != 0)
+            pc_map[line.last_write_pc].false_shares++;
+    }
+}
+
+line_thread_t &
+sharing_t::line_thread(line_sharing_t &line, unsigned int tidx)
+{
+    for (std::vector<line_thread_t>::iterator it = line.threads.begin();
+         it != line.threads.end(); ++it) {
+        if (it->tidx == tidx)
+            return *it;
+    }
+    line.threads.push_back(line_thread_t((unsigned short)tidx));
+    return line.threads.back();
+}
+
+void
+sharing_t::access_line(addr_t tag, uint64_t mask, unsigned int tidx, bool is_write,
+                       addr_t pc)
+{
+    line_sharing_t &line = line_map[tag];
+    uint64_t tbit = (uint64_t)1 << tidx;
+    line_thread_t &self = line_thread(line, tidx);
+    if (is_write) {
+        // A write transfers the line if other threads hold a copy, which it
+        // invalidates.
+        if ((line.holders & ~tbit) != 0) {
+            uint64_t others = 0;
+            for (std::vector<line_thread_t>::iterator it = line.threads.begin();
+                 it != line.threads.end(); ++it) {
+                if (it->tidx == tidx || (line.holders & ((uint64_t)1 << it->tidx)) == 0)
+                    continue;
+                others |= it->read_mask | it->write_mask;
+                it->read_mask = 0;
+                it->write_mask = 0;
+            }
+            record_share(line, (mask & others) != 0, pc);
+        }
+        if ((line.holders & tbit) == 0) {
+            self.read_mask = 0;
+            self.write_mask = 0;
+        }
+        self.write_mask |= mask;
+        line.holders = tbit;
+        line.last_write_pc = pc;
+        line.writers |= tbit;
+    } else {
+        // A read by a thread without a copy transfers the line from the
+        // threads holding written bytes.
+        if ((line.holders & tbit) == 0) {
+            uint64_t written = 0;
+            for (std::vector<line_thread_t>::iterator it = line.threads.begin();
+                 it != line.threads.end(); ++it) {
+                if ((line.holders & ((uint64_t)1 << it->tidx)) != 0)
+                    written |= it->write_mask;
+            }
+            if (written != 0)
+                record_share(line, (mask & written) != 0, pc);
+            self.read_mask = 0;
+            self.write_mask = 0;
+            line.holders |= tbit;
+        }
+        self.read_mask |= mask;
+        line.readers |= tbit;
+    }
+}
+
+bool
+sharing_t::process_memref(const memref_t &memref)
+{
+    // Prefetches do not change the line's contents and are not considered.
+    if (memref.data.type != TRACE_TYPE_READ && memref.data.type != TRACE_TYPE_WRITE)
+        return true;
+    total_refs++;
+    unsigned int tidx = thread_index(memref.data.tid);
+    addr_t start = memref.data.addr;
+    addr_t last = start + (memref.data.size == 0 ? 0 : memref.data.size - 1);
+    // An access that straddles lines is handled as one access per line.
+    for (addr_t tag = start >> line_size_bits; tag <= last >> line_size_bits; ++tag) {
+        addr_t line_start = tag << line_size_bits;
+        addr_t line_last = line_start + line_size - 1;
+        addr_t lo = start > line_start ? start : line_start;
+        addr_t hi = last < line_last ? last : line_last;
+        access_line(tag, granule_mask(lo - line_start, hi - line_start), tidx,
+                    memref.data.type == TRACE_TYPE_WRITE, memref.data.pc);
+    }
+    return true;
+}
+
+static bool
+cmp_line_false(const std::pair<addr_t, line_sharing_t> &l,
+               const std::pair<addr_t, line_sharing_t> &r)
+{
+    if (l.second.false_shares != r.second.false_shares)
+        return l.second.false_shares > r.second.false_shares;
+    return l.second.true_shares > r.second.true_shares;
+}
+
+static bool
+cmp_line_true(const std::pair<addr_t, line_sharing_t> &l,
+              const std::pair<addr_t, line_sharing_t> &r)
+{
+    if (l.second.true_shares != r.second.true_shares)
+        return l.second.true_shares > r.second.true_shares;
+    return l.second.false_shares > r.second.false_shares;
+}
+
+static bool
+cmp_pc_false(const std::pair<addr_t, pc_sharing_t> &l,
+             const std::pair<addr_t, pc_sharing_t> &r)
+{
+    if (l.second.false_shares != r.second.false_shares)
+        return l.second.false_shares > r.second.false_shares;
+    return l.second.true_shares > r.second.true_shares;
+}
+
+static bool
+cmp_pc_true(const std::pair<addr_t, pc_sharing_t> &l,
+            const std::pair<addr_t, pc_sharing_t> &r)
+{
+    if (l.second.true_shares != r.second.true_shares)
+        return l.second.true_shares > r.second.true_shares;
+    return l.second.false_shares > r.second.false_shares;
+}
+
+bool
+sharing_t::print_results()
+{
+    uint64_t shared_lines = 0, multi_writer_lines = 0;
+    uint64_t false_lines = 0, true_lines = 0;
+    for (std::map<addr_t, line_sharing_t>::iterator it = line_map.begin();
+         it != line_map.end(); ++it) {
+        if (count_bits(it->second.readers | it->second.writers) > 1)
+            shared_lines++;
+        if (count_bits(it->second.writers) > 1)
+            multi_writer_lines++;
+        if (it->second.false_shares > 0)
+            false_lines++;
+        if (it->second.true_shares > 0)
+            true_lines++;
+    }
+    std::cerr << TOOL_NAME << " result:\n";
+    std::cerr << TOOL_NAME << ": " << tid2idx.size() << " threads\n";
+    std::cerr << TOOL_NAME << ": " << total_refs << " data references\n";
+    std::cerr << TOOL_NAME << ": " << line_map.size() << " unique cache lines\n";
+    std::cerr << TOOL_NAME << ": " << shared_lines
+              << " cache lines accessed by multiple threads\n";
+    std::cerr << TOOL_NAME << ": " << multi_writer_lines
+              << " cache lines written by multiple threads\n";
+    std::cerr << TOOL_NAME << ": " << true_lines << " cache lines with "
+              << total_true_shares << " true sharing transfers\n";
+    std::cerr << TOOL_NAME << ": " << false_lines << " cache lines with "
+              << total_false_shares << " false sharing transfers\n";
+
+    std::vector<std::pair<addr_t, line_sharing_t> > top_lines(report_top);
+    for (int pass = 0; pass < 2; pass++) {
+        std::vector<std::pair<addr_t, line_sharing_t> >::iterator end =
+            std::partial_sort_copy(line_map.begin(), line_map.end(),
+                                   top_lines.begin(), top_lines.end(),
+                                   pass == 0 ? cmp_line_false : cmp_line_true);
+        std::cerr << TOOL_NAME << ": top " << (end - top_lines.begin()) << " "
+                  << (pass == 0 ? "false" : "true") << " sharing cache lines\n";
+        std::cerr << std::setw(18) << "cache line" << ": "
+                  << std::setw(12) << "#false" << ", "
+                  << std::setw(12) << "#true" << ", "
+                  << std::setw(8) << "#readers" << ", "
+                  << std::setw(8) << "#writers" << ", "
+                  << std::setw(18) << "last write pc" << "\n";
+        for (std::vector<std::pair<addr_t, line_sharing_t> >::iterator it =
+                 top_lines.begin(); it != end; ++it) {
+            std::cerr << std::setw(18) << std::hex << std::showbase
+                      << (it->first << line_size_bits) << ": "
+                      << std::setw(12) << std::dec << it->second.false_shares << ", "
+                      << std::setw(12) << it->second.true_shares << ", "
+                      << std::setw(8) << count_bits(it->second.readers) << ", "
+                      << std::setw(8) << count_bits(it->second.writers) << ", "
+                      << std::setw(18) << std::hex << it->second.last_write_pc
+                      << std::dec << "\n";
+        }
+    }
+
+    std::vector<std::pair<addr_t, pc_sharing_t> > top_pcs(report_top);
+    for (int pass = 0; pass < 2; pass++) {
+        std::vector<std::pair<addr_t, pc_sharing_t> >::iterator end =
+            std::partial_sort_copy(pc_map.begin(), pc_map.end(),
+                                   top_pcs.begin(), top_pcs.end(),
+                                   pass == 0 ? cmp_pc_false : cmp_pc_true);
+        std::cerr << TOOL_NAME << ": top " << (end - top_pcs.begin()) << " "
+                  << (pass == 0 ? "false" : "true") << " sharing pcs\n";
+        std::cerr << std::setw(18) << "pc" << ": "
+                  << std::setw(12) << "#false" << ", "
+                  << std::setw(12) << "#true" << "\n";
+        for (std::vector<std::pair<addr_t, pc_sharing_t> >::iterator it =
+                 top_pcs.begin(); it != end; ++it) {
+            std::cerr << std::setw(18) << std::hex << std::showbase << it->first << ": "
+                      << std::setw(12) << std::dec << it->second.false_shares << ", "
+                      << std::setw(12) << it->second.true_shares << "\n";
+        }
+    }
+    return true;
+}
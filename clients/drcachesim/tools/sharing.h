@@ -0,0 +1,127 @@
+/* **********************************************************
+ * Copyright (c) 2017 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* sharing: a memory trace analysis tool that detects cache lines accessed by
+ * multiple threads and classifies the sharing as true or false sharing.
+ */
+
+#ifndef _SHARING_H_
+#define _SHARING_H_ 1
+
+#include <map>
+#include <string>
+#include <vector>
+#include "../analysis_tool.h"
+#include "../common/memref.h"
+
+// Threads are mapped to a dense index that selects a bit in the per-line
+// thread sets below.  Threads beyond the last bit all share the last bit,
+// which can hide sharing among those late threads but never reports sharing
+// that did not happen between distinct indices.
+#define SHARING_MAX_THREAD_BITS 64
+
+// Each thread that touches a line gets a record of the byte granules it has
+// read and written since it last obtained a copy of the line.  We model the
+// coherence protocol's view of the line: a write by one thread invalidates
+// the other threads' copies, and a thread without a copy obtains one from the
+// writer.  Each such transfer is classified as true sharing if the accessing
+// thread touches bytes in another thread's masks (for a read, only bytes that
+// were written), and as false sharing otherwise.
+struct line_thread_t
+{
+    unsigned short tidx;  // thread index
+    uint64_t read_mask;   // byte granules read since this thread got the line
+    uint64_t write_mask;  // byte granules written since this thread got the line
+    line_thread_t(unsigned short idx) : tidx(idx), read_mask(0), write_mask(0)
+    {
+    }
+};
+
+struct line_sharing_t
+{
+    uint64_t readers;        // set of threads that have read the line
+    uint64_t writers;        // set of threads that have written the line
+    uint64_t holders;        // set of threads with a valid copy of the line
+    addr_t last_write_pc;    // pc of the last write, for attribution
+    uint64_t true_shares;
+    uint64_t false_shares;
+    // Most lines are only touched by one thread, so this is a short vector
+    // rather than a map.
+    std::vector<line_thread_t> threads;
+    line_sharing_t() :
+        readers(0), writers(0), holders(0), last_write_pc(0), true_shares(0),
+        false_shares(0)
+    {
+    }
+};
+
+struct pc_sharing_t
+{
+    uint64_t true_shares;
+    uint64_t false_shares;
+    pc_sharing_t() : true_shares(0), false_shares(0)
+    {
+    }
+};
+
+class sharing_t : public analysis_tool_t
+{
+ public:
+    sharing_t();
+    virtual ~sharing_t();
+    virtual bool process_memref(const memref_t &memref);
+    virtual bool print_results();
+
+ protected:
+    unsigned int thread_index(memref_tid_t tid);
+    uint64_t granule_mask(addr_t start, addr_t end);
+    line_thread_t &line_thread(line_sharing_t &line, unsigned int tidx);
+    void access_line(addr_t tag, uint64_t mask, unsigned int tidx, bool is_write,
+                     addr_t pc);
+    void record_share(line_sharing_t &line, bool is_true, addr_t pc);
+
+    /* XXX i#2020: use unsorted_map (C++11) for faster lookup */
+    std::map<addr_t, line_sharing_t> line_map;
+    std::map<addr_t, pc_sharing_t> pc_map;
+    std::map<memref_tid_t, unsigned int> tid2idx;
+
+    uint64_t total_refs;
+    uint64_t total_true_shares;
+    uint64_t total_false_shares;
+    size_t line_size;
+    size_t line_size_bits;
+    size_t granule_bits;  // log2 of the bytes covered by one mask bit
+    size_t report_top;
+    static const std::string TOOL_NAME;
+};
+
+#endif /* _SHARING_H_ */
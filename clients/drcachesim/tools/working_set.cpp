@@ -0,0 +1,136 @@
+/* **********************************************************
+ * Copyright (c) 2017 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <iomanip>
+#include <iostream>
+#include "droption.h"
+#include "working_set.h"
+#include "../common/options.h"
+#include "../common/utils.h"
+
+const std::string working_set_t::TOOL_NAME = "Working set";
+
+working_set_t::working_set_t() :
+    window_instrs(0), total_instrs(0)
+{
+    unsigned int precision = op_working_set_precision.get_value();
+    line_size_bits = compute_log2((int)op_line_size.get_value());
+    page_size_bits = compute_log2((int)op_page_size.get_value());
+    window_size = op_working_set_window.get_value();
+    cur_window = new footprint_t(precision);
+    total = new footprint_t(precision);
+    if (op_verbose.get_value() >= 2) {
+        std::cerr << "window size " << window_size << " instructions, "
+                  << "sketch precision " << precision << " bits" << std::endl;
+    }
+}
+
+working_set_t::~working_set_t()
+{
+    delete cur_window;
+    delete total;
+}
+
+bool
+working_set_t::process_memref(const memref_t &memref)
+{
+    if (type_is_instr(memref.instr.type)) {
+        cur_window->instr_lines.insert(memref.instr.addr >> line_size_bits);
+        cur_window->instr_pages.insert(memref.instr.addr >> page_size_bits);
+        if (++window_instrs == window_size && window_size > 0)
+            end_window();
+    } else if (memref.data.type == TRACE_TYPE_READ ||
+               memref.data.type == TRACE_TYPE_WRITE ||
+               type_is_prefetch(memref.data.type)) {
+        // Like the cache simulator, we count an instruction prefetch as an
+        // instruction fetch.
+        if (memref.data.type == TRACE_TYPE_PREFETCH_INSTR) {
+            cur_window->instr_lines.insert(memref.data.addr >> line_size_bits);
+            cur_window->instr_pages.insert(memref.data.addr >> page_size_bits);
+        } else {
+            cur_window->data_lines.insert(memref.data.addr >> line_size_bits);
+            cur_window->data_pages.insert(memref.data.addr >> page_size_bits);
+        }
+    }
+    return true;
+}
+
+void
+working_set_t::end_window()
+{
+    window_footprint_t win;
+    win.instrs = window_instrs;
+    win.instr_lines = cur_window->instr_lines.estimate();
+    win.data_lines = cur_window->data_lines.estimate();
+    win.instr_pages = cur_window->instr_pages.estimate();
+    win.data_pages = cur_window->data_pages.estimate();
+    windows.push_back(win);
+    total->merge(*cur_window);
+    cur_window->clear();
+    total_instrs += window_instrs;
+    window_instrs = 0;
+}
+
+bool
+working_set_t::print_results()
+{
+    // Account for the final partial window.
+    if (window_instrs > 0)
+        end_window();
+    std::cerr << TOOL_NAME << " result:\n";
+    std::cerr << TOOL_NAME << ": " << total_instrs << " instructions\n";
+    std::cerr << TOOL_NAME << ": icache = " << total->instr_lines.estimate()
+              << " unique cache lines\n";
+    std::cerr << TOOL_NAME << ": dcache = " << total->data_lines.estimate()
+              << " unique cache lines\n";
+    std::cerr << TOOL_NAME << ": instruction pages = "
+              << total->instr_pages.estimate() << " unique pages\n";
+    std::cerr << TOOL_NAME << ": data pages = "
+              << total->data_pages.estimate() << " unique pages\n";
+    std::cerr << TOOL_NAME << ": " << windows.size() << " windows of "
+              << window_size << " instructions\n";
+    std::cerr << std::setw(8) << "window" << ": "
+              << std::setw(12) << "#instrs" << ", "
+              << std::setw(12) << "#ilines" << ", "
+              << std::setw(12) << "#dlines" << ", "
+              << std::setw(10) << "#ipages" << ", "
+              << std::setw(10) << "#dpages" << "\n";
+    for (size_t i = 0; i < windows.size(); i++) {
+        std::cerr << std::setw(8) << i << ": "
+                  << std::setw(12) << windows[i].instrs << ", "
+                  << std::setw(12) << windows[i].instr_lines << ", "
+                  << std::setw(12) << windows[i].data_lines << ", "
+                  << std::setw(10) << windows[i].instr_pages << ", "
+                  << std::setw(10) << windows[i].data_pages << "\n";
+    }
+    return true;
+}
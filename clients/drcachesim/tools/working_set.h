@@ -0,0 +1,111 @@
+/* **********************************************************
+ * Copyright (c) 2017 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* working_set: a memory trace analysis tool that estimates the number of
+ * unique cache lines and pages touched over time.
+ */
+
+#ifndef _WORKING_SET_H_
+#define _WORKING_SET_H_ 1
+
+#include <string>
+#include <vector>
+#include "hyperloglog.h"
+#include "../analysis_tool.h"
+#include "../common/memref.h"
+
+// The footprint of one window of the trace, or of the whole trace.
+// Each count is kept as a fixed-size sketch so memory use does not grow with
+// the footprint.  Each window's footprint is merged into the whole-trace one
+// when the window ends.
+struct footprint_t
+{
+    footprint_t(unsigned int precision) :
+        instr_lines(precision), data_lines(precision),
+        instr_pages(precision), data_pages(precision)
+    {
+    }
+    void
+    merge(const footprint_t &other)
+    {
+        instr_lines.merge(other.instr_lines);
+        data_lines.merge(other.data_lines);
+        instr_pages.merge(other.instr_pages);
+        data_pages.merge(other.data_pages);
+    }
+    void
+    clear()
+    {
+        instr_lines.clear();
+        data_lines.clear();
+        instr_pages.clear();
+        data_pages.clear();
+    }
+    hyperloglog_t instr_lines;
+    hyperloglog_t data_lines;
+    hyperloglog_t instr_pages;
+    hyperloglog_t data_pages;
+};
+
+// The estimates for one completed window.
+struct window_footprint_t
+{
+    uint64_t instrs;
+    uint64_t instr_lines;
+    uint64_t data_lines;
+    uint64_t instr_pages;
+    uint64_t data_pages;
+};
+
+class working_set_t : public analysis_tool_t
+{
+ public:
+    working_set_t();
+    virtual ~working_set_t();
+    virtual bool process_memref(const memref_t &memref);
+    virtual bool print_results();
+
+ protected:
+    void end_window();
+
+    footprint_t *cur_window;
+    footprint_t *total;
+    std::vector<window_footprint_t> windows;
+    uint64_t window_instrs;
+    uint64_t total_instrs;
+    uint64_t window_size;
+    size_t line_size_bits;
+    size_t page_size_bits;
+    static const std::string TOOL_NAME;
+};
+
+#endif /* _WORKING_SET_H_ */
@@ -51,6 +51,7 @@
 #include "instru.h"
 #include "raw2trace.h"
 #include "physaddr.h"
+#include "../common/compact_entry.h"
 #include "../common/trace_entry.h"
 #include "../common/named_pipe.h"
 #include "../common/options.h"
@@ -95,7 +96,9 @@ typedef struct {
     byte *buf_base;
     uint64 num_refs;
     uint64 bytes_written;
+    uint64 bytes_sent;
     file_t file; /* For offline traces */
+    byte *compact_buf; /* For -ipc_compact */
 } per_thread_t;
 
 #define MAX_NUM_DELAY_INSTRS 32
@@ -111,6 +114,8 @@ typedef struct {
 
 /* For online simulation, we write to a single global pipe */
 static named_pipe_t ipc_pipe;
+/* The max amount of trace_entry_t data we send in one atomic pipe write */
+static ssize_t pipe_write_size;
 
 #define MAX_INSTRU_SIZE 64  /* the max obj size of instr_t or its children */
 static instru_t *instru;
@@ -118,6 +123,7 @@ static instru_t *instru;
 static client_id_t client_id;
 static void  *mutex;    /* for multithread support */
 static uint64 num_refs; /* keep a global memory reference count */
+static uint64 num_bytes_sent; /* for online traces */
 
 /* virtual to physical translation */
 static bool have_phys;
@@ -197,11 +203,23 @@ static size_t buf_hdr_slots_size;
 static inline byte *
 atomic_pipe_write(void *drcontext, byte *pipe_start, byte *pipe_end)
 {
+    per_thread_t *data = (per_thread_t *) drmgr_get_tls_field(drcontext, tls_idx);
     ssize_t towrite = pipe_end - pipe_start;
-    DR_ASSERT(towrite <= ipc_pipe.get_atomic_write_size() &&
+    DR_ASSERT(towrite <= pipe_write_size &&
               towrite > (ssize_t)buf_hdr_slots_size);
-    if (ipc_pipe.write((void *)pipe_start, towrite) < (ssize_t)towrite)
-        DR_ASSERT(false);
+    if (op_ipc_compact.get_value()) {
+        ssize_t len = (ssize_t)
+            compact_encode_packet((trace_entry_t *)pipe_start,
+                                  towrite / sizeof(trace_entry_t), data->compact_buf);
+        DR_ASSERT(len <= ipc_pipe.get_atomic_write_size());
+        if (ipc_pipe.write((void *)data->compact_buf, len) < len)
+            DR_ASSERT(false);
+        data->bytes_sent += len;
+    } else {
+        if (ipc_pipe.write((void *)pipe_start, towrite) < (ssize_t)towrite)
+            DR_ASSERT(false);
+        data->bytes_sent += towrite;
+    }
     // Re-emit thread entry header
     DR_ASSERT(pipe_end - buf_hdr_slots_size > pipe_start);
     pipe_start = pipe_end - buf_hdr_slots_size;
@@ -277,7 +295,7 @@ memtrace(void *drcontext, bool skip_size_cap)
                 // We can only split before TRACE_TYPE_INSTR, assuming only a few data
                 // entries in between instr entries.
                 if (instru->get_entry_type(mem_ref) == TRACE_TYPE_INSTR) {
-                    if ((mem_ref - pipe_start) > ipc_pipe.get_atomic_write_size())
+                    if ((mem_ref - pipe_start) > pipe_write_size)
                         pipe_start = atomic_pipe_write(drcontext, pipe_start, pipe_end);
                     // Advance pipe_end pointer
                     pipe_end = mem_ref;
@@ -290,7 +308,7 @@ memtrace(void *drcontext, bool skip_size_cap)
             // Write the rest to pipe
             // The last few entries (e.g., instr + refs) may exceed the atomic write size,
             // so we may need two writes.
-            if ((buf_ptr - pipe_start) > ipc_pipe.get_atomic_write_size())
+            if ((buf_ptr - pipe_start) > pipe_write_size)
                 pipe_start = atomic_pipe_write(drcontext, pipe_start, pipe_end);
             if ((buf_ptr - pipe_start) > (ssize_t)buf_hdr_slots_size)
                 atomic_pipe_write(drcontext, pipe_start, buf_ptr);
@@ -716,6 +734,12 @@ event_thread_init(void *drcontext)
     BUF_PTR(data->seg_base) = data->buf_base + buf_hdr_slots_size;
     data->num_refs = 0;
     data->bytes_written = 0;
+    data->bytes_sent = 0;
+    data->compact_buf = NULL;
+    if (!op_offline.get_value() && op_ipc_compact.get_value()) {
+        data->compact_buf = (byte *)
+            dr_thread_alloc(drcontext, ipc_pipe.get_atomic_write_size());
+    }
 
     if (op_offline.get_value()) {
         /* We do not need to call drx_init before using drx_open_unique_appid_file.
@@ -779,7 +803,10 @@ event_thread_exit(void *drcontext)
 
     dr_mutex_lock(mutex);
     num_refs += data->num_refs;
+    num_bytes_sent += data->bytes_sent;
     dr_mutex_unlock(mutex);
+    if (data->compact_buf != NULL)
+        dr_thread_free(drcontext, data->compact_buf, ipc_pipe.get_atomic_write_size());
     dr_raw_mem_free(data->buf_base, max_buf_size);
     dr_thread_free(drcontext, data, sizeof(per_thread_t));
 }
@@ -790,6 +817,11 @@ event_exit(void)
     dr_log(NULL, LOG_ALL, 1, "drcachesim num refs seen: " SZFMT"\n", num_refs);
     NOTIFY(1, "drmemtrace exiting process " PIDFMT"; traced " SZFMT" references.\n",
            dr_get_process_id(), num_refs);
+    if (!op_offline.get_value() && num_refs > 0) {
+        NOTIFY(1, "drmemtrace sent " SZFMT" bytes; %d.%02d bytes per reference.\n",
+               num_bytes_sent, (int)(num_bytes_sent / num_refs),
+               (int)((num_bytes_sent * 100 / num_refs) % 100));
+    }
     /* we use placement new for better isolation */
     instru->~instru_t();
     dr_global_free(instru, MAX_INSTRU_SIZE);
@@ -936,6 +968,16 @@ drmemtrace_client_main(client_id_t id, int argc, const char *argv[])
 #endif
         if (!ipc_pipe.maximize_buffer())
             NOTIFY(1, "Failed to maximize pipe buffer: performance may suffer.\n");
+        pipe_write_size = ipc_pipe.get_atomic_write_size();
+        if (op_ipc_compact.get_value()) {
+            // A compact record can be larger than a trace_entry_t in the worst
+            // case, so we limit the entries per write such that every encoded
+            // packet still fits in one atomic write.
+            ssize_t max_entries = (ipc_pipe.get_atomic_write_size() -
+                                   COMPACT_PACKET_HEADER_SIZE) / COMPACT_ENTRY_MAX_SIZE;
+            if (max_entries * (ssize_t)sizeof(trace_entry_t) < pipe_write_size)
+                pipe_write_size = max_entries * sizeof(trace_entry_t);
+        }
     }
 
     if (!drmgr_init() || !drutil_init() || drreg_init(&ops) != DRREG_SUCCESS)
@@ -43,6 +43,13 @@ analyze_callee_regs_usage(dcontext_t *dcontext, callee_info_t *ci)
     ASSERT_NOT_IMPLEMENTED(false); /* FIXME i#1569: NYI on AArch64 */
 }
 
+bool
+analyze_callee_simd_usage(dcontext_t *dcontext, callee_info_t *ci)
+{
+    /* FIXME i#1569: NYI on AArch64: all SIMD regs are left marked as used */
+    return false;
+}
+
 void
 analyze_callee_save_reg(dcontext_t *dcontext, callee_info_t *ci)
 {
@@ -1111,6 +1111,129 @@ app_instr_is_in_it_block(dcontext_t *dcontext, instr_t *instr)
 
 #endif /* !AARCH64 */
 
+#ifdef AARCH64
+/* For -shadow_ret_stack: see the x86 mangle.c for the scheme.  We have no
+ * way to materialize the cache address of a later instr in the same fragment
+ * with a mov, so the call sequence uses a meta "bl" over an inline landing
+ * to obtain its address in x30, which the call mangling overwrites next.
+ * The inline landing restores x0, which a matching return uses for its "br",
+ * and branches to the landing exit, which like every exit is at the end.
+ */
+static opnd_t
+shadow_ret_tls_opnd(ushort slot, opnd_size_t size)
+{
+    return opnd_create_sized_tls_slot(os_tls_offset(slot), size);
+}
+
+/* Appends a landing exit to retaddr to the end of ilist and inserts before
+ * where, which must precede the write of the return address to x30, the push
+ * of retaddr and the inline landing that leads to that exit.
+ */
+static void
+insert_shadow_ret_push(dcontext_t *dcontext, instrlist_t *ilist, instr_t *where,
+                       ptr_uint_t retaddr)
+{
+    instr_t *over = INSTR_CREATE_label(dcontext);
+    instr_t *landing = XINST_CREATE_jump(dcontext, opnd_create_pc((app_pc)retaddr));
+    instr_set_translation(landing, (app_pc)retaddr);
+    instr_set_our_mangling(landing, true);
+    instr_exit_branch_set_type(landing, LINK_DIRECT|LINK_JMP);
+    instrlist_append(ilist, landing);
+    STATS_INC(num_shadow_ret_pushes);
+
+    PRE(ilist, where, instr_create_save_to_tls(dcontext, DR_REG_X0, TLS_REG0_SLOT));
+    PRE(ilist, where, instr_create_save_to_tls(dcontext, DR_REG_X1, TLS_REG1_SLOT));
+    /* The index is only accessed as a byte so it wraps on its own. */
+    PRE(ilist, where,
+        INSTR_CREATE_ldrb(dcontext, opnd_create_reg(DR_REG_W0),
+                          shadow_ret_tls_opnd(TLS_SHADOW_RET_INDEX_SLOT, OPSZ_1)));
+    PRE(ilist, where,
+        INSTR_CREATE_add(dcontext, opnd_create_reg(DR_REG_W0),
+                         opnd_create_reg(DR_REG_W0), OPND_CREATE_INT(1)));
+    PRE(ilist, where,
+        INSTR_CREATE_strb(dcontext,
+                          shadow_ret_tls_opnd(TLS_SHADOW_RET_INDEX_SLOT, OPSZ_1),
+                          opnd_create_reg(DR_REG_W0)));
+    PRE(ilist, where,
+        INSTR_CREATE_ldrb(dcontext, opnd_create_reg(DR_REG_W0),
+                          shadow_ret_tls_opnd(TLS_SHADOW_RET_INDEX_SLOT, OPSZ_1)));
+    PRE(ilist, where,
+        instr_create_restore_from_tls(dcontext, DR_REG_X1, TLS_SHADOW_RET_ENTRIES_SLOT));
+    PRE(ilist, where,
+        INSTR_CREATE_add_shift(dcontext, opnd_create_reg(DR_REG_X1),
+                               opnd_create_reg(DR_REG_X1), opnd_create_reg(DR_REG_X0),
+                               OPND_CREATE_LSL(), OPND_CREATE_INT(4)));
+    insert_mov_immed_ptrsz(dcontext, (ptr_int_t)retaddr, opnd_create_reg(DR_REG_X0),
+                           ilist, where, NULL, NULL);
+    PRE(ilist, where,
+        XINST_CREATE_store(dcontext,
+                           OPND_CREATE_MEMPTR(DR_REG_X1,
+                                              offsetof(shadow_ret_entry_t, retaddr)),
+                           opnd_create_reg(DR_REG_X0)));
+    /* The ctis come last so that translation can follow the spills up to here. */
+    PRE(ilist, where, INSTR_CREATE_bl(dcontext, opnd_create_instr(over)));
+    PRE(ilist, where, instr_create_restore_from_tls(dcontext, DR_REG_X0, TLS_REG0_SLOT));
+    PRE(ilist, where, XINST_CREATE_jump(dcontext, opnd_create_instr(landing)));
+    PRE(ilist, where, over);
+    PRE(ilist, where,
+        XINST_CREATE_store(dcontext,
+                           OPND_CREATE_MEMPTR(DR_REG_X1,
+                                              offsetof(shadow_ret_entry_t, landing)),
+                           opnd_create_reg(DR_REG_X30)));
+    PRE(ilist, where, instr_create_restore_from_tls(dcontext, DR_REG_X1, TLS_REG1_SLOT));
+    PRE(ilist, where, instr_create_restore_from_tls(dcontext, DR_REG_X0, TLS_REG0_SLOT));
+}
+
+/* Inserts before where, which must be the ibl exit of a return whose target
+ * is in IBL_TARGET_REG, a pop of the shadow stack and a branch to its landing
+ * if its return address matches.
+ */
+static void
+insert_shadow_ret_check(dcontext_t *dcontext, instrlist_t *ilist, instr_t *where)
+{
+    instr_t *miss = INSTR_CREATE_label(dcontext);
+
+    PRE(ilist, where, instr_create_save_to_tls(dcontext, DR_REG_X0, TLS_REG0_SLOT));
+    PRE(ilist, where, instr_create_save_to_tls(dcontext, DR_REG_X1, TLS_REG1_SLOT));
+    PRE(ilist, where,
+        INSTR_CREATE_ldrb(dcontext, opnd_create_reg(DR_REG_W0),
+                          shadow_ret_tls_opnd(TLS_SHADOW_RET_INDEX_SLOT, OPSZ_1)));
+    PRE(ilist, where,
+        INSTR_CREATE_sub(dcontext, opnd_create_reg(DR_REG_W1),
+                         opnd_create_reg(DR_REG_W0), OPND_CREATE_INT(1)));
+    PRE(ilist, where,
+        INSTR_CREATE_strb(dcontext,
+                          shadow_ret_tls_opnd(TLS_SHADOW_RET_INDEX_SLOT, OPSZ_1),
+                          opnd_create_reg(DR_REG_W1)));
+    PRE(ilist, where,
+        instr_create_restore_from_tls(dcontext, DR_REG_X1, TLS_SHADOW_RET_ENTRIES_SLOT));
+    PRE(ilist, where,
+        INSTR_CREATE_add_shift(dcontext, opnd_create_reg(DR_REG_X1),
+                               opnd_create_reg(DR_REG_X1), opnd_create_reg(DR_REG_X0),
+                               OPND_CREATE_LSL(), OPND_CREATE_INT(4)));
+    PRE(ilist, where,
+        XINST_CREATE_load(dcontext, opnd_create_reg(DR_REG_X0),
+                          OPND_CREATE_MEMPTR(DR_REG_X1,
+                                             offsetof(shadow_ret_entry_t, retaddr))));
+    PRE(ilist, where,
+        INSTR_CREATE_sub(dcontext, opnd_create_reg(DR_REG_X0),
+                         opnd_create_reg(DR_REG_X0), opnd_create_reg(IBL_TARGET_REG)));
+    PRE(ilist, where,
+        INSTR_CREATE_cbnz(dcontext, opnd_create_instr(miss), opnd_create_reg(DR_REG_X0)));
+    PRE(ilist, where,
+        XINST_CREATE_load(dcontext, opnd_create_reg(DR_REG_X0),
+                          OPND_CREATE_MEMPTR(DR_REG_X1,
+                                             offsetof(shadow_ret_entry_t, landing))));
+    PRE(ilist, where, instr_create_restore_from_tls(dcontext, DR_REG_X1, TLS_REG1_SLOT));
+    PRE(ilist, where,
+        instr_create_restore_from_tls(dcontext, IBL_TARGET_REG, IBL_TARGET_SLOT));
+    PRE(ilist, where, INSTR_CREATE_br(dcontext, opnd_create_reg(DR_REG_X0)));
+    PRE(ilist, where, miss);
+    PRE(ilist, where, instr_create_restore_from_tls(dcontext, DR_REG_X1, TLS_REG1_SLOT));
+    PRE(ilist, where, instr_create_restore_from_tls(dcontext, DR_REG_X0, TLS_REG0_SLOT));
+}
+#endif
+
 instr_t *
 mangle_direct_call(dcontext_t *dcontext, instrlist_t *ilist, instr_t *instr,
                    instr_t *next_instr, bool mangle_calls, uint flags)
@@ -1122,6 +1245,8 @@ mangle_direct_call(dcontext_t *dcontext, instrlist_t *ilist, instr_t *instr,
     ASSERT(opnd_is_pc(instr_get_target(instr)));
     target = (ptr_int_t)opnd_get_pc(instr_get_target(instr));
     retaddr = get_call_return_address(dcontext, ilist, instr);
+    if (shadow_ret_stack_applies(dcontext, flags) && target != retaddr)
+        insert_shadow_ret_push(dcontext, ilist, instr, retaddr);
     insert_mov_immed_ptrsz(dcontext, retaddr,
                            opnd_create_reg(DR_REG_X30), ilist, instr, NULL, NULL);
     instrlist_remove(ilist, instr); /* remove OP_bl */
@@ -1213,6 +1338,11 @@ mangle_indirect_call(dcontext_t *dcontext, instrlist_t *ilist, instr_t *instr,
             XINST_CREATE_move(dcontext, opnd_create_reg(IBL_TARGET_REG),
                               instr_get_target(instr)));
     }
+    /* The target is in IBL_TARGET_REG by now, so x30 is free to clobber. */
+    if (shadow_ret_stack_applies(dcontext, flags)) {
+        insert_shadow_ret_push(dcontext, ilist, next_instr,
+                               get_call_return_address(dcontext, ilist, instr));
+    }
     insert_mov_immed_ptrsz(dcontext,
                            get_call_return_address(dcontext, ilist, instr),
                            opnd_create_reg(DR_REG_X30),
@@ -1271,6 +1401,10 @@ mangle_return(dcontext_t *dcontext, instrlist_t *ilist, instr_t *instr,
 {
     /* The mangling is identical */
     mangle_indirect_jump(dcontext, ilist, instr, next_instr, flags);
+#ifdef AARCH64
+    if (shadow_ret_stack_applies(dcontext, flags))
+        insert_shadow_ret_check(dcontext, ilist, next_instr);
+#endif
 }
 
 instr_t *
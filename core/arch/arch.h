@@ -347,6 +347,7 @@ typedef struct _clean_call_info_t {
     bool out_of_line_swap; /* whether we use clean_call_{save,restore} gencode */
     void *callee_info;  /* callee information */
     instrlist_t *ilist; /* instruction list for inline optimization */
+    instr_t *slow_path; /* where an inlined fast path needs the full call */
 } clean_call_info_t;
 
 /* flags for insert_meta_call_vargs, to indicate various properties about the call */
@@ -1277,6 +1278,9 @@ typedef struct _callee_info_t {
     uint slots_used;          /* scratch slots needed after analysis */
     slot_t scratch_slots[CLEANCALL_NUM_INLINE_SLOTS];  /* scratch slot allocation */
     instrlist_t *ilist;       /* instruction list of function for inline. */
+    bool is_helper;           /* decoded for splicing into a calling callee */
+    bool has_slow_path;       /* ilist ends in the label its rare path targets */
+    struct _callee_info_t *fast_path; /* inlinable fast path of a bailout callee */
 } callee_info_t;
 extern callee_info_t     default_callee_info;
 extern clean_call_info_t default_clean_call_info;
@@ -1309,6 +1313,9 @@ get_call_return_address(dcontext_t *dcontext, instrlist_t *ilist, instr_t *instr
 app_pc
 get_app_instr_xl8(instr_t *instr);
 
+bool
+shadow_ret_stack_applies(dcontext_t *dcontext, uint flags);
+
 #ifdef X64
 /* in x86_to_x64.c */
 void
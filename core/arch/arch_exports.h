@@ -166,9 +166,31 @@ typedef struct _local_state_t {
     spill_state_t spill_space;
 } local_state_t;
 
+/* With -shadow_ret_stack, each mangled call pushes its app return address
+ * along with the cache address of a fragment exit to that return address,
+ * and each mangled return jumps straight to that exit when the top entry
+ * matches, bypassing the ibl.  The index is only ever accessed as a single
+ * byte by the inlined code so it wraps around on its own: an overflowing
+ * call chain simply overwrites its oldest entries.
+ */
+#define SHADOW_RET_STACK_ENTRIES 256
+
+typedef struct _shadow_ret_entry_t {
+    app_pc retaddr;
+    byte *landing;
+} shadow_ret_entry_t;
+
+typedef struct _shadow_ret_state_t {
+    shadow_ret_entry_t *entries;
+    ptr_uint_t index;
+    /* Scratch slot holding the landing address for an indirect jmp on x86. */
+    byte *target;
+} shadow_ret_state_t;
+
 typedef struct _local_state_extended_t {
     spill_state_t spill_space;
     table_stat_state_t table_space;
+    shadow_ret_state_t ret_stack;
 } local_state_extended_t;
 
 /* local_state_[extended_]t is allocated in os-specific thread-local storage (TLS),
@@ -223,6 +245,14 @@ typedef struct _local_state_extended_t {
                                   + offsetof(table_stat_state_t, table[btype])  \
                                   + offsetof(lookup_table_access_t, lookuptable)))
 
+#define SHADOW_RET_OFFSET        (offsetof(local_state_extended_t, ret_stack))
+#define TLS_SHADOW_RET_ENTRIES_SLOT ((ushort)(SHADOW_RET_OFFSET                 \
+                                  + offsetof(shadow_ret_state_t, entries)))
+#define TLS_SHADOW_RET_INDEX_SLOT ((ushort)(SHADOW_RET_OFFSET                   \
+                                  + offsetof(shadow_ret_state_t, index)))
+#define TLS_SHADOW_RET_TARGET_SLOT ((ushort)(SHADOW_RET_OFFSET                  \
+                                  + offsetof(shadow_ret_state_t, target)))
+
 #ifdef HASHTABLE_STATISTICS
 # define TLS_HTABLE_STATS_SLOT   ((ushort)(offsetof(local_state_extended_t,     \
                                                     table_space)                \
@@ -364,6 +394,11 @@ emit_detach_callback_final_jmp(dcontext_t *dcontext,
 #  define ATOMIC_COMPARE_EXCHANGE_PTR ATOMIC_COMPARE_EXCHANGE_int
 # endif
 # define SPINLOCK_PAUSE() _mm_pause() /* PAUSE = 0xf3 0x90 = repz nop */
+/* x86 does not reorder loads with loads or stores with stores, so we only
+ * need to stop the compiler from doing so.
+ */
+# define MEMORY_LOAD_BARRIER() _ReadWriteBarrier()
+# define MEMORY_STORE_BARRIER() _ReadWriteBarrier()
 # define RDTSC_LL(var) (var = __rdtsc())
 # define SERIALIZE_INSTRUCTIONS() do { \
         int cpuid_res_local[4];        \
@@ -479,6 +514,11 @@ static inline int64 atomic_add_exchange_int64(volatile int64 *var, int64 value)
                        : "0" (newval), "m" (var))
 
 #  define SPINLOCK_PAUSE()   __asm__ __volatile__("pause")
+/* x86 does not reorder loads with loads or stores with stores, so we only
+ * need to stop the compiler from doing so.
+ */
+#  define MEMORY_LOAD_BARRIER() __asm__ __volatile__("" : : : "memory")
+#  define MEMORY_STORE_BARRIER() __asm__ __volatile__("" : : : "memory")
 #  ifdef X64
 #   define RDTSC_LL(llval) do {                   \
       uint low, high;                             \
@@ -623,6 +663,8 @@ atomic_exchange_int(volatile int *var, int newval)
 
 #  define SPINLOCK_PAUSE() \
     do { __asm__ __volatile__("wfi"); } while (0) /* wait for interrupt */
+#  define MEMORY_LOAD_BARRIER() __asm__ __volatile__("dmb ishld" : : : "memory")
+#  define MEMORY_STORE_BARRIER() __asm__ __volatile__("dmb ishst" : : : "memory")
 
 uint64 proc_get_timestamp(void);
 #  define RDTSC_LL(llval) do { (llval) = proc_get_timestamp(); } while (0)
@@ -751,6 +793,9 @@ static inline bool atomic_dec_becomes_zero(volatile int *var)
        : "cc", "memory", "r2", "r3");
 
 #  define SPINLOCK_PAUSE()  __asm__ __volatile__("wfi") /* wait for interrupt */
+/* ARMv7 has no load-only barrier */
+#  define MEMORY_LOAD_BARRIER() __asm__ __volatile__("dmb ish" : : : "memory")
+#  define MEMORY_STORE_BARRIER() __asm__ __volatile__("dmb ishst" : : : "memory")
 uint64 proc_get_timestamp(void);
 #  define RDTSC_LL(llval) (llval) = proc_get_timestamp()
 #  define SERIALIZE_INSTRUCTIONS() __asm__ __volatile__("clrex");
@@ -1822,11 +1867,17 @@ build_basic_block_fragment(dcontext_t *dcontext, app_pc start_pc,
                            uint initial_flags, bool linked, bool visible
                            _IF_CLIENT(bool for_trace)
                            _IF_CLIENT(instrlist_t **unmangled_ilist));
+bool bb_build_claim(dcontext_t *dcontext, app_pc tag);
+void bb_build_claim_wait(dcontext_t *dcontext, app_pc tag);
+void bb_build_claim_release(dcontext_t *dcontext, app_pc tag);
 
 void interp(dcontext_t *dcontext);
 uint extend_trace(dcontext_t *dcontext, fragment_t *f, linkstub_t *prev_l);
 int append_trace_speculate_last_ibl(dcontext_t *dcontext, instrlist_t *trace,
                                     app_pc speculate_next_tag, bool record_translation);
+int append_trace_ibl_inline_cache(dcontext_t *dcontext, instrlist_t *trace,
+                                  app_pc *targets, uint num_targets,
+                                  bool record_translation);
 
 uint
 forward_eflags_analysis(dcontext_t *dcontext, instrlist_t *ilist, instr_t *instr);
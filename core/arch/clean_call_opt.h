@@ -52,6 +52,13 @@ callee_info_slot_opnd(callee_info_t *ci, slot_kind_t kind, reg_id_t value);
 void
 analyze_callee_regs_usage(dcontext_t *dcontext, callee_info_t *ci);
 
+/* Finds the SIMD registers used by a callee that could not be fully
+ * analyzed, following direct calls.  Returns false, leaving every register
+ * marked as used, if the code reachable from the callee cannot be bounded.
+ */
+bool
+analyze_callee_simd_usage(dcontext_t *dcontext, callee_info_t *ci);
+
 void
 analyze_callee_save_reg(dcontext_t *dcontext, callee_info_t *ci);
 
@@ -95,6 +95,8 @@ callee_info_free(dcontext_t *dcontext, callee_info_t *ci)
         ASSERT(ci->opt_inline);
         instrlist_clear_and_destroy(GLOBAL_DCONTEXT, ci->ilist);
     }
+    if (ci->fast_path != NULL)
+        callee_info_free(dcontext, ci->fast_path);
     HEAP_TYPE_FREE(GLOBAL_DCONTEXT, ci, callee_info_t,
                    ACCT_CLEANCALL, PROTECTED);
 }
@@ -213,6 +215,9 @@ callee_info_table_add(callee_info_t *ci)
 /* The max number of instructions the callee can have for inline. */
 #define MAX_NUM_INLINE_INSTRS 20
 
+static void
+decode_callee_ilist(dcontext_t *dcontext, callee_info_t *ci);
+
 /* Decode instruction from callee and return the next_pc to be decoded. */
 static app_pc
 decode_callee_instr(dcontext_t *dcontext, callee_info_t *ci, app_pc instr_pc)
@@ -247,6 +252,62 @@ decode_callee_instr(dcontext_t *dcontext, callee_info_t *ci, app_pc instr_pc)
     return next_pc;
 }
 
+/* Splice in the body of a small leaf function the callee calls directly, so
+ * that a callee calling out only to such helpers can still be analyzed and
+ * inlined.  The helper's frame would be merged with the callee's, so the
+ * helper must not touch the stack, and it must not branch.
+ */
+static app_pc
+check_callee_helper(dcontext_t *dcontext, callee_info_t *ci, app_pc next_pc,
+                    app_pc tgt_pc)
+{
+    callee_info_t *helper;
+    instr_t *instr;
+    int num_instrs = 0;
+    bool splice = true;
+
+    if (ci->is_helper || tgt_pc == next_pc || is_in_dynamo_dll(tgt_pc))
+        return NULL;
+    helper = callee_info_create(tgt_pc, 0);
+    helper->is_helper = true;
+    decode_callee_ilist(dcontext, helper);
+    if (helper->bailout || helper->bwd_tgt != NULL || helper->fwd_tgt != NULL ||
+        helper->num_instrs > MAX_NUM_INLINE_INSTRS)
+        splice = false;
+    for (instr  = (splice ? instrlist_first(helper->ilist) : NULL);
+         instr != NULL;
+         instr  = instr_get_next(instr)) {
+        if (instr_uses_reg(instr, DR_REG_XSP)) {
+            LOG(THREAD, LOG_CLEANCALL, 2,
+                "CLEANCALL: helper "PFX" uses the stack at "PFX"\n",
+                tgt_pc, instr_get_app_pc(instr));
+            splice = false;
+            break;
+        }
+    }
+    if (splice) {
+        LOG(THREAD, LOG_CLEANCALL, 2,
+            "CLEANCALL: splicing helper "PFX" into callee "PFX"\n",
+            tgt_pc, ci->start);
+        STATS_INC(cleancall_helpers_spliced);
+        for (instr  = instrlist_first(helper->ilist);
+             instr != NULL;
+             instr  = instrlist_first(helper->ilist)) {
+            instrlist_remove(helper->ilist, instr);
+            instrlist_append(ci->ilist, instr);
+            num_instrs++;
+        }
+        ci->num_instrs += num_instrs;
+        ci->bailout = false;
+    }
+    if (helper->ilist != NULL) {
+        instrlist_clear_and_destroy(GLOBAL_DCONTEXT, helper->ilist);
+        helper->ilist = NULL;
+    }
+    callee_info_free(dcontext, helper);
+    return splice ? next_pc : NULL;
+}
+
 /* check newly decoded instruction from callee */
 static app_pc
 check_callee_instr(dcontext_t *dcontext, callee_info_t *ci, app_pc next_pc)
@@ -297,8 +358,15 @@ check_callee_instr(dcontext_t *dcontext, callee_info_t *ci, app_pc next_pc)
              * 2. call pic_func;
              *    and in pic_func: mov [%xsp] %r1; ret;
              */
-            if (INTERNAL_OPTION(opt_cleancall) >= 1)
-                return check_callee_instr_level2(dcontext, ci, next_pc, cur_pc, tgt_pc);
+            if (INTERNAL_OPTION(opt_cleancall) >= 1) {
+                int num_instrs = ci->num_instrs;
+                app_pc pc = check_callee_instr_level2(dcontext, ci, next_pc,
+                                                      cur_pc, tgt_pc);
+                if (pc == NULL && ci->num_instrs == num_instrs &&
+                    INTERNAL_OPTION(opt_cleancall) >= 2)
+                    pc = check_callee_helper(dcontext, ci, next_pc, tgt_pc);
+                return pc;
+            }
         } else { /* ubr or cbr */
             tgt_pc = opnd_get_pc(instr_get_target(instr));
             if (tgt_pc < cur_pc) { /* backward branch */
@@ -325,7 +393,7 @@ static void
 check_callee_ilist(dcontext_t *dcontext, callee_info_t *ci)
 {
     instrlist_t *ilist = ci->ilist;
-    instr_t *cti, *tgt, *ret;
+    instr_t *cti, *next_cti, *tgt, *ret, *label;
     app_pc   tgt_pc;
     if (!ci->bailout) {
         /* no target pc of any branch is in a middle of an instruction,
@@ -336,7 +404,8 @@ check_callee_ilist(dcontext_t *dcontext, callee_info_t *ci)
         ASSERT(instr_is_return(ret));
         for (cti  = instrlist_first(ilist);
              cti != ret;
-             cti  = instr_get_next(cti)) {
+             cti  = next_cti) {
+            next_cti = instr_get_next(cti);
             if (!instr_is_cti(cti))
                 continue;
             ASSERT(!instr_is_mbr(cti));
@@ -347,7 +416,7 @@ check_callee_ilist(dcontext_t *dcontext, callee_info_t *ci)
                 if (tgt_pc == instr_get_app_pc(tgt))
                     break;
             }
-            if (tgt == NULL) {
+            if (tgt == NULL && !ci->has_slow_path) {
                 /* cannot find a target instruction, bail out */
                 LOG(THREAD, LOG_CLEANCALL, 2,
                     "CLEANCALL: bail out on strange internal branch at: "PFX
@@ -355,6 +424,25 @@ check_callee_ilist(dcontext_t *dcontext, callee_info_t *ci)
                 ci->bailout = true;
                 break;
             }
+            if (tgt != NULL) {
+                /* Branch to a label in front of the target, as the target
+                 * itself may be removed later, e.g., the pop of a callee-saved
+                 * register or the RETURN.
+                 */
+                label = instr_get_prev(tgt);
+                if (label == NULL || !instr_is_label(label)) {
+                    label = INSTR_CREATE_label(GLOBAL_DCONTEXT);
+                    instrlist_preinsert(ilist, tgt, label);
+                }
+                instr_set_target(cti, opnd_create_instr(label));
+            }
+            /* The branch may not reach its target once our spill code is
+             * inlined around the callee.
+             */
+            if (instr_is_cti_short(cti)) {
+                instr_set_meta(cti);
+                convert_to_near_rel_meta(GLOBAL_DCONTEXT, ilist, cti);
+            }
         }
         /* remove RETURN as we do not need it any more */
         instrlist_remove(ilist, ret);
@@ -438,12 +526,6 @@ analyze_callee_inline(dcontext_t *dcontext, callee_info_t *ci)
             ci->start, ci->num_instrs);
         opt_inline = false;
     }
-    if (ci->bwd_tgt != NULL || ci->fwd_tgt != NULL) {
-        LOG(THREAD, LOG_CLEANCALL, 1,
-            "CLEANCALL: callee "PFX" cannot be inlined: has control flow.\n",
-            ci->start);
-        opt_inline = false;
-    }
     if (ci->num_simd_used != 0) {
         LOG(THREAD, LOG_CLEANCALL, 1,
             "CLEANCALL: callee "PFX" cannot be inlined: uses XMM.\n",
@@ -510,13 +592,107 @@ analyze_callee_ilist(dcontext_t *dcontext, callee_info_t *ci)
     }
 }
 
+/* For partial inlining of a callee we could not analyze as a whole, decode and
+ * analyze the path from its entry to its first return.  Branches leaving that
+ * path go to the rare path, where the inlined code restores the app state and
+ * makes the full clean call instead.  As that runs the callee from its entry
+ * again, nothing before the last such branch may write memory.
+ */
+static callee_info_t *
+analyze_callee_fast_path(dcontext_t *dcontext, callee_info_t *ci, uint num_args)
+{
+    callee_info_t *fp = callee_info_create(ci->start, num_args);
+    instr_t *instr, *tgt, *last_exit = NULL;
+    app_pc cur_pc = fp->start, tgt_pc;
+
+    LOG(THREAD, LOG_CLEANCALL, 2,
+        "CLEANCALL: decoding fast path of callee "PFX"\n", fp->start);
+    fp->ilist = instrlist_create(GLOBAL_DCONTEXT);
+    fp->bailout = false;
+    fp->has_slow_path = true;
+    while (cur_pc != NULL) {
+        cur_pc = decode_callee_instr(dcontext, fp, cur_pc);
+        if (cur_pc == NULL)
+            break;
+        instr = instrlist_last(fp->ilist);
+        if (instr_is_return(instr))
+            break;
+        if (fp->num_instrs > MAX_NUM_INLINE_INSTRS ||
+            instr_is_syscall(instr) || instr_is_interrupt(instr) ||
+            (instr_is_cti(instr) && !instr_is_cbr(instr) && !instr_is_ubr(instr))) {
+            LOG(THREAD, LOG_CLEANCALL, 2,
+                "CLEANCALL: no fast path: too long or calls out at "PFX"\n",
+                instr_get_app_pc(instr));
+            fp->bailout = true;
+            break;
+        }
+    }
+    if (!fp->bailout) {
+        /* Find the branches that leave the fast path. */
+        for (instr  = instrlist_first(fp->ilist);
+             instr != NULL;
+             instr  = instr_get_next(instr)) {
+            if (!instr_is_cti(instr) || instr_is_return(instr))
+                continue;
+            tgt_pc = opnd_get_pc(instr_get_target(instr));
+            for (tgt  = instrlist_first(fp->ilist);
+                 tgt != NULL;
+                 tgt  = instr_get_next(tgt)) {
+                if (tgt_pc == instr_get_app_pc(tgt))
+                    break;
+            }
+            if (tgt == NULL)
+                last_exit = instr;
+            else if (tgt_pc <= instr_get_app_pc(instr))
+                fp->bailout = true; /* no loops */
+            else if (fp->fwd_tgt == NULL || tgt_pc > fp->fwd_tgt)
+                fp->fwd_tgt = tgt_pc;
+        }
+        if (last_exit == NULL)
+            fp->bailout = true;
+    }
+    for (instr  = instrlist_first(fp->ilist);
+         !fp->bailout && instr != last_exit;
+         instr  = instr_get_next(instr)) {
+        if (instr_writes_memory(instr)) {
+            LOG(THREAD, LOG_CLEANCALL, 2,
+                "CLEANCALL: no fast path: write before rare path at "PFX"\n",
+                instr_get_app_pc(instr));
+            fp->bailout = true;
+            break;
+        }
+    }
+    check_callee_ilist(dcontext, fp);
+    if (!fp->bailout)
+        analyze_callee_ilist(dcontext, fp);
+    if (fp->bailout || !fp->opt_inline) {
+        if (fp->ilist != NULL) {
+            instrlist_clear_and_destroy(GLOBAL_DCONTEXT, fp->ilist);
+            fp->ilist = NULL;
+        }
+        callee_info_free(dcontext, fp);
+        return NULL;
+    }
+    /* The branches to the rare path now target a label at the end. */
+    tgt = INSTR_CREATE_label(GLOBAL_DCONTEXT);
+    for (instr  = instrlist_first(fp->ilist);
+         instr != NULL;
+         instr  = instr_get_next(instr)) {
+        if (instr_is_cti(instr) && opnd_is_near_pc(instr_get_target(instr)))
+            instr_set_target(instr, opnd_create_instr(tgt));
+    }
+    instrlist_append(fp->ilist, tgt);
+    LOG(THREAD, LOG_CLEANCALL, 1,
+        "CLEANCALL: fast path of callee "PFX" can be inlined.\n", fp->start);
+    return fp;
+}
+
 static void
-analyze_clean_call_regs(dcontext_t *dcontext, clean_call_info_t *cci)
+analyze_clean_call_simd(dcontext_t *dcontext, clean_call_info_t *cci)
 {
-    uint i, num_regparm;
+    uint i;
     callee_info_t *info = cci->callee_info;
 
-    /* 1. xmm registers */
     for (i = 0; i < NUM_SIMD_REGS; i++) {
         if (info->simd_used[i]) {
             cci->simd_skip[i] = false;
@@ -530,6 +706,16 @@ analyze_clean_call_regs(dcontext_t *dcontext, clean_call_info_t *cci)
     }
     if (INTERNAL_OPTION(opt_cleancall) > 2 && cci->num_simd_skip != NUM_SIMD_REGS)
         cci->should_align = false;
+}
+
+static void
+analyze_clean_call_regs(dcontext_t *dcontext, clean_call_info_t *cci)
+{
+    uint i, num_regparm;
+    callee_info_t *info = cci->callee_info;
+
+    /* 1. xmm registers */
+    analyze_clean_call_simd(dcontext, cci);
     /* 2. general purpose registers */
     /* set regs not to be saved for clean call */
     for (i = 0; i < NUM_GP_REGS; i++) {
@@ -685,6 +871,33 @@ analyze_clean_call_inline(dcontext_t *dcontext, clean_call_info_t *cci)
     return opt_inline;
 }
 
+/* Try to inline the fast path of a callee that bails out.  On failure, cci is
+ * reset for the regular out-of-line call.
+ */
+static bool
+analyze_clean_call_fast_path(dcontext_t *dcontext, clean_call_info_t *cci,
+                             instr_t *where, opnd_t *args)
+{
+    callee_info_t *ci = cci->callee_info;
+    callee_info_t *fp = ci->fast_path;
+
+    if (cci->num_args > 1 || cci->num_args > fp->num_args || cci->save_fpstate) {
+        LOG(THREAD, LOG_CLEANCALL, 2,
+            "CLEANCALL: fail inlining fast path of clean call "PFX".\n",
+            ci->start);
+        return false;
+    }
+    cci->callee_info = fp;
+    analyze_clean_call_aflags(dcontext, cci, where);
+    analyze_clean_call_regs(dcontext, cci);
+    analyze_clean_call_args(dcontext, cci, args);
+    if (analyze_clean_call_inline(dcontext, cci))
+        return true;
+    clean_call_info_init(cci, cci->callee, cci->save_fpstate, cci->num_args);
+    cci->callee_info = ci;
+    return false;
+}
+
 bool
 analyze_clean_call(dcontext_t *dcontext, clean_call_info_t *cci, instr_t *where,
                    void *callee, bool save_fpstate, bool always_out_of_line,
@@ -713,6 +926,14 @@ analyze_clean_call(dcontext_t *dcontext, clean_call_info_t *cci, instr_t *where,
             if (ci->bailout) {
                 callee_info_init(ci);
                 ci->start = (app_pc)callee;
+                /* A callee that calls out may still leave most xmm regs alone,
+                 * and with AVX saving all 16 full ymm regs is much of the switch.
+                 */
+                if (analyze_callee_simd_usage(dcontext, ci))
+                    STATS_INC(cleancall_simd_analyzed_nonleaf);
+                /* Its common case may still be cheap enough to inline. */
+                if (INTERNAL_OPTION(opt_cleancall) >= 2)
+                    ci->fast_path = analyze_callee_fast_path(dcontext, ci, num_args);
             } else
                 analyze_callee_ilist(dcontext, ci);
             /* 4.4. add info into callee list */
@@ -728,6 +949,13 @@ analyze_clean_call(dcontext_t *dcontext, clean_call_info_t *cci, instr_t *where,
             analyze_clean_call_args(dcontext, cci, args);
             /* 8. inline optimization analysis */
             should_inline = analyze_clean_call_inline(dcontext, cci);
+        } else if (ci->fast_path != NULL && !always_out_of_line &&
+                   analyze_clean_call_fast_path(dcontext, cci, where, args)) {
+            should_inline = true;
+        } else {
+            analyze_clean_call_simd(dcontext, cci);
+            if (cci->num_simd_skip > 0)
+                STATS_ADD(cleancall_simd_saves_skipped_nonleaf, cci->num_simd_skip);
         }
     }
 # ifdef X86
@@ -752,17 +980,26 @@ insert_inline_clean_call(dcontext_t *dcontext, clean_call_info_t *cci,
                          instrlist_t *ilist, instr_t *where, opnd_t *args)
 {
     instrlist_t *callee = cci->ilist;
-    instr_t *instr;
+    callee_info_t *ci = cci->callee_info;
+    instr_t *instr, *slow = NULL, *done;
 
     ASSERT(cci->ilist != NULL);
     ASSERT(SCRATCH_ALWAYS_TLS());
     /* 0. update stats */
     STATS_INC(cleancall_inlined);
+    if (ci->bwd_tgt != NULL || ci->fwd_tgt != NULL)
+        STATS_INC(cleancall_inlined_branchy);
     /* 1. save registers */
     insert_inline_reg_save(dcontext, cci, ilist, where, args);
     /* 2. setup parameters */
     insert_inline_arg_setup(dcontext, cci, ilist, where, args);
     /* 3. inline clean call ilist */
+    if (ci->has_slow_path) {
+        /* the fast path's branches to the rare path target the final label */
+        slow = instrlist_last(callee);
+        ASSERT(instr_is_label(slow));
+        instrlist_remove(callee, slow);
+    }
     instr = instrlist_first(callee);
     while (instr != NULL) {
         instrlist_remove(callee, instr);
@@ -780,6 +1017,18 @@ insert_inline_clean_call(dcontext_t *dcontext, clean_call_info_t *cci,
     cci->ilist = NULL;
     /* 4. restore registers */
     insert_inline_reg_restore(dcontext, cci, ilist, where);
+    /* 5. the rare path restores them too, and then needs the full clean call,
+     * which our caller inserts before cci->slow_path.
+     */
+    if (slow != NULL) {
+        STATS_INC(cleancall_inlined_fast_path);
+        done = INSTR_CREATE_label(dcontext);
+        PRE(ilist, where, XINST_CREATE_jump(dcontext, opnd_create_instr(done)));
+        PRE(ilist, where, slow);
+        insert_inline_reg_restore(dcontext, cci, ilist, where);
+        PRE(ilist, where, done);
+        cci->slow_path = done;
+    }
     /* XXX: the inlined code looks like this
      *   mov    %rax -> %gs:0x00
      *   mov    %rdi -> %gs:0x01
@@ -107,6 +107,19 @@ heap_free(dcontext_t *dcontext, void *p, size_t size HEAPACCT(which_heap_t which
     free(p);
 }
 
+/* there is no block building and thus no -bb_ir_arena here */
+void *
+heap_ir_alloc(dcontext_t *dcontext, size_t size)
+{
+    return malloc(size);
+}
+
+void
+heap_ir_free(dcontext_t *dcontext, void *p, size_t size)
+{
+    free(p);
+}
+
 dcontext_t *
 get_thread_private_dcontext(void)
 {
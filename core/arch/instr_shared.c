@@ -87,7 +87,7 @@
 instr_t*
 instr_create(dcontext_t *dcontext)
 {
-    instr_t *instr = (instr_t*) heap_alloc(dcontext, sizeof(instr_t) HEAPACCT(ACCT_IR));
+    instr_t *instr = (instr_t*) heap_ir_alloc(dcontext, sizeof(instr_t));
     /* everything initializes to 0, even flags, to indicate
      * an uninitialized instruction */
     memset((void *)instr, 0, sizeof(instr_t));
@@ -106,14 +106,14 @@ instr_destroy(dcontext_t *dcontext, instr_t *instr)
     instr_free(dcontext, instr);
 
     /* CAUTION: assumes that instr is not part of any instrlist */
-    heap_free(dcontext, instr, sizeof(instr_t) HEAPACCT(ACCT_IR));
+    heap_ir_free(dcontext, instr, sizeof(instr_t));
 }
 
 /* returns a clone of orig, but with next and prev fields set to NULL */
 instr_t *
 instr_clone(dcontext_t *dcontext, instr_t *orig)
 {
-    instr_t *instr = (instr_t*) heap_alloc(dcontext, sizeof(instr_t) HEAPACCT(ACCT_IR));
+    instr_t *instr = (instr_t*) heap_ir_alloc(dcontext, sizeof(instr_t));
     memcpy((void *)instr, (void *)orig, sizeof(instr_t));
     instr->next = NULL;
     instr->prev = NULL;
@@ -126,8 +126,7 @@ instr_clone(dcontext_t *dcontext, instr_t *orig)
 
     if ((orig->flags & INSTR_RAW_BITS_ALLOCATED) != 0) {
         /* instr length already set from memcpy */
-        instr->bytes = (byte *) heap_alloc(dcontext, instr->length
-                                           HEAPACCT(ACCT_IR));
+        instr->bytes = (byte *) heap_ir_alloc(dcontext, instr->length);
         memcpy((void *)instr->bytes, (void *)orig->bytes, instr->length);
     }
 #ifdef CUSTOM_EXIT_STUBS
@@ -140,15 +139,13 @@ instr_clone(dcontext_t *dcontext, instr_t *orig)
     else /* disable normal dst cloning */
 #endif
     if (orig->num_dsts > 0) { /* checking num_dsts, not dsts, b/c of label data */
-        instr->dsts = (opnd_t *) heap_alloc(dcontext, instr->num_dsts*sizeof(opnd_t)
-                                          HEAPACCT(ACCT_IR));
+        instr->dsts = (opnd_t *) heap_ir_alloc(dcontext, instr->num_dsts*sizeof(opnd_t));
         memcpy((void *)instr->dsts, (void *)orig->dsts,
                instr->num_dsts*sizeof(opnd_t));
     }
     if (orig->num_srcs > 1) { /* checking num_src, not srcs, b/c of label data */
-        instr->srcs = (opnd_t *) heap_alloc(dcontext,
-                                          (instr->num_srcs-1)*sizeof(opnd_t)
-                                          HEAPACCT(ACCT_IR));
+        instr->srcs = (opnd_t *) heap_ir_alloc(dcontext,
+                                               (instr->num_srcs-1)*sizeof(opnd_t));
         memcpy((void *)instr->srcs, (void *)orig->srcs,
                (instr->num_srcs-1)*sizeof(opnd_t));
     }
@@ -174,7 +171,7 @@ void
 instr_free(dcontext_t *dcontext, instr_t *instr)
 {
     if ((instr->flags & INSTR_RAW_BITS_ALLOCATED) != 0) {
-        heap_free(dcontext, instr->bytes, instr->length HEAPACCT(ACCT_IR));
+        heap_ir_free(dcontext, instr->bytes, instr->length);
         instr->bytes = NULL;
         instr->flags &= ~INSTR_RAW_BITS_ALLOCATED;
     }
@@ -188,15 +185,13 @@ instr_free(dcontext_t *dcontext, instr_t *instr)
     }
 #endif
     if (instr->num_dsts > 0) { /* checking num_dsts, not dsts, b/c of label data */
-        heap_free(dcontext, instr->dsts, instr->num_dsts*sizeof(opnd_t)
-                  HEAPACCT(ACCT_IR));
+        heap_ir_free(dcontext, instr->dsts, instr->num_dsts*sizeof(opnd_t));
         instr->dsts = NULL;
         instr->num_dsts = 0;
     }
     if (instr->num_srcs > 1) { /* checking num_src, not src, b/c of label data */
         /* remember one src is static, rest are dynamic */
-        heap_free(dcontext, instr->srcs, (instr->num_srcs-1)*sizeof(opnd_t)
-                  HEAPACCT(ACCT_IR));
+        heap_ir_free(dcontext, instr->srcs, (instr->num_srcs-1)*sizeof(opnd_t));
         instr->srcs = NULL;
         instr->num_srcs = 0;
     }
@@ -532,16 +527,15 @@ instr_set_num_opnds(dcontext_t *dcontext,
         CLIENT_ASSERT_TRUNCATE(instr->num_dsts, byte, instr_num_dsts,
                                "instr_set_num_opnds: too many dsts");
         instr->num_dsts = (byte) instr_num_dsts;
-        instr->dsts = (opnd_t *) heap_alloc(dcontext, instr_num_dsts*sizeof(opnd_t)
-                                          HEAPACCT(ACCT_IR));
+        instr->dsts = (opnd_t *) heap_ir_alloc(dcontext, instr_num_dsts*sizeof(opnd_t));
     }
     if (instr_num_srcs > 0) {
         /* remember that src0 is static, rest are dynamic */
         if (instr_num_srcs > 1) {
             CLIENT_ASSERT(instr->num_srcs <= 1 && instr->srcs == NULL,
                           "instr_set_num_opnds: srcs are already set");
-            instr->srcs = (opnd_t *) heap_alloc(dcontext, (instr_num_srcs-1)*sizeof(opnd_t)
-                                              HEAPACCT(ACCT_IR));
+            instr->srcs = (opnd_t *) heap_ir_alloc(dcontext,
+                                                   (instr_num_srcs-1)*sizeof(opnd_t));
         }
         CLIENT_ASSERT_TRUNCATE(instr->num_srcs, byte, instr_num_srcs,
                                "instr_set_num_opnds: too many srcs");
@@ -588,9 +582,8 @@ instr_remove_srcs(dcontext_t *dcontext, instr_t *instr, uint start, uint end)
     CLIENT_ASSERT(start >= 0 && end <= instr->num_srcs && start < end,
                   "instr_remove_srcs: ordinals invalid");
     if (instr->num_srcs - 1 > (byte)(end - start)) {
-        new_srcs = (opnd_t *) heap_alloc
-            (dcontext, (instr->num_srcs - 1 - (end-start))*sizeof(opnd_t)
-             HEAPACCT(ACCT_IR));
+        new_srcs = (opnd_t *) heap_ir_alloc
+            (dcontext, (instr->num_srcs - 1 - (end-start))*sizeof(opnd_t));
         if (start > 1)
             memcpy(new_srcs, instr->srcs, (start-1)*sizeof(opnd_t));
         if ((byte)end < instr->num_srcs - 1) {
@@ -601,8 +594,7 @@ instr_remove_srcs(dcontext_t *dcontext, instr_t *instr, uint start, uint end)
         new_srcs = NULL;
     if (start == 0 && end < instr->num_srcs)
         instr->src0 = instr->srcs[end - 1];
-    heap_free(dcontext, instr->srcs, (instr->num_srcs-1)*sizeof(opnd_t)
-              HEAPACCT(ACCT_IR));
+    heap_ir_free(dcontext, instr->srcs, (instr->num_srcs-1)*sizeof(opnd_t));
     instr->num_srcs -= (byte)(end - start);
     instr->srcs = new_srcs;
     instr_being_modified(instr, false/*raw bits invalid*/);
@@ -617,8 +609,8 @@ instr_remove_dsts(dcontext_t *dcontext, instr_t *instr, uint start, uint end)
     CLIENT_ASSERT(start >= 0 && end <= instr->num_dsts && start < end,
                   "instr_remove_dsts: ordinals invalid");
     if (instr->num_dsts > (byte)(end - start)) {
-        new_dsts = (opnd_t *) heap_alloc
-            (dcontext, (instr->num_dsts - (end-start))*sizeof(opnd_t) HEAPACCT(ACCT_IR));
+        new_dsts = (opnd_t *) heap_ir_alloc
+            (dcontext, (instr->num_dsts - (end-start))*sizeof(opnd_t));
         if (start > 0)
             memcpy(new_dsts, instr->dsts, start*sizeof(opnd_t));
         if (end < instr->num_dsts) {
@@ -627,7 +619,7 @@ instr_remove_dsts(dcontext_t *dcontext, instr_t *instr, uint start, uint end)
         }
     } else
         new_dsts = NULL;
-    heap_free(dcontext, instr->dsts, instr->num_dsts*sizeof(opnd_t) HEAPACCT(ACCT_IR));
+    heap_ir_free(dcontext, instr->dsts, instr->num_dsts*sizeof(opnd_t));
     instr->num_dsts -= (byte)(end - start);
     instr->dsts = new_dsts;
     instr_being_modified(instr, false/*raw bits invalid*/);
@@ -1077,7 +1069,7 @@ instr_free_raw_bits(dcontext_t *dcontext, instr_t *instr)
 {
     if ((instr->flags & INSTR_RAW_BITS_ALLOCATED) == 0)
         return;
-    heap_free(dcontext, instr->bytes, instr->length HEAPACCT(ACCT_IR));
+    heap_ir_free(dcontext, instr->bytes, instr->length);
     instr->flags &= ~INSTR_RAW_BITS_VALID;
     instr->flags &= ~INSTR_RAW_BITS_ALLOCATED;
 }
@@ -1094,7 +1086,7 @@ instr_allocate_raw_bits(dcontext_t *dcontext, instr_t *instr, uint num_bytes)
         original_bits = instr->bytes;
     if ((instr->flags & INSTR_RAW_BITS_ALLOCATED) == 0 ||
         instr->length != num_bytes) {
-        byte * new_bits = (byte *) heap_alloc(dcontext, num_bytes HEAPACCT(ACCT_IR));
+        byte * new_bits = (byte *) heap_ir_alloc(dcontext, num_bytes);
         if (original_bits != NULL) {
             /* copy original bits into modified bits so can just modify
              * a few and still have all info in one place
@@ -116,6 +116,34 @@ DECLARE_CXTSWPROT_VAR(mutex_t bb_building_lock, INIT_LOCK_FREE(bb_building_lock)
 /* i#1111: we do not use the lock until the 2nd thread is created */
 volatile bool bb_lock_start;
 
+/* -bb_build_claims: per-tag claims that let a shared bb be decoded, passed to
+ * the client, and mangled without holding bb_building_lock, which is then only
+ * held to emit and link.  Claims are taken and released while holding
+ * bb_building_lock, so plain stores suffice.  A thread waiting for another
+ * thread's claim counts itself in bb_claim_waiters and sleeps on
+ * bb_claim_released, which is signaled by each release while there are
+ * waiters; each woken waiter passes the signal on to the next one, and they
+ * all look their tags up again.  A tag whose slot holds a
+ * different tag is built without a claim: build_basic_block_fragment() looks
+ * the tag up again before emitting, which catches any duplicate build.
+ */
+#define BB_CLAIM_BITS 8
+#define BB_CLAIM_SLOTS (1 << BB_CLAIM_BITS)
+typedef struct _bb_claim_t {
+    app_pc tag;
+    dcontext_t *owner;
+} bb_claim_t;
+DECLARE_CXTSWPROT_VAR(static bb_claim_t bb_claims[BB_CLAIM_SLOTS], {{0}});
+DECLARE_CXTSWPROT_VAR(static uint bb_claim_waiters, 0);
+static event_t bb_claim_released;
+
+#define BB_CLAIMS_ACTIVE() \
+    (DYNAMO_OPTION(bb_build_claims) && USE_BB_BUILDING_LOCK() && \
+     /* module load events rely on the lock for serialization */ \
+     !dr_modload_hook_exists())
+
+#define BB_CLAIM_SLOT(tag) (&bb_claims[HASH_FUNC_BITS((ptr_uint_t)(tag), BB_CLAIM_BITS)])
+
 #ifdef INTERNAL
 file_t bbdump_file = INVALID_FILE;
 #endif
@@ -134,6 +162,8 @@ interp_init()
         ASSERT(bbdump_file != INVALID_FILE);
     }
 #endif
+    if (DYNAMO_OPTION(bb_build_claims))
+        bb_claim_released = create_event();
 }
 
 #ifdef CUSTOM_TRACES_RET_REMOVAL
@@ -153,6 +183,10 @@ interp_exit()
     }
 #endif
     DELETE_LOCK(bb_building_lock);
+    if (bb_claim_released != NULL) {
+        destroy_event(bb_claim_released);
+        bb_claim_released = NULL;
+    }
 
     LOG(GLOBAL, LOG_INTERP|LOG_STATS, 1, "Total application code seen: %d KB\n",
         GLOBAL_STAT(app_code_seen)/1024);
@@ -183,6 +217,7 @@ typedef struct {
     bool mangle_ilist;       /* should bb ilist be mangled? */
     bool record_translation; /* store translation info for each instr_t? */
     bool has_bb_building_lock; /* usually ==for_cache; used for aborting bb building */
+    bool has_bb_claim;       /* -bb_build_claims: start_pc claimed by this thread */
     bool checked_start_vmarea; /* caller called check_new_page_start() on start_pc */
     file_t outf;               /* send disassembly and notes to a file?
                                 * we use this mainly for dumping trace origins */
@@ -235,6 +270,7 @@ typedef struct {
 #ifdef ARM
     dr_pred_type_t svc_pred;    /* predicate for conditional svc */
 #endif
+    bool ir_arena;              /* ilist is in the -bb_ir_arena arena */
     DEBUG_DECLARE(bool initialized;)
 } build_bb_t;
 
@@ -1924,11 +1960,39 @@ bb_process_non_ignorable_syscall(dcontext_t *dcontext, build_bb_t *bb,
     return false; /* end bb now */
 }
 
+#if defined(CLIENT_INTERFACE) && defined(UNIX)
+/* Surrounds the inlined syscall bb->instr with clean calls to the client's
+ * inline syscall events, which observe it without a dispatch round trip.
+ */
+static void
+bb_insert_inline_syscall_hooks(dcontext_t *dcontext, build_bb_t *bb, int sysnum)
+{
+    /* A label keeps the post-syscall call after the syscall even when bb->instr
+     * is the last instr so far.
+     */
+    instr_t *post = INSTR_CREATE_label(dcontext);
+    bool was_int = (instr_get_opcode(bb->instr) == IF_X86_ELSE(OP_int, OP_svc));
+    BBPRINT(bb, 3, "inserting inline hooks around syscall # %d\n", sysnum);
+    instrlist_meta_postinsert(bb->ilist, bb->instr, post);
+    dr_insert_clean_call(dcontext, bb->ilist, bb->instr,
+                         (void *)inline_syscall_pre_hook, false, 2,
+                         OPND_CREATE_INT32(sysnum), OPND_CREATE_INT32(was_int));
+    dr_insert_clean_call(dcontext, bb->ilist, post,
+                         (void *)inline_syscall_post_hook, false, 1,
+                         OPND_CREATE_INT32(sysnum));
+    /* PR 213005: coarse units can't handle added ctis */
+    bb->flags &= ~FRAG_COARSE_GRAIN;
+}
+#endif
+
 /* returns true to indicate "continue bb" and false to indicate "end bb now" */
 static inline bool
 bb_process_syscall(dcontext_t *dcontext, build_bb_t *bb)
 {
     int sysnum;
+#if defined(CLIENT_INTERFACE) && defined(UNIX)
+    bool inline_hooks = false;
+#endif
 #ifdef CLIENT_INTERFACE
     /* PR 307284: for simplicity do syscall/int processing post-client.
      * We give up on inlining but we can still use ignorable/shared syscalls
@@ -1973,6 +2037,23 @@ bb_process_syscall(dcontext_t *dcontext, build_bb_t *bb)
                 "pretending syscall # %d is -1\n", sysnum);
         sysnum = -1;
     }
+#endif
+#if defined(CLIENT_INTERFACE) && defined(UNIX)
+    if (sysnum != -1 && instrument_filter_inline_syscall(dcontext, sysnum)) {
+        /* The inline hooks need the syscall to be executed in the cache:
+         * sysenter is never inlined (see below).  Otherwise we fall back to
+         * the regular syscall events, as though the client had filtered it.
+         */
+        if (DYNAMO_OPTION(ignore_syscalls) &&
+            ignorable_system_call(sysnum, bb->instr, NULL)
+            IF_X86(&& instr_get_opcode(bb->instr) != OP_sysenter))
+            inline_hooks = true;
+        else {
+            BBPRINT(bb, 3, "client inline hooks need interception => pretending "
+                    "syscall # %d is -1\n", sysnum);
+            sysnum = -1;
+        }
+    }
 #endif
     if (sysnum != -1 &&
         DYNAMO_OPTION(ignore_syscalls) &&
@@ -1990,6 +2071,10 @@ bb_process_syscall(dcontext_t *dcontext, build_bb_t *bb)
         bool continue_bb;
 
         if (bb_process_ignorable_syscall(dcontext, bb, sysnum, &continue_bb)) {
+#if defined(CLIENT_INTERFACE) && defined(UNIX)
+            if (inline_hooks)
+                bb_insert_inline_syscall_hooks(dcontext, bb, sysnum);
+#endif
             if (!DYNAMO_OPTION(inline_ignored_syscalls))
                 continue_bb = false;
             return continue_bb;
@@ -3348,6 +3433,13 @@ build_bb_ilist(dcontext_t *dcontext, build_bb_t *bb)
         bb->full_decode = true;
         bb->record_translation = true;
     }
+    /* -compact_translations and -fast_signals record a table from the final
+     * ilist of each shared bb when it is emitted.  That needs the translations
+     * but not a full decode: an undecoded bundle is translated contiguously.
+     */
+    if (bb->for_cache && RECORD_COMPACT_TRANSLATIONS() && DYNAMO_OPTION(shared_bbs) &&
+        !TEST(FRAG_TEMP_PRIVATE, bb->flags))
+        bb->record_translation = true;
 
     KSTART(bb_decoding);
     while (true) {
@@ -4386,6 +4478,10 @@ bb_build_abort(dcontext_t *dcontext, bool clean_vmarea, bool unlock)
             instrlist_clear_and_destroy(dcontext, bb->ilist);
             DODEBUG({ bb->ilist = NULL; });
         }
+        if (bb->ir_arena) {
+            heap_ir_arena_exit(dcontext);
+            bb->ir_arena = false;
+        }
         if (clean_vmarea) {
             /* Free the vmlist and any locks held (we could have been in
              * the middle of check_thread_vm_area and had a decode fault
@@ -4394,6 +4490,17 @@ bb_build_abort(dcontext_t *dcontext, bool clean_vmarea, bool unlock)
             check_thread_vm_area_abort(dcontext, &bb->vmlist, bb->flags);
         } /* else we were presumably called from vmarea so caller does cleanup */
         if (unlock) {
+            if (bb->has_bb_claim) {
+                /* The caller's release after the build will not run.  If we
+                 * aborted while building without the lock, re-take it.
+                 */
+                if (!bb->has_bb_building_lock)
+                    mutex_lock(&bb_building_lock);
+                bb_build_claim_release(dcontext, bb->start_pc);
+                if (!bb->has_bb_building_lock)
+                    mutex_unlock(&bb_building_lock);
+                bb->has_bb_claim = false;
+            }
             /* Assumption: bb building lock is held iff bb->for_cache,
              * and on a nested app bb build where !bb->for_cache we do keep the
              * original bb info in dcontext (see build_bb_ilist()).
@@ -5043,6 +5150,14 @@ init_interp_build_bb(dcontext_t *dcontext, build_bb_t *bb, app_pc start,
     /* we need to clone the ilist pre-mangling */
     bb->unmangled_ilist = unmangled_ilist;
 #endif
+    /* The IR of a bb for the cache dies once it is emitted, unless it is
+     * being cloned for a trace.
+     */
+    if (DYNAMO_OPTION(bb_ir_arena) > 0
+        IF_CLIENT_INTERFACE(&& unmangled_ilist == NULL && !instrument_keeps_bb_ir())) {
+        heap_ir_arena_enter(dcontext);
+        bb->ir_arena = true;
+    }
 }
 
 static inline void
@@ -5054,11 +5169,102 @@ exit_interp_build_bb(dcontext_t *dcontext, build_bb_t *bb)
 
     /* free the instrlist_t elements */
     instrlist_clear_and_destroy(dcontext, bb->ilist);
+    if (bb->ir_arena) {
+        heap_ir_arena_exit(dcontext);
+        bb->ir_arena = false;
+    }
+}
+
+/* For -bb_build_claims.  Must hold bb_building_lock.  Returns false if another
+ * thread holds a claim on tag, in which case this thread is counted as a waiter
+ * and the caller must release the lock, call bb_build_claim_wait(), and look
+ * tag up again.  Otherwise, claims tag if its slot is free and returns true.
+ */
+bool
+bb_build_claim(dcontext_t *dcontext, app_pc tag)
+{
+    bb_claim_t *claim = BB_CLAIM_SLOT(tag);
+    if (!BB_CLAIMS_ACTIVE())
+        return true;
+    ASSERT_OWN_MUTEX(true, &bb_building_lock);
+    if (claim->tag == tag) {
+        ASSERT(claim->owner != dcontext);
+        bb_claim_waiters++;
+        return false;
+    }
+    if (claim->tag == NULL) {
+        claim->tag = tag;
+        claim->owner = dcontext;
+    } else
+        STATS_INC(bb_build_claim_collisions);
+    return true;
+}
+
+/* Waits, without holding bb_building_lock, until some claim is released after a
+ * failed bb_build_claim() on tag.  The claim on tag itself may still be held
+ * when this returns, which the caller's next bb_build_claim() will find.
+ */
+void
+bb_build_claim_wait(dcontext_t *dcontext, app_pc tag)
+{
+    ASSERT_DO_NOT_OWN_MUTEX(true, &bb_building_lock);
+    STATS_INC(bb_build_claim_waits);
+    wait_for_event(bb_claim_released);
+    mutex_lock(&bb_building_lock);
+    ASSERT(bb_claim_waiters > 0);
+    bb_claim_waiters--;
+    if (bb_claim_waiters > 0)
+        signal_event(bb_claim_released);
+    mutex_unlock(&bb_building_lock);
+}
+
+/* Must hold bb_building_lock.  A nop unless this thread holds a claim on tag. */
+void
+bb_build_claim_release(dcontext_t *dcontext, app_pc tag)
+{
+    bb_claim_t *claim = BB_CLAIM_SLOT(tag);
+    if (claim->tag == tag && claim->owner == dcontext) {
+        ASSERT_OWN_MUTEX(true, &bb_building_lock);
+        claim->owner = NULL;
+        claim->tag = NULL;
+        if (bb_claim_waiters > 0)
+            signal_event(bb_claim_released);
+    }
+}
+
+/* Drops bb_building_lock for the decode and client phases of a bb whose tag
+ * this thread has claimed.  Returns whether the lock was dropped.
+ */
+static bool
+bb_build_unlock_for_claim(dcontext_t *dcontext, build_bb_t *bb)
+{
+    bb_claim_t *claim = BB_CLAIM_SLOT(bb->start_pc);
+    if (!BB_CLAIMS_ACTIVE() || !bb->has_bb_building_lock ||
+        claim->tag != bb->start_pc || claim->owner != dcontext)
+        return false;
+    bb->has_bb_claim = true;
+    bb->has_bb_building_lock = false;
+    SHARED_BB_UNLOCK();
+    STATS_INC(bb_build_unlocked);
+    return true;
+}
+
+/* Re-takes bb_building_lock to emit the bb.  The claim stays set until the
+ * caller releases it, which bb_build_abort() does instead on an abort.
+ */
+static void
+bb_build_relock_for_claim(dcontext_t *dcontext, build_bb_t *bb)
+{
+    ASSERT(bb->has_bb_claim);
+    mutex_lock(&bb_building_lock);
+    bb->has_bb_building_lock = true;
 }
 
 /* Interprets the application's instructions until the end of a basic
  * block is found, and then creates a fragment for the basic block.
  * DOES NOT look in the hashtable to see if such a fragment already exists!
+ * (With -bb_build_claims, if another thread added the same shared bb while
+ * this one was building without bb_building_lock, returns that fragment.)
  */
 fragment_t *
 build_basic_block_fragment(dcontext_t *dcontext, app_pc start, uint initial_flags,
@@ -5093,18 +5299,30 @@ build_basic_block_fragment(dcontext_t *dcontext, app_pc start, uint initial_flag
 #endif
         build_native_exec_bb(dcontext, &bb);
     } else {
+        bool unlocked = bb_build_unlock_for_claim(dcontext, &bb);
         build_bb_ilist(dcontext, &bb);
+        if (unlocked)
+            bb_build_relock_for_claim(dcontext, &bb);
         if (dcontext->bb_build_info == NULL) { /* going native */
             f = NULL;
             goto build_basic_block_fragment_done;
         }
+        if (unlocked && TEST(FRAG_SHARED, bb.flags)) {
+            f = fragment_lookup_shared_bb(dcontext, start);
+            if (f != NULL) {
+                /* a thread that did not see our claim built it meanwhile */
+                STATS_INC(bb_build_claim_races);
+                vm_area_destroy_list(dcontext, bb.vmlist);
+                exit_interp_build_bb(dcontext, &bb);
+                goto build_basic_block_fragment_done;
+            }
+        }
         if (bb.native_exec) {
             /* change bb to be a native_exec gateway */
             bool is_call = bb.native_call;
             LOG(THREAD, LOG_INTERP, 2, "replacing built bb with native_exec bb\n");
-            instrlist_clear_and_destroy(dcontext, bb.ilist);
             vm_area_destroy_list(dcontext, bb.vmlist);
-            dcontext->bb_build_info = NULL;
+            exit_interp_build_bb(dcontext, &bb);
             init_interp_build_bb(dcontext, &bb, start, initial_flags
                                  _IF_CLIENT(for_trace) _IF_CLIENT(unmangled_ilist));
 #ifdef CLIENT_INTERFACE
@@ -5476,6 +5694,10 @@ recreate_fragment_ilist(dcontext_t *dcontext, byte *pc,
                         optimize_trace(dcontext, f->tag, ilist);
                     /* else, never optimized */
                 } else
+# endif
+# ifdef FRAG_UNOPTIMIZED
+                /* -optimize_async has not yet swapped in an optimized copy */
+                if (!TEST(FRAG_UNOPTIMIZED, f->flags))
 # endif
                     optimize_trace(dcontext, f->tag, ilist);
             }
@@ -6475,6 +6697,127 @@ append_trace_speculate_last_ibl(dcontext_t *dcontext, instrlist_t *trace,
     return added_size;
 }
 
+/* Adds an inline cache for -ibl_inline_cache to the last IBL exit of a trace: a
+ * chain of comparisons of the indirect branch target against the profiled
+ * targets, each of which on a match leaves through its own direct exit so it
+ * links straight to the target's fragment.  A target that matches none of them
+ * falls through to the original exit to the ibl.
+ * Returns additional size to add to trace estimate.
+ */
+int
+append_trace_ibl_inline_cache(dcontext_t *dcontext, instrlist_t *trace,
+                              app_pc *targets, uint num_targets,
+                              bool record_translation)
+{
+    int added_size = 0;
+#ifdef X86
+    instr_t *targeter = instrlist_last(trace); /* the exit to the IBL */
+    uint i;
+
+    ASSERT(targeter != NULL && instr_is_exit_cti(targeter));
+    ASSERT(num_targets > 0 && num_targets <= IBL_INLINE_CACHE_MAX_TARGETS);
+
+    if (record_translation)
+        instrlist_set_translation_target(trace, instr_get_translation(targeter));
+    instrlist_set_our_mangling(trace, true); /* PR 267260 */
+
+    STATS_INC(num_traces_end_at_ibl_inline_cache);
+
+    /* XCX holds the target and the app XCX is in its spill slot, as for
+     * append_trace_speculate_last_ibl().  We use the same flags-free jecxz
+     * comparison as insert_transparent_comparison(), but with the tag in XAX so
+     * it works for any 64-bit tag:
+     *
+     *     mov  xax, xax-tls-spill-slot
+     *   for each target:
+     *     mov  $-tag, xax
+     *     lea  (xcx,xax,1), xcx
+     *     jecxz hit
+     *     mov  $tag, xax
+     *     lea  (xcx,xax,1), xcx
+     *     jmp  next
+     *   hit:
+     *     mov  xax-tls-spill-slot, xax
+     *     <restore app xcx>
+     *     jmp  tag                     # new direct exit
+     *   next:
+     *   ...
+     *     mov  xax-tls-spill-slot, xax
+     *     jmp  <exit stub: IBL>        # unchanged targeter
+     *
+     * As with speculation (case 5085), a hit exit that is unlinked looks like a
+     * direct exit to dispatch.
+     */
+    added_size +=
+        tracelist_add(dcontext, trace, targeter,
+                      INSTR_CREATE_mov_st(dcontext,
+                                          opnd_create_tls_slot
+                                          (os_tls_offset(PREFIX_XAX_SPILL_SLOT)),
+                                          opnd_create_reg(REG_XAX)));
+    for (i = 0; i < num_targets; i++) {
+        instr_t *hit = INSTR_CREATE_label(dcontext);
+        instr_t *next = INSTR_CREATE_label(dcontext);
+        instr_t *jmp;
+        added_size +=
+            tracelist_add(dcontext, trace, targeter,
+                          INSTR_CREATE_mov_imm(dcontext, opnd_create_reg(REG_XAX),
+                                               OPND_CREATE_INTPTR
+                                               (-(ptr_int_t)targets[i])));
+        added_size +=
+            tracelist_add(dcontext, trace, targeter,
+                          INSTR_CREATE_lea(dcontext, opnd_create_reg(REG_XCX),
+                                           opnd_create_base_disp(REG_XCX, REG_XAX, 1,
+                                                                 0, OPSZ_lea)));
+        jmp = INSTR_CREATE_jecxz(dcontext, opnd_create_instr(hit));
+        /* do not treat jecxz as exit cti! */
+        instr_set_meta(jmp);
+        added_size += tracelist_add(dcontext, trace, targeter, jmp);
+        /* no match: recover the target in xcx */
+        added_size +=
+            tracelist_add(dcontext, trace, targeter,
+                          INSTR_CREATE_mov_imm(dcontext, opnd_create_reg(REG_XAX),
+                                               OPND_CREATE_INTPTR
+                                               ((ptr_int_t)targets[i])));
+        added_size +=
+            tracelist_add(dcontext, trace, targeter,
+                          INSTR_CREATE_lea(dcontext, opnd_create_reg(REG_XCX),
+                                           opnd_create_base_disp(REG_XCX, REG_XAX, 1,
+                                                                 0, OPSZ_lea)));
+        jmp = INSTR_CREATE_jmp_short(dcontext, opnd_create_instr(next));
+        instr_set_meta(jmp);
+        added_size += tracelist_add(dcontext, trace, targeter, jmp);
+
+        added_size += tracelist_add(dcontext, trace, targeter, hit);
+        added_size +=
+            tracelist_add(dcontext, trace, targeter,
+                          INSTR_CREATE_mov_ld(dcontext, opnd_create_reg(REG_XAX),
+                                              opnd_create_tls_slot
+                                              (os_tls_offset(PREFIX_XAX_SPILL_SLOT))));
+        added_size += insert_restore_spilled_xcx(dcontext, trace, targeter);
+        added_size += tracelist_add(dcontext, trace, targeter,
+                                    XINST_CREATE_jump(dcontext,
+                                                      opnd_create_pc(targets[i])));
+        added_size += tracelist_add(dcontext, trace, targeter, next);
+        LOG(THREAD, LOG_INTERP, 3,
+            "append_trace_ibl_inline_cache: added cmp vs. "PFX" for ind br\n",
+            targets[i]);
+    }
+    added_size +=
+        tracelist_add(dcontext, trace, targeter,
+                      INSTR_CREATE_mov_ld(dcontext, opnd_create_reg(REG_XAX),
+                                          opnd_create_tls_slot
+                                          (os_tls_offset(PREFIX_XAX_SPILL_SLOT))));
+
+    if (record_translation)
+        instrlist_set_translation_target(trace, NULL);
+    instrlist_set_our_mangling(trace, false); /* PR 267260 */
+#elif defined(AARCHXX)
+    /* FIXME i#1551, i#1569: NYI on ARM/AArch64 */
+    ASSERT_NOT_IMPLEMENTED(false);
+#endif
+    return added_size;
+}
+
 #ifdef HASHTABLE_STATISTICS
 /* Add a counter on last IBL exit
  * if speculate_next_tag is not NULL then check case 4817's possible success
@@ -6638,11 +6981,9 @@ extend_trace(dcontext_t *dcontext, fragment_t *f, linkstub_t *prev_l)
                             md->trace_flags, &new_exits_dir, &new_exits_indir);
 
     md->blk_info[md->num_blks].info.tag = f->tag;
-#if defined(RETURN_AFTER_CALL) || defined(RCT_IND_BRANCH)
     if (md->num_blks > 0)
         md->blk_info[md->num_blks - 1].info.num_exits -= num_exits_deleted;
     md->blk_info[md->num_blks].info.num_exits = new_exits_dir + new_exits_indir;
-#endif
     md->num_blks++;
 
     /* We need to remove any nops we added for -pad_jmps (we don't expect there
@@ -6854,13 +7195,11 @@ mangle_trace(dcontext_t *dcontext, instrlist_t *ilist, monitor_data_t *md)
                 return false;
             }
         }
-#if defined(RETURN_AFTER_CALL) || defined(RCT_IND_BRANCH)
         /* PR 306761: we need to re-calculate md->blk_info[blk].info.num_exits,
          * and then adjust after fixup_last_cti.
          */
         if (instr_will_be_exit_cti(inst))
             md->blk_info[blk].info.num_exits++;
-#endif
 
     }
     if (blk < md->num_blks) {
@@ -6952,9 +7291,7 @@ mangle_trace(dcontext_t *dcontext, instrlist_t *ilist, monitor_data_t *md)
                                &num_exits_deleted,
                                /* Only walk ilist between these instrs */
                                start_instr, inst);
-#if defined(RETURN_AFTER_CALL) || defined(RCT_IND_BRANCH)
                 md->blk_info[blk].info.num_exits -= num_exits_deleted;
-#endif
             }
             blk++;
             /* skip fall-throughs */
@@ -620,6 +620,19 @@ get_call_return_address(dcontext_t *dcontext, instrlist_t *ilist, instr_t *instr
     return retaddr;
 }
 
+/* Returns whether calls and returns in a fragment with the given flags
+ * maintain the -shadow_ret_stack.  The landing addresses pushed by calls are
+ * absolute cache addresses, so we exclude fragments whose code is later
+ * copied elsewhere (traces) or frozen (coarse-grain units).
+ */
+bool
+shadow_ret_stack_applies(dcontext_t *dcontext, uint flags)
+{
+    return (DYNAMO_OPTION(shadow_ret_stack) &&
+            !TESTANY(FRAG_IS_TRACE | FRAG_COARSE_GRAIN, flags) &&
+            X64_MODE_DC(dcontext) == X64_CACHE_MODE_DC(dcontext));
+}
+
 #ifdef UNIX
 /* find the system call number in instrlist for an inlined system call
  * by simpling walking the ilist backward and finding "mov immed => %eax"
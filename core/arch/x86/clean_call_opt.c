@@ -169,6 +169,101 @@ analyze_callee_regs_usage(dcontext_t *dcontext, callee_info_t *ci)
     }
 }
 
+/* Limits on the code analyze_callee_simd_usage() decodes for one callee. */
+#define MAX_SIMD_SCAN_DEPTH  4
+#define MAX_SIMD_SCAN_INSTRS 1024
+
+/* Decodes the function at start up to its return, plus every function it
+ * directly calls, and marks the SIMD registers they use in ci.
+ * We decode linearly up to a return past every forward branch target, so
+ * all the code that can execute is covered as long as no branch leaves
+ * that range.  Returns false if that cannot be established.
+ */
+static bool
+scan_callee_simd_usage(dcontext_t *dcontext, callee_info_t *ci, app_pc start,
+                       uint depth, uint *budget)
+{
+    app_pc pc = start, cur_pc, tgt_pc, fwd_tgt = NULL;
+    instr_t instr;
+    bool ok = false;
+    uint i;
+
+    instr_init(GLOBAL_DCONTEXT, &instr);
+    while (*budget > 0) {
+        (*budget)--;
+        cur_pc = pc;
+        instr_reset(GLOBAL_DCONTEXT, &instr);
+        TRY_EXCEPT(dcontext, {
+            pc = decode(GLOBAL_DCONTEXT, cur_pc, &instr);
+        }, { /* EXCEPT */
+            pc = NULL;
+        });
+        if (pc == NULL || !instr_valid(&instr) ||
+            instr_is_syscall(&instr) || instr_is_interrupt(&instr))
+            break;
+        /* these change SIMD registers without naming them */
+        if (instr_get_opcode(&instr) == OP_vzeroupper ||
+            instr_get_opcode(&instr) == OP_vzeroall ||
+            instr_get_opcode(&instr) == OP_fxrstor32 ||
+            instr_get_opcode(&instr) == OP_fxrstor64 ||
+            instr_get_opcode(&instr) == OP_xrstor32 ||
+            instr_get_opcode(&instr) == OP_xrstor64)
+            break;
+        for (i = 0; i < NUM_SIMD_REGS; i++) {
+            if (!ci->simd_used[i] &&
+                instr_uses_reg(&instr, (DR_REG_XMM0 + (reg_id_t)i))) {
+                LOG(THREAD, LOG_CLEANCALL, 2,
+                    "CLEANCALL: callee "PFX" uses XMM%d at "PFX"\n",
+                    ci->start, i, cur_pc);
+                ci->simd_used[i] = true;
+                ci->num_simd_used++;
+            }
+        }
+        if (!instr_is_cti(&instr))
+            continue;
+        if (instr_is_mbr(&instr)) {
+            ok = instr_is_return(&instr) && (fwd_tgt == NULL || fwd_tgt <= cur_pc);
+            break;
+        }
+        if (!instr_is_call_direct(&instr) && !instr_is_ubr(&instr) &&
+            !instr_is_cbr(&instr))
+            break; /* far cti */
+        tgt_pc = opnd_get_pc(instr_get_target(&instr));
+        if (instr_is_call_direct(&instr)) {
+            /* DR's own routines may read the mcontext we would not fill in */
+            if (depth >= MAX_SIMD_SCAN_DEPTH || is_in_dynamo_dll(tgt_pc) ||
+                !scan_callee_simd_usage(dcontext, ci, tgt_pc, depth + 1, budget))
+                break;
+        } else if (tgt_pc < start) {
+            break; /* may leave the function, e.g., a tail call */
+        } else if (tgt_pc > cur_pc && (fwd_tgt == NULL || tgt_pc > fwd_tgt)) {
+            fwd_tgt = tgt_pc;
+        }
+    }
+    instr_free(GLOBAL_DCONTEXT, &instr);
+    return ok;
+}
+
+bool
+analyze_callee_simd_usage(dcontext_t *dcontext, callee_info_t *ci)
+{
+    uint i, budget = MAX_SIMD_SCAN_INSTRS;
+    ci->num_simd_used = 0;
+    memset(ci->simd_used, 0, sizeof(bool) * NUM_SIMD_REGS);
+    if (scan_callee_simd_usage(dcontext, ci, ci->start, 0, &budget)) {
+        LOG(THREAD, LOG_CLEANCALL, 2,
+            "CLEANCALL: callee "PFX" and its callees use %d XMM regs\n",
+            ci->start, ci->num_simd_used);
+        return true;
+    }
+    LOG(THREAD, LOG_CLEANCALL, 2,
+        "CLEANCALL: cannot bound XMM usage of callee "PFX"\n", ci->start);
+    ci->num_simd_used = NUM_SIMD_REGS;
+    for (i = 0; i < NUM_SIMD_REGS; i++)
+        ci->simd_used[i] = true;
+    return false;
+}
+
 /* We use push/pop pattern to detect callee saved registers,
  * and assume that the code later won't change those saved value
  * on the stack.
@@ -1435,6 +1435,153 @@ mangle_far_direct_helper(dcontext_t *dcontext, instrlist_t *ilist, instr_t *inst
                              OPND_CREATE_INT32((ptr_uint_t)pc)));
 }
 
+/***************************************************************************
+ * SHADOW RETURN STACK
+ *
+ * For -shadow_ret_stack, each mangled call pushes its return address plus the
+ * cache address of a landing exit to that return address, and each mangled
+ * return pops the top entry and, if its target matches, jumps to the landing
+ * exit rather than going through the ibl.  None of this touches the
+ * arithmetic flags, so no flags need to be saved.
+ */
+
+static opnd_t
+shadow_ret_tls_opnd(ushort slot, opnd_size_t size)
+{
+    return opnd_create_sized_tls_slot(os_tls_offset(slot), size);
+}
+
+/* Sets xax to the entry array and turns the index in xbx into an entry scale. */
+static void
+insert_shadow_ret_entry_base(dcontext_t *dcontext, instrlist_t *ilist, instr_t *where)
+{
+    PRE(ilist, where,
+        INSTR_CREATE_mov_ld(dcontext, opnd_create_reg(REG_XAX),
+                            shadow_ret_tls_opnd(TLS_SHADOW_RET_ENTRIES_SLOT, OPSZ_PTR)));
+#ifdef X64
+    /* There is no 16x scale: double the index and use an 8x scale. */
+    PRE(ilist, where,
+        INSTR_CREATE_lea(dcontext, opnd_create_reg(REG_XBX),
+                         opnd_create_base_disp(REG_XBX, REG_XBX, 1, 0, OPSZ_lea)));
+#endif
+    ASSERT(sizeof(shadow_ret_entry_t) == 8 * IF_X64_ELSE(2, 1));
+}
+
+static opnd_t
+shadow_ret_entry_opnd(size_t field_offs)
+{
+    return opnd_create_base_disp(REG_XAX, REG_XBX, 8, (int)field_offs, OPSZ_PTR);
+}
+
+/* Appends a landing exit to retaddr to the end of ilist and inserts before
+ * where the push of retaddr and the landing address.
+ */
+static void
+insert_shadow_ret_push(dcontext_t *dcontext, instrlist_t *ilist, instr_t *where,
+                       ptr_uint_t retaddr)
+{
+    instr_t *landing = XINST_CREATE_jump(dcontext, opnd_create_pc((app_pc)retaddr));
+    /* Like the fall-through exit, this is our own exit, but it is never
+     * reached by falling through: only by a matching return.
+     */
+    instr_set_translation(landing, (app_pc)retaddr);
+    instr_set_our_mangling(landing, true);
+    instr_exit_branch_set_type(landing, LINK_DIRECT|LINK_JMP);
+    instrlist_append(ilist, landing);
+    STATS_INC(num_shadow_ret_pushes);
+
+    PRE(ilist, where, instr_create_save_to_tls(dcontext, REG_XAX, TLS_XAX_SLOT));
+    PRE(ilist, where, instr_create_save_to_tls(dcontext, REG_XBX, TLS_XBX_SLOT));
+    /* The index is only accessed as a byte so it wraps on its own. */
+    PRE(ilist, where,
+        INSTR_CREATE_movzx(dcontext, opnd_create_reg(REG_EBX),
+                           shadow_ret_tls_opnd(TLS_SHADOW_RET_INDEX_SLOT, OPSZ_1)));
+    PRE(ilist, where,
+        INSTR_CREATE_lea(dcontext, opnd_create_reg(REG_XBX),
+                         opnd_create_base_disp(REG_XBX, REG_NULL, 0, 1, OPSZ_lea)));
+    PRE(ilist, where,
+        INSTR_CREATE_mov_st(dcontext,
+                            shadow_ret_tls_opnd(TLS_SHADOW_RET_INDEX_SLOT, OPSZ_1),
+                            opnd_create_reg(REG_BL)));
+    PRE(ilist, where,
+        INSTR_CREATE_movzx(dcontext, opnd_create_reg(REG_EBX), opnd_create_reg(REG_BL)));
+    insert_shadow_ret_entry_base(dcontext, ilist, where);
+    insert_mov_immed_ptrsz(dcontext, (ptr_int_t)retaddr,
+                           shadow_ret_entry_opnd(offsetof(shadow_ret_entry_t, retaddr)),
+                           ilist, where, NULL, NULL);
+    /* We don't know where the landing will be encoded, so assume it's far. */
+    insert_mov_instr_addr(dcontext, landing, (byte *) POINTER_MAX,
+                          shadow_ret_entry_opnd(offsetof(shadow_ret_entry_t, landing)),
+                          ilist, where, NULL, NULL);
+    PRE(ilist, where, instr_create_restore_from_tls(dcontext, REG_XBX, TLS_XBX_SLOT));
+    PRE(ilist, where, instr_create_restore_from_tls(dcontext, REG_XAX, TLS_XAX_SLOT));
+}
+
+/* Inserts before where, which must be the ibl exit of a return whose target
+ * is in xcx and whose app xcx was spilled by mangle_return(), a pop of the
+ * shadow stack and a jump to its landing if its return address matches.
+ */
+static void
+insert_shadow_ret_check(dcontext_t *dcontext, instrlist_t *ilist, instr_t *where,
+                        uint flags)
+{
+    instr_t *hit = INSTR_CREATE_label(dcontext);
+    instr_t *miss = INSTR_CREATE_label(dcontext);
+
+    PRE(ilist, where, instr_create_save_to_tls(dcontext, REG_XAX, TLS_XAX_SLOT));
+    PRE(ilist, where, instr_create_save_to_tls(dcontext, REG_XBX, TLS_XBX_SLOT));
+    PRE(ilist, where,
+        INSTR_CREATE_movzx(dcontext, opnd_create_reg(REG_EBX),
+                           shadow_ret_tls_opnd(TLS_SHADOW_RET_INDEX_SLOT, OPSZ_1)));
+    PRE(ilist, where,
+        INSTR_CREATE_lea(dcontext, opnd_create_reg(REG_XAX),
+                         opnd_create_base_disp(REG_XBX, REG_NULL, 0, -1, OPSZ_lea)));
+    PRE(ilist, where,
+        INSTR_CREATE_mov_st(dcontext,
+                            shadow_ret_tls_opnd(TLS_SHADOW_RET_INDEX_SLOT, OPSZ_1),
+                            opnd_create_reg(REG_AL)));
+    insert_shadow_ret_entry_base(dcontext, ilist, where);
+    PRE(ilist, where,
+        INSTR_CREATE_lea(dcontext, opnd_create_reg(REG_XAX),
+                         opnd_create_base_disp(REG_XAX, REG_XBX, 8, 0, OPSZ_lea)));
+    PRE(ilist, where,
+        INSTR_CREATE_mov_ld(dcontext, opnd_create_reg(REG_XBX),
+                            OPND_CREATE_MEMPTR(REG_XAX,
+                                               offsetof(shadow_ret_entry_t, landing))));
+    PRE(ilist, where,
+        INSTR_CREATE_mov_st(dcontext,
+                            shadow_ret_tls_opnd(TLS_SHADOW_RET_TARGET_SLOT, OPSZ_PTR),
+                            opnd_create_reg(REG_XBX)));
+    PRE(ilist, where,
+        INSTR_CREATE_mov_ld(dcontext, opnd_create_reg(REG_XBX),
+                            OPND_CREATE_MEMPTR(REG_XAX,
+                                               offsetof(shadow_ret_entry_t, retaddr))));
+    /* xcx -= retaddr, as xcx + ~retaddr + 1, and test for zero w/o the flags. */
+    PRE(ilist, where, INSTR_CREATE_not(dcontext, opnd_create_reg(REG_XBX)));
+    PRE(ilist, where,
+        INSTR_CREATE_lea(dcontext, opnd_create_reg(REG_XCX),
+                         opnd_create_base_disp(REG_XCX, REG_XBX, 1, 1, OPSZ_lea)));
+    PRE(ilist, where, INSTR_CREATE_jecxz(dcontext, opnd_create_instr(hit)));
+    /* Mismatch: put the target back for the ibl. */
+    PRE(ilist, where, INSTR_CREATE_not(dcontext, opnd_create_reg(REG_XBX)));
+    PRE(ilist, where,
+        INSTR_CREATE_lea(dcontext, opnd_create_reg(REG_XCX),
+                         opnd_create_base_disp(REG_XCX, REG_XBX, 1, 0, OPSZ_lea)));
+    PRE(ilist, where, instr_create_restore_from_tls(dcontext, REG_XBX, TLS_XBX_SLOT));
+    PRE(ilist, where, instr_create_restore_from_tls(dcontext, REG_XAX, TLS_XAX_SLOT));
+    PRE(ilist, where, INSTR_CREATE_jmp_short(dcontext, opnd_create_instr(miss)));
+    PRE(ilist, where, hit);
+    PRE(ilist, where, instr_create_restore_from_tls(dcontext, REG_XBX, TLS_XBX_SLOT));
+    PRE(ilist, where, instr_create_restore_from_tls(dcontext, REG_XAX, TLS_XAX_SLOT));
+    PRE(ilist, where,
+        RESTORE_FROM_DC_OR_TLS(dcontext, flags, REG_XCX, MANGLE_XCX_SPILL_SLOT,
+                               XCX_OFFSET));
+    PRE(ilist, where,
+        INSTR_CREATE_jmp_ind(dcontext,
+                             shadow_ret_tls_opnd(TLS_SHADOW_RET_TARGET_SLOT, OPSZ_PTR)));
+    PRE(ilist, where, miss);
+}
+
 /***************************************************************************
  * DIRECT CALL
  * Returns new next_instr
@@ -1514,6 +1661,11 @@ mangle_direct_call(dcontext_t *dcontext, instrlist_t *ilist, instr_t *instr,
 
     /* convert a direct call to a push of the return address */
     insert_push_retaddr(dcontext, ilist, instr, retaddr, pushsz);
+    if (shadow_ret_stack_applies(dcontext, flags) &&
+        instr_get_opcode(instr) == OP_call && pushsz == OPSZ_PTR &&
+        /* A call to the next instr is not going to have a matching ret. */
+        target != (app_pc)retaddr)
+        insert_shadow_ret_push(dcontext, ilist, instr, retaddr);
 
     /* remove the call */
     instrlist_remove(ilist, instr);
@@ -1687,6 +1839,8 @@ mangle_indirect_call(dcontext_t *dcontext, instrlist_t *ilist, instr_t *instr,
     if (TEST(INSTR_IND_CALL_DIRECT, instr->flags)) {
         /* convert the call to a push of the return address */
         insert_push_retaddr(dcontext, ilist, instr, retaddr, pushsz);
+        if (shadow_ret_stack_applies(dcontext, flags) && pushsz == OPSZ_PTR)
+            insert_shadow_ret_push(dcontext, ilist, instr, retaddr);
         /* remove the call */
         instrlist_remove(ilist, instr);
         instr_destroy(dcontext, instr);
@@ -1706,6 +1860,9 @@ mangle_indirect_call(dcontext_t *dcontext, instrlist_t *ilist, instr_t *instr,
          */
     }
     insert_push_retaddr(dcontext, ilist, next_instr, retaddr, pushsz);
+    if (shadow_ret_stack_applies(dcontext, flags) &&
+        instr_get_opcode(instr) == OP_call_ind && pushsz == OPSZ_PTR)
+        insert_shadow_ret_push(dcontext, ilist, next_instr, retaddr);
 
     /* save away xcx so that we can use it */
     /* (it's restored in x86.s (indirect_branch_lookup) */
@@ -1985,6 +2142,10 @@ mangle_return(dcontext_t *dcontext, instrlist_t *ilist, instr_t *instr,
 #endif
     }
 
+    if (shadow_ret_stack_applies(dcontext, flags) &&
+        instr_get_opcode(instr) == OP_ret && retsz == OPSZ_PTR)
+        insert_shadow_ret_check(dcontext, ilist, next_instr, flags);
+
     /* remove the ret */
     instrlist_remove(ilist, instr);
     instr_destroy(dcontext, instr);
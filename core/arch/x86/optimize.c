@@ -130,6 +130,27 @@ void logtrace(dcontext_t *dcontext, uint level, instrlist_t *trace, const char *
 /****************************************************************************/
 /* master routine */
 
+#ifdef DEBUG
+static int
+opt_instr_count(instrlist_t *trace)
+{
+    instr_t *inst;
+    int count = 0;
+    for (inst = instrlist_first(trace); inst != NULL; inst = instr_get_next(inst))
+        count++;
+    return count;
+}
+
+/* Runs one pass and adds the net number of instrs it removed to stat. */
+# define OPT_PASS(stat, pass) do {                              \
+        int pre_count = opt_instr_count(trace);                 \
+        pass;                                                   \
+        STATS_ADD(stat, pre_count - opt_instr_count(trace));    \
+    } while (0)
+#else
+# define OPT_PASS(stat, pass) pass
+#endif
+
 void
 optimize_trace(dcontext_t *dcontext, app_pc tag, instrlist_t *trace)
 {
@@ -145,6 +166,7 @@ optimize_trace(dcontext_t *dcontext, app_pc tag, instrlist_t *trace)
      * targets, so we go ahead and do that up front
      */
     instrlist_decode_cti(dcontext, trace);
+    DOSTATS({ STATS_ADD(opt_instrs_in, opt_instr_count(trace)); });
 
 #ifdef DEBUG
     LOG(THREAD, LOG_OPTS, 3, "\noptimize_trace ******************\n");
@@ -160,7 +182,7 @@ optimize_trace(dcontext_t *dcontext, app_pc tag, instrlist_t *trace)
     }
 
     if (dynamo_options.call_return_matching) {
-        call_return_matching(dcontext, tag, trace);
+        OPT_PASS(opt_removed_call_return, call_return_matching(dcontext, tag, trace));
     }
 
     if (dynamo_options.unroll_loops) {
@@ -176,27 +198,28 @@ optimize_trace(dcontext_t *dcontext, app_pc tag, instrlist_t *trace)
     }
 
     if (dynamo_options.rlr) {
-        remove_redundant_loads(dcontext, tag, trace);
+        OPT_PASS(opt_removed_rlr, remove_redundant_loads(dcontext, tag, trace));
     }
 
     if (dynamo_options.remove_unnecessary_zeroing) {
-        remove_unnecessary_zeroing(dcontext, tag, trace);
+        OPT_PASS(opt_removed_zeroing,
+                 remove_unnecessary_zeroing(dcontext, tag, trace));
     }
 
     if (dynamo_options.constant_prop) {
-        constant_propagation(dcontext, tag, trace);
+        OPT_PASS(opt_removed_constant_prop, constant_propagation(dcontext, tag, trace));
     }
 
     if (dynamo_options.remove_dead_code) {
-        remove_dead_code(dcontext, tag, trace);
+        OPT_PASS(opt_removed_dead_code, remove_dead_code(dcontext, tag, trace));
     }
 
     if (dynamo_options.stack_adjust) {
-        stack_adjust_combiner(dcontext, tag, trace);
+        OPT_PASS(opt_removed_stack_adjust, stack_adjust_combiner(dcontext, tag, trace));
     }
 
     if (dynamo_options.peephole) {
-        peephole_optimize(dcontext, tag, trace);
+        OPT_PASS(opt_removed_peephole, peephole_optimize(dcontext, tag, trace));
     }
 
 #ifdef IA32_ON_IA64
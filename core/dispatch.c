@@ -136,6 +136,7 @@ dispatch(dcontext_t *dcontext)
 {
     fragment_t *targetf;
     fragment_t coarse_f;
+    app_pc claimed_tag;
 
 #ifdef HAVE_TLS
 # if defined(UNIX) && defined(X86)
@@ -212,6 +213,15 @@ dispatch(dcontext_t *dcontext)
                                                           &coarse_f, dcontext->last_exit);
             }
             if (targetf == NULL) {
+                /* with -bb_build_claims, wait for any other thread building this
+                 * tag rather than building it again
+                 */
+                claimed_tag = dcontext->next_tag;
+                if (!bb_build_claim(dcontext, claimed_tag)) {
+                    SHARED_BB_UNLOCK();
+                    bb_build_claim_wait(dcontext, claimed_tag);
+                    continue;
+                }
                 SELF_PROTECT_LOCAL(dcontext, WRITABLE);
                 targetf =
                     build_basic_block_fragment(dcontext, dcontext->next_tag,
@@ -219,6 +229,7 @@ dispatch(dcontext_t *dcontext)
                                                _IF_CLIENT(false/*!for_trace*/)
                                                _IF_CLIENT(NULL));
                 SELF_PROTECT_LOCAL(dcontext, READONLY);
+                bb_build_claim_release(dcontext, claimed_tag);
             }
             if (targetf != NULL && TEST(FRAG_COARSE_GRAIN, targetf->flags)) {
                 /* targetf is a static temp fragment protected by bb_building_lock,
@@ -239,6 +250,8 @@ dispatch(dcontext_t *dcontext)
         } while (true);
 
         if (targetf != NULL) {
+            if (DYNAMO_OPTION(cache_clock_replace))
+                fcache_fragment_entered(dcontext, targetf);
             if (dispatch_enter_fcache(dcontext, targetf)) {
                 /* won't reach here: will re-enter dispatch() with a clean stack */
                 ASSERT_NOT_REACHED();
@@ -836,9 +849,8 @@ dispatch_enter_dynamorio(dcontext_t *dcontext)
                     coarse_info_t *info = dcontext->coarse_exit.dir_exit;
                     ASSERT(info != NULL);
                     if (info->mod_shift != 0 &&
-                        dcontext->next_tag >= info->persist_base &&
-                        dcontext->next_tag < info->persist_base +
-                        (info->end_pc - info->base_pc))
+                        dcontext->next_tag >= info->base_pc + info->mod_shift &&
+                        dcontext->next_tag < info->end_pc + info->mod_shift)
                         dcontext->next_tag -= info->mod_shift;
                 }
             }
@@ -1077,6 +1089,11 @@ dispatch_exit_fcache(dcontext_t *dcontext)
          */
         fragment_add_ibl_target(dcontext, dcontext->next_tag,
                                 extract_branchtype(dcontext->last_exit->flags));
+        /* profile the targets of this exit for -ibl_inline_cache */
+        if (DYNAMO_OPTION(ibl_inline_cache) > 0) {
+            monitor_ibl_profile_exit(dcontext, dcontext->last_fragment,
+                                     dcontext->last_exit, dcontext->next_tag);
+        }
         /* FIXME: optimize this to stay writable if we're going to
          * be building a bb as well -- no very quick check though
          */
@@ -354,6 +354,35 @@ get_dr_stats(void)
     return stats;
 }
 
+#ifdef CLIENT_INTERFACE
+DR_API
+bool
+dr_get_statistic(const char *stat_name, int64 *val OUT)
+{
+    CLIENT_ASSERT(val != NULL, "invalid parameter");
+    *val = 0;
+    if (stat_name == NULL || !GLOBAL_STATS_ON())
+        return false;
+#ifdef DEBUG
+# define STATS_DEF(desc, statname)                                   \
+    if (strcmp(stat_name, #statname) == 0) {                         \
+        *val = (int64) GLOBAL_STAT(statname);                        \
+        return true;                                                 \
+    }
+#else
+# define RSTATS_DEF(desc, statname)                                  \
+    if (strcmp(stat_name, #statname) == 0) {                         \
+        *val = (int64) GLOBAL_STAT(statname);                        \
+        return true;                                                 \
+    }
+#endif
+# include "statsx.h"
+#undef STATS_DEF
+#undef RSTATS_DEF
+    return false;
+}
+#endif /* CLIENT_INTERFACE */
+
 /* initialize per-process dynamo state; this must be called before any
  * threads are created and before any other API calls are made;
  * returns zero on success, non-zero on failure
@@ -651,6 +680,12 @@ dynamorio_app_init(void)
          */
         vm_area_delay_load_coarse_units();
 #endif
+#ifdef ASYNC_OPTIMIZE
+        /* like a client's threads, the helper thread is created once the
+         * initial thread has a dcontext
+         */
+        monitor_async_optimize_init();
+#endif
 
 #ifdef WINDOWS
         if (!INTERNAL_OPTION(noasynch))
@@ -721,6 +756,9 @@ dynamorio_fork_init(dcontext_t *dcontext)
      */
     thread_record_t **threads;
     int i, num_threads;
+    /* only pay for timing and walking the inherited cache if we keep the stats */
+    bool fork_stats = GLOBAL_STATS_ON();
+    uint64 start_micros = fork_stats ? query_time_micros() : 0;
 # ifdef DEBUG
     char parent_logdir[MAXIMUM_PATH];
 # endif
@@ -773,6 +811,10 @@ dynamorio_fork_init(dcontext_t *dcontext)
     }
 # endif /* DEBUG */
 
+# ifdef ASYNC_OPTIMIZE
+    /* the parent's threads exiting below take the helper thread's queue lock */
+    monitor_async_optimize_fork_reset();
+# endif
     /* must re-hash parent entry in threads table, plus no longer have any
      * other threads (fork -> we're alone in address space), so clear
      * out entire thread table, then add child
@@ -810,6 +852,12 @@ dynamorio_fork_init(dcontext_t *dcontext)
      * on a fork -- probably everyone who makes a log file on init.
      */
     fragment_fork_init(dcontext);
+    /* For comparing how much each child rebuilds vs reuses from its parent. */
+    if (DYNAMO_OPTION(zygote) || fork_stats) {
+        uint inherited = fcache_fork_init(dcontext, fork_stats);
+        if (fork_stats)
+            GLOBAL_STAT(num_fragments_inherited) = inherited;
+    }
     /* this must be called after dynamo_other_thread_exit() above */
     signal_fork_init(dcontext);
 
@@ -818,6 +866,18 @@ dynamorio_fork_init(dcontext_t *dcontext)
         instrument_fork_init(dcontext);
     }
 # endif
+# ifdef ASYNC_OPTIMIZE
+    /* re-creates the helper thread, which the fork did not copy */
+    monitor_async_optimize_init();
+# endif
+
+    if (fork_stats) {
+        GLOBAL_STAT(fork_init_micros) =
+            (stats_int_t) (query_time_micros() - start_micros);
+        LOG(GLOBAL, LOG_TOP, 1, "fork child inherited %d fragments, initialized in "
+            "%d us\n", (int) GLOBAL_STAT(num_fragments_inherited),
+            (int) GLOBAL_STAT(fork_init_micros));
+    }
 }
 #endif /* UNIX */
 
@@ -831,6 +891,11 @@ dcontext_t *
 standalone_init(void)
 {
     dcontext_t *dcontext;
+#ifndef STANDALONE_UNIT_TEST
+    /* Separate components of one standalone tool may each initialize us. */
+    if (standalone_library && dynamo_initialized)
+        return GLOBAL_DCONTEXT;
+#endif
     standalone_library = true;
     /* We have release-build stats now so this is not just DEBUG */
     stats = &nonshared_stats;
@@ -918,7 +918,8 @@ emit_fragment_common(dcontext_t *dcontext, app_pc tag,
     if (TEST(FRAG_HAS_TRANSLATION_INFO, f->flags)) {
         ASSERT(!TEST(FRAG_COARSE_GRAIN, f->flags));
         fragment_record_translation_info(dcontext, f, ilist);
-    }
+    } else if (RECORD_COMPACT_TRANSLATIONS())
+        fragment_cache_translation_info(dcontext, f, ilist);
 
     /* if necessary, i-cache sync */
     machine_cache_sync((void*)f->start_pc, (void*)(f->start_pc+f->size), true);
@@ -398,6 +398,10 @@ typedef struct _fcache_unit_t {
     cache_pc reserved_end_pc;  /* reservation end address, open-ended */
     size_t size;               /* committed size: equals (end_pc - start_pc) */
     bool full;                 /* to tell whether cache is filled to end */
+    bool huge_pages;           /* -cache_huge_pages: from heap_mmap_huge() */
+#ifdef UNIX
+    bool inherited;            /* -zygote: inherited from the parent across fork */
+#endif
     struct _fcache *cache;     /* up-pointer to parent cache */
 #if defined(SIDELINE) || defined(WINDOWS_PC_SAMPLE)
     dcontext_t *dcontext;
@@ -448,6 +452,10 @@ typedef struct _fcache {
 #endif
     /* Is this a dedicated coarse-grain cache unit */
     bool is_coarse:1;
+#ifdef UNIX
+    /* -zygote: some units are inherited from the parent and should not be written */
+    bool has_inherited:1;
+#endif
     fragment_t *fifo;            /* the FIFO list of fragments to delete.
                                 * also includes empty slots as EmptySlots
                                 * (all empty slots are at front of FIFO) */
@@ -495,6 +503,10 @@ typedef struct _fcache {
      * recording num_regenerated and num_replaced
      */
     bool     record_wset;
+    /* for -cache_clock_replace: fragments given a second chance that have not
+     * been entered since, keyed by tag.  Created on the first replacement.
+     */
+    generic_table_t *clock_table;
 
     free_list_header_t *free_list[FREE_LIST_SIZES_NUM];
 #ifdef DEBUG
@@ -515,6 +527,13 @@ typedef struct _fcache {
 typedef struct _fcache_thread_units_t {
     fcache_t *bb;    /* basic block fcache */
     fcache_t *trace; /* trace fcache */
+    /* -cache_hot_layout: bounded caches holding fragments moved out of bb and
+     * trace once they were found hot, created on first use
+     */
+    fcache_t *hot_bb;
+    fcache_t *hot_trace;
+    /* are new private fragments being placed in the hot caches? */
+    bool place_hot;
     /* we delay unmapping units, but only one at a time: */
     cache_pc pending_unmap_pc;
     size_t pending_unmap_size;
@@ -733,6 +752,24 @@ fcache_free_unit(dcontext_t *dcontext, fcache_unit_t *unit, bool dealloc_or_reus
         }                                                                     \
     } while (0);
 
+#define HUGE_PAGE_ALIGN_PARAM(param, ret) do {                            \
+    if (!ALIGNED(FCACHE_OPTION(param), HUGE_PAGE_SIZE)) {                 \
+        FCACHE_OPTION(param) =                                            \
+            (uint) ALIGN_FORWARD(FCACHE_OPTION(param), HUGE_PAGE_SIZE);   \
+        ret = true;                                                       \
+    }                                                                     \
+} while (0);
+
+/* -cache_huge_pages units are whole huge pages, committed in full */
+#define HUGE_PAGE_PARAMS(who, ret) do {                                   \
+    /* a 0 max means unlimited and is left alone */                       \
+    HUGE_PAGE_ALIGN_PARAM(cache_##who##_max, ret);                        \
+    HUGE_PAGE_ALIGN_PARAM(cache_##who##_unit_init, ret);                  \
+    HUGE_PAGE_ALIGN_PARAM(cache_##who##_unit_max, ret);                   \
+    HUGE_PAGE_ALIGN_PARAM(cache_##who##_unit_quadruple, ret);             \
+    HUGE_PAGE_ALIGN_PARAM(cache_##who##_unit_upgrade, ret);               \
+} while (0);
+
 /* pulled out from fcache_init, checks for compatibility among the fcache
  * options, returns true if modified the value of any options to make them
  * compatible.  This is called while the options are writable. */
@@ -741,6 +778,16 @@ fcache_check_option_compatibility()
 {
     bool ret = false;
     uint i;
+    if (DYNAMO_OPTION(cache_huge_pages)) {
+        /* Only the shared caches use huge pages: there are few of them and
+         * their units are never resized.  Rounding every thread's private
+         * units up to a fully committed 2MB would cost far more memory than
+         * the iTLB misses it saves.
+         */
+        HUGE_PAGE_PARAMS(shared_bb, ret);
+        HUGE_PAGE_PARAMS(shared_trace, ret);
+        HUGE_PAGE_PARAMS(coarse_bb, ret);
+    }
     CHECK_PARAMS(bb, "Basic block", ret);
     CHECK_PARAMS(trace, "Trace", ret);
     CHECK_WSET_PARAM(bb, ret);
@@ -919,6 +966,28 @@ remove_unit_from_cache(fcache_unit_t *u)
     u->cache = NULL;
 }
 
+/* Whether the units of cache are backed by huge pages for -cache_huge_pages */
+#define FCACHE_HUGE_PAGES(cache) (DYNAMO_OPTION(cache_huge_pages) && (cache)->is_shared)
+
+/* Allocates the memory for a unit.  Huge page units are committed in full and
+ * have no guard pages, which would keep them off a huge page boundary.
+ */
+static cache_pc
+fcache_unit_mmap(size_t reserve_size, size_t commit_size, bool huge_pages)
+{
+    if (huge_pages) {
+        ASSERT(commit_size == reserve_size);
+        return (cache_pc) heap_mmap_huge(reserve_size);
+    }
+    return (cache_pc) heap_mmap_reserve(reserve_size, commit_size);
+}
+
+static void
+fcache_unit_munmap(cache_pc pc, size_t size, bool huge_pages)
+{
+    heap_munmap_ex((void *)pc, size, !huge_pages);
+}
+
 static void
 fcache_really_free_unit(fcache_unit_t *u, bool on_dead_list, bool dealloc_unit)
 {
@@ -947,7 +1016,7 @@ fcache_really_free_unit(fcache_unit_t *u, bool on_dead_list, bool dealloc_unit)
      */
     vmvector_remove(fcache_unit_areas, u->start_pc, u->reserved_end_pc);
     if (dealloc_unit)
-        heap_munmap((void*)u->start_pc, UNIT_RESERVED_SIZE(u));
+        fcache_unit_munmap(u->start_pc, UNIT_RESERVED_SIZE(u), u->huge_pages);
     /* always dealloc the metadata */
     nonpersistent_heap_free(GLOBAL_DCONTEXT, u, sizeof(fcache_unit_t)
                             HEAPACCT(ACCT_MEM_MGT));
@@ -1274,7 +1343,7 @@ fcache_create_unit(dcontext_t *dcontext, fcache_t *cache, cache_pc pc, size_t si
             fcache_unit_t *prev_u = NULL;
             u = allunits->dead;
             while (u != NULL) {
-                if (u->size >= size &&
+                if (u->size >= size && u->huge_pages == FCACHE_HUGE_PAGES(cache) &&
                     (cache->max_size == 0 || cache->size + u->size <= cache->max_size)) {
                     /* remove from dead list */
                     if (prev_u == NULL)
@@ -1310,14 +1379,21 @@ fcache_create_unit(dcontext_t *dcontext, fcache_t *cache, cache_pc pc, size_t si
                                      HEAPACCT(ACCT_MEM_MGT));
         if (pc != NULL) {
             u->start_pc = pc;
+            u->huge_pages = false;
             commit_size = size;
             STATS_FCACHE_ADD(cache, claimed, size);
             STATS_ADD(fcache_combined_claimed, size);
         } else {
             /* allocate new unit */
-            commit_size = DYNAMO_OPTION(cache_commit_increment);
+            u->huge_pages = FCACHE_HUGE_PAGES(cache);
+            if (u->huge_pages) {
+                /* a unit for an oversized fragment may not be a whole huge page */
+                size = ALIGN_FORWARD(size, HUGE_PAGE_SIZE);
+                commit_size = size;
+            } else
+                commit_size = DYNAMO_OPTION(cache_commit_increment);
             ASSERT(commit_size <= size);
-            u->start_pc = (cache_pc) heap_mmap_reserve(size, commit_size);
+            u->start_pc = fcache_unit_mmap(size, commit_size, u->huge_pages);
         }
         ASSERT(u->start_pc != NULL);
         ASSERT(proc_is_cache_aligned((void *)u->start_pc));
@@ -1345,6 +1421,9 @@ fcache_create_unit(dcontext_t *dcontext, fcache_t *cache, cache_pc pc, size_t si
 
     u->cur_pc = u->start_pc;
     u->full = false;
+#ifdef UNIX
+    u->inherited = false;
+#endif
     u->cache = cache;
 #if defined(SIDELINE) || defined(WINDOWS_PC_SAMPLE)
     u->dcontext = dcontext;
@@ -1459,23 +1538,23 @@ fcache_free_unit(dcontext_t *dcontext, fcache_unit_t *unit, bool dealloc_or_reus
 /* assuming size will either be aligned at VM_ALLOCATION_BOUNDARY or
  * smaller where no adjustment is necessary
  */
-#define FCACHE_GUARDED(size)                                            \
+#define FCACHE_GUARDED(cache, size)                                     \
         ((size) -                                                       \
-         ((DYNAMO_OPTION(guard_pages) &&                                \
+         ((DYNAMO_OPTION(guard_pages) && !FCACHE_HUGE_PAGES(cache) &&   \
            ((size) >= VM_ALLOCATION_BOUNDARY - 2 * (uint)PAGE_SIZE))    \
           ? (2 * (uint)PAGE_SIZE) : 0))
 
 #define SET_CACHE_PARAMS(cache, which) do {                             \
     cache->max_size =                                                   \
-        FCACHE_GUARDED(FCACHE_OPTION(cache_##which##_max));             \
+        FCACHE_GUARDED(cache, FCACHE_OPTION(cache_##which##_max));      \
     cache->max_unit_size =                                              \
-        FCACHE_GUARDED(FCACHE_OPTION(cache_##which##_unit_max));        \
+        FCACHE_GUARDED(cache, FCACHE_OPTION(cache_##which##_unit_max)); \
     cache->max_quadrupled_unit_size =                                   \
-        FCACHE_GUARDED(FCACHE_OPTION(cache_##which##_unit_quadruple));  \
+        FCACHE_GUARDED(cache, FCACHE_OPTION(cache_##which##_unit_quadruple)); \
     cache->free_upgrade_size =                                          \
-        FCACHE_GUARDED(FCACHE_OPTION(cache_##which##_unit_upgrade));    \
+        FCACHE_GUARDED(cache, FCACHE_OPTION(cache_##which##_unit_upgrade)); \
     cache->init_unit_size =                                             \
-        FCACHE_GUARDED(FCACHE_OPTION(cache_##which##_unit_init));       \
+        FCACHE_GUARDED(cache, FCACHE_OPTION(cache_##which##_unit_init)); \
     cache->finite_cache = dynamo_options.finite_##which##_cache;        \
     cache->regen_param = dynamo_options.cache_##which##_regen;          \
     cache->replace_param = dynamo_options.cache_##which##_replace;      \
@@ -1491,6 +1570,9 @@ fcache_cache_init(dcontext_t *dcontext, uint flags, bool initial_unit)
     cache->is_trace = TEST(FRAG_IS_TRACE, flags);
     cache->is_shared = TEST(FRAG_SHARED, flags);
     cache->is_coarse = TEST(FRAG_COARSE_GRAIN, flags);
+#ifdef UNIX
+    cache->has_inherited = false;
+#endif
     DODEBUG({ cache->is_local = false; });
     cache->coarse_info = NULL;
     DODEBUG({ cache->consistent = true; });
@@ -1532,6 +1614,7 @@ fcache_cache_init(dcontext_t *dcontext, uint flags, bool initial_unit)
     cache->num_replaced = 0;
     cache->wset_check = 0;
     cache->record_wset = false;
+    cache->clock_table = NULL;
     if (cache->is_shared) { /* else won't use free list */
         memset(cache->free_list, 0, sizeof(cache->free_list));
         DODEBUG({
@@ -1589,6 +1672,8 @@ fcache_cache_free(dcontext_t *dcontext, fcache_t *cache, bool free_units)
     ASSERT(size_check == cache_size);
     ASSERT(cache->size == 0);
 
+    if (cache->clock_table != NULL)
+        generic_hash_destroy(alloc_dc, cache->clock_table);
     if (cache->is_shared)
         DELETE_LOCK(cache->lock);
 
@@ -1873,6 +1958,8 @@ fcache_increase_size(dcontext_t *dcontext, fcache_t *cache, fcache_unit_t *unit,
                                !dr_trace_hook_exists()));
     /* we shouldn't come here if we have reservation room */
     ASSERT(unit->reserved_end_pc == unit->end_pc);
+    /* huge page units are shared and those are never resized */
+    ASSERT(!unit->huge_pages);
     if (new_size*4 <= cache->max_quadrupled_unit_size)
         new_size *= 4;
     else
@@ -1906,7 +1993,7 @@ fcache_increase_size(dcontext_t *dcontext, fcache_t *cache, fcache_unit_t *unit,
         u = allunits->dead;
         prev_u = NULL;
         while (u != NULL) {
-            if (UNIT_RESERVED_SIZE(u) >= new_size) {
+            if (UNIT_RESERVED_SIZE(u) >= new_size && !u->huge_pages) {
                 fcache_thread_units_t *tu = (fcache_thread_units_t *)
                     dcontext->fcache_field;
                 /* remove from dead list */
@@ -1977,7 +2064,7 @@ fcache_increase_size(dcontext_t *dcontext, fcache_t *cache, fcache_unit_t *unit,
         ASSERT(commit_size >= slot_size);
         commit_size += unit->size;
         ASSERT(commit_size <= new_size);
-        new_memory = (cache_pc) heap_mmap_reserve(new_size, commit_size);
+        new_memory = fcache_unit_mmap(new_size, commit_size, false);
         STATS_FCACHE_SUB(cache, capacity, unit->size);
         STATS_FCACHE_ADD(cache, capacity, commit_size);
         STATS_FCACHE_MAX(cache, capacity_peak, capacity);
@@ -2059,6 +2146,66 @@ fcache_increase_size(dcontext_t *dcontext, fcache_t *cache, fcache_unit_t *unit,
     LOG(THREAD, LOG_CACHE, 1, "\tDone increasing unit size\n");
 }
 
+#ifdef UNIX
+/* Marks cache's units as inherited if mark is true.  Returns the number of live
+ * fragments in them if count is true, or 0: that walks every fragment, so it is
+ * only done when we keep the statistic.
+ */
+static uint
+fcache_mark_inherited(fcache_t *cache, bool mark, bool count)
+{
+    fcache_unit_t *u;
+    cache_pc pc;
+    fragment_t *f;
+    uint live = 0;
+    if (cache == NULL || (!mark && !count))
+        return 0;
+    PROTECT_CACHE(cache, lock);
+    for (u = cache->units; u != NULL; u = u->next_local) {
+        if (mark) {
+            u->inherited = true;
+            RSTATS_INC(fcache_units_inherited);
+        }
+        if (!count)
+            continue;
+        pc = u->start_pc;
+        while (pc < u->cur_pc) {
+            f = *((fragment_t **)pc);
+            if (!USE_FIFO_FOR_CACHE(cache) && FRAG_IS_FREE_LIST(f)) {
+                pc += ((free_list_header_t *) pc)->size;
+                continue;
+            }
+            ASSERT(f != NULL);
+            ASSERT(FRAG_HDR_START(f) == pc);
+            if (!FRAG_EMPTY(f))
+                live++;
+            /* advance to contiguously-next fragment_t in cache */
+            pc += FRAG_SIZE(f);
+        }
+    }
+    if (mark)
+        cache->has_inherited = true;
+    PROTECT_CACHE(cache, unlock);
+    return live;
+}
+
+/* Called in the child of a fork.  If count is true, returns the number of live
+ * shared fragments the child inherited from the parent; else returns 0.
+ * -zygote: the child keeps using those fragments, but we place its new fragments
+ * in new units, created lazily, so that the inherited cache pages stay shared
+ * copy-on-write with the parent and its other children.  That is not airtight:
+ * linking a new fragment to an exit of an inherited one patches the exit in the
+ * inherited page, and deleting an inherited fragment writes a free list header
+ * or empty slot there.  Either copies just that page.
+ */
+uint
+fcache_fork_init(dcontext_t *dcontext, bool count)
+{
+    return fcache_mark_inherited(shared_cache_bb, DYNAMO_OPTION(zygote), count) +
+        fcache_mark_inherited(shared_cache_trace, DYNAMO_OPTION(zygote), count);
+}
+#endif
+
 static void
 fcache_thread_reset_init(dcontext_t *dcontext)
 {
@@ -2080,6 +2227,9 @@ fcache_thread_init(dcontext_t *dcontext)
      * once we have that conditional for traces it's no extra cost for bbs
      */
     tu->bb = NULL;
+    tu->hot_bb = NULL;
+    tu->hot_trace = NULL;
+    tu->place_hot = false;
     tu->pending_unmap_pc = NULL;
     tu->pending_flush = false;
 
@@ -2134,6 +2284,10 @@ fcache_thread_exit_stats(dcontext_t *dcontext)
             fcache_cache_stats(dcontext, tu->bb);
         if (tu->trace != NULL)
             fcache_cache_stats(dcontext, tu->trace);
+        if (tu->hot_bb != NULL)
+            fcache_cache_stats(dcontext, tu->hot_bb);
+        if (tu->hot_trace != NULL)
+            fcache_cache_stats(dcontext, tu->hot_trace);
     });
 }
 #endif
@@ -2149,7 +2303,7 @@ fcache_thread_reset_free(dcontext_t *dcontext)
          */
         vmvector_remove(fcache_unit_areas, tu->pending_unmap_pc,
                         tu->pending_unmap_pc+tu->pending_unmap_size);
-        heap_munmap(tu->pending_unmap_pc, tu->pending_unmap_size);
+        fcache_unit_munmap(tu->pending_unmap_pc, tu->pending_unmap_size, false);
         tu->pending_unmap_pc = NULL;
     }
     if (tu->bb != NULL) {
@@ -2160,6 +2314,14 @@ fcache_thread_reset_free(dcontext_t *dcontext)
         fcache_cache_free(dcontext, tu->trace, true);
         tu->trace = NULL;
     }
+    if (tu->hot_bb != NULL) {
+        fcache_cache_free(dcontext, tu->hot_bb, true);
+        tu->hot_bb = NULL;
+    }
+    if (tu->hot_trace != NULL) {
+        fcache_cache_free(dcontext, tu->hot_trace, true);
+        tu->hot_trace = NULL;
+    }
 }
 
 void
@@ -2471,6 +2633,7 @@ try_for_more_space(dcontext_t *dcontext, fcache_t *cache, fcache_unit_t *unit,
     ASSERT(CACHE_PROTECTED(cache));
 
     if (unit->end_pc < unit->reserved_end_pc &&
+        IF_UNIX(!unit->inherited &&)
         !POINTER_OVERFLOW_ON_ADD(unit->cur_pc, slot_size) &&
         /* simpler to just not support taking very last page in address space */
         !POINTER_OVERFLOW_ON_ADD(unit->end_pc, commit_size)) {
@@ -2500,8 +2663,10 @@ try_for_more_space(dcontext_t *dcontext, fcache_t *cache, fcache_unit_t *unit,
          * re-linking when resize.
          * i#696: Don't try to resize fcache units when clients are present.
          * They may use labels to insert absolute fragment PCs.
+         * -shadow_ret_stack also embeds absolute landing addresses.
          */
-        if (unit->size >= cache->max_unit_size
+        if (unit->size >= cache->max_unit_size || DYNAMO_OPTION(shadow_ret_stack)
+            IF_UNIX(|| unit->inherited)
             IF_CLIENT_INTERFACE(|| dr_bb_hook_exists()
                                 || dr_trace_hook_exists())) {
             fcache_unit_t *newunit;
@@ -2512,8 +2677,16 @@ try_for_more_space(dcontext_t *dcontext, fcache_t *cache, fcache_unit_t *unit,
                     * fragment is >4KB!  We'll have set wset_check though.
                     */
                    cache->wset_check > 0); /* shouldn't be empty! */
-            /* fill out to end first -- turn remaining room into empty slot */
-            extend_unit_end(dcontext, cache, unit, 0, true);
+#ifdef UNIX
+            if (unit->inherited) {
+                /* -zygote: leave the inherited pages untouched so they stay
+                 * shared with the parent: no empty slot header at the end.
+                 */
+                unit->full = true;
+            } else
+#endif
+                /* fill out to end first -- turn remaining room into empty slot */
+                extend_unit_end(dcontext, cache, unit, 0, true);
             ASSERT(unit->full);
 
             /* before create a new unit, see if we should flush an old one */
@@ -2725,6 +2898,93 @@ removed_fragment_stats(dcontext_t *dcontext, fcache_t *cache, fragment_t *f)
 }
 #endif /* DEBUG */
 
+/* -cache_clock_replace: second-chance replacement for private FIFO caches.
+ * There is no spare flag bit for a reference bit, so we sample references
+ * instead.  When the FIFO hand reaches a fragment that is not in
+ * cache->clock_table we give it a second chance: we move it to the tail of the
+ * FIFO, add it to the table, and unlink its incoming links and remove it from
+ * the ibt tables so that its next execution comes back through dispatch.
+ * There, fcache_fragment_entered() removes it from the table (i.e., sets its
+ * reference bit) and relinks it.  A fragment the hand finds still in the table
+ * has not been executed since its second chance and is replaced.
+ */
+#define CLOCK_TABLE_BITS 8
+#define CLOCK_TABLE_LOAD 75
+
+static inline bool
+clock_replace_applies(fcache_t *cache)
+{
+    return DYNAMO_OPTION(cache_clock_replace) && USE_FIFO_FOR_CACHE(cache) &&
+        cache->finite_cache;
+}
+
+static void
+clock_forget_fragment(dcontext_t *dcontext, fcache_t *cache, fragment_t *f)
+{
+    if (cache->clock_table != NULL &&
+        generic_hash_lookup(dcontext, cache->clock_table, (ptr_uint_t) f->tag) == f)
+        generic_hash_remove(dcontext, cache->clock_table, (ptr_uint_t) f->tag);
+}
+
+/* Returns true if victim was given a second chance, in which case it is now
+ * at the tail of the FIFO; returns false if victim should be replaced.
+ */
+static bool
+clock_second_chance(dcontext_t *dcontext, fcache_t *cache, fragment_t *victim)
+{
+    fragment_t *prev;
+    ASSERT(CACHE_PROTECTED(cache));
+    ASSERT(clock_replace_applies(cache));
+    if (FRAG_EMPTY(victim) || TEST(FRAG_CANNOT_DELETE, victim->flags))
+        return false;
+    if (cache->clock_table == NULL) {
+        cache->clock_table =
+            generic_hash_create(dcontext, CLOCK_TABLE_BITS, CLOCK_TABLE_LOAD, 0,
+                                NULL _IF_DEBUG("clock second chances"));
+    }
+    prev = (fragment_t *)
+        generic_hash_lookup(dcontext, cache->clock_table, (ptr_uint_t) victim->tag);
+    if (prev == victim)
+        return false;
+    if (prev != NULL) {
+        /* a different fragment for this tag was deleted w/o telling us */
+        generic_hash_remove(dcontext, cache->clock_table, (ptr_uint_t) victim->tag);
+    }
+    generic_hash_add(dcontext, cache->clock_table, (ptr_uint_t) victim->tag, victim);
+    LOG(THREAD, LOG_CACHE, 4, "	giving F%d a second chance\n", victim->id);
+    /* trace heads are already unlinked and come back to dispatch every time */
+    if (TEST(FRAG_LINKED_INCOMING, victim->flags) &&
+        !TEST(FRAG_IS_TRACE_HEAD, victim->flags))
+        unlink_fragment_incoming(dcontext, victim);
+    if (IS_IBL_TARGET(victim->flags))
+        fragment_remove_from_ibt_tables(dcontext, victim, false/*leave in shared*/);
+    fifo_remove(dcontext, cache, victim);
+    fifo_append(cache, victim);
+    STATS_INC(num_fragments_second_chance);
+    return true;
+}
+
+/* Called from dispatch on each entry into a fragment, when -cache_clock_replace
+ * is on.  Marks f as referenced and relinks it if its second chance unlinked it.
+ */
+void
+fcache_fragment_entered(dcontext_t *dcontext, fragment_t *f)
+{
+    fcache_t *cache;
+    ASSERT(DYNAMO_OPTION(cache_clock_replace));
+    if (!USE_FIFO(f) || TEST(FRAG_FAKE, f->flags))
+        return;
+    cache = FIFO_UNIT(f)->cache;
+    if (cache->clock_table == NULL ||
+        generic_hash_lookup(dcontext, cache->clock_table, (ptr_uint_t) f->tag) != f)
+        return;
+    generic_hash_remove(dcontext, cache->clock_table, (ptr_uint_t) f->tag);
+    LOG(THREAD, LOG_CACHE, 4, "fcache_fragment_entered: F%d referenced\n", f->id);
+    /* the ibt tables are refilled on the next ibl miss */
+    if (!TESTANY(FRAG_LINKED_INCOMING|FRAG_IS_TRACE_HEAD, f->flags))
+        link_fragment_incoming(dcontext, f, false/*not new*/);
+}
+
 static void
 force_fragment_from_cache(dcontext_t *dcontext, fcache_t *cache, fragment_t *victim)
 {
@@ -2738,6 +2998,8 @@ force_fragment_from_cache(dcontext_t *dcontext, fcache_t *cache, fragment_t *vic
          */
         if (cache->finite_cache)
             cache->num_replaced++;
+        if (USE_FIFO(victim))
+            clock_forget_fragment(dcontext, cache, victim);
         DOSTATS({ removed_fragment_stats(dcontext, cache, victim); });
         STATS_INC(num_fragments_replaced);
         fragment_delete(dcontext, victim, FRAGDEL_NO_FCACHE);
@@ -2860,19 +3122,43 @@ replace_fifo(dcontext_t *dcontext, fcache_t *cache, fragment_t *f, uint slot_siz
              fragment_t *fifo)
 {
     fcache_unit_t *unit;
+    fragment_t *next;
+    uint second_chances = 0;
+    bool clock = clock_replace_applies(cache);
     ASSERT(USE_FIFO(f));
     ASSERT(CACHE_PROTECTED(cache));
     while (fifo != NULL) {
         unit = FIFO_UNIT(fifo);
+        next = FIFO_NEXT(fifo);
         if ((ptr_uint_t)(unit->end_pc - FRAG_HDR_START(fifo)) >= slot_size) {
+            /* With -cache_clock_replace, skip fragments executed since the hand
+             * last passed them.  This terminates since each fragment is given
+             * at most one second chance here and is then at the FIFO tail.
+             */
+            if (clock && clock_second_chance(dcontext, cache, fifo)) {
+                second_chances++;
+                /* if fifo was the only entry left, revisit it */
+                fifo = (next == NULL) ? fifo : next;
+                continue;
+            }
             /* try to replace fifo and possibly subsequent frags with f
              * could fail if un-deletable frags
              */
             DOLOG(4, LOG_CACHE, { verify_fifo(dcontext, cache); });
-            if (replace_fragments(dcontext, cache, unit, f, fifo, slot_size))
+            if (replace_fragments(dcontext, cache, unit, f, fifo, slot_size)) {
+                if (clock && cache->replace_param > 0 &&
+                    second_chances >= cache->replace_param) {
+                    /* Most of the cache is live: the working set is likely
+                     * larger than the cache, so check the regen/replace ratio
+                     * at the next fill rather than replace_param frags from now.
+                     */
+                    cache->wset_check = 0;
+                    STATS_INC(num_clock_wset_checks);
+                }
                 return true;
+            }
         }
-        fifo = FIFO_NEXT(fifo);
+        fifo = next;
     }
     return false;
 }
@@ -3127,7 +3413,11 @@ find_free_list_slot(dcontext_t *dcontext, fcache_t *cache, fragment_t *f, uint s
          * finish immediately */
         header = cache->free_list[bucket];
 
-        while (header != NULL && header->size < size) {
+        while (header != NULL &&
+               (header->size < size
+                /* -zygote: leave holes in pages shared with the parent alone */
+                IF_UNIX(|| (cache->has_inherited &&
+                            fcache_lookup_unit((cache_pc)header)->inherited)))) {
             /* FIXME: if we keep the list sorted, we'd not waste too
              * much space by picking the first large enough slot */
             /* FIXME: if we want to coalesce here we can act on any
@@ -3256,7 +3546,8 @@ add_fragment_common(dcontext_t *dcontext, fcache_t *cache, fragment_t *f, uint s
 
     /* second, look for room at end, if cache never filled up before */
     unit = cache->units; /* most recent is only potentially non-full unit */
-    if (!unit->full && (ptr_uint_t)(unit->end_pc - unit->cur_pc) >= slot_size) {
+    if (!unit->full && IF_UNIX(!unit->inherited &&)
+        (ptr_uint_t)(unit->end_pc - unit->cur_pc) >= slot_size) {
         /* just add to end */
         size_t extra;
         place_fragment(dcontext, f, unit, unit->cur_pc);
@@ -3514,6 +3805,63 @@ fcache_return_extra_space(dcontext_t *dcontext, fragment_t *f, size_t space_in)
                        released ? returnable_space : 0);
 }
 
+/* Returns this thread's hot bb or trace cache for -cache_hot_layout, creating
+ * it if necessary.  A hot cache is a single unit of -cache_hot_max bytes with
+ * FIFO replacement, so the fragments it holds stay contiguous: once it is full,
+ * the oldest hot fragments are deleted to make room and are later rebuilt in
+ * the regular caches.
+ */
+static fcache_t *
+fcache_hot_cache(dcontext_t *dcontext, bool is_trace)
+{
+    fcache_thread_units_t *tu = (fcache_thread_units_t *) dcontext->fcache_field;
+    fcache_t **hot = is_trace ? &tu->hot_trace : &tu->hot_bb;
+    if (*hot == NULL) {
+        fcache_t *cache = fcache_cache_init(dcontext, is_trace ? FRAG_IS_TRACE : 0,
+                                            false/*no unit yet*/);
+        DODEBUG({
+            cache->name = is_trace ? "Hot trace (private)" : "Hot basic block (private)";
+        });
+        cache->max_size = DYNAMO_OPTION(cache_hot_max);
+        cache->max_unit_size = cache->max_size;
+        cache->max_quadrupled_unit_size = cache->max_size;
+        cache->free_upgrade_size = cache->max_size;
+        cache->init_unit_size = cache->max_size;
+        cache->finite_cache = true;
+        cache->regen_param = 0;
+        cache->replace_param = 0;
+        cache->units = fcache_create_unit(dcontext, cache, NULL, cache->init_unit_size);
+        LOG(THREAD, LOG_CACHE, 1, "Initial %s cache is %d KB\n",
+            is_trace ? "hot trace" : "hot bb", cache->init_unit_size/1024);
+        *hot = cache;
+    }
+    return *hot;
+}
+
+/* Sets whether fragments subsequently emitted by this thread are placed in its
+ * hot caches.  Only thread-private fragments are affected.
+ */
+void
+fcache_set_hot_placement(dcontext_t *dcontext, bool hot)
+{
+    fcache_thread_units_t *tu = (fcache_thread_units_t *) dcontext->fcache_field;
+    ASSERT(DYNAMO_OPTION(cache_hot_layout));
+    tu->place_hot = hot;
+}
+
+/* Returns whether f lives in one of this thread's hot caches */
+bool
+fcache_fragment_is_hot(dcontext_t *dcontext, fragment_t *f)
+{
+    fcache_thread_units_t *tu = (fcache_thread_units_t *) dcontext->fcache_field;
+    fcache_unit_t *unit;
+    if (TEST(FRAG_SHARED, f->flags) || (tu->hot_bb == NULL && tu->hot_trace == NULL))
+        return false;
+    unit = FIFO_UNIT(f);
+    return (unit != NULL && unit->cache != NULL &&
+            (unit->cache == tu->hot_bb || unit->cache == tu->hot_trace));
+}
+
 static fcache_t *
 get_cache_for_new_fragment(dcontext_t *dcontext, fragment_t *f)
 {
@@ -3555,6 +3903,8 @@ get_cache_for_new_fragment(dcontext_t *dcontext, fragment_t *f)
                 return shared_cache_bb;
         }
     } else {
+        if (tu->place_hot)
+            return fcache_hot_cache(dcontext, IN_TRACE_CACHE(f->flags));
         /* thread-private caches are delayed */
         if (IN_TRACE_CACHE(f->flags)) {
             if (tu->trace == NULL) {
@@ -3598,7 +3948,7 @@ fcache_add_fragment(dcontext_t *dcontext, fragment_t *f)
         vmvector_remove(fcache_unit_areas, tu->pending_unmap_pc,
                         tu->pending_unmap_pc+tu->pending_unmap_size);
         /* caller must dec stats since here we don't know type of cache */
-        heap_munmap(tu->pending_unmap_pc, tu->pending_unmap_size);
+        fcache_unit_munmap(tu->pending_unmap_pc, tu->pending_unmap_size, false);
         tu->pending_unmap_pc = NULL;
     }
 
@@ -3622,6 +3972,8 @@ fcache_add_fragment(dcontext_t *dcontext, fragment_t *f)
     add_fragment_common(dcontext, cache, f, slot_size);
     ASSERT(!PAD_JMPS_SHIFT_START(f->flags) ||
            ALIGNED(f->start_pc, START_PC_ALIGNMENT)); /* for start_pc padding to work */
+    /* -zygote: new code never goes in a unit inherited across fork */
+    IF_UNIX(ASSERT(!cache->has_inherited || !FIFO_UNIT(f)->inherited));
     DOLOG(3, LOG_CACHE, {
         if (USE_FIFO_FOR_CACHE(cache))
             verify_fifo(dcontext, cache);
@@ -3645,6 +3997,8 @@ fcache_remove_fragment(dcontext_t *dcontext, fragment_t *f)
 
     DOSTATS({ removed_fragment_stats(dcontext, cache, f); });
     STATS_FCACHE_SUB(cache, used, FRAG_SIZE(f));
+    if (USE_FIFO(f))
+        clock_forget_fragment(dcontext, cache, f);
 
 #ifdef DEBUG_MEMORY
     /* Catch stale execution by filling w/ int3.
@@ -4442,6 +4796,10 @@ fcache_low_on_memory()
         fcache_reset_cache(dcontext, tu->bb);
     if (tu->trace != NULL)
         fcache_reset_cache(dcontext, tu->trace);
+    if (tu->hot_bb != NULL)
+        fcache_reset_cache(dcontext, tu->hot_bb);
+    if (tu->hot_trace != NULL)
+        fcache_reset_cache(dcontext, tu->hot_trace);
 #endif
 
     /* now free the entire dead list (including thread units just moved here) */
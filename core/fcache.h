@@ -102,8 +102,14 @@ void fcache_thread_init(dcontext_t *dcontext);
 void fcache_thread_exit_stats(dcontext_t *dcontext);
 #endif
 void fcache_thread_exit(dcontext_t *dcontext);
+#ifdef UNIX
+uint fcache_fork_init(dcontext_t *dcontext, bool count);
+#endif
 
 void fcache_add_fragment(dcontext_t *dcontext, fragment_t *f);
+void fcache_set_hot_placement(dcontext_t *dcontext, bool hot);
+bool fcache_fragment_is_hot(dcontext_t *dcontext, fragment_t *f);
+void fcache_fragment_entered(dcontext_t *dcontext, fragment_t *f);
 void fcache_shift_start_pc(dcontext_t *dcontext, fragment_t *f, uint space);
 void fcache_return_extra_space(dcontext_t *dcontext, fragment_t *f, size_t space);
 void fcache_remove_fragment(dcontext_t *dcontext, fragment_t *f);
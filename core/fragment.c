@@ -54,6 +54,9 @@
 #ifdef UNIX
 # include "nudge.h"
 #endif
+#if defined(X86) && defined(X64)
+# include <emmintrin.h> /* SSE2, for -ibl_buckets */
+#endif
 
 /* FIXME: make these runtime parameters */
 #define INIT_HTABLE_SIZE_SHARED_BB    (DYNAMO_OPTION(coarse_units) ? 5 : 10)
@@ -143,6 +146,15 @@ static dead_table_lists_t *dead_lists;
 
 DECLARE_CXTSWPROT_VAR(static mutex_t dead_tables_lock, INIT_LOCK_FREE(dead_tables_lock));
 
+/* Compact translation tables for shared fragments, keyed by fragment_t: recorded
+ * for every fragment at emit time with -compact_translations or -fast_signals.
+ * Entries are removed when their fragment is freed, and all of them at reset.
+ */
+static generic_table_t *xl8_cache_table;
+
+static void
+xl8_cache_free_entry(dcontext_t *dcontext, void *entry);
+
 #ifdef RETURN_AFTER_CALL
 /* High level lock for an atomic lookup+add operation on the
  * after call tables. */
@@ -575,6 +587,55 @@ update_lookuptable_tls(dcontext_t *dcontext, ibl_table_t *table)
         table->hash_mask;
 }
 
+/* Invalidates every -shadow_ret_stack entry of dcontext's thread.  The
+ * landing addresses point into fragments, so this must be called before any
+ * shared fragment the thread could have pushed is freed, which is when the
+ * thread acknowledges a shared flush via set_flushtime_last_update().  Private
+ * fragments use shadow_ret_stack_remove_fragment().  The thread must not be
+ * executing in the cache.  Any address no call can return to works as the
+ * empty retaddr; we use POINTER_MAX.
+ */
+static void
+shadow_ret_stack_clear(dcontext_t *dcontext)
+{
+    local_state_extended_t *state =
+        (local_state_extended_t *) dcontext->local_state;
+    uint i;
+    if (state == NULL || state->ret_stack.entries == NULL)
+        return;
+    for (i = 0; i < SHADOW_RET_STACK_ENTRIES; i++) {
+        state->ret_stack.entries[i].retaddr = (app_pc) POINTER_MAX;
+        state->ret_stack.entries[i].landing = NULL;
+    }
+    state->ret_stack.index = 0;
+    STATS_INC(num_shadow_ret_stack_clears);
+}
+
+/* Invalidates the -shadow_ret_stack entries of dcontext's thread whose
+ * landings are in the private fragment f, which is about to be freed.
+ * Traces never contain landings (see shadow_ret_stack_applies()), so they
+ * are skipped without a scan.
+ */
+static void
+shadow_ret_stack_remove_fragment(dcontext_t *dcontext, fragment_t *f)
+{
+    local_state_extended_t *state =
+        (local_state_extended_t *) dcontext->local_state;
+    uint i;
+    ASSERT(!TEST(FRAG_SHARED, f->flags));
+    if (state == NULL || state->ret_stack.entries == NULL ||
+        TEST(FRAG_IS_TRACE, f->flags))
+        return;
+    for (i = 0; i < SHADOW_RET_STACK_ENTRIES; i++) {
+        cache_pc landing = state->ret_stack.entries[i].landing;
+        if (landing >= f->start_pc && landing < f->start_pc + f->size) {
+            state->ret_stack.entries[i].retaddr = (app_pc) POINTER_MAX;
+            state->ret_stack.entries[i].landing = NULL;
+            STATS_INC(num_shadow_ret_stack_removes);
+        }
+    }
+}
+
 #ifdef DEBUG
 static const char *ibl_bb_table_type_names[IBL_BRANCH_TYPE_END] =
     {"ret_bb", "indcall_bb", "indjmp_bb"};
@@ -616,6 +677,47 @@ dump_lookuptable_tls(dcontext_t *dcontext)
 #define FRAGENTRY_FROM_FRAGMENT(f) \
     { (f)->tag, PC_AS_JMP_TGT(FRAG_ISA_MODE(f->flags), (f)->start_pc) }
 
+#if defined(X86) && defined(X64)
+/* -ibl_buckets: the C lookups compare the tags of a cache line of entries at a
+ * time using SSE2, which every x64 processor has.  The in-cache lookup routines
+ * still compare one entry at a time: they own only two registers and the flags,
+ * and preserving the app's xmm state there would cost more than it saves.
+ */
+# define IBL_BUCKET_ENTRIES 4
+
+/* Returns a bit per entry of the pair, set if the entry's tag is tag or null. */
+static inline uint
+ibl_bucket_pair_stops(fragment_entry_t *pair, __m128i tag)
+{
+    __m128i tags = _mm_unpacklo_epi64(_mm_loadu_si128((__m128i *)&pair[0]),
+                                      _mm_loadu_si128((__m128i *)&pair[1]));
+    __m128i match = _mm_cmpeq_epi32(tags, tag);
+    __m128i null = _mm_cmpeq_epi32(tags, _mm_setzero_si128());
+    /* SSE2 has no 64-bit compare: a tag matches if both of its dwords do */
+    match = _mm_and_si128(match, _mm_shuffle_epi32(match, _MM_SHUFFLE(2, 3, 0, 1)));
+    null = _mm_and_si128(null, _mm_shuffle_epi32(null, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (uint)_mm_movemask_pd(_mm_castsi128_pd(_mm_or_si128(match, null)));
+}
+
+/* ENTRY_BUCKET_PROBE for ibl tables: see hashtablex.h */
+static inline uint
+ibl_bucket_probe(ibl_table_t *table, fragment_entry_t *bucket, ptr_uint_t tag)
+{
+    static const byte first_stop[16] = { 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0 };
+    __m128i key;
+    if (!DYNAMO_OPTION(ibl_buckets))
+        return IBL_BUCKET_ENTRIES + 1;
+    ASSERT(sizeof(fragment_entry_t) == sizeof(__m128i) &&
+           offsetof(fragment_entry_t, tag_fragment) == 0);
+    key = _mm_set1_epi64x((int64)tag);
+    /* Only empty entries and the sentinel have a null tag, and the lookup never
+     * hands us a bucket holding the sentinel.
+     */
+    return first_stop[ibl_bucket_pair_stops(&bucket[0], key) |
+                      (ibl_bucket_pair_stops(&bucket[2], key) << 2)];
+}
+#endif
+
 /* macros w/ name and types are duplicated in fragment.h -- keep in sync */
 #define NAME_KEY ibl
 #define ENTRY_TYPE fragment_entry_t
@@ -638,6 +740,10 @@ static const fragment_entry_t fe_sentinel = { NULL_TAG, HASHLOOKUP_SENTINEL_STAR
 #define ENTRY_IS_INVALID(fe)  IBL_ENTRY_IS_INVALID(fe)
 #define IBL_ENTRIES_ARE_EQUAL(fe1,fe2)  ((fe1).tag_fragment == (fe2).tag_fragment)
 #define ENTRIES_ARE_EQUAL(table,fe1,fe2)  IBL_ENTRIES_ARE_EQUAL(fe1,fe2)
+#if defined(X86) && defined(X64)
+# define ENTRY_BUCKET_SIZE IBL_BUCKET_ENTRIES
+# define ENTRY_BUCKET_PROBE(table, entries, tag) ibl_bucket_probe(table, entries, tag)
+#endif
 #define HASHTABLE_WHICH_HEAP(flags) FRAGTABLE_WHICH_HEAP(flags)
 #define HTLOCK_RANK               table_rwlock
 #define HASHTABLE_ENTRY_STATS 1
@@ -1435,6 +1541,17 @@ fragment_init()
         memset(dead_lists, 0, sizeof(*dead_lists));
     }
 
+    if (RECORD_COMPACT_TRANSLATIONS() && SHARED_FRAGMENTS_ENABLED()) {
+        xl8_cache_table =
+            generic_hash_create(GLOBAL_DCONTEXT, INIT_HTABLE_SIZE_SHARED_BB,
+                                80 /* load factor: not perf-critical */,
+                                HASHTABLE_ENTRY_SHARED | HASHTABLE_SHARED |
+                                HASHTABLE_PERSISTENT | HASHTABLE_RELAX_CLUSTER_CHECKS,
+                                xl8_cache_free_entry _IF_DEBUG("xl8 cache table"));
+        /* We need a rank above table_rwlock as fragments can be freed holding it. */
+        ASSIGN_INIT_READWRITE_LOCK_FREE(xl8_cache_table->rwlock, xl8_cache_lock);
+    }
+
     fragment_reset_init();
 
 #if defined(INTERNAL) || defined(CLIENT_INTERFACE)
@@ -1573,6 +1690,13 @@ fragment_reset_free(void)
         reset_shared_block_table(shared_traces, &shared_traces_lock);
     }
 #endif
+
+    /* all fragments are gone, whether or not we freed them individually above */
+    if (xl8_cache_table != NULL) {
+        TABLE_RWLOCK(xl8_cache_table, write, lock);
+        generic_hash_clear(GLOBAL_DCONTEXT, xl8_cache_table);
+        TABLE_RWLOCK(xl8_cache_table, write, unlock);
+    }
 }
 
 /* free all state */
@@ -1616,6 +1740,11 @@ fragment_exit()
 
     fragment_reset_free();
 
+    if (xl8_cache_table != NULL) {
+        generic_hash_destroy(GLOBAL_DCONTEXT, xl8_cache_table);
+        xl8_cache_table = NULL;
+    }
+
 #ifdef RETURN_AFTER_CALL
     if (dynamo_options.ret_after_call && rac_non_module_table.live_table != NULL) {
         DODEBUG({
@@ -2003,6 +2132,16 @@ fragment_thread_reset_init(dcontext_t *dcontext)
     }
     ASSERT(IBL_BRANCH_TYPE_END == 3);
 
+    if (DYNAMO_OPTION(shadow_ret_stack)) {
+        local_state_extended_t *state =
+            (local_state_extended_t *) dcontext->local_state;
+        /* Written by the inlined call sequences in the cache, so unprotected. */
+        state->ret_stack.entries =
+            HEAP_ARRAY_ALLOC(dcontext, shadow_ret_entry_t, SHADOW_RET_STACK_ENTRIES,
+                             ACCT_IBLTABLE, UNPROTECTED);
+        shadow_ret_stack_clear(dcontext);
+    }
+
     update_generated_hashtable_access(dcontext);
 }
 
@@ -2049,6 +2188,8 @@ fragment_thread_init(dcontext_t *dcontext)
     pt->finished_all_unlink = create_event();
     pt->soon_to_be_linking = false;
     pt->at_syscall_at_flush = false;
+    pt->epoch_flush_start = NULL;
+    pt->epoch_flush_end = NULL;
 }
 
 static bool
@@ -2164,6 +2305,14 @@ fragment_thread_reset_free(dcontext_t *dcontext)
     hashtable_fragment_free(dcontext, &pt->bb);
     hashtable_fragment_free(dcontext, &pt->future);
 
+    if (DYNAMO_OPTION(shadow_ret_stack)) {
+        local_state_extended_t *state =
+            (local_state_extended_t *) dcontext->local_state;
+        HEAP_ARRAY_FREE(dcontext, state->ret_stack.entries, shadow_ret_entry_t,
+                        SHADOW_RET_STACK_ENTRIES, ACCT_IBLTABLE, UNPROTECTED);
+        state->ret_stack.entries = NULL;
+    }
+
     SELF_PROTECT_CACHE(dcontext, NULL, READONLY);
 
 #else
@@ -2326,6 +2475,7 @@ fragment_init_heap(fragment_t *f, app_pc tag, int direct_exits, int indirect_exi
          * but we need a non-zero value for linkstub_fragment()
          */
         t->num_bbs = 1;
+        t->inline_cached = false;
 #ifdef PROFILE_RDTSC
         t->count = 0UL;
         t->total_time = (uint64) 0;
@@ -2587,6 +2737,11 @@ fragment_free(dcontext_t *dcontext, fragment_t *f)
         translation_info_free(dcontext, FRAGMENT_TRANSLATION_INFO(f));
     } else
         ASSERT(FRAGMENT_TRANSLATION_INFO(f) == NULL);
+    if (xl8_cache_table != NULL && TEST(FRAG_SHARED, f->flags)) {
+        TABLE_RWLOCK(xl8_cache_table, write, lock);
+        generic_hash_remove(GLOBAL_DCONTEXT, xl8_cache_table, (ptr_uint_t) f);
+        TABLE_RWLOCK(xl8_cache_table, write, unlock);
+    }
 
     /* N.B.: monitor_remove_fragment() was called in fragment_delete,
      * which is assumed to have been called prior to fragment_free
@@ -3031,6 +3186,14 @@ fragment_delete(dcontext_t *dcontext, fragment_t *f, uint actions)
     ASSERT(!TEST(FRAG_SHARED, f->flags) || TEST(FRAG_WAS_DELETED, f->flags) ||
            dynamo_exited || dynamo_resetting || is_self_allsynch_flushing());
 
+    /* Private fragments are freed right away, so drop any shadow return stack
+     * entry that points into this one.  Shared fragments are covered at
+     * flush acknowledgement time.
+     */
+    if (DYNAMO_OPTION(shadow_ret_stack) && !TEST(FRAG_SHARED, f->flags) &&
+        dcontext != GLOBAL_DCONTEXT)
+        shadow_ret_stack_remove_fragment(dcontext, f);
+
 #if defined(CLIENT_INTERFACE) && defined(CLIENT_SIDELINE)
     /* need to protect ability to reference frag fields and fcache space */
     /* all other options are mostly notification */
@@ -3169,6 +3332,113 @@ fragment_record_translation_info(dcontext_t *dcontext, fragment_t *f, instrlist_
         ASSERT_NOT_REACHED();
 }
 
+static void
+xl8_cache_free_entry(dcontext_t *dcontext, void *entry)
+{
+    compact_translation_info_free(dcontext, (compact_translation_info_t *) entry);
+}
+
+/* Returns the compact translation table cached for f by
+ * fragment_cache_translation_info(), or NULL if there is none.
+ * On a non-NULL return the table's read lock is held, which keeps the entry
+ * from being freed, until fragment_release_cached_translation_info() is called.
+ * If !wait (i.e., in a signal handler), returns NULL rather than waiting if the
+ * table is being updated.
+ */
+compact_translation_info_t *
+fragment_acquire_cached_translation_info(fragment_t *f, bool wait)
+{
+    compact_translation_info_t *info;
+    if (xl8_cache_table == NULL || !TEST(FRAG_SHARED, f->flags))
+        return NULL;
+    if (wait)
+        read_lock(&xl8_cache_table->rwlock);
+    else if (!read_trylock(&xl8_cache_table->rwlock))
+        return NULL;
+    info = (compact_translation_info_t *)
+        generic_hash_lookup(GLOBAL_DCONTEXT, xl8_cache_table, (ptr_uint_t) f);
+    if (info == NULL)
+        read_unlock(&xl8_cache_table->rwlock);
+    return info;
+}
+
+void
+fragment_release_cached_translation_info(void)
+{
+    ASSERT(xl8_cache_table != NULL);
+    read_unlock(&xl8_cache_table->rwlock);
+}
+
+/* Like fragment_acquire_cached_translation_info() but for signal handlers
+ * deciding whether to deliver a signal now: returns false rather than waiting
+ * if the table is being updated, and only reports whether f has a table.
+ */
+bool
+fragment_has_cached_translation_info_nowait(fragment_t *f)
+{
+    bool found;
+    if (xl8_cache_table == NULL || !TEST(FRAG_SHARED, f->flags))
+        return false;
+    if (!read_trylock(&xl8_cache_table->rwlock))
+        return false;
+    found = (generic_hash_lookup(GLOBAL_DCONTEXT, xl8_cache_table, (ptr_uint_t) f)
+             != NULL);
+    read_unlock(&xl8_cache_table->rwlock);
+    return found;
+}
+
+/* Ensures the shared fragment f has a compact translation table cached for it,
+ * so that state recreation within f does not need to rebuild f each time.
+ * The table is computed from ilist if non-NULL, which must be f's final ilist
+ * as at emit time, and otherwise by rebuilding f from the app code.
+ * Returns whether f now has a cached table.
+ * As for fragment_record_translation_info(), when ilist is NULL the caller must
+ * ensure f cannot be flushed meanwhile (typically by holding thread_initexit_lock).
+ */
+bool
+fragment_cache_translation_info(dcontext_t *dcontext, fragment_t *f, instrlist_t *ilist)
+{
+    translation_info_t *info;
+    compact_translation_info_t *cinfo;
+    instr_t *inst;
+    if (xl8_cache_table == NULL || !TEST(FRAG_SHARED, f->flags))
+        return false;
+    if (fragment_acquire_cached_translation_info(f, true/*wait*/) != NULL) {
+        fragment_release_cached_translation_info();
+        return true;
+    }
+    /* We can only trust the app code for live, non-selfmod fragments. */
+    if (TESTANY(FRAG_COARSE_GRAIN | FRAG_SELFMOD_SANDBOXED | FRAG_WAS_DELETED |
+                FRAG_HAS_TRANSLATION_INFO, f->flags))
+        return false;
+    /* A trace's ilist, decoded from its constituent bbs, has no translations:
+     * it is cached by rebuilding it once a fast signal has interrupted it.
+     */
+    for (inst = (ilist == NULL) ? NULL : instrlist_first(ilist); inst != NULL;
+         inst = instr_get_next(inst)) {
+        if (instr_get_translation(inst) == NULL && !instr_is_meta(inst))
+            return false;
+    }
+    info = record_translation_info(dcontext, f, ilist);
+    cinfo = translation_info_compact(dcontext, info, f->tag);
+    translation_info_free(dcontext, info);
+    if (cinfo == NULL) {
+        STATS_INC(num_fragment_translation_uncacheable);
+        return false;
+    }
+    TABLE_RWLOCK(xl8_cache_table, write, lock);
+    if (generic_hash_lookup(GLOBAL_DCONTEXT, xl8_cache_table, (ptr_uint_t) f) == NULL) {
+        generic_hash_add(GLOBAL_DCONTEXT, xl8_cache_table, (ptr_uint_t) f, cinfo);
+        STATS_INC(num_fragment_translation_cached);
+        cinfo = NULL;
+    }
+    TABLE_RWLOCK(xl8_cache_table, write, unlock);
+    /* another thread beat us to it */
+    if (cinfo != NULL)
+        compact_translation_info_free(dcontext, cinfo);
+    return true;
+}
+
 /* Removes the shared fragment f from all lookup tables in a safe
  * manner that does not require a full flush synch.
  * This routine can be called without synchronizing with other threads.
@@ -3998,6 +4268,7 @@ fragment_copy_data_fields(dcontext_t *dcontext, fragment_t *f_src, fragment_t *f
             memcpy(t_dst->bbs, t_src->bbs, t_src->num_bbs*sizeof(trace_bb_info_t));
             t_dst->num_bbs = t_src->num_bbs;
         }
+        t_dst->inline_cached = t_src->inline_cached;
 
 #ifdef PROFILE_RDTSC
         t_dst->count = t_src->count;
@@ -5450,6 +5721,9 @@ void
 set_flushtime_last_update(dcontext_t *dcontext, uint val)
 {
     per_thread_t *pt = (per_thread_t *) dcontext->fragment_field;
+    /* Once we acknowledge the flush, its shared fragments can be freed. */
+    if (DYNAMO_OPTION(shadow_ret_stack))
+        shadow_ret_stack_clear(dcontext);
     pt->flushtime_last_update = val;
 }
 
@@ -5467,6 +5741,10 @@ get_at_syscall(dcontext_t *dcontext)
     return dcontext->upcontext_ptr->at_syscall;
 }
 
+static int
+flush_epoch_unlink_private(dcontext_t *dcontext, dcontext_t *tgt_dcontext,
+                           app_pc start, app_pc end _IF_DGCDIAG(app_pc written_pc));
+
 /* Assumes caller takes care of synchronization.
  * Returns false iff was_I_flushed ends up being deleted right now from
  * a private cache OR was_I_flushed has been flushed from a shared cache
@@ -5478,6 +5756,13 @@ check_flush_queue(dcontext_t *dcontext, fragment_t *was_I_flushed)
     per_thread_t *pt = (per_thread_t *) dcontext->fragment_field;
     bool not_flushed = true;
     ASSERT_OWN_MUTEX(true, &pt->linking_lock);
+    /* pick up private flush work an epoch flusher left to us */
+    if (pt->epoch_flush_end != NULL) {
+        app_pc start = pt->epoch_flush_start, end = pt->epoch_flush_end;
+        pt->epoch_flush_start = NULL;
+        pt->epoch_flush_end = NULL;
+        flush_epoch_unlink_private(dcontext, dcontext, start, end _IF_DGCDIAG(NULL));
+    }
     /* first check private queue and act on pending deletions */
     if (pt->flush_queue_nonempty) {
         bool local_prot = local_heap_protected(dcontext);
@@ -5961,6 +6246,7 @@ DECLARE_NEVERPROT_VAR(static int flush_num_threads, 0);
 DECLARE_NEVERPROT_VAR(static int pending_delete_threads, 0);
 DECLARE_NEVERPROT_VAR(static int shared_flushed, 0);
 DECLARE_NEVERPROT_VAR(static bool flush_synchall, false);
+DECLARE_NEVERPROT_VAR(static bool flush_epoch, false);
 #ifdef DEBUG
 DECLARE_NEVERPROT_VAR(static int num_flushed, 0);
 DECLARE_NEVERPROT_VAR(static int flush_last_stage, 0);
@@ -5988,6 +6274,7 @@ flush_fragments_free_futures(app_pc base, size_t size)
                 thcounter_range_remove(tgt_dcontext, base, base + size);
             }
         }
+        thcounter_range_remove(GLOBAL_DCONTEXT, base, base + size);
         if (SHARED_FRAGMENTS_ENABLED())
             fragment_delete_futures_in_region(GLOBAL_DCONTEXT, base, base + size);
         release_recursive_lock(&change_linking_lock);
@@ -6479,6 +6766,184 @@ flush_fragments_synch_priv(dcontext_t *dcontext, app_pc base, size_t size,
     }
 }
 
+/* Squashes tgt_dcontext's trace-in-progress and unlinks its private fragments
+ * if either overlaps [start, end).  The caller must own tgt_dcontext's
+ * linking_lock, and tgt_dcontext must not be could_be_linking (or must be the
+ * caller itself).  The unlinked fragments are freed by tgt_dcontext at its next
+ * check_flush_queue().  Returns the number of fragments unlinked.
+ */
+static int
+flush_epoch_unlink_private(dcontext_t *dcontext, dcontext_t *tgt_dcontext,
+                           app_pc start, app_pc end _IF_DGCDIAG(app_pc written_pc))
+{
+    per_thread_t *tgt_pt = (per_thread_t *) tgt_dcontext->fragment_field;
+    ASSERT_OWN_MUTEX(true, &tgt_pt->linking_lock);
+    if (is_building_trace(tgt_dcontext)) {
+        void *trace_vmlist = cur_trace_vmlist(tgt_dcontext);
+        if (trace_vmlist != NULL &&
+            vm_list_overlaps(tgt_dcontext, trace_vmlist, start, end)) {
+            LOG(THREAD, LOG_FRAGMENT, 2,
+                "\tsquashing trace of thread "TIDFMT"\n", tgt_dcontext->owning_thread);
+            trace_abort(tgt_dcontext);
+        }
+    }
+    if (!thread_vm_area_overlap(tgt_dcontext, start, end))
+        return 0;
+    tgt_pt->flush_queue_nonempty = true;
+    return vm_area_unlink_fragments(tgt_dcontext, start, end, 0
+                                    _IF_DGCDIAG(written_pc));
+}
+
+/* Returns whether a flush of a region of the given size can take the
+ * -flush_epoch path, where no thread is stopped.  Only shared fragments are
+ * unlinked up front; each thread's next synch point, where it signs off on
+ * the new flushtime_global, serves as its quiescent state before the flushed
+ * memory is freed by the regular shared deletion ref counts.  A thread at a
+ * syscall is quiescent already and is signed off by the flusher.  That requires
+ * that unlinking a shared fragment never touches another thread's private
+ * ibt tables, and that no bb can be built from the region's stale contents
+ * without holding bb_building_lock.
+ */
+static bool
+flush_epoch_applies(size_t size, bool own_initexit_lock)
+{
+    return (DYNAMO_OPTION(flush_epoch) && size > 0 &&
+            /* we need trace_building_lock, which ranks before thread_initexit_lock */
+            !own_initexit_lock &&
+            !RUNNING_WITHOUT_CODE_CACHE() &&
+            DYNAMO_OPTION(shared_deletion) && USE_BB_BUILDING_LOCK() &&
+            /* -bb_build_claims decodes outside of bb_building_lock */
+            !DYNAMO_OPTION(bb_build_claims) &&
+            (DYNAMO_OPTION(shared_traces) || DYNAMO_OPTION(disable_traces)) &&
+            (DYNAMO_OPTION(shared_bb_ibt_tables) || !SHARED_BB_IB_TARGETS()) &&
+            (DYNAMO_OPTION(shared_trace_ibt_tables) || !DYNAMO_OPTION(shared_traces)));
+}
+
+/* The -flush_epoch replacement for flush_fragments_synch_priv().  Rather than
+ * waiting for could_be_linking threads and stopping every thread at its next
+ * cache exit, we hold the fragment building locks for the duration of the
+ * flush so that the region cannot be re-populated before the caller updates
+ * the executable areas, and leave each thread to run.  Shared fragments are
+ * unlinked in stage 2 exactly as for a synched flush: unlinking and table
+ * removal are atomic, and a thread holding a pointer to a flushed fragment
+ * drops it at its next synch point, which is also where it decrements the
+ * pending deletion ref count.  Private fragments are unlinked here for threads
+ * in the cache; a could_be_linking thread is handed the region instead and
+ * unlinks its own private fragments at its next check_flush_queue(), before
+ * it can enter the cache.
+ */
+static void
+flush_fragments_epoch_start(dcontext_t *dcontext, app_pc base, size_t size
+                            _IF_DGCDIAG(app_pc written_pc))
+{
+    dcontext_t *tgt_dcontext;
+    per_thread_t *tgt_pt;
+    int i;
+
+    ASSERT(!is_self_couldbelinking());
+    ASSERT_OWN_NO_LOCKS();
+    if (DYNAMO_OPTION(shared_traces))
+        mutex_lock(&trace_building_lock);
+    mutex_lock(&thread_initexit_lock);
+    mutex_lock(&bb_building_lock);
+    flusher = dcontext;
+    flush_epoch = true;
+    get_list_of_threads(&flush_threads, &flush_num_threads);
+
+    ASSERT(flush_last_stage == 0);
+    DODEBUG({ flush_last_stage = 1; });
+
+    flush_base = base;
+    flush_size = size;
+    pending_delete_threads = flush_num_threads;
+    DODEBUG({ num_flushed = 0; });
+    STATS_INC(flush_epoch_flushes);
+
+    for (i=0; i<flush_num_threads; i++) {
+        tgt_dcontext = flush_threads[i]->dcontext;
+        tgt_pt = (per_thread_t *) tgt_dcontext->fragment_field;
+        mutex_lock(&tgt_pt->linking_lock);
+        if (tgt_pt->about_to_exit) {
+            /* thread is waiting for thread_initexit_lock to exit */
+        } else if (tgt_dcontext == dcontext || !tgt_pt->could_be_linking) {
+#ifdef DEBUG
+            num_flushed +=
+#endif
+                flush_epoch_unlink_private(dcontext, tgt_dcontext, base, base + size
+                                           _IF_DGCDIAG(written_pc));
+        } else {
+            /* Hand the region to the thread.  If an earlier epoch flush's region
+             * is still pending we simply cover both: over-flushing a thread's
+             * private fragments is harmless.
+             */
+            LOG(THREAD, LOG_FRAGMENT, 2,
+                "\tdeferring private flush to thread "TIDFMT"\n",
+                tgt_dcontext->owning_thread);
+            if (tgt_pt->epoch_flush_end == NULL) {
+                tgt_pt->epoch_flush_start = base;
+                tgt_pt->epoch_flush_end = base + size;
+            } else {
+                if (base < tgt_pt->epoch_flush_start)
+                    tgt_pt->epoch_flush_start = base;
+                if (base + size > tgt_pt->epoch_flush_end)
+                    tgt_pt->epoch_flush_end = base + size;
+            }
+            STATS_INC(flush_epoch_deferred);
+        }
+        mutex_unlock(&tgt_pt->linking_lock);
+    }
+}
+
+/* The -flush_epoch replacement for the thread release in
+ * flush_fragments_end_synch(): there is nobody to release, so we sign off on
+ * the flush for threads waiting at a system call and drop the locks taken in
+ * flush_fragments_epoch_start().
+ */
+static void
+flush_fragments_epoch_end(dcontext_t *dcontext, bool keep_initexit_lock)
+{
+    dcontext_t *tgt_dcontext;
+    per_thread_t *tgt_pt;
+    int i;
+
+    ASSERT(flush_epoch);
+    /* A thread at a syscall holds no fragment pointers and, now that stage 2
+     * has unlinked the flushed fragments and removed them from the shared ibt
+     * tables, cannot reach them on its way back into the cache.  So like the
+     * synched path we act on its behalf as though it had reached a synch
+     * point, rather than keep the flushed memory around until its syscall
+     * returns.  Holding its linking_lock serializes with its own
+     * check_flush_queue(), and we check at_syscall only here, after stage 2,
+     * so a thread that just returned is not mistaken for a quiescent one.
+     */
+    if (DYNAMO_OPTION(syscalls_synch_flush)) {
+        for (i = 0; i < flush_num_threads; i++) {
+            tgt_dcontext = flush_threads[i]->dcontext;
+            tgt_pt = (per_thread_t *) tgt_dcontext->fragment_field;
+            if (tgt_dcontext == dcontext)
+                continue;
+            mutex_lock(&tgt_pt->linking_lock);
+            if (!tgt_pt->about_to_exit && !tgt_pt->could_be_linking &&
+                get_at_syscall(tgt_dcontext) &&
+                tgt_pt->flushtime_last_update < flushtime_global) {
+                vm_area_check_shared_pending(tgt_dcontext, NULL);
+                STATS_INC(num_shared_flush_atsyscall);
+            }
+            mutex_unlock(&tgt_pt->linking_lock);
+        }
+    }
+    flush_epoch = false;
+    flusher = NULL;
+    global_heap_free(flush_threads, flush_num_threads*sizeof(thread_record_t*)
+                     HEAPACCT(ACCT_THREAD_MGT));
+    flush_threads = NULL;
+    mutex_unlock(&bb_building_lock);
+    if (DYNAMO_OPTION(shared_traces))
+        mutex_unlock(&trace_building_lock);
+    if (!keep_initexit_lock)
+        mutex_unlock(&thread_initexit_lock);
+}
+
 /* This routine begins a flush of the group of fragments in the memory
  * region [base, base+size) by synchronizing with each thread and unlinking
  * all private fragments in the region.
@@ -6547,6 +7012,11 @@ flush_fragments_synch_unlink_priv(dcontext_t *dcontext, app_pc base, size_t size
         return true;
     }
 
+    if (flush_epoch_applies(size, own_initexit_lock)) {
+        flush_fragments_epoch_start(dcontext, base, size _IF_DGCDIAG(written_pc));
+        return true;
+    }
+
     flush_fragments_synch_priv(dcontext, base, size, own_initexit_lock,
                                flush_fragments_thread_unlink _IF_DGCDIAG(written_pc));
 
@@ -6647,14 +7117,17 @@ flush_fragments_unlink_shared(dcontext_t *dcontext, app_pc base, size_t size,
         });
     }
 
+    /* an epoch flush never unlinked these */
+    if (!flush_epoch) {
 #ifdef WINDOWS
-    /* Re-link thread-shared shared_syscall */
-    if (DYNAMO_OPTION(shared_syscalls) && IS_SHARED_SYSCALL_THREAD_SHARED)
-        link_shared_syscall(GLOBAL_DCONTEXT);
+        /* Re-link thread-shared shared_syscall */
+        if (DYNAMO_OPTION(shared_syscalls) && IS_SHARED_SYSCALL_THREAD_SHARED)
+            link_shared_syscall(GLOBAL_DCONTEXT);
 #endif
 
-    if (!special_ibl_xfer_is_thread_private())
-        link_special_ibl_xfer(GLOBAL_DCONTEXT);
+        if (!special_ibl_xfer_is_thread_private())
+            link_special_ibl_xfer(GLOBAL_DCONTEXT);
+    }
 
     STATS_ADD(num_flushed_fragments, num_flushed);
     DODEBUG({
@@ -6743,6 +7216,11 @@ flush_fragments_end_synch(dcontext_t *dcontext, bool keep_initexit_lock)
         return;
     }
 
+    if (flush_epoch) {
+        flush_fragments_epoch_end(dcontext, keep_initexit_lock);
+        return;
+    }
+
     /* now can let all threads at DR synch point go
      * FIXME: if implement thread-private optimization above, this would turn into
      * re-setting exec areas lock to treat all threads uniformly
@@ -8789,3 +9267,76 @@ fragment_coarse_htable_resurrect(dcontext_t *dcontext,  coarse_info_t *info,
 }
 
 /*******************************************************************************/
+
+#ifdef STANDALONE_UNIT_TEST
+/* Compares C lookups in an ibl table with and without -ibl_buckets.  The tags
+ * hash to random indices, and at this load they form long collision runs.
+ */
+# define IBL_BENCH_BITS 14
+# define IBL_BENCH_LOAD 80
+/* half of the tags are added: 75% of the table's capacity */
+# define IBL_BENCH_TAGS (2 * 3 * (1 << IBL_BENCH_BITS) / 4)
+# define IBL_BENCH_ROUNDS IF_DEBUG_ELSE(20, 200)
+
+static ptr_uint_t ibl_bench_tags[IBL_BENCH_TAGS];
+
+static void
+ibl_buckets_bench(bool buckets)
+{
+    ibl_table_t table;
+    fragment_entry_t fe;
+    uint i, round, hits = 0;
+    uint64 start_us, end_us;
+    bool old_buckets = DYNAMO_OPTION(ibl_buckets);
+    dynamo_options.ibl_buckets = buckets;
+    hashtable_ibl_myinit(GLOBAL_DCONTEXT, &table, IBL_BENCH_BITS, IBL_BENCH_LOAD,
+                         HASH_FUNCTION_NONE, 0, IBL_INDCALL, false /*no lookup*/,
+                         FRAG_TABLE_SHARED | FRAG_TABLE_TARGET_SHARED
+                         _IF_DEBUG("ibl bench table"));
+    TABLE_RWLOCK(&table, write, lock);
+    for (i = 0; i < IBL_BENCH_TAGS; i += 2) {
+        fe.tag_fragment = (app_pc) ibl_bench_tags[i];
+        fe.start_pc_fragment = (cache_pc) ibl_bench_tags[i];
+        hashtable_ibl_add(GLOBAL_DCONTEXT, fe, &table);
+    }
+    TABLE_RWLOCK(&table, write, unlock);
+    EXPECT(table.capacity, (1 << IBL_BENCH_BITS) + 1); /* not resized */
+
+    TABLE_RWLOCK(&table, read, lock);
+    start_us = query_time_micros();
+    for (round = 0; round < IBL_BENCH_ROUNDS; round++) {
+        for (i = 0; i < IBL_BENCH_TAGS; i++) {
+            fe = hashtable_ibl_lookup(GLOBAL_DCONTEXT, ibl_bench_tags[i], &table);
+            if (i % 2 == 0) {
+                EXPECT((ptr_uint_t) fe.tag_fragment, ibl_bench_tags[i]);
+                hits++;
+            } else
+                EXPECT(IBL_ENTRY_IS_EMPTY(fe), true);
+        }
+    }
+    end_us = query_time_micros();
+    TABLE_RWLOCK(&table, read, unlock);
+    EXPECT(hits, IBL_BENCH_ROUNDS * IBL_BENCH_TAGS / 2);
+    print_file(STDERR, "%s: "UINT64_FORMAT_STRING" lookups/sec, half of them hits\n",
+               buckets ? "-ibl_buckets" : "linear probe",
+               (uint64)IBL_BENCH_ROUNDS * IBL_BENCH_TAGS * 1000000 /
+               (end_us > start_us ? end_us - start_us : 1));
+    hashtable_ibl_myfree(GLOBAL_DCONTEXT, &table);
+    dynamo_options.ibl_buckets = old_buckets;
+}
+
+void
+unit_test_fragment(void)
+{
+    uint i;
+    print_file(STDERR, "\nibl table lookup tests\n");
+    set_random_seed((uint) query_time_millis());
+    for (i = 0; i < IBL_BENCH_TAGS; i++) {
+        /* distinct tags whose low bits, which pick the bucket, are random */
+        ibl_bench_tags[i] = ((ptr_uint_t)(i + 1) << IBL_BENCH_BITS) |
+            get_random_offset(1 << IBL_BENCH_BITS);
+    }
+    ibl_buckets_bench(false);
+    ibl_buckets_bench(true);
+}
+#endif /* STANDALONE_UNIT_TEST */
@@ -152,6 +152,9 @@
 # endif
 #elif defined(SIDELINE)
 # define FRAG_DO_NOT_SIDELINE     0x40000000
+#else
+/* this trace is awaiting -optimize_async and has not been through optimize_trace() */
+# define FRAG_UNOPTIMIZED         0x40000000
 #endif
 
 /* This fragment immediately follows a free entry in the fcache */
@@ -307,15 +310,14 @@ struct _future_fragment_t {
 
 typedef struct _trace_bb_info_t {
     app_pc tag;
-#if defined(RETURN_AFTER_CALL) || defined(RCT_IND_BRANCH)
     /* PR 204770: holds # exits in the trace corresponding to that bb.
-     * Used to obtain a better RCT source address.
+     * Used to obtain a better RCT source address and by -trace_reform_window
+     * to tell side exits from the final exits.
      * We could recreate to obtain this, except for flushed fragments: but
      * we do this frequently enough that it's simpler to store for all
      * fragments.
      */
     uint num_exits;
-#endif
 } trace_bb_info_t;
 
 /* N.B.: if you add fields to trace_t, make sure to add them
@@ -330,6 +332,8 @@ typedef struct _trace_only_t {
     /* holds the tags (and other info) for all constituent basic blocks */
     trace_bb_info_t *bbs;
     uint    num_bbs;
+    /* whether the last indirect exit compares against -ibl_inline_cache targets */
+    bool    inline_cached;
 } trace_only_t;
 
 /* trace extension of fragment_t */
@@ -521,6 +525,12 @@ typedef struct _per_thread_t {
      * not used while not flushing.
      */
     bool           at_syscall_at_flush;
+    /* for -flush_epoch: region whose private fragments this thread must unlink
+     * itself at its next synch point, as the flusher did not wait for it.
+     * Controlled by linking_lock.
+     */
+    app_pc         epoch_flush_start;
+    app_pc         epoch_flush_end;
 } per_thread_t;
 
 
@@ -567,6 +577,12 @@ typedef struct _per_thread_t {
 #define FRAGMENT_TRANSLATION_INFO(f) \
   (HAS_STORED_TRANSLATION_INFO(f) ? (*(FRAGMENT_TRANSLATION_INFO_ADDR(f))) : NULL)
 
+/* Whether shared fragments get a compact translation table at emit time:
+ * -fast_signals relies on them to translate without rebuilding fragments.
+ */
+#define RECORD_COMPACT_TRANSLATIONS() \
+  (DYNAMO_OPTION(compact_translations) IF_UNIX(|| !IS_STRING_OPTION_EMPTY(fast_signals)))
+
 static inline const char *
 fragment_type_name(fragment_t *f)
 {
@@ -671,6 +687,18 @@ fragment_delete(dcontext_t *dcontext, fragment_t *f, uint actions);
 void
 fragment_record_translation_info(dcontext_t *dcontext, fragment_t *f, instrlist_t *ilist);
 
+compact_translation_info_t *
+fragment_acquire_cached_translation_info(fragment_t *f, bool wait);
+
+void
+fragment_release_cached_translation_info(void);
+
+bool
+fragment_has_cached_translation_info_nowait(fragment_t *f);
+
+bool
+fragment_cache_translation_info(dcontext_t *dcontext, fragment_t *f, instrlist_t *ilist);
+
 void
 fragment_remove_shared_no_flush(dcontext_t *dcontext, fragment_t *f);
 
@@ -816,6 +816,11 @@ struct _dcontext_t {
     reg_t          sys_param4;      /* used for post_system_call i#173 */
     bool           sys_was_int;     /* was the last system call via do_int_syscall? */
     bool           sys_xbp;         /* PR 313715: store orig xbp */
+    /* -fast_signals: set while this thread translates its own state from within
+     * its signal handler for an asynchronous signal, where translation must fail
+     * rather than wait on a lock, and may fail at any untranslatable point
+     */
+    bool           xl8_nowait;
 # ifdef DEBUG
     bool           mprot_multi_areas; /* PR 410921: mprotect of 2 or more vmareas? */
 # endif
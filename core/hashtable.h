@@ -120,8 +120,10 @@
         ASSERT(lookup_stats.hit_stat == 0);                     \
 } while (0)
 # define HTABLE_STAT_INC(ftable,event) ftable->drlookup_stats.event##_stat++
+# define HTABLE_STAT_ADD(ftable,event,num) ftable->drlookup_stats.event##_stat += (num)
 #else
 # define HTABLE_STAT_INC(ftable,event) ((void)0)
+# define HTABLE_STAT_ADD(ftable,event,num) ((void)0)
 #endif
 
 
@@ -77,6 +77,12 @@
  *     Needs higher rank than memory alloc locks.
  * optional for main table:
  *    bool TAGS_ARE_EQUAL(table, tag1, tag2)
+ *    uint ENTRY_BUCKET_PROBE(table, entries, tag)
+ *      returns the index of the first of ENTRY_BUCKET_SIZE entries that is
+ *      empty or has tag, or ENTRY_BUCKET_SIZE if there is none, or
+ *      ENTRY_BUCKET_SIZE+1 if not probing table in buckets.  Lookups then
+ *      skip runs of colliding entries a bucket at a time.  Only supported
+ *      without HASHTABLE_USE_LOOKUPTABLE and with tag equality.
  *
  * for lookuptable:
  *  if HASHTABLE_USE_LOOKUPTABLE is defined:
@@ -721,6 +727,27 @@ HTNAME(hashtable_,NAME_KEY,_lookup)(dcontext_t *dcontext, ptr_uint_t tag,
     DODEBUG({
         HTNAME(hashtable_,NAME_KEY,_check_consistency)(dcontext,htable,hindex);
     });
+#ifdef ENTRY_BUCKET_PROBE
+    /* Skip whole buckets of colliding entries; the loop below then resolves the
+     * entry we stop at.  A bucket must not cover the sentinel, so near the end
+     * of the table we leave the probing to the loop below.
+     */
+    while (hindex + ENTRY_BUCKET_SIZE < htable->capacity) {
+        uint skip = ENTRY_BUCKET_PROBE(htable, &htable->table[hindex], tag);
+        if (skip > ENTRY_BUCKET_SIZE)
+            break;
+# ifdef HASHTABLE_STATISTICS
+        collision_len += skip;
+        HTABLE_STAT_ADD(htable, collision, skip);
+# endif
+        if (skip < ENTRY_BUCKET_SIZE) {
+            hindex += skip;
+            break;
+        }
+        hindex = HASH_INDEX_WRAPAROUND(hindex + ENTRY_BUCKET_SIZE, htable);
+    }
+    e = htable->table[hindex];
+#endif
     while (!ENTRY_IS_EMPTY(e)) {
         DODEBUG({
             HTNAME(hashtable_,NAME_KEY,_check_consistency)(dcontext,htable,hindex);
@@ -2260,6 +2287,8 @@ HTNAME(hashtable_,NAME_KEY,_resurrect)(dcontext_t *dcontext, byte *mapped_table
 #undef ENTRY_EMPTY
 #undef ENTRY_SENTINEL
 #undef TAGS_ARE_EQUAL
+#undef ENTRY_BUCKET_PROBE
+#undef ENTRY_BUCKET_SIZE
 
 #undef AUX_ENTRY_TAG
 #undef AUX_ENTRY_IS_EMPTY
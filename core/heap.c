@@ -276,10 +276,64 @@ typedef struct _thread_units_t {
 #define SEPARATE_NONPERSISTENT_HEAP() \
     (DYNAMO_OPTION(enable_reset) IF_CLIENT_INTERFACE(|| true))
 
+/* A thread's cache of free fixed-size blocks of one bucket of a global heap,
+ * linked through their first word like thread_units_t.free_list.
+ * The bottom fresh blocks were carved from a unit by the refill and have never
+ * been handed out, which the heap accounting counts as new allocations.
+ */
+typedef struct _heap_magazine_t {
+    heap_pc top;
+    uint count;
+    uint fresh;
+} heap_magazine_t;
+
+/* Per-thread magazines for one global heap (-heap_magazine_size).  A thread
+ * allocates from and frees to its own magazines without global_alloc_lock,
+ * and only takes the lock to refill an empty magazine or drain a full one,
+ * half a magazine at a time.  Blocks sitting in a magazine are free as far as
+ * heap accounting is concerned: allocs and frees through the magazines are
+ * accounted in acct here, which is added to the global stats on thread exit
+ * just like a thread's private heap.
+ * This lives in unprotected memory as it is written on every alloc and free.
+ */
+typedef struct _heap_magazines_t {
+    uint capacity;
+    heap_magazine_t mag[BLOCK_TYPES-1]; /* no variable-length bucket */
+#ifdef HEAP_ACCOUNTING
+    heap_acct_t acct;
+#endif
+} heap_magazines_t;
+
+/* A chunk of a -bb_ir_arena arena, allocated from the thread's local heap.
+ * The arena's storage follows the header.
+ */
+typedef struct _ir_arena_chunk_t {
+    struct _ir_arena_chunk_t *next;
+    size_t size; /* including this header */
+} ir_arena_chunk_t;
+
+/* Per-thread bump-pointer storage for the IR of the bb being built
+ * (-bb_ir_arena).  Frees are ignored and the whole arena is reset by the
+ * outermost heap_ir_arena_exit().  The base chunk is kept for the life of the
+ * thread; chunks added when a bb outgrows it are freed on reset.
+ */
+typedef struct _ir_arena_t {
+    ir_arena_chunk_t *base;
+    ir_arena_chunk_t *overflow; /* newest first */
+    byte *cur;
+    byte *end;
+    uint depth; /* heap_ir_arena_enter() nesting */
+} ir_arena_t;
+
 /* per-thread structure: */
 typedef struct _thread_heap_t {
     thread_units_t *local_heap;
     thread_units_t *nonpersistent_heap;
+    /* for the global and global non-persistent heaps, if -heap_magazine_size */
+    heap_magazines_t *global_magazines;
+    heap_magazines_t *nonpersistent_magazines;
+    /* created by the first heap_ir_arena_enter() */
+    ir_arena_t *ir_arena;
 } thread_heap_t;
 
 /* global, unique thread-shared structure:
@@ -381,6 +435,7 @@ const char * whichheap_name[] = {
 # endif
     "Lib Dup",
     "Clean Call",
+    "Xl8 Tables",
     /* NOTE: Add your heap name here */
     "Other",
 };
@@ -963,33 +1018,56 @@ rel32_reachable_from_vmcode(byte *tgt)
  * (e.g. 64KB) but the caller is not forced to request at that
  * alignment.  We explicitly synchronize reservations and decommits
  * within the vm_heap_t.
-
+ * If alignment is larger than a block (it must then be a multiple of the block
+ * size) the returned address is aligned to it.
+ *
  * Returns NULL if the VMMHeap is full or too fragmented to satisfy
  * the request.
  */
 static vm_addr_t
-vmm_heap_reserve_blocks(vm_heap_t *vmh, size_t size_in)
+vmm_heap_reserve_blocks(vm_heap_t *vmh, size_t size_in, size_t alignment)
 {
     vm_addr_t p;
     uint request;
     uint first_block;
+    uint extra = 0;
     size_t size;
 
     size = ALIGN_FORWARD(size_in, DYNAMO_OPTION(vmm_block_size));
     ASSERT_TRUNCATE(request, uint, size/DYNAMO_OPTION(vmm_block_size));
     request = (uint) size/DYNAMO_OPTION(vmm_block_size);
+    if (alignment > DYNAMO_OPTION(vmm_block_size)) {
+        /* we over-reserve and give back the unaligned head and tail */
+        ASSERT(ALIGNED(alignment, DYNAMO_OPTION(vmm_block_size)));
+        extra = (uint) (alignment/DYNAMO_OPTION(vmm_block_size)) - 1;
+    }
 
     LOG(GLOBAL, LOG_HEAP, 2,
-        "vmm_heap_reserve_blocks: size=%d => %d in blocks=%d free_blocks~=%d\n",
-        size_in, size, request, vmh->num_free_blocks);
+        "vmm_heap_reserve_blocks: size=%d => %d in blocks=%d+%d free_blocks~=%d\n",
+        size_in, size, request, extra, vmh->num_free_blocks);
 
     mutex_lock(&vmh->lock);
-    if (vmh->num_free_blocks < request) {
+    if (vmh->num_free_blocks < request + extra) {
         mutex_unlock(&vmh->lock);
         return NULL;
     }
-    first_block = bitmap_allocate_blocks(vmh->blocks, vmh->num_blocks, request);
+    first_block = bitmap_allocate_blocks(vmh->blocks, vmh->num_blocks,
+                                         request + extra);
     if (first_block != BITMAP_NOT_FOUND) {
+        if (extra > 0) {
+            vm_addr_t start = vmm_block_to_addr(vmh, first_block);
+            uint head = (uint)
+                ((ALIGN_FORWARD(start, alignment) - (ptr_uint_t)start) /
+                 DYNAMO_OPTION(vmm_block_size));
+            ASSERT(head <= extra);
+            if (head > 0)
+                bitmap_free_blocks(vmh->blocks, vmh->num_blocks, first_block, head);
+            if (extra - head > 0) {
+                bitmap_free_blocks(vmh->blocks, vmh->num_blocks,
+                                   first_block + head + request, extra - head);
+            }
+            first_block += head;
+        }
         vmh->num_free_blocks -= request;
     }
     mutex_unlock(&vmh->lock);
@@ -1126,7 +1204,11 @@ vmm_heap_reserve(size_t size, heap_error_code_t *error_code, bool executable)
             }
         }
 
-        p = vmm_heap_reserve_blocks(&heapmgt->vmheap, size);
+        /* -cache_huge_pages units are whole huge pages: see heap_mmap_huge() */
+        p = vmm_heap_reserve_blocks(&heapmgt->vmheap, size,
+                                    (executable && DYNAMO_OPTION(cache_huge_pages) &&
+                                     ALIGNED(size, HUGE_PAGE_SIZE)) ?
+                                    HUGE_PAGE_SIZE : 0);
         LOG(GLOBAL, LOG_HEAP, 2, "vmm_heap_reserve: size=%d p="PFX"\n",
             size, p);
 
@@ -2151,6 +2233,26 @@ heap_mmap_reserve(size_t reserve_size, size_t commit_size)
                         MEMPROT_EXEC|MEMPROT_READ|MEMPROT_WRITE, true);
 }
 
+/* Allocates size bytes of executable memory, fully committed, starting on a
+ * huge page boundary and advised to be backed by huge pages.  size must be a
+ * multiple of HUGE_PAGE_SIZE.  There are no guard pages, as they would move
+ * the start off the boundary: free with heap_munmap_ex(p, size, false).
+ * If the memory could not be placed in the vmm heap it may be unaligned, in
+ * which case it is still usable but is backed by regular pages.
+ */
+void *
+heap_mmap_huge(size_t size)
+{
+    void *p;
+    ASSERT(ALIGNED(size, HUGE_PAGE_SIZE));
+    p = heap_mmap_ex(size, size, MEMPROT_EXEC|MEMPROT_READ|MEMPROT_WRITE, false);
+    if (p != NULL && ALIGNED(p, HUGE_PAGE_SIZE) && os_heap_advise_huge_pages(p, size))
+        STATS_ADD(huge_page_mmap_capacity, size);
+    else
+        STATS_INC(huge_page_mmap_failures);
+    return p;
+}
+
 /* It is up to the caller to ensure commit_size is a page size multiple,
  * and that it does not extend beyond the initial reservation.
  */
@@ -2638,11 +2740,250 @@ heap_vmareas_synch_units()
     release_recursive_lock(&global_alloc_lock);
 }
 
+#ifdef DEBUG
+/* Updates the per-bucket stats for a block of alloc_size bytes from bucket
+ * that is handed out for a request of size bytes.
+ */
+static void
+heap_bucket_alloc_stats(int bucket, size_t size, size_t aligned_size, size_t alloc_size
+                        HEAPACCT(which_heap_t which))
+{
+    ATOMIC_ADD(int, block_count[bucket], 1);
+    ATOMIC_ADD(int, block_total_count[bucket], 1);
+    /* FIXME: should atomically store inc-ed val in temp to avoid races w/ max */
+    ATOMIC_MAX(int, block_peak_count[bucket], block_count[bucket]);
+    ASSERT(CHECK_TRUNCATE_TYPE_uint(alloc_size - aligned_size));
+    ATOMIC_ADD(int, block_wasted[bucket], (int) (alloc_size - aligned_size));
+    /* FIXME: should atomically store val in temp to avoid races w/ max */
+    ATOMIC_MAX(int, block_peak_wasted[bucket], block_wasted[bucket]);
+    if (aligned_size > size) {
+        ASSERT(CHECK_TRUNCATE_TYPE_uint(aligned_size - size));
+        ATOMIC_ADD(int, block_align_pad[bucket], (int) (aligned_size - size));
+        /* FIXME: should atomically store val in temp to avoid races w/ max */
+        ATOMIC_MAX(int, block_peak_align_pad[bucket], block_align_pad[bucket]);
+        STATS_ADD_PEAK(heap_align, aligned_size - size);
+        LOG(GLOBAL, LOG_STATS, 5,
+            "alignment mismatch: %s ask %d, aligned is %d -> %d pad\n",
+            IF_HEAPACCT_ELSE(whichheap_name[which], ""),
+            size, aligned_size, aligned_size-size);
+    }
+    if (bucket == BLOCK_TYPES-1) {
+        STATS_ADD(heap_headers, HEADER_SIZE);
+        STATS_INC(heap_allocs_variable);
+    } else {
+        STATS_INC(heap_allocs_buckets);
+        if (alloc_size > aligned_size) {
+            STATS_ADD_PEAK(heap_bucket_pad, alloc_size - aligned_size);
+            LOG(GLOBAL, LOG_STATS, 5,
+                "bucket mismatch: %s ask (aligned) %d, got %d, -> %d\n",
+                IF_HEAPACCT_ELSE(whichheap_name[which], ""),
+                aligned_size, alloc_size, alloc_size-aligned_size);
+        }
+    }
+}
+#endif
+
+/* Returns the calling thread's magazines in front of the global heap tu, or
+ * NULL if it has none.
+ */
+static inline heap_magazines_t *
+heap_magazines_for(thread_units_t *tu)
+{
+    dcontext_t *dcontext;
+    thread_heap_t *th;
+    if (DYNAMO_OPTION(heap_magazine_size) == 0)
+        return NULL;
+    dcontext = get_thread_private_dcontext();
+    if (dcontext == NULL || dcontext == GLOBAL_DCONTEXT)
+        return NULL;
+    th = (thread_heap_t *) dcontext->heap_field;
+    if (th == NULL)
+        return NULL;
+    if (tu == &heapmgt->global_units)
+        return th->global_magazines;
+    if (tu == &heapmgt->global_nonpersistent_units)
+        return th->nonpersistent_magazines;
+    return NULL;
+}
+
+static inline int
+heap_magazine_bucket(size_t aligned_size)
+{
+    int bucket = 0;
+    if (aligned_size > BLOCK_SIZES[BLOCK_TYPES-2])
+        return -1; /* variable-length blocks do not go through magazines */
+    while (aligned_size > BLOCK_SIZES[bucket])
+        bucket++;
+    return bucket;
+}
+
+/* Moves up to half a magazine of free blocks from tu's free list, or failing
+ * that from the committed room in its current unit, into the empty
+ * mags->mag[bucket].  Never extends or creates units: the caller falls back to
+ * the regular path for that, which can grab the DR areas lock.
+ * Blocks carved from the unit go in first, so that they stay at the bottom.
+ */
+static void
+heap_magazine_refill(heap_magazines_t *mags, thread_units_t *tu, int bucket)
+{
+    heap_magazine_t *mag = &mags->mag[bucket];
+    size_t alloc_size = BLOCK_SIZES[bucket];
+    uint batch = MAX(mags->capacity / 2, 1);
+    uint reused = 0;
+    heap_pc p;
+    ASSERT(mag->top == NULL && mag->count == 0 && mag->fresh == 0);
+    acquire_recursive_lock(&global_alloc_lock);
+    for (p = tu->free_list[bucket]; p != NULL && reused < batch; p = *((heap_pc *)p))
+        reused++;
+    while (mag->count < batch - reused) {
+        heap_unit_t *u = tu->cur_unit;
+        if (POINTER_OVERFLOW_ON_ADD(u->cur_pc, alloc_size) ||
+            u->cur_pc + alloc_size > u->end_pc)
+            break;
+        p = u->cur_pc;
+        u->cur_pc += alloc_size;
+        ASSERT(ALIGNED(p, HEAP_ALIGNMENT));
+        *((heap_pc *)p) = mag->top;
+        mag->top = p;
+        mag->count++;
+        mag->fresh++;
+    }
+    for (; reused > 0; reused--) {
+        p = tu->free_list[bucket];
+        tu->free_list[bucket] = *((heap_pc *)p);
+        ASSERT(ALIGNED(p, HEAP_ALIGNMENT));
+        *((heap_pc *)p) = mag->top;
+        mag->top = p;
+        mag->count++;
+    }
+    release_recursive_lock(&global_alloc_lock);
+    STATS_INC(heap_magazine_refills);
+}
+
+/* Moves free blocks from mags->mag[bucket] back to tu's free list until only
+ * keep are left.
+ */
+static void
+heap_magazine_drain(heap_magazines_t *mags, thread_units_t *tu, int bucket, uint keep)
+{
+    heap_magazine_t *mag = &mags->mag[bucket];
+    if (mag->count <= keep)
+        return;
+    acquire_recursive_lock(&global_alloc_lock);
+    while (mag->count > keep) {
+        heap_pc p = mag->top;
+        mag->top = *((heap_pc *)p);
+        /* a fresh block drained unused is counted as reuse if handed out later */
+        if (mag->count <= mag->fresh)
+            mag->fresh--;
+        mag->count--;
+        *((heap_pc *)p) = tu->free_list[bucket];
+        tu->free_list[bucket] = p;
+    }
+    release_recursive_lock(&global_alloc_lock);
+    STATS_INC(heap_magazine_drains);
+}
+
+/* Allocates from the thread's magazine for size's bucket, refilling it from
+ * tu if empty.  Returns NULL if the caller should use the regular path.
+ */
+static void *
+heap_magazine_alloc(heap_magazines_t *mags, thread_units_t *tu, size_t size
+                    HEAPACCT(which_heap_t which))
+{
+    size_t aligned_size = ALIGN_FORWARD(size, HEAP_ALIGNMENT);
+    int bucket = heap_magazine_bucket(aligned_size);
+    size_t alloc_size;
+    heap_magazine_t *mag;
+    heap_pc p;
+#ifdef DEBUG_MEMORY
+    uint chklvl = CHKLVL_MEMFILL + (IF_HEAPACCT_ELSE(which == ACCT_LIBDUP ? 1 : 0, 0));
+#endif
+    if (size == 0 || bucket < 0)
+        return NULL;
+    mag = &mags->mag[bucket];
+    if (mag->top == NULL) {
+        heap_magazine_refill(mags, tu, bucket);
+        if (mag->top == NULL)
+            return NULL;
+    }
+    alloc_size = BLOCK_SIZES[bucket];
+    p = mag->top;
+    mag->top = *((heap_pc *)p);
+    if (mag->count <= mag->fresh) {
+        mag->fresh--;
+        ACCOUNT_FOR_ALLOC(alloc_new, mags, which, alloc_size, aligned_size);
+    } else
+        ACCOUNT_FOR_ALLOC(alloc_reuse, mags, which, alloc_size, aligned_size);
+    mag->count--;
+    DOSTATS({
+        heap_bucket_alloc_stats(bucket, size, aligned_size, alloc_size HEAPACCT(which));
+    });
+#ifdef DEBUG_MEMORY
+    /* same checks and fills as common_heap_alloc() */
+    DOCHECK(chklvl, {
+        CLIENT_ASSERT(is_region_memset_to_char
+                      (p+sizeof(heap_pc *), alloc_size-sizeof(heap_pc *),
+                       HEAP_UNALLOCATED_BYTE), "memory corruption detected");
+    });
+    DOCHECK(chklvl, memset(p+size, HEAP_PAD_BYTE, alloc_size-size););
+    DOCHECK(chklvl, memset(p, HEAP_ALLOCATED_BYTE, size););
+#endif
+    return (void *)p;
+}
+
+/* Frees to the thread's magazine for size's bucket, first draining half of it
+ * to tu if full.  Returns false if the caller should use the regular path.
+ */
+static bool
+heap_magazine_free(heap_magazines_t *mags, thread_units_t *tu, void *p_void, size_t size
+                   HEAPACCT(which_heap_t which))
+{
+    heap_pc p = (heap_pc) p_void;
+    size_t aligned_size = ALIGN_FORWARD(size, HEAP_ALIGNMENT);
+    int bucket = heap_magazine_bucket(aligned_size);
+    size_t alloc_size;
+    heap_magazine_t *mag;
+#ifdef DEBUG_MEMORY
+    uint chklvl = CHKLVL_MEMFILL + (IF_HEAPACCT_ELSE(which == ACCT_LIBDUP ? 1 : 0, 0));
+#endif
+    if (size == 0 || bucket < 0)
+        return false;
+    mag = &mags->mag[bucket];
+    if (mag->count >= mags->capacity)
+        heap_magazine_drain(mags, tu, bucket, mags->capacity / 2);
+    alloc_size = BLOCK_SIZES[bucket];
+#ifdef DEBUG_MEMORY
+    /* same checks and fills as common_heap_free() */
+    ASSERT_MESSAGE(chklvl, "heap overflow",
+                   is_region_memset_to_char(p+size, alloc_size-size, HEAP_PAD_BYTE));
+    DOCHECK(CHKLVL_MEMFILL, memset(p, HEAP_UNALLOCATED_BYTE, alloc_size););
+#endif
+    STATS_SUB(heap_bucket_pad, (alloc_size - aligned_size));
+    STATS_SUB(heap_align, (aligned_size - size));
+    DOSTATS({
+        ATOMIC_ADD(int, block_count[bucket], -1);
+        ATOMIC_ADD(int, block_wasted[bucket], -(int)(alloc_size - aligned_size));
+        ATOMIC_ADD(int, block_align_pad[bucket], -(int)(aligned_size - size));
+    });
+    ACCOUNT_FOR_FREE(mags, which, alloc_size);
+    *((heap_pc *)p) = mag->top;
+    mag->top = p;
+    mag->count++;
+    return true;
+}
+
 /* shared between global and global_unprotected */
 static void *
 common_global_heap_alloc(thread_units_t *tu, size_t size HEAPACCT(which_heap_t which))
 {
     void *p;
+    heap_magazines_t *mags = heap_magazines_for(tu);
+    if (mags != NULL) {
+        p = heap_magazine_alloc(mags, tu, size HEAPACCT(which));
+        if (p != NULL)
+            return p;
+    }
     acquire_recursive_lock(&global_alloc_lock);
     p = common_heap_alloc(tu, size HEAPACCT(which));
     release_recursive_lock(&global_alloc_lock);
@@ -2665,11 +3006,15 @@ static void
 common_global_heap_free(thread_units_t *tu, void *p, size_t size HEAPACCT(which_heap_t which))
 {
     bool ok;
+    heap_magazines_t *mags;
     if (p == NULL) {
         ASSERT(false && "attempt to free NULL");
         return;
     }
 
+    mags = heap_magazines_for(tu);
+    if (mags != NULL && heap_magazine_free(mags, tu, p, size HEAPACCT(which)))
+        return;
     acquire_recursive_lock(&global_alloc_lock);
     ok = common_heap_free(tu, p, size HEAPACCT(which));
     release_recursive_lock(&global_alloc_lock);
@@ -3019,26 +3364,32 @@ print_heap_statistics()
 }
 
 static void
-add_heapacct_to_global_stats(heap_acct_t *acct)
+add_heapacct_to_units(thread_units_t *tu, heap_acct_t *acct)
 {
-    /* add this thread's stats to the accurate (non-racy) global stats
-     * FIXME: this gives a nice in-one-place total, but loses the
-     * global-heap-only stats -- perhaps should add a total_units stats
-     * to capture total and leave global alone here?
-     */
     uint i;
     acquire_recursive_lock(&global_alloc_lock);
     for (i = 0; i < ACCT_LAST; i++) {
-        heapmgt->global_units.acct.alloc_reuse[i] += acct->alloc_reuse[i];
-        heapmgt->global_units.acct.alloc_new[i] += acct->alloc_new[i];
-        heapmgt->global_units.acct.cur_usage[i] += acct->cur_usage[i];
+        tu->acct.alloc_reuse[i] += acct->alloc_reuse[i];
+        tu->acct.alloc_new[i] += acct->alloc_new[i];
+        tu->acct.cur_usage[i] += acct->cur_usage[i];
         /* FIXME: these maxes are now not simultaneous max but sum-of-maxes */
-        heapmgt->global_units.acct.max_usage[i] += acct->max_usage[i];
-        heapmgt->global_units.acct.max_single[i] += acct->max_single[i];
-        heapmgt->global_units.acct.num_alloc[i] += acct->num_alloc[i];
+        tu->acct.max_usage[i] += acct->max_usage[i];
+        tu->acct.max_single[i] += acct->max_single[i];
+        tu->acct.num_alloc[i] += acct->num_alloc[i];
     }
     release_recursive_lock(&global_alloc_lock);
 }
+
+static void
+add_heapacct_to_global_stats(heap_acct_t *acct)
+{
+    /* add this thread's stats to the accurate (non-racy) global stats
+     * FIXME: this gives a nice in-one-place total, but loses the
+     * global-heap-only stats -- perhaps should add a total_units stats
+     * to capture total and leave global alone here?
+     */
+    add_heapacct_to_units(&heapmgt->global_units, acct);
+}
 #endif
 
 /* dcontext only used for debugging */
@@ -3142,6 +3493,28 @@ threadunits_exit(thread_units_t *tu, dcontext_t *dcontext)
 #endif  /* defined(DEBUG) && defined(HEAP_ACCOUNTING) */
 }
 
+static void
+heap_magazines_init(heap_magazines_t *mags, uint capacity)
+{
+    memset(mags, 0, sizeof(*mags));
+    mags->capacity = capacity;
+}
+
+/* Returns all of mags' blocks to tu and adds its accounting to tu's, where
+ * the frees or allocs of blocks that crossed between mags and tu balance out.
+ */
+static void
+heap_magazines_exit(heap_magazines_t *mags, thread_units_t *tu)
+{
+    int i;
+    for (i = 0; i < BLOCK_TYPES-1; i++)
+        heap_magazine_drain(mags, tu, i, 0);
+#ifdef HEAP_ACCOUNTING
+    add_heapacct_to_units(tu, &mags->acct);
+    memset(&mags->acct, 0, sizeof(mags->acct));
+#endif
+}
+
 void
 heap_thread_reset_init(dcontext_t *dcontext)
 {
@@ -3157,6 +3530,10 @@ heap_thread_init(dcontext_t *dcontext)
 {
     thread_heap_t *th = (thread_heap_t *)
         global_heap_alloc(sizeof(thread_heap_t) HEAPACCT(ACCT_MEM_MGT));
+    /* the global heap looks these up through heap_field */
+    th->global_magazines = NULL;
+    th->nonpersistent_magazines = NULL;
+    th->ir_arena = NULL;
     dcontext->heap_field = (void *) th;
     th->local_heap = (thread_units_t *) global_heap_alloc(sizeof(thread_units_t)
                                                        HEAPACCT(ACCT_MEM_MGT));
@@ -3167,12 +3544,31 @@ heap_thread_init(dcontext_t *dcontext)
     } else
         th->nonpersistent_heap = NULL;
     heap_thread_reset_init(dcontext);
+    if (DYNAMO_OPTION(heap_magazine_size) > 0) {
+        heap_magazines_t *mags = (heap_magazines_t *)
+            global_unprotected_heap_alloc(sizeof(heap_magazines_t)
+                                          HEAPACCT(ACCT_MEM_MGT));
+        heap_magazines_init(mags, DYNAMO_OPTION(heap_magazine_size));
+        th->global_magazines = mags;
+        if (SEPARATE_NONPERSISTENT_HEAP()) {
+            mags = (heap_magazines_t *)
+                global_unprotected_heap_alloc(sizeof(heap_magazines_t)
+                                              HEAPACCT(ACCT_MEM_MGT));
+            heap_magazines_init(mags, DYNAMO_OPTION(heap_magazine_size));
+            th->nonpersistent_magazines = mags;
+        }
+    }
 }
 
 void
 heap_thread_reset_free(dcontext_t *dcontext)
 {
     thread_heap_t *th = (thread_heap_t *) dcontext->heap_field;
+    /* the global non-persistent units are about to be thrown out */
+    if (th->nonpersistent_magazines != NULL) {
+        heap_magazines_exit(th->nonpersistent_magazines,
+                            &heapmgt->global_nonpersistent_units);
+    }
     if (SEPARATE_NONPERSISTENT_HEAP()) {
         ASSERT(th->nonpersistent_heap != NULL);
         /* FIXME: free directly rather than sending to dead list for
@@ -3188,14 +3584,40 @@ void
 heap_thread_exit(dcontext_t *dcontext)
 {
     thread_heap_t *th = (thread_heap_t *) dcontext->heap_field;
+    if (th->ir_arena != NULL) {
+        ir_arena_t *arena = th->ir_arena;
+        if (arena->depth > 0) { /* exiting in the middle of a build */
+            arena->depth = 1;
+            heap_ir_arena_exit(dcontext);
+        }
+        if (arena->base != NULL)
+            heap_free(dcontext, arena->base, arena->base->size HEAPACCT(ACCT_IR));
+        th->ir_arena = NULL;
+        HEAP_TYPE_FREE(dcontext, arena, ir_arena_t, ACCT_MEM_MGT, PROTECTED);
+    }
     threadunits_exit(th->local_heap, dcontext);
     heap_thread_reset_free(dcontext);
+    if (th->global_magazines != NULL) {
+        heap_magazines_t *mags = th->global_magazines;
+        th->global_magazines = NULL;
+        heap_magazines_exit(mags, &heapmgt->global_units);
+        global_unprotected_heap_free(mags, sizeof(*mags) HEAPACCT(ACCT_MEM_MGT));
+    }
+    if (th->nonpersistent_magazines != NULL) {
+        heap_magazines_t *mags = th->nonpersistent_magazines;
+        th->nonpersistent_magazines = NULL;
+        global_unprotected_heap_free(mags, sizeof(*mags) HEAPACCT(ACCT_MEM_MGT));
+    }
     global_heap_free(th->local_heap, sizeof(thread_units_t) HEAPACCT(ACCT_MEM_MGT));
     if (SEPARATE_NONPERSISTENT_HEAP()) {
         ASSERT(th->nonpersistent_heap != NULL);
         global_heap_free(th->nonpersistent_heap, sizeof(thread_units_t)
                          HEAPACCT(ACCT_MEM_MGT));
     }
+    /* The rest of thread teardown still frees global heap memory, which must
+     * not find our magazines through heap_field.
+     */
+    dcontext->heap_field = NULL;
     global_heap_free(th, sizeof(thread_heap_t) HEAPACCT(ACCT_MEM_MGT));
 }
 
@@ -3511,40 +3933,9 @@ common_heap_alloc(thread_units_t *tu, size_t size HEAPACCT(which_heap_t which))
 
         ACCOUNT_FOR_ALLOC(alloc_new, tu, which, alloc_size, aligned_size);
     }
+    /* do this before done_allocating: want to ignore special-unit allocs */
     DOSTATS({
-        /* do this before done_allocating: want to ignore special-unit allocs */
-        ATOMIC_ADD(int, block_count[bucket], 1);
-        ATOMIC_ADD(int, block_total_count[bucket], 1);
-        /* FIXME: should atomically store inc-ed val in temp to avoid races w/ max */
-        ATOMIC_MAX(int, block_peak_count[bucket], block_count[bucket]);
-        ASSERT(CHECK_TRUNCATE_TYPE_uint(alloc_size - aligned_size));
-        ATOMIC_ADD(int, block_wasted[bucket], (int) (alloc_size - aligned_size));
-        /* FIXME: should atomically store val in temp to avoid races w/ max */
-        ATOMIC_MAX(int, block_peak_wasted[bucket], block_wasted[bucket]);
-        if (aligned_size > size) {
-            ASSERT(CHECK_TRUNCATE_TYPE_uint(aligned_size - size));
-            ATOMIC_ADD(int, block_align_pad[bucket], (int) (aligned_size - size));
-            /* FIXME: should atomically store val in temp to avoid races w/ max */
-            ATOMIC_MAX(int, block_peak_align_pad[bucket], block_align_pad[bucket]);
-            STATS_ADD_PEAK(heap_align, aligned_size - size);
-            LOG(GLOBAL, LOG_STATS, 5,
-                "alignment mismatch: %s ask %d, aligned is %d -> %d pad\n",
-                IF_HEAPACCT_ELSE(whichheap_name[which], ""),
-                size, aligned_size, aligned_size-size);
-        }
-        if (bucket == BLOCK_TYPES-1) {
-            STATS_ADD(heap_headers, HEADER_SIZE);
-            STATS_INC(heap_allocs_variable);
-        } else {
-            STATS_INC(heap_allocs_buckets);
-            if (alloc_size > aligned_size) {
-                STATS_ADD_PEAK(heap_bucket_pad, alloc_size - aligned_size);
-                LOG(GLOBAL, LOG_STATS, 5,
-                    "bucket mismatch: %s ask (aligned) %d, got %d, -> %d\n",
-                    IF_HEAPACCT_ELSE(whichheap_name[which], ""),
-                    aligned_size, alloc_size, alloc_size-aligned_size);
-            }
-        }
+        heap_bucket_alloc_stats(bucket, size, aligned_size, alloc_size HEAPACCT(which));
     });
  done_allocating:
 #ifdef DEBUG_MEMORY
@@ -3771,6 +4162,126 @@ heap_free(dcontext_t *dcontext, void *p, size_t size HEAPACCT(which_heap_t which
     ASSERT(ok);
 }
 
+/* Points the arena at fresh space of at least size bytes in a new chunk */
+static ir_arena_chunk_t *
+ir_arena_new_chunk(dcontext_t *dcontext, ir_arena_t *arena, size_t size)
+{
+    ir_arena_chunk_t *chunk;
+    size = MAX(DYNAMO_OPTION(bb_ir_arena), sizeof(*chunk) + size);
+    chunk = (ir_arena_chunk_t *) heap_alloc(dcontext, size HEAPACCT(ACCT_IR));
+    chunk->next = NULL;
+    chunk->size = size;
+    arena->cur = (byte *) (chunk + 1);
+    arena->end = (byte *) chunk + size;
+    return chunk;
+}
+
+void
+heap_ir_arena_enter(dcontext_t *dcontext)
+{
+    thread_heap_t *th;
+    ASSERT(dcontext != GLOBAL_DCONTEXT);
+    th = (thread_heap_t *) dcontext->heap_field;
+    if (th->ir_arena == NULL) {
+        th->ir_arena = HEAP_TYPE_ALLOC(dcontext, ir_arena_t, ACCT_MEM_MGT, PROTECTED);
+        memset(th->ir_arena, 0, sizeof(*th->ir_arena));
+    }
+    th->ir_arena->depth++;
+}
+
+void
+heap_ir_arena_exit(dcontext_t *dcontext)
+{
+    ir_arena_t *arena = ((thread_heap_t *) dcontext->heap_field)->ir_arena;
+    ASSERT(arena != NULL && arena->depth > 0);
+    arena->depth--;
+    if (arena->depth > 0)
+        return;
+    while (arena->overflow != NULL) {
+        ir_arena_chunk_t *next = arena->overflow->next;
+        heap_free(dcontext, arena->overflow, arena->overflow->size HEAPACCT(ACCT_IR));
+        arena->overflow = next;
+    }
+    if (arena->base != NULL) {
+        arena->cur = (byte *) (arena->base + 1);
+        arena->end = (byte *) arena->base + arena->base->size;
+#ifdef DEBUG_MEMORY
+        /* catch IR used past the end of the build */
+        memset(arena->cur, HEAP_UNALLOCATED_BYTE, arena->end - arena->cur);
+#endif
+    }
+}
+
+/* Returns dcontext's arena if it is in use.  Only the owning thread touches an
+ * arena: IR allocated with another thread's dcontext, such as when translating
+ * its state, comes from the heap.
+ */
+static inline ir_arena_t *
+ir_arena_active(dcontext_t *dcontext)
+{
+    ir_arena_t *arena;
+    if (dcontext == NULL || dcontext->heap_field == NULL)
+        return NULL;
+    arena = ((thread_heap_t *) dcontext->heap_field)->ir_arena;
+    if (arena == NULL || arena->depth == 0)
+        return NULL;
+    return arena;
+}
+
+/* Checks the current thread's arena whatever dcontext IR is freed with, as IR
+ * built into a bb is sometimes freed with GLOBAL_DCONTEXT.
+ */
+static bool
+ir_arena_contains(void *p)
+{
+    ir_arena_t *arena = ir_arena_active(get_thread_private_dcontext());
+    ir_arena_chunk_t *chunk;
+    if (arena == NULL)
+        return false;
+    for (chunk = arena->overflow; chunk != NULL; chunk = chunk->next) {
+        if ((byte *) p > (byte *) chunk && (byte *) p < (byte *) chunk + chunk->size)
+            return true;
+    }
+    chunk = arena->base;
+    return (chunk != NULL &&
+            (byte *) p > (byte *) chunk && (byte *) p < (byte *) chunk + chunk->size);
+}
+
+void *
+heap_ir_alloc(dcontext_t *dcontext, size_t size)
+{
+    ir_arena_t *arena;
+    byte *p;
+    /* check the option first to keep the TLS lookup off the common path */
+    if (DYNAMO_OPTION(bb_ir_arena) == 0 || dcontext == GLOBAL_DCONTEXT ||
+        dcontext != get_thread_private_dcontext() ||
+        (arena = ir_arena_active(dcontext)) == NULL)
+        return heap_alloc(dcontext, size HEAPACCT(ACCT_IR));
+    size = ALIGN_FORWARD(size, HEAP_ALIGNMENT);
+    if (arena->base == NULL)
+        arena->base = ir_arena_new_chunk(dcontext, arena, size);
+    else if ((size_t) (arena->end - arena->cur) < size) {
+        ir_arena_chunk_t *chunk = ir_arena_new_chunk(dcontext, arena, size);
+        chunk->next = arena->overflow;
+        arena->overflow = chunk;
+        STATS_INC(bb_ir_arena_chunks);
+    }
+    p = arena->cur;
+    arena->cur += size;
+    STATS_INC(bb_ir_arena_allocs);
+    return p;
+}
+
+void
+heap_ir_free(dcontext_t *dcontext, void *p, size_t size)
+{
+    if (DYNAMO_OPTION(bb_ir_arena) > 0 && ir_arena_contains(p)) {
+        STATS_INC(bb_ir_arena_frees);
+        return;
+    }
+    heap_free(dcontext, p, size HEAPACCT(ACCT_IR));
+}
+
 bool local_heap_protected(dcontext_t *dcontext)
 {
     thread_heap_t *th = (thread_heap_t *) dcontext->heap_field;
@@ -4998,3 +5509,115 @@ release_landing_pad_mem(void)
 }
 #endif  /* WINDOWS */
 /*----------------------------------------------------------------------------*/
+
+#ifdef STANDALONE_UNIT_TEST
+# ifdef UNIX
+#  include <pthread.h>
+# endif
+
+/* Global heap alloc/free throughput with 1 to MAX_BENCH_THREADS threads
+ * allocating and freeing a mix of bucket sizes, through global_alloc_lock
+ * only vs through per-thread magazines, along with how often
+ * global_alloc_lock was contended.
+ */
+# define MAX_BENCH_THREADS 8
+# define BENCH_BATCH 64
+# define BENCH_ROUNDS 2000
+# define BENCH_MAGAZINE_SIZE 64
+static volatile bool bench_use_magazines;
+
+static size_t
+bench_size(int i)
+{
+    static const size_t sizes[] = { 8, 24, 48, 64, 100, 256 };
+    return sizes[i % (sizeof(sizes)/sizeof(sizes[0]))];
+}
+
+static IF_UNIX_ELSE(void *, DWORD WINAPI)
+bench_thread(void *arg)
+{
+    heap_magazines_t mags;
+    heap_magazines_t *m = bench_use_magazines ? &mags : NULL;
+    void *blocks[BENCH_BATCH];
+    int round, i;
+    IF_UNIX(unit_test_thread_init());
+    heap_magazines_init(&mags, BENCH_MAGAZINE_SIZE);
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        for (i = 0; i < BENCH_BATCH; i++) {
+            blocks[i] = NULL;
+            if (m != NULL) {
+                blocks[i] = heap_magazine_alloc(m, &heapmgt->global_units,
+                                                bench_size(i) HEAPACCT(ACCT_OTHER));
+            }
+            if (blocks[i] == NULL) {
+                blocks[i] = common_global_heap_alloc(&heapmgt->global_units,
+                                                     bench_size(i) HEAPACCT(ACCT_OTHER));
+            }
+            EXPECT(blocks[i] != NULL, true);
+            *(int *)blocks[i] = i;
+        }
+        for (i = 0; i < BENCH_BATCH; i++) {
+            EXPECT(*(int *)blocks[i], i);
+            if (m == NULL ||
+                !heap_magazine_free(m, &heapmgt->global_units, blocks[i], bench_size(i)
+                                    HEAPACCT(ACCT_OTHER))) {
+                common_global_heap_free(&heapmgt->global_units, blocks[i], bench_size(i)
+                                        HEAPACCT(ACCT_OTHER));
+            }
+        }
+    }
+    heap_magazines_exit(&mags, &heapmgt->global_units);
+    IF_UNIX(unit_test_thread_exit());
+    return 0;
+}
+
+static void
+heap_magazine_bench(bool use_magazines, int num_threads)
+{
+    int i;
+    uint64 start_ms, end_ms;
+# ifdef DEADLOCK_AVOIDANCE
+    uint contended = global_alloc_lock.lock.count_times_contended;
+# endif
+# ifdef UNIX
+    dcontext_t *dcontext;
+    pthread_t threads[MAX_BENCH_THREADS];
+# else
+    HANDLE threads[MAX_BENCH_THREADS];
+# endif
+    bench_use_magazines = use_magazines;
+    start_ms = query_time_millis();
+# ifdef UNIX
+    dcontext = unit_test_thread_create_pre();
+    for (i = 0; i < num_threads; i++)
+        pthread_create(&threads[i], NULL, bench_thread, NULL);
+    unit_test_thread_create_post(dcontext);
+    for (i = 0; i < num_threads; i++)
+        pthread_join(threads[i], NULL);
+# else /* WINDOWS */
+    for (i = 0; i < num_threads; i++)
+        threads[i] = CreateThread(NULL, 0, bench_thread, NULL, 0, NULL);
+    WaitForMultipleObjects(num_threads, threads, TRUE, INFINITE);
+# endif /* UNIX/WINDOWS */
+    end_ms = query_time_millis();
+    print_file(STDERR, "%s, %d threads: "UINT64_FORMAT_STRING" alloc+free/sec\n",
+               use_magazines ? "magazines" : "global lock", num_threads,
+               (uint64)num_threads * BENCH_ROUNDS * BENCH_BATCH * 1000 /
+               (end_ms > start_ms ? end_ms - start_ms : 1));
+# ifdef DEADLOCK_AVOIDANCE
+    print_file(STDERR, "\tglobal_alloc_lock contended %d times\n",
+               global_alloc_lock.lock.count_times_contended - contended);
+# endif
+}
+
+void
+unit_test_heap(void)
+{
+    int num_threads;
+    print_file(STDERR, "\nglobal heap magazine tests\n");
+    for (num_threads = 1; num_threads <= MAX_BENCH_THREADS; num_threads *= 2) {
+        heap_magazine_bench(false, num_threads);
+        heap_magazine_bench(true, num_threads);
+    }
+}
+#endif /* STANDALONE_UNIT_TEST */
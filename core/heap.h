@@ -73,6 +73,7 @@ typedef enum {
 # endif
     ACCT_LIBDUP, /* private copies of system libs => may leak */
     ACCT_CLEANCALL,
+    ACCT_XL8_TABLE, /* -compact_translations tables */
     /* NOTE: Also update the whichheap_name in heap.c when adding here */
     ACCT_OTHER,
     ACCT_LAST
@@ -152,6 +153,14 @@ void *heap_mmap_reserve(size_t reserve_size, size_t commit_size);
 void *heap_mmap_ex(size_t reserve_size, size_t commit_size, uint prot, bool guarded);
 void heap_munmap_ex(void *p, size_t size, bool guarded);
 
+/* Transparent huge page size used for -cache_huge_pages. */
+#define HUGE_PAGE_SIZE (2*1024*1024)
+
+/* Allocates committed, unguarded, huge-page-aligned executable memory.
+ * Free with heap_munmap_ex(p, size, false).
+ */
+void *heap_mmap_huge(size_t size);
+
 /* updates dynamo_areas and calls the os_ versions */
 byte *
 map_file(file_t f, size_t *size INOUT, uint64 offs, app_pc addr, uint prot,
@@ -192,6 +201,17 @@ bool is_stack_overflow(dcontext_t *dcontext, byte *sp);
 void *heap_alloc(dcontext_t *dcontext, size_t size HEAPACCT(which_heap_t which));
 void heap_free(dcontext_t *dcontext, void *p, size_t size HEAPACCT(which_heap_t which));
 
+/* For instr_t, operand and raw byte storage.  Between heap_ir_arena_enter() and
+ * the matching heap_ir_arena_exit() on dcontext (-bb_ir_arena), heap_ir_alloc()
+ * carves from a per-thread arena, heap_ir_free() of arena memory does nothing,
+ * and the outermost exit reclaims it all at once.  Otherwise these are
+ * heap_alloc() and heap_free().
+ */
+void heap_ir_arena_enter(dcontext_t *dcontext);
+void heap_ir_arena_exit(dcontext_t *dcontext);
+void *heap_ir_alloc(dcontext_t *dcontext, size_t size);
+void heap_ir_free(dcontext_t *dcontext, void *p, size_t size);
+
 #ifdef HEAP_ACCOUNTING
 void print_heap_statistics(void);
 #endif
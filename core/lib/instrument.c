@@ -218,6 +218,9 @@ static callback_list_t post_syscall_callbacks = {0,};
 static callback_list_t exception_callbacks = {0,};
 #else
 static callback_list_t signal_callbacks = {0,};
+static callback_list_t filter_inline_syscall_callbacks = {0,};
+static callback_list_t pre_inline_syscall_callbacks = {0,};
+static callback_list_t post_inline_syscall_callbacks = {0,};
 #endif
 #ifdef PROGRAM_SHEPHERDING
 static callback_list_t security_violation_callbacks = {0,};
@@ -256,6 +259,8 @@ typedef struct _client_lib_t {
      * single global list.
      */
     callback_list_t nudge_callbacks;
+    /* set by dr_keep_bb_ir() */
+    bool keep_bb_ir;
 } client_lib_t;
 
 /* these should only be modified prior to instrument_init(), since no
@@ -753,6 +758,9 @@ void free_all_callback_lists()
     free_callback_list(&exception_callbacks);
 #else
     free_callback_list(&signal_callbacks);
+    free_callback_list(&filter_inline_syscall_callbacks);
+    free_callback_list(&pre_inline_syscall_callbacks);
+    free_callback_list(&post_inline_syscall_callbacks);
 #endif
 #ifdef PROGRAM_SHEPHERDING
     free_callback_list(&security_violation_callbacks);
@@ -900,6 +908,30 @@ dr_unregister_bb_event(dr_emit_flags_t (*func)
     return remove_callback(&bb_callbacks, (void (*)(void))func, true);
 }
 
+DR_API
+void
+dr_keep_bb_ir(client_id_t id)
+{
+    size_t i;
+    /* client_libs is only written before other threads can read it */
+    CLIENT_ASSERT(!dynamo_initialized, "dr_keep_bb_ir must be called at init time");
+    for (i = 0; i < num_client_libs; i++) {
+        if (client_libs[i].id == id)
+            client_libs[i].keep_bb_ir = true;
+    }
+}
+
+bool
+instrument_keeps_bb_ir(void)
+{
+    size_t i;
+    for (i = 0; i < num_client_libs; i++) {
+        if (client_libs[i].keep_bb_ir)
+            return true;
+    }
+    return false;
+}
+
 void
 dr_register_trace_event(dr_emit_flags_t (*func)
                         (void *drcontext, void *tag, instrlist_t *trace,
@@ -1129,6 +1161,49 @@ dr_unregister_post_syscall_event(void (*func)(void *drcontext, int sysnum))
     return remove_callback(&post_syscall_callbacks, (void (*)(void))func, true);
 }
 
+#ifdef UNIX
+void
+dr_register_filter_inline_syscall_event(bool (*func)(void *drcontext, int sysnum))
+{
+    add_callback(&filter_inline_syscall_callbacks, (void (*)(void))func, true);
+}
+
+bool
+dr_unregister_filter_inline_syscall_event(bool (*func)(void *drcontext, int sysnum))
+{
+    return remove_callback(&filter_inline_syscall_callbacks, (void (*)(void))func,
+                           true);
+}
+
+void
+dr_register_pre_inline_syscall_event(void (*func)(void *drcontext, int sysnum,
+                                                  reg_t *params))
+{
+    add_callback(&pre_inline_syscall_callbacks, (void (*)(void))func, true);
+}
+
+bool
+dr_unregister_pre_inline_syscall_event(void (*func)(void *drcontext, int sysnum,
+                                                    reg_t *params))
+{
+    return remove_callback(&pre_inline_syscall_callbacks, (void (*)(void))func, true);
+}
+
+void
+dr_register_post_inline_syscall_event(void (*func)(void *drcontext, int sysnum,
+                                                   reg_t result))
+{
+    add_callback(&post_inline_syscall_callbacks, (void (*)(void))func, true);
+}
+
+bool
+dr_unregister_post_inline_syscall_event(void (*func)(void *drcontext, int sysnum,
+                                                     reg_t result))
+{
+    return remove_callback(&post_inline_syscall_callbacks, (void (*)(void))func, true);
+}
+#endif /* UNIX */
+
 #ifdef PROGRAM_SHEPHERDING
 void
 dr_register_security_event(void (*func)(void *drcontext, void *source_tag,
@@ -2037,6 +2112,41 @@ instrument_invoke_another_syscall(dcontext_t *dcontext)
     return dcontext->client_data->invoke_another_syscall;
 }
 
+#ifdef UNIX
+/* returns whether this sysnum should have inline hooks around its syscall sites */
+bool
+instrument_filter_inline_syscall(dcontext_t *dcontext, int sysnum)
+{
+    bool ret = false;
+    if (filter_inline_syscall_callbacks.num == 0)
+        return ret;
+    call_all_ret(ret, =, || ret, filter_inline_syscall_callbacks,
+                 bool (*)(void *, int), (void *)dcontext, sysnum);
+    return ret;
+}
+
+/* Called from a clean call in the code cache: there is no dispatch transition
+ * and the in_{pre,post}_syscall state used by the regular events is not set.
+ */
+void
+instrument_pre_inline_syscall(dcontext_t *dcontext, int sysnum, reg_t *params)
+{
+    if (pre_inline_syscall_callbacks.num == 0)
+        return;
+    call_all(pre_inline_syscall_callbacks, int (*)(void *, int, reg_t *),
+             (void *)dcontext, sysnum, params);
+}
+
+void
+instrument_post_inline_syscall(dcontext_t *dcontext, int sysnum, reg_t result)
+{
+    if (post_inline_syscall_callbacks.num == 0)
+        return;
+    call_all(post_inline_syscall_callbacks, int (*)(void *, int, reg_t),
+             (void *)dcontext, sysnum, result);
+}
+#endif /* UNIX */
+
 #ifdef WINDOWS
 /* Notify user of exceptions.  Note: not called for RaiseException */
 bool
@@ -5188,6 +5298,14 @@ dr_insert_clean_call_ex_varg(void *drcontext, instrlist_t *ilist, instr_t *where
         STATS_INC(cleancall_inlined);
         LOG(THREAD, LOG_CLEANCALL, 2, "CLEANCALL: inlined callee "PFX"\n", callee);
         insert_inline_clean_call(dcontext, &cci, ilist, where, args);
+        if (cci.slow_path != NULL) {
+            /* Only the callee's fast path was inlined: its rare path ends up
+             * here and needs the full clean call.
+             */
+            dr_insert_clean_call_ex_varg(drcontext, ilist, cci.slow_path, callee,
+                                         save_flags | DR_CLEANCALL_ALWAYS_OUT_OF_LINE,
+                                         num_args, args);
+        }
         return;
 #else /* CLIENT_INTERFACE */
         ASSERT_NOT_REACHED();
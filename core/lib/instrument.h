@@ -78,6 +78,8 @@ void instrument_thread_exit(dcontext_t *dcontext);
 # ifdef UNIX
 void instrument_fork_init(dcontext_t *dcontext);
 # endif
+/* returns whether a client keeps bb IR beyond the bb event (dr_keep_bb_ir()) */
+bool instrument_keeps_bb_ir(void);
 bool instrument_basic_block(dcontext_t *dcontext, app_pc tag, instrlist_t *bb,
                             bool for_trace, bool translating,
                             dr_emit_flags_t *emitflags);
@@ -102,6 +104,12 @@ bool instrument_filter_syscall(dcontext_t *dcontext, int sysnum);
 bool instrument_pre_syscall(dcontext_t *dcontext, int sysnum);
 void instrument_post_syscall(dcontext_t *dcontext, int sysnum);
 bool instrument_invoke_another_syscall(dcontext_t *dcontext);
+# ifdef UNIX
+/* returns whether this sysnum should have inline hooks around its syscall sites */
+bool instrument_filter_inline_syscall(dcontext_t *dcontext, int sysnum);
+void instrument_pre_inline_syscall(dcontext_t *dcontext, int sysnum, reg_t *params);
+void instrument_post_inline_syscall(dcontext_t *dcontext, int sysnum, reg_t result);
+# endif
 
 void instrument_nudge(dcontext_t *dcontext, client_id_t id, uint64 arg);
 # ifdef WINDOWS
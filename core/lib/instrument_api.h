@@ -345,6 +345,12 @@ DR_API
  * case, clients should be prepared to see duplicate tags without an
  * intermediate deletion.
  *
+ * \note If the -bb_build_claims runtime option is specified, this event
+ * can be called concurrently by different threads for different tags,
+ * including tags in the same module.  Only calls for the same tag are
+ * serialized, so a client that updates shared or per-module state from
+ * this event must synchronize that state itself.
+ *
  * \note A client can change the control flow of the application by
  * changing the control transfer instruction at end of the basic block.
  * If a basic block is ended with a non-control transfer instruction,
@@ -381,6 +387,21 @@ dr_unregister_bb_event(dr_emit_flags_t (*func)
                        (void *drcontext, void *tag, instrlist_t *bb,
                         bool for_trace, bool translating));
 
+DR_API
+/**
+ * When the \p -bb_ir_arena runtime option is enabled, the instrlist_t passed
+ * to the basic block event when a block is built for the code cache, and
+ * every instr_t and instrlist_t created with that \p drcontext during the
+ * event, live in a per-thread arena that is reclaimed as a whole once the
+ * block is emitted.  A client that keeps any of them beyond the event, or
+ * frees them later, must call this routine from dr_client_main() to have them
+ * allocated individually on the heap.  This affects every client, as they
+ * share the same IR.  Instrumentation of traces and state translation are
+ * not affected.
+ */
+void
+dr_keep_bb_ir(client_id_t id);
+
 DR_API
 /**
  * Registers a callback function for the trace event.  DR calls \p func
@@ -1124,6 +1145,114 @@ DR_API
 bool
 dr_unregister_post_syscall_event(void (*func)(void *drcontext, int sysnum));
 
+/* DR_API EXPORT BEGIN */
+#ifdef UNIX
+/**
+ * The number of system call parameters passed to an inline pre-syscall
+ * event callback (dr_register_pre_inline_syscall_event()).
+ */
+# define DR_INLINE_SYSCALL_NUM_PARAMS 6
+/* DR_API EXPORT END */
+
+DR_API
+/**
+ * Registers a callback function for the inline syscall filter event.
+ * DR calls \p func at each system call site with a
+ * statically-determinable system call number that no client asked to
+ * intercept via the regular filter event
+ * (dr_register_filter_syscall_event()).  If \p func returns true, the
+ * inline pre-syscall (dr_register_pre_inline_syscall_event()) and
+ * post-syscall (dr_register_post_inline_syscall_event()) events are
+ * invoked around that system call site.
+ *
+ * Unlike the regular syscall events, the inline events are clean calls
+ * inserted around the system call in the code cache, so they cost no
+ * context switch back to DR.  They are limited to observing the system
+ * call: they cannot skip it, change its parameters or its result, or
+ * invoke another system call.  A client that needs those capabilities
+ * for some system call number should return true for it from its
+ * regular filter event instead, which takes precedence.
+ *
+ * If DR cannot execute the system call inline (because DR itself needs
+ * to intercept it, or because of the system call gateway in use), the
+ * regular pre-syscall and post-syscall events are invoked for it
+ * instead, just as though the regular filter event had returned true.
+ *
+ * The filter is consulted when a block containing the system call is
+ * built, so it should be registered at initialization time and its
+ * answer should not change for a given \p sysnum.  On MacOS, \p sysnum
+ * is the same number passed to the regular filter event.
+ */
+void
+dr_register_filter_inline_syscall_event(bool (*func)(void *drcontext, int sysnum));
+
+DR_API
+/**
+ * Unregister a callback function for the inline syscall filter event.
+ * \return true if unregistration is successful and false if it is not
+ * (e.g., \p func was not registered).
+ */
+bool
+dr_unregister_filter_inline_syscall_event(bool (*func)(void *drcontext, int sysnum));
+
+DR_API
+/**
+ * Registers a callback function for the inline pre-syscall event.  DR
+ * calls \p func from the code cache just before the application invokes
+ * a system call selected by the inline filter event
+ * (dr_register_filter_inline_syscall_event()).  \p params holds the
+ * first #DR_INLINE_SYSCALL_NUM_PARAMS system call parameters; entries
+ * beyond the number of parameters the system call takes are undefined.
+ *
+ * The callback runs as a clean call and is subject to the same
+ * restrictions (see dr_insert_clean_call()).  The application's machine
+ * state can be read with dr_get_mcontext() but the regular syscall
+ * routines such as dr_syscall_get_param() are not available.
+ */
+void
+dr_register_pre_inline_syscall_event(void (*func)(void *drcontext, int sysnum,
+                                                  reg_t *params));
+
+DR_API
+/**
+ * Unregister a callback function for the inline pre-syscall event.
+ * \return true if unregistration is successful and false if it is not
+ * (e.g., \p func was not registered).
+ */
+bool
+dr_unregister_pre_inline_syscall_event(void (*func)(void *drcontext, int sysnum,
+                                                    reg_t *params));
+
+DR_API
+/**
+ * Registers a callback function for the inline post-syscall event.  DR
+ * calls \p func from the code cache just after the application finished
+ * invoking a system call selected by the inline filter event
+ * (dr_register_filter_inline_syscall_event()).  \p result holds the
+ * raw value returned by the kernel.
+ *
+ * The same restrictions as for the inline pre-syscall event apply
+ * (dr_register_pre_inline_syscall_event()).  As with the regular
+ * post-syscall event, system calls that do not return to their call
+ * site have no post-syscall event.
+ */
+void
+dr_register_post_inline_syscall_event(void (*func)(void *drcontext, int sysnum,
+                                                   reg_t result));
+
+DR_API
+/**
+ * Unregister a callback function for the inline post-syscall event.
+ * \return true if unregistration is successful and false if it is not
+ * (e.g., \p func was not registered).
+ */
+bool
+dr_unregister_post_inline_syscall_event(void (*func)(void *drcontext, int sysnum,
+                                                     reg_t result));
+/* DR_API EXPORT BEGIN */
+#endif /* UNIX */
+/* DR_API EXPORT END */
+
 
 /* DR_API EXPORT BEGIN */
 
@@ -1506,6 +1635,8 @@ DR_API
  * \warning This context cannot be used as the drcontext for a thread
  * running under DR control!  It is only for standalone programs that
  * wish to use DR as a library of disassembly, etc. routines.
+ * It is safe to call this routine more than once: subsequent calls return
+ * the same context.
  * \return NULL on failure, such as running on an unsupported operating
  * system version.
  */
@@ -1611,6 +1742,28 @@ DR_API
 bool
 dr_get_integer_option(const char *option_name, uint64 *val OUT);
 
+DR_API
+/**
+ * Read the current process-wide value of the DynamoRIO statistic named \p
+ * stat_name into \p val.  Statistics are named by their internal identifiers
+ * (e.g., "num_bbs"), which are the names printed with their values in the
+ * global log file.  Only a few statistics are kept in release builds: most are
+ * only kept in debug builds.  None are kept under the -no_global_rstats
+ * runtime option in release builds or the -no_global_stats runtime option in
+ * debug builds.  Other threads may update a statistic while it is being read.
+ *
+ * This routine is meant for tests and diagnostics, such as checking that an
+ * option whose only effect is on performance took effect.  Like the
+ * undocumented options, statistics are not officially supported and may be
+ * renamed or removed in any release.
+ * \warning Always pass a full int64 for \p val.
+ * \return false if no statistic named \p stat_name is kept in this build or
+ * statistics are disabled, in which case \p val is set to 0, and true
+ * otherwise.
+ */
+bool
+dr_get_statistic(const char *stat_name, int64 *val OUT);
+
 DR_API
 /**
  * Returns the client library name and path that were originally specified
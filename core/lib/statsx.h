@@ -97,6 +97,8 @@
     RSTATS_DEF("Total signals delivered", num_signals)
     RSTATS_DEF("Signals dropped", num_signals_dropped)
     RSTATS_DEF("Signals in coarse units delayed", num_signals_coarse_delayed)
+    STATS_DEF("Signals delivered via fast path", num_signals_fast)
+    STATS_DEF("Fast signals delayed after all", num_fast_signals_delayed)
 #endif
     STATS_DEF("Exceptions in decoding app memory", num_exceptions_decode)
     RSTATS_DEF("System calls, pre", pre_syscall)
@@ -237,6 +239,8 @@
     STATS_DEF("Cache consistency flushes", num_flushes)
     STATS_DEF("Cache consistency flushes that flushed nothing", num_empty_flushes)
     STATS_DEF("Cache consistency flushes via synchall", flush_synchall)
+    STATS_DEF("Cache consistency flushes via epochs", flush_epoch_flushes)
+    STATS_DEF("Epoch flush private unlinks deferred to thread", flush_epoch_deferred)
     STATS_DEF("Thread not translated in synchall flush (race)", flush_synchall_races)
     STATS_DEF("Thread not synched with in synchall flush", flush_synchall_fail)
     STATS_DEF("Cache consistency coarse units flushed", flush_coarse_units)
@@ -387,6 +391,15 @@
     STATS_DEF("Fragments generated, bb and trace", num_fragments)
     RSTATS_DEF("Basic block fragments generated", num_bbs)
     RSTATS_DEF("Trace fragments generated", num_traces)
+#ifdef UNIX
+    RSTATS_DEF("Fragments inherited across fork", num_fragments_inherited)
+    RSTATS_DEF("Fork child initialization time (us)", fork_init_micros)
+    RSTATS_DEF("Fcache units inherited across fork", fcache_units_inherited)
+#endif
+    STATS_DEF("Shared bbs built without bb_building_lock", bb_build_unlocked)
+    STATS_DEF("Bb builds that waited for another thread's claim", bb_build_claim_waits)
+    STATS_DEF("Bb builds whose claim slot held another tag", bb_build_claim_collisions)
+    STATS_DEF("Bb builds discarded for a concurrent duplicate", bb_build_claim_races)
 #ifdef X64
     STATS_DEF("32-bit basic block fragments generated", num_32bit_bbs)
     STATS_DEF("32-bit trace fragments generated", num_32bit_traces)
@@ -406,12 +419,36 @@
     STATS_DEF("Maximum number of bbs in a trace", max_bbs_in_a_trace)
     STATS_DEF("Traces truncated due to cache size limits", num_max_trace_size_enforced)
     STATS_DEF("Number of times max_trace_bbs was enforced", num_max_trace_bbs_enforced)
+#ifdef INTERNAL
+    STATS_DEF("Traces queued for helper thread optimization", num_traces_async_queued)
+    STATS_DEF("Traces optimized on the helper thread", num_traces_async_optimized)
+    STATS_DEF("Optimized traces swapped in", num_traces_async_swapped)
+    STATS_DEF("Optimized traces discarded: trace gone or flushed",
+              num_traces_async_stale)
+    STATS_DEF("Helper thread optimization time (us)", async_opt_micros)
+    STATS_DEF("Instrs in traces passed to optimize_trace", opt_instrs_in)
+    STATS_DEF("Net instrs removed by call-return matching", opt_removed_call_return)
+    STATS_DEF("Net instrs removed by redundant load removal", opt_removed_rlr)
+    STATS_DEF("Net instrs removed by zeroing removal", opt_removed_zeroing)
+    STATS_DEF("Net instrs removed by constant propagation", opt_removed_constant_prop)
+    STATS_DEF("Net instrs removed by dead code removal", opt_removed_dead_code)
+    STATS_DEF("Net instrs removed by stack adjust combining", opt_removed_stack_adjust)
+    STATS_DEF("Net instrs removed by peephole optimization", opt_removed_peephole)
+#endif
     STATS_DEF("Trace wannabes prevented from being traces", num_wannabe_traces)
     STATS_DEF("Trace head too large to be a trace", num_huge_fragments)
     STATS_DEF("Shared trace links shifted back to trace head", links_shared_trace_to_head)
     STATS_DEF("Shadowed trace head deleted", shadowed_trace_head_deleted)
     STATS_DEF("Trace head counters reset on trace deletion", th_counter_reset)
     STATS_DEF("Trace heads re-marked", trace_head_remark)
+    STATS_DEF("Trace exit profiles started", trace_reform_windows)
+    STATS_DEF("Trace exit profiles abandoned", trace_reform_lost)
+    STATS_DEF("Traces re-formed after exit profile", trace_reform_retired)
+    STATS_DEF("Traces kept after exit profile", trace_reform_kept)
+    STATS_DEF("Trace side exits profiled before re-forming", trace_reform_early_before)
+    STATS_DEF("Trace final exits profiled before re-forming", trace_reform_final_before)
+    STATS_DEF("Trace side exits profiled after re-forming", trace_reform_early_after)
+    STATS_DEF("Trace final exits profiled after re-forming", trace_reform_final_after)
     STATS_DEF("Future fragments generated", num_future_fragments)
     STATS_DEF("Shared fragments generated", num_shared_fragments)
     STATS_DEF("Shared bbs generated", num_shared_bbs)
@@ -474,6 +511,8 @@
     STATS_DEF("Shared fragments deleted no-flush, race", shared_delete_noflush_race)
     STATS_DEF("Trace component fragments deleted", trace_components_deleted)
     STATS_DEF("Fragments deleted due to capacity conflicts", num_fragments_replaced)
+    STATS_DEF("Fragments spared for a second chance", num_fragments_second_chance)
+    STATS_DEF("Replacements that forced a working set check", num_clock_wset_checks)
     STATS_DEF("Fragments deleted on thread/process death", num_fragments_deleted_exit)
     STATS_DEF("Fragments deleted on thread/process reset", num_fragments_deleted_reset)
     STATS_DEF("Trace heads marked", num_trace_heads_marked)
@@ -481,6 +520,8 @@
     STATS_DEF("Fragments deleted after selfmod", num_fragments_deleted_selfmod)
     STATS_DEF("Fragments deleted for munmap or RO consistency", num_fragments_deleted_consistency)
     STATS_DEF("Fragments deleted for copy & replace", num_fragments_deleted_copy_and_replace)
+    STATS_DEF("Fragments moved to the hot cache", num_fragments_moved_hot)
+    STATS_DEF("Traces emitted into the hot cache", num_traces_emitted_hot)
 #ifdef CLIENT_INTERFACE
     STATS_DEF("Fragments deleted by client interface", num_fragments_deleted_client)
 #endif
@@ -562,8 +603,17 @@
     STATS_DEF("Recreated fragments, traces", num_recreated_traces)
     STATS_DEF("Recreations via app re-decode", recreate_via_app_ilist)
     STATS_DEF("Recreations via stored info", recreate_via_stored_info)
+    STATS_DEF("Recreations via cached info", recreate_via_cached_info)
+    STATS_DEF("Fragments with translation info cached", num_fragment_translation_cached)
+    STATS_DEF("Fragments with app code too spread to cache info",
+              num_fragment_translation_uncacheable)
+    STATS_DEF("Cached translation info bytes", compact_translation_bytes)
+    STATS_DEF("Peak cached translation info bytes", peak_compact_translation_bytes)
     STATS_DEF("Recreation spill value restores", recreate_spill_restores)
     STATS_DEF("IBL stubs updated on table resize", num_ibl_stub_resize_updates)
+    STATS_DEF("Shadow return stack pushes inserted", num_shadow_ret_pushes)
+    STATS_DEF("Shadow return stack clears", num_shadow_ret_stack_clears)
+    STATS_DEF("Shadow return entries into deleted frags", num_shadow_ret_stack_removes)
 
     STATS_DEF("Patched fragments", emit_patched_fragments)
     STATS_DEF("Patched relocation slots", emit_patched_relocations)
@@ -905,6 +955,11 @@
     STATS_DEF("Peak heap bucket pad space (bytes)", peak_heap_bucket_pad)
     STATS_DEF("Heap allocs in buckets", heap_allocs_buckets)
     STATS_DEF("Heap allocs variable-sized", heap_allocs_variable)
+    STATS_DEF("Heap magazine refills from the global heap", heap_magazine_refills)
+    STATS_DEF("Heap magazine drains to the global heap", heap_magazine_drains)
+    STATS_DEF("IR allocs from the bb arena", bb_ir_arena_allocs)
+    STATS_DEF("IR frees skipped in the bb arena", bb_ir_arena_frees)
+    STATS_DEF("IR bb arena overflow chunks", bb_ir_arena_chunks)
     STATS_DEF("Total reserved memory", reserved_memory_capacity)
     STATS_DEF("Peak total reserved memory", peak_reserved_memory_capacity)
     STATS_DEF("Guard pages, reserved virtual pages", guard_pages)
@@ -978,6 +1033,8 @@
     STATS_DEF("Our peak virtual memory blocks in use", peak_vmm_vsize_blocks_used)
     STATS_DEF("Wasted vmm space due to alignment", vmm_vsize_wasted)
     STATS_DEF("Peak wasted vmm space due to alignment", peak_vmm_vsize_wasted)
+    STATS_DEF("Huge-page-backed cache unit capacity (bytes)", huge_page_mmap_capacity)
+    STATS_DEF("Cache units not backed by huge pages", huge_page_mmap_failures)
     STATS_DEF("Allocations using multiple vmm blocks", vmm_multi_block_allocs)
     STATS_DEF("Blocks used for multi-block allocs", vmm_multi_blocks)
     STATS_DEF("Our virtual memory in use (bytes)", vmm_vsize_used)
@@ -991,6 +1048,8 @@
     STATS_DEF("Number of safe reads", num_safe_reads)
     STATS_DEF("Number of safe writes", num_safe_writes)
     STATS_DEF("Number of vmarea vector resize reallocations", num_vmareas_resized)
+    STATS_DEF("Lockless vmarea lookups retried", vmarea_lockless_retries)
+    STATS_DEF("Lockless vmarea lookups done locked", vmarea_lockless_fallbacks)
     STATS_DEF("Number of vmarea vector resize synch fixups", num_vmareas_resize_synch)
     STATS_DEF("Peak vmarea vector length", max_vmareas_length)
     STATS_DEF("Peak dynamo areas vector length", max_DRareas_length)
@@ -1128,6 +1187,10 @@
     STATS_DEF("Trace fragment ending with an IBL, syscall", num_traces_end_at_ibl_syscall)
     STATS_DEF("Trace fragment ending at MUST_END_TRACE", num_traces_at_must_end_trace)
     STATS_DEF("Trace fragment ending with an IBL, speculative", num_traces_end_at_ibl_speculative_link)
+    STATS_DEF("Trace fragment ending with an IBL, inline cache", num_traces_end_at_ibl_inline_cache)
+    STATS_DEF("IBL sites profiled as inline cacheable", num_ibl_sites_inline_cached)
+    STATS_DEF("IBL sites profiled as megamorphic", num_ibl_sites_megamorphic)
+    STATS_DEF("Traces deleted for a megamorphic inline cache", num_ibl_sites_demoted)
     STATS_DEF("Yields in intercept_apc wait dynamo_initialized", apc_yields_while_initializing)
     STATS_DEF("IBL Tables groomed", num_ibt_groomed)
     STATS_DEF("IBL Tables reached maximum capacity", num_ibt_max_capacity)
@@ -1199,7 +1262,12 @@
     STATS_DEF("Clean Call analyzed", cleancall_analyzed)
     STATS_DEF("Clean Call inserted", cleancall_inserted)
     STATS_DEF("Clean Call inlined", cleancall_inlined)
+    STATS_DEF("Clean Call inlined with branches", cleancall_inlined_branchy)
+    STATS_DEF("Clean Call fast paths inlined", cleancall_inlined_fast_path)
+    STATS_DEF("Clean Call helper calls spliced", cleancall_helpers_spliced)
     STATS_DEF("Clean Call xmm skipped", cleancall_simd_skipped)
+    STATS_DEF("Clean Call non-leaf callee xmm usage found", cleancall_simd_analyzed_nonleaf)
+    STATS_DEF("Clean Call non-leaf xmm saves skipped", cleancall_simd_saves_skipped_nonleaf)
     STATS_DEF("Clean Call aflags save skipped", cleancall_aflags_save_skipped)
     STATS_DEF("Clean Call aflags clear skipped", cleancall_aflags_clear_skipped)
     /* i#107 handle application using same segment register */
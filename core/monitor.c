@@ -45,7 +45,7 @@
 #include "emit.h"
 #include "fcache.h"
 #include "monitor.h"
-#ifdef CUSTOM_TRACES
+#if defined(CUSTOM_TRACES) || defined(ASYNC_OPTIMIZE)
 #  include "instrument.h"
 #endif
 #include <string.h> /* for memset */
@@ -97,6 +97,11 @@ extern bool mangle_trace(dcontext_t *dcontext, instrlist_t *ilist, monitor_data_
          heap_free(dc, p, __VA_ARGS__))
 
 static void reset_trace_state(dcontext_t *dcontext, bool grab_link_lock);
+static bool hot_layout_applies_to(uint flags, uint size);
+static bool trace_exit_is_early(dcontext_t *dcontext, fragment_t *f, linkstub_t *l);
+
+/* -ibl_inline_cache site profiles, keyed by block tag and shared by all threads */
+static generic_table_t *ibl_profile_table;
 
 /* synchronization of shared traces */
 DECLARE_CXTSWPROT_VAR(mutex_t trace_building_lock, INIT_LOCK_FREE(trace_building_lock));
@@ -294,8 +299,240 @@ mangle_trace_at_end(void)
 #endif
 }
 
+#ifdef ASYNC_OPTIMIZE
+/* -optimize_async: rather than having the app thread wait for
+ * optimize_trace(), end_and_emit_trace() emits a private trace as-is, marked
+ * FRAG_UNOPTIMIZED, and queues a copy of its ilist.  A helper thread optimizes
+ * the copy and hands it back to the owning thread, which swaps it in at its
+ * next monitor_cache_enter() the way a client fragment replacement is done:
+ * only the owner may fragment_replace() a private fragment.
+ */
+typedef struct _async_opt_t {
+    dcontext_t *owner;  /* NULL once the owning thread has exited */
+    app_pc tag;
+    /* The trace the copy was made from.  A flush since then or a different
+     * trace now at tag invalidates the copy.
+     */
+    fragment_t *f;
+    uint flushtime;
+    uint num_bbs;
+    app_pc *bb_tags;
+    instrlist_t *ilist; /* a GLOBAL_DCONTEXT copy */
+    struct _async_opt_t *next;
+} async_opt_t;
+
+typedef struct _async_opt_queue_t {
+    mutex_t lock;
+    async_opt_t *head; /* FIFO of copies waiting for the helper thread */
+    async_opt_t *tail;
+    async_opt_t *in_flight; /* the copy being optimized, if any */
+    void *pending; /* signaled while head != NULL */
+    bool helper_running;
+} async_opt_queue_t;
+
+static async_opt_queue_t *async_opt;
+
+static void
+async_opt_free(async_opt_t *req)
+{
+    while (req != NULL) {
+        async_opt_t *next = req->next;
+        instrlist_clear_and_destroy(GLOBAL_DCONTEXT, req->ilist);
+        HEAP_ARRAY_FREE(GLOBAL_DCONTEXT, req->bb_tags, app_pc, req->num_bbs,
+                        ACCT_TRACE, UNPROTECTED);
+        HEAP_TYPE_FREE(GLOBAL_DCONTEXT, req, async_opt_t, ACCT_TRACE, UNPROTECTED);
+        req = next;
+    }
+}
+
+static void
+async_optimize_thread(void *arg)
+{
+    async_opt_t *req;
+    DEBUG_DECLARE(uint64 start_micros;)
+    while (true) {
+        dr_event_wait(async_opt->pending);
+        mutex_lock(&async_opt->lock);
+        req = async_opt->head;
+        if (req == NULL) {
+            dr_event_reset(async_opt->pending);
+            mutex_unlock(&async_opt->lock);
+            continue;
+        }
+        async_opt->head = req->next;
+        if (async_opt->head == NULL)
+            async_opt->tail = NULL;
+        req->next = NULL;
+        async_opt->in_flight = req;
+        mutex_unlock(&async_opt->lock);
+
+        DODEBUG({ start_micros = query_time_micros(); });
+        optimize_trace(GLOBAL_DCONTEXT, req->tag, req->ilist);
+        STATS_ADD(async_opt_micros, query_time_micros() - start_micros);
+        STATS_INC(num_traces_async_optimized);
+
+        mutex_lock(&async_opt->lock);
+        async_opt->in_flight = NULL;
+        if (req->owner != NULL) {
+            monitor_data_t *md = (monitor_data_t *) req->owner->monitor_field;
+            req->next = md->async_done;
+            md->async_done = req;
+            req = NULL;
+        }
+        mutex_unlock(&async_opt->lock);
+        /* the owner exited while we were optimizing */
+        async_opt_free(req);
+    }
+}
+
+void
+monitor_async_optimize_init(void)
+{
+    if (async_opt == NULL) {
+        if (!dynamo_options.optimize || !dynamo_options.optimize_async)
+            return;
+        if (DYNAMO_OPTION(shared_traces)) {
+            /* only the owning thread can swap in the optimized copy */
+            SYSLOG_INTERNAL_WARNING("-optimize_async only applies to thread-private "
+                                    "traces: shared traces are optimized in place");
+            return;
+        }
+        async_opt = HEAP_TYPE_ALLOC(GLOBAL_DCONTEXT, async_opt_queue_t, ACCT_TRACE,
+                                    UNPROTECTED);
+        memset(async_opt, 0, sizeof(*async_opt));
+        ASSIGN_INIT_LOCK_FREE(async_opt->lock, async_opt_lock);
+        async_opt->pending = dr_event_create();
+    }
+    async_opt->helper_running = dr_create_client_thread(async_optimize_thread, NULL);
+    if (!async_opt->helper_running) {
+        /* traces are optimized in place instead */
+        SYSLOG_INTERNAL_WARNING("-optimize_async failed to create its helper thread");
+    }
+}
+
+# ifdef UNIX
+/* Called in a fork child before the parent's threads are cleaned up.  The
+ * helper thread did not come along, but it may have been holding the queue
+ * lock, and the copy it was optimizing is lost.
+ */
+void
+monitor_async_optimize_fork_reset(void)
+{
+    if (async_opt == NULL)
+        return;
+    mutex_fork_reset(&async_opt->lock);
+    async_opt_free(async_opt->in_flight);
+    async_opt->in_flight = NULL;
+    async_opt->helper_running = false;
+}
+# endif
+
+/* Returns a copy of trace for the helper thread to optimize, or NULL if the
+ * trace should be optimized in place.
+ */
+static instrlist_t *
+async_optimize_copy(dcontext_t *dcontext, instrlist_t *trace, uint flags)
+{
+    instrlist_t *copy;
+    instr_t *inst;
+    if (async_opt == NULL || !async_opt->helper_running ||
+        TESTANY(FRAG_SHARED | FRAG_SELFMOD_SANDBOXED, flags))
+        return NULL;
+    copy = instrlist_clone(GLOBAL_DCONTEXT, trace);
+    /* raw bits point into md->trace_buf, which the next trace re-uses */
+    for (inst = instrlist_first(copy); inst != NULL; inst = instr_get_next(inst))
+        instr_make_persistent(GLOBAL_DCONTEXT, inst);
+    return copy;
+}
+
+static void
+async_optimize_queue(dcontext_t *dcontext, fragment_t *f, instrlist_t *ilist)
+{
+    monitor_data_t *md = (monitor_data_t *) dcontext->monitor_field;
+    async_opt_t *req = HEAP_TYPE_ALLOC(GLOBAL_DCONTEXT, async_opt_t, ACCT_TRACE,
+                                       UNPROTECTED);
+    uint i;
+    req->owner = dcontext;
+    req->tag = f->tag;
+    req->f = f;
+    req->flushtime = flushtime_global;
+    req->num_bbs = md->num_blks;
+    req->bb_tags = HEAP_ARRAY_ALLOC(GLOBAL_DCONTEXT, app_pc, md->num_blks,
+                                    ACCT_TRACE, UNPROTECTED);
+    for (i = 0; i < md->num_blks; i++)
+        req->bb_tags[i] = md->blk_info[i].info.tag;
+    req->ilist = ilist;
+    req->next = NULL;
+    mutex_lock(&async_opt->lock);
+    if (async_opt->tail == NULL)
+        async_opt->head = req;
+    else
+        async_opt->tail->next = req;
+    async_opt->tail = req;
+    dr_event_signal(async_opt->pending);
+    mutex_unlock(&async_opt->lock);
+    STATS_INC(num_traces_async_queued);
+}
+
+/* Drops dcontext's copies, whether queued, finished, or being optimized. */
+static void
+async_optimize_thread_exit(dcontext_t *dcontext)
+{
+    monitor_data_t *md = (monitor_data_t *) dcontext->monitor_field;
+    async_opt_t *req, **prev_next, *dead = NULL, *done;
+    mutex_lock(&async_opt->lock);
+    async_opt->tail = NULL;
+    for (prev_next = &async_opt->head; *prev_next != NULL; ) {
+        req = *prev_next;
+        if (req->owner == dcontext) {
+            *prev_next = req->next;
+            req->next = dead;
+            dead = req;
+        } else {
+            async_opt->tail = req;
+            prev_next = &req->next;
+        }
+    }
+    if (async_opt->in_flight != NULL && async_opt->in_flight->owner == dcontext)
+        async_opt->in_flight->owner = NULL;
+    done = md->async_done;
+    md->async_done = NULL;
+    mutex_unlock(&async_opt->lock);
+    async_opt_free(dead);
+    async_opt_free(done);
+}
+
+/* Whether req's copy was made from trace_f, the trace now at req->tag. */
+static bool
+async_optimize_is_current(async_opt_t *req, fragment_t *trace_f)
+{
+    trace_only_t *t;
+    uint i;
+    if (trace_f != req->f || !TEST(FRAG_UNOPTIMIZED, trace_f->flags) ||
+        flushtime_global != req->flushtime)
+        return false;
+    /* trace_f could be a later trace re-using the same fragment_t */
+    t = TRACE_FIELDS(trace_f);
+    if (t->num_bbs != req->num_bbs)
+        return false;
+    for (i = 0; i < req->num_bbs; i++) {
+        if (t->bbs[i].tag != req->bb_tags[i])
+            return false;
+    }
+    return true;
+}
+#endif /* ASYNC_OPTIMIZE */
+
+static void
+ibl_profile_free(dcontext_t *dcontext, void *p)
+{
+    HEAP_TYPE_FREE(GLOBAL_DCONTEXT, p, ibl_site_profile_t, ACCT_THCOUNTER, UNPROTECTED);
+}
+
 /* Initialization */
-/* thread-shared init does nothing, thread-private init does it all */
+/* thread-shared init only sets up the -ibl_inline_cache profiles, thread-private
+ * init does the rest
+ */
 void
 monitor_init()
 {
@@ -304,6 +541,16 @@ monitor_init()
      * this does not include exit stubs
      */
     ASSERT(MAX_TRACE_BUFFER_SIZE <= MAX_FRAGMENT_SIZE);
+    if (DYNAMO_OPTION(ibl_inline_cache) > 0 && !RUNNING_WITHOUT_CODE_CACHE()) {
+        ibl_profile_table =
+            generic_hash_create(GLOBAL_DCONTEXT, INIT_COUNTER_TABLE_SIZE,
+                                COUNTER_TABLE_LOAD,
+                                /* persist so a reset does not re-profile */
+                                HASHTABLE_ENTRY_SHARED | HASHTABLE_SHARED |
+                                HASHTABLE_PERSISTENT | HASHTABLE_RELAX_CLUSTER_CHECKS,
+                                ibl_profile_free _IF_DEBUG("ibl site profiles"));
+        ibl_profile_table->hash_func = HASH_FUNCTION_MULTIPLY_PHI;
+    }
 }
 
 /* re-initializes non-persistent memory */
@@ -336,6 +583,22 @@ monitor_exit()
     LOG(GLOBAL, LOG_MONITOR|LOG_STATS, 1,
         "Trace fragments generated: %d\n", GLOBAL_STAT(num_traces));
     DELETE_LOCK(trace_building_lock);
+    if (ibl_profile_table != NULL) {
+        generic_hash_destroy(GLOBAL_DCONTEXT, ibl_profile_table);
+        ibl_profile_table = NULL;
+    }
+#ifdef ASYNC_OPTIMIZE
+    /* the helper thread is waiting for more work and will never run again */
+    if (async_opt != NULL) {
+        async_opt_free(async_opt->head);
+        async_opt_free(async_opt->in_flight);
+        dr_event_destroy(async_opt->pending);
+        DELETE_LOCK(async_opt->lock);
+        HEAP_TYPE_FREE(GLOBAL_DCONTEXT, async_opt, async_opt_queue_t, ACCT_TRACE,
+                       UNPROTECTED);
+        async_opt = NULL;
+    }
+#endif
 }
 
 static void
@@ -371,6 +634,13 @@ monitor_thread_init(dcontext_t *dcontext)
                                           HASHTABLE_PERSISTENT,
                                           thcounter_free _IF_DEBUG("trace heads"));
     md->thead_table->hash_func = HASH_FUNCTION_MULTIPLY_PHI;
+    if (DYNAMO_OPTION(cache_hot_layout)) {
+        md->hot_table =
+            generic_hash_create(dcontext, INIT_COUNTER_TABLE_SIZE, COUNTER_TABLE_LOAD,
+                                HASHTABLE_PERSISTENT,
+                                thcounter_free _IF_DEBUG("hot fragment counts"));
+        md->hot_table->hash_func = HASH_FUNCTION_MULTIPLY_PHI;
+    }
 }
 
 /* atexit cleanup */
@@ -386,6 +656,11 @@ monitor_thread_exit(dcontext_t *dcontext)
      * can never be built from that particular trace head.
      */
     trace_abort(dcontext);
+#ifdef ASYNC_OPTIMIZE
+    /* even without freeing, the helper thread must not touch md past this */
+    if (async_opt != NULL)
+        async_optimize_thread_exit(dcontext);
+#endif
 #ifdef DEBUG
     if (md->trace_buf != NULL)
         heap_free(dcontext, md->trace_buf, md->trace_buf_size HEAPACCT(ACCT_TRACE));
@@ -399,6 +674,8 @@ monitor_thread_exit(dcontext_t *dcontext)
      */
     if (!RUNNING_WITHOUT_CODE_CACHE()) {
         generic_hash_destroy(dcontext, md->thead_table);
+        if (md->hot_table != NULL)
+            generic_hash_destroy(dcontext, md->hot_table);
         heap_free(dcontext, md, sizeof(monitor_data_t) HEAPACCT(ACCT_TRACE));
     }
 #endif
@@ -427,13 +704,196 @@ thcounter_add(dcontext_t *dcontext, app_pc tag)
     return e;
 }
 
-/* Deletes all trace head entries in [start,end) */
+/* Deletes all trace head entries in [start,end).  Passing GLOBAL_DCONTEXT
+ * deletes the process-wide entries instead.
+ */
 void
 thcounter_range_remove(dcontext_t *dcontext, app_pc start, app_pc end)
 {
-    monitor_data_t *md = (monitor_data_t *) dcontext->monitor_field;
+    monitor_data_t *md;
+    if (dcontext == GLOBAL_DCONTEXT) {
+        /* the ibl site profiles are keyed by block tags as well */
+        if (ibl_profile_table != NULL) {
+            TABLE_RWLOCK(ibl_profile_table, write, lock);
+            generic_hash_range_remove(GLOBAL_DCONTEXT, ibl_profile_table,
+                                      (ptr_uint_t) start, (ptr_uint_t) end);
+            TABLE_RWLOCK(ibl_profile_table, write, unlock);
+        }
+        return;
+    }
+    md = (monitor_data_t *) dcontext->monitor_field;
     generic_hash_range_remove(dcontext, md->thead_table,
                               (ptr_uint_t) start, (ptr_uint_t) end);
+    if (md->hot_table != NULL) {
+        generic_hash_range_remove(dcontext, md->hot_table,
+                                  (ptr_uint_t) start, (ptr_uint_t) end);
+    }
+}
+
+/* Returns the tag of the block whose indirect branch l of f is, if its
+ * targets are profiled for -ibl_inline_cache, or NULL.  For a trace only the
+ * indirect exit of its final block counts: that is where the block's profile
+ * is consumed.
+ */
+static app_pc
+ibl_profile_site(dcontext_t *dcontext, fragment_t *f, linkstub_t *l)
+{
+    trace_only_t *t;
+    if (ibl_profile_table == NULL || LINKSTUB_FAKE(l) ||
+        TESTANY(FRAG_COARSE_GRAIN|FRAG_FAKE, f->flags))
+        return NULL;
+    if (!TEST(FRAG_IS_TRACE, f->flags))
+        return f->tag;
+    t = TRACE_FIELDS(f);
+    if (t->bbs == NULL || trace_exit_is_early(dcontext, f, l))
+        return NULL;
+    return t->bbs[t->num_bbs - 1].tag;
+}
+
+/* Records a target of site p.  The caller must hold the table write lock.
+ * Returns whether this made the site megamorphic.
+ */
+static bool
+ibl_profile_record(ibl_site_profile_t *p, app_pc target)
+{
+    uint i;
+    p->samples++;
+    for (i = 0; i < p->num_targets; i++) {
+        if (p->target[i] == target) {
+            p->count[i]++;
+            return false;
+        }
+    }
+    if (p->num_targets < IBL_PROFILE_TARGETS) {
+        p->target[i] = target;
+        p->count[i] = 1;
+        p->num_targets++;
+    }
+    if (p->megamorphic || p->num_targets <= DYNAMO_OPTION(ibl_inline_cache))
+        return false;
+    p->megamorphic = true;
+    STATS_INC(num_ibl_sites_megamorphic);
+    return true;
+}
+
+/* Called on every exit through the indirect exit l of f to target that
+ * reaches dispatch: every ibl miss, plus the exits taken while building a
+ * trace.  The exit stays linked, so a target found in the ibl table is not
+ * seen again and the profile mostly holds the distinct targets of the site,
+ * counted by how often they missed.  A trace
+ * whose inline cache site has turned megamorphic is marked for deletion so
+ * that it is rebuilt without the compare chain.
+ */
+void
+monitor_ibl_profile_exit(dcontext_t *dcontext, fragment_t *f, linkstub_t *l,
+                         app_pc target)
+{
+    monitor_data_t *md = (monitor_data_t *) dcontext->monitor_field;
+    ibl_site_profile_t *p;
+    app_pc site;
+    ASSERT(LINKSTUB_INDIRECT(l->flags));
+    site = ibl_profile_site(dcontext, f, l);
+    if (site == NULL)
+        return;
+    TABLE_RWLOCK(ibl_profile_table, write, lock);
+    p = (ibl_site_profile_t *)
+        generic_hash_lookup(GLOBAL_DCONTEXT, ibl_profile_table, (ptr_uint_t) site);
+    if (p == NULL) {
+        p = HEAP_TYPE_ALLOC(GLOBAL_DCONTEXT, ibl_site_profile_t, ACCT_THCOUNTER,
+                            UNPROTECTED);
+        memset(p, 0, sizeof(*p));
+        p->tag = site;
+        generic_hash_add(GLOBAL_DCONTEXT, ibl_profile_table, (ptr_uint_t) site, p);
+    }
+    if (ibl_profile_record(p, target)) {
+        LOG(THREAD, LOG_MONITOR, 3, "ibl site "PFX": megamorphic after %d misses\n",
+            site, p->samples);
+    }
+    if (p->megamorphic && TEST(FRAG_IS_TRACE, f->flags) &&
+        TRACE_FIELDS(f)->inline_cached)
+        md->ibl_demote_tag = f->tag;
+    TABLE_RWLOCK(ibl_profile_table, write, unlock);
+}
+
+/* Deletes the trace marked by monitor_ibl_profile_exit(), whose inline cache
+ * compares against targets of a now megamorphic site.  The head's counter is
+ * lazily reset (TH_COUNTER_CREATED_TRACE_VALUE) so the trace is rebuilt, with
+ * only the ibl lookup at its end, once the head is hot again.  Returns the
+ * fragment to enter, which is NULL if f was deleted.
+ */
+static fragment_t *
+ibl_inline_cache_demote(dcontext_t *dcontext, fragment_t *f)
+{
+    monitor_data_t *md = (monitor_data_t *) dcontext->monitor_field;
+    fragment_t *trace_f;
+    SELF_PROTECT_LOCAL(dcontext, WRITABLE);
+    trace_f = fragment_lookup_trace(dcontext, md->ibl_demote_tag);
+    md->ibl_demote_tag = NULL;
+    SELF_PROTECT_LOCAL(dcontext, READONLY);
+    if (trace_f == NULL || !TRACE_FIELDS(trace_f)->inline_cached ||
+        TESTANY(FRAG_COARSE_GRAIN | FRAG_TEMP_PRIVATE | FRAG_CANNOT_DELETE,
+                trace_f->flags))
+        return f;
+    /* fragment_remove_shared_no_flush() cannot remove from private ibt tables */
+    if (TEST(FRAG_SHARED, trace_f->flags) && IS_IBL_TARGET(trace_f->flags) &&
+        !DYNAMO_OPTION(shared_trace_ibt_tables))
+        return f;
+    LOG(THREAD, LOG_MONITOR, 2,
+        "demoting inline cache of trace F%d("PFX"): its site is megamorphic\n",
+        trace_f->id, trace_f->tag);
+    if (f == trace_f)
+        f = NULL;
+    if (trace_f == dcontext->last_fragment)
+        last_exit_deleted(dcontext);
+    /* a racing thread deleting the same shared trace is handled by
+     * fragment_remove_shared_no_flush()
+     */
+    if (TEST(FRAG_SHARED, trace_f->flags))
+        fragment_remove_shared_no_flush(dcontext, trace_f);
+    else
+        fragment_delete(dcontext, trace_f, FRAGDEL_ALL);
+    STATS_INC(num_ibl_sites_demoted);
+    return f;
+}
+
+/* Fills targets with the inline cache targets for the indirect branch ending
+ * the block site_tag, most frequent first, and returns their count.  Returns
+ * 0 for sites that are unprofiled or megamorphic: those are left to the ibl
+ * hashtable lookup.
+ */
+uint
+monitor_ibl_inline_cache_targets(dcontext_t *dcontext, app_pc site_tag,
+                                 app_pc *targets/*OUT*/, uint max_targets)
+{
+    ibl_site_profile_t *p;
+    uint count[IBL_PROFILE_TARGETS];
+    uint i, j, num = 0;
+    if (ibl_profile_table == NULL)
+        return 0;
+    max_targets = MIN(DYNAMO_OPTION(ibl_inline_cache), max_targets);
+    TABLE_RWLOCK(ibl_profile_table, read, lock);
+    p = (ibl_site_profile_t *)
+        generic_hash_lookup(GLOBAL_DCONTEXT, ibl_profile_table, (ptr_uint_t) site_tag);
+    if (p != NULL && !p->megamorphic) {
+        /* keep the max_targets most frequent, by insertion */
+        for (i = 0; i < p->num_targets; i++) {
+            if (num == max_targets && count[num - 1] >= p->count[i])
+                continue;
+            j = (num < max_targets) ? num++ : num - 1;
+            for (; j > 0 && count[j - 1] < p->count[i]; j--) {
+                targets[j] = targets[j - 1];
+                count[j] = count[j - 1];
+            }
+            targets[j] = p->target[i];
+            count[j] = p->count[i];
+        }
+    }
+    TABLE_RWLOCK(ibl_profile_table, read, unlock);
+    if (num > 0)
+        STATS_INC(num_ibl_sites_inline_cached);
+    else if (p != NULL)
+        LOG(THREAD, LOG_MONITOR, 3, "ibl site "PFX": megamorphic\n", site_tag);
+    return num;
 }
 
 bool
@@ -585,6 +1045,8 @@ monitor_remove_fragment(dcontext_t *dcontext, fragment_t *f)
         md->last_copy = NULL; /* no other action required */
         STATS_INC(num_trace_private_deletions);
     }
+    if (md->reform.trace == f)
+        md->reform.trace = NULL;
     /* Must check to see if the last fragment, which was added to the
      * trace, is being deleted before we're done with it.
      * This can happen due to a flush from self-modifying code,
@@ -1194,11 +1656,16 @@ end_and_emit_trace(dcontext_t *dcontext, fragment_t *cur_f)
     fragment_t *trace_f;
     trace_only_t *trace_tr;
     bool replace_trace_head = false;
+    bool place_hot;
+    bool inline_cached = false;
     fragment_t wrapper;
     uint i;
 #if defined(DEBUG) || defined(INTERNAL) || defined(CLIENT_INTERFACE)
     /* was the trace passed through optimizations or the client interface? */
     bool externally_mangled = false;
+#endif
+#ifdef ASYNC_OPTIMIZE
+    instrlist_t *unoptimized = NULL; /* for the -optimize_async helper thread */
 #endif
     /* we cannot simply upgrade a basic block fragment
      * to a trace b/c traces have prefixes that basic blocks don't!
@@ -1260,7 +1727,7 @@ end_and_emit_trace(dcontext_t *dcontext, fragment_t *cur_f)
         md->emitted_size -= local_exit_stub_size(dcontext, target, md->trace_flags);
     }
 
-    if (DYNAMO_OPTION(speculate_last_exit)
+    if (DYNAMO_OPTION(speculate_last_exit) || DYNAMO_OPTION(ibl_inline_cache) > 0
 #ifdef HASHTABLE_STATISTICS
         || INTERNAL_OPTION(speculate_last_exit_stats) || INTERNAL_OPTION(stay_on_trace_stats)
 #endif
@@ -1285,11 +1752,31 @@ end_and_emit_trace(dcontext_t *dcontext, fragment_t *cur_f)
             /* otherwise last_exit is the last trace BB and next_tag
              * is the current IBL target that we'll always speculate */
             if (LINKSTUB_INDIRECT(dcontext->last_exit->flags)) {
+                app_pc ic_targets[IBL_INLINE_CACHE_MAX_TARGETS];
+                uint num_ic_targets;
                 LOG(THREAD, LOG_MONITOR, 2,
                     "Last trace IBL exit (trace "PFX", next_tag "PFX")\n",
                     tag, dcontext->next_tag);
                 ASSERT_CURIOSITY(dcontext->next_tag != NULL);
-                if (DYNAMO_OPTION(speculate_last_exit)) {
+                /* the site is the indirect branch ending the final block */
+                num_ic_targets = monitor_ibl_inline_cache_targets
+                    (dcontext, md->blk_info[md->num_blks - 1].info.tag, ic_targets,
+                     IBL_INLINE_CACHE_MAX_TARGETS);
+                if (num_ic_targets > 0) {
+                    /* the profile of the final block's indirect branch beats
+                     * speculating on the single target seen now
+                     */
+                    uint i;
+                    inline_cached = true;
+                    md->emitted_size +=
+                        append_trace_ibl_inline_cache(dcontext, trace, ic_targets,
+                                                      num_ic_targets, false);
+                    for (i = 0; i < num_ic_targets; i++) {
+                        md->emitted_size +=
+                            local_exit_stub_size(dcontext, ic_targets[i],
+                                                 md->trace_flags);
+                    }
+                } else if (DYNAMO_OPTION(speculate_last_exit)) {
                     app_pc speculate_next_tag = dcontext->next_tag;
 #ifdef SPECULATE_LAST_EXIT_STUDY
                     /* for a performance study: add overhead on
@@ -1303,7 +1790,8 @@ end_and_emit_trace(dcontext_t *dcontext, fragment_t *cur_f)
                 } else {
 #ifdef HASHTABLE_STATISTICS
                     ASSERT(INTERNAL_OPTION(stay_on_trace_stats) ||
-                           INTERNAL_OPTION(speculate_last_exit_stats));
+                           INTERNAL_OPTION(speculate_last_exit_stats) ||
+                           DYNAMO_OPTION(ibl_inline_cache) > 0);
                     DOSTATS({
                         md->emitted_size +=
                             append_ib_trace_last_ibl_exit_stat(dcontext, trace,
@@ -1327,7 +1815,7 @@ end_and_emit_trace(dcontext_t *dcontext, fragment_t *cur_f)
         for (i=0; i<md->num_blks; i++) {
             LOG(THREAD, LOG_MONITOR, 2, "\tblock %3d == "PFX" (%d exit(s))\n",
                 i, md->blk_info[i].info.tag,
-                IF_RETURN_AFTER_CALL_ELSE(md->blk_info[i].info.num_exits, 0));
+                md->blk_info[i].info.num_exits);
         }
     });
 
@@ -1341,7 +1829,13 @@ end_and_emit_trace(dcontext_t *dcontext, fragment_t *cur_f)
         && !dynamo_options.sideline
 #  endif
         ) {
-        optimize_trace(dcontext, tag, trace);
+# ifdef ASYNC_OPTIMIZE
+        unoptimized = async_optimize_copy(dcontext, trace, md->trace_flags);
+        if (unoptimized != NULL)
+            md->trace_flags |= FRAG_UNOPTIMIZED;
+        else
+# endif
+            optimize_trace(dcontext, tag, trace);
         externally_mangled = true;
     }
 #endif /* INTERNAL */
@@ -1496,6 +1990,14 @@ end_and_emit_trace(dcontext_t *dcontext, fragment_t *cur_f)
     /* ensure trace was NOT aborted */
     ASSERT(md->trace_tag == tag);
 
+    /* With -cache_hot_layout a new private trace goes straight into the hot
+     * cache: its head was just entered -trace_threshold times, and once linked
+     * the trace is no longer entered from dispatch where it could be counted.
+     */
+    place_hot = (DYNAMO_OPTION(cache_hot_layout) &&
+                 hot_layout_applies_to(md->trace_flags, md->emitted_size));
+    if (place_hot)
+        fcache_set_hot_placement(dcontext, true);
     /* emit trace fragment into fcache with tag value */
     if (replace_trace_head) {
 #ifndef CUSTOM_TRACES
@@ -1508,6 +2010,10 @@ end_and_emit_trace(dcontext_t *dcontext, fragment_t *cur_f)
                                 true/*link*/);
     }
     ASSERT(trace_f != NULL);
+    if (place_hot) {
+        fcache_set_hot_placement(dcontext, false);
+        STATS_INC(num_traces_emitted_hot);
+    }
     /* our estimate should be conservative
      * if externally mangled, all bets are off for now --
      * FIXME: would be nice to gracefully handle opt or client
@@ -1531,10 +2037,18 @@ end_and_emit_trace(dcontext_t *dcontext, fragment_t *cur_f)
                                  HEAPACCT(ACCT_TRACE));
     for (i = 0; i < md->num_blks; i++)
         trace_tr->bbs[i] = md->blk_info[i].info;
+    trace_tr->inline_cached = inline_cached;
 
     if (TEST(FRAG_SHARED, md->trace_flags))
         mutex_unlock(&trace_building_lock);
 
+#ifdef ASYNC_OPTIMIZE
+    if (unoptimized != NULL) {
+        async_optimize_queue(dcontext, trace_f, unoptimized);
+        unoptimized = NULL;
+    }
+#endif
+
     RSTATS_INC(num_traces);
     DOSTATS({ IF_X86_64(if (FRAG_IS_32(trace_f->flags)) STATS_INC(num_32bit_traces);) });
     STATS_ADD(num_bbs_in_all_traces, md->num_blks);
@@ -1617,6 +2131,10 @@ end_and_emit_trace(dcontext_t *dcontext, fragment_t *cur_f)
 #endif
 
  end_and_emit_trace_return:
+#ifdef ASYNC_OPTIMIZE
+    if (unoptimized != NULL)
+        instrlist_clear_and_destroy(GLOBAL_DCONTEXT, unoptimized);
+#endif
     if (cur_f == NULL && cur_f_tag == tag)
         return trace_f;
     else {
@@ -1899,6 +2417,406 @@ check_fine_to_coarse_trace_head(dcontext_t *dcontext, fragment_t *f)
     }
 }
 
+/* Returns whether a fragment with flags and size can be placed in a
+ * -cache_hot_layout hot cache
+ */
+static bool
+hot_layout_applies_to(uint flags, uint size)
+{
+    return (!TESTANY(FRAG_SHARED | FRAG_COARSE_GRAIN | FRAG_TEMP_PRIVATE | FRAG_FAKE |
+                     FRAG_CANNOT_DELETE | FRAG_SELFMOD_SANDBOXED |
+                     FRAG_HAS_TRANSLATION_INFO, flags) &&
+            /* PR 213005: we cannot decode client code past a bb's last exit */
+            (TEST(FRAG_IS_TRACE, flags) || !TEST(FRAG_CANNOT_BE_TRACE, flags)) &&
+            size <= DYNAMO_OPTION(cache_hot_max) / 4);
+}
+
+/* Returns whether f can be moved into a -cache_hot_layout hot cache */
+static inline bool
+hot_layout_applies(dcontext_t *dcontext, fragment_t *f)
+{
+    /* a trace head is about to be replaced by a trace, which is placed in
+     * the hot cache when it is emitted
+     */
+    if (TEST(FRAG_IS_TRACE_HEAD, f->flags) && !DYNAMO_OPTION(disable_traces))
+        return false;
+    return hot_layout_applies_to(f->flags, f->size);
+}
+
+/* Emits ilist with flags as a replacement for private fragment f and moves f's
+ * links and hashtable entry to it, as is done for a client fragment
+ * replacement.  The caller must delete f.  Returns the replacement.
+ */
+static fragment_t *
+emit_private_replacement(dcontext_t *dcontext, fragment_t *f, instrlist_t *ilist,
+                         uint flags)
+{
+    fragment_t *new_f;
+    uint orig_flags = f->flags;
+    void *vmlist = NULL;
+    DEBUG_DECLARE(bool ok;)
+
+    DEBUG_DECLARE(ok =)
+        vm_area_add_to_list(dcontext, f->tag, &vmlist, orig_flags, f, false/*no locks*/);
+    ASSERT(ok); /* should never fail for private fragments */
+    /* prevent emit from deleting f, we still need it */
+    f->flags |= FRAG_CANNOT_DELETE;
+    new_f = emit_invisible_fragment(dcontext, f->tag, ilist, flags, vmlist);
+    f->flags = orig_flags;
+    fragment_copy_data_fields(dcontext, f, new_f);
+    /* new_f is added to the ibl tables on its next indirect branch miss */
+    fragment_remove_from_ibt_tables(dcontext, f, false);
+    shift_links_to_new_fragment(dcontext, f, new_f);
+    fragment_replace(dcontext, f, new_f);
+    return new_f;
+}
+
+/* Re-emits f into this thread's hot cache and replaces f with the copy.
+ * Returns the copy.
+ */
+static fragment_t *
+move_to_hot_cache(dcontext_t *dcontext, fragment_t *f)
+{
+    instrlist_t *ilist;
+    fragment_t *new_f;
+
+    SELF_PROTECT_LOCAL(dcontext, WRITABLE);
+    /* the instrs point into f's code, which is valid until f is deleted */
+    ilist = decode_fragment(dcontext, f, NULL, NULL, f->flags, NULL, NULL);
+    fcache_set_hot_placement(dcontext, true);
+    new_f = emit_private_replacement(dcontext, f, ilist, f->flags);
+    fcache_set_hot_placement(dcontext, false);
+    instrlist_clear_and_destroy(dcontext, ilist);
+    LOG(THREAD, LOG_MONITOR|LOG_CACHE, 2, "moved hot F%d("PFX") to F%d @"PFX"\n",
+        f->id, f->tag, new_f->id, new_f->start_pc);
+    fragment_delete(dcontext, f, FRAGDEL_NO_OUTPUT | FRAGDEL_NO_UNLINK |
+                    FRAGDEL_NO_HTABLE);
+    SELF_PROTECT_LOCAL(dcontext, READONLY);
+    STATS_INC(num_fragments_moved_hot);
+    return new_f;
+}
+
+#ifdef ASYNC_OPTIMIZE
+/* Swaps in the copies the -optimize_async helper thread has finished
+ * optimizing for this thread.  Returns the fragment to enter in place of f.
+ */
+static fragment_t *
+async_optimize_swap(dcontext_t *dcontext, fragment_t *f)
+{
+    monitor_data_t *md = (monitor_data_t *) dcontext->monitor_field;
+    async_opt_t *req, *next, *retry = NULL;
+
+    mutex_lock(&async_opt->lock);
+    req = md->async_done;
+    md->async_done = NULL;
+    mutex_unlock(&async_opt->lock);
+    SELF_PROTECT_LOCAL(dcontext, WRITABLE);
+    for (; req != NULL; req = next) {
+        fragment_t *trace_f = fragment_lookup_trace(dcontext, req->tag);
+        next = req->next;
+        req->next = NULL;
+        if (!async_optimize_is_current(req, trace_f)) {
+            STATS_INC(num_traces_async_stale);
+        } else if (trace_f == dcontext->last_fragment) {
+            /* last_exit may point into it: try again next time */
+            req->next = retry;
+            retry = req;
+            continue;
+        } else {
+            instrlist_t *ilist = instrlist_clone(dcontext, req->ilist);
+            fragment_t *new_f =
+                emit_private_replacement(dcontext, trace_f, ilist,
+                                         trace_f->flags & ~FRAG_UNOPTIMIZED);
+            instrlist_clear_and_destroy(dcontext, ilist);
+            LOG(THREAD, LOG_MONITOR|LOG_OPTS, 2,
+                "swapped in optimized F%d @"PFX" for F%d("PFX")\n",
+                new_f->id, new_f->start_pc, trace_f->id, trace_f->tag);
+            fragment_delete(dcontext, trace_f, FRAGDEL_NO_OUTPUT | FRAGDEL_NO_UNLINK |
+                            FRAGDEL_NO_HTABLE);
+            if (f == trace_f)
+                f = new_f;
+            STATS_INC(num_traces_async_swapped);
+        }
+        async_opt_free(req);
+    }
+    SELF_PROTECT_LOCAL(dcontext, READONLY);
+    if (retry != NULL) {
+        mutex_lock(&async_opt->lock);
+        for (req = retry; req->next != NULL; req = req->next)
+            ; /* find the tail */
+        req->next = md->async_done;
+        md->async_done = retry;
+        mutex_unlock(&async_opt->lock);
+    }
+    return f;
+}
+#endif
+
+/* Counts an entry into f from dispatch for -cache_hot_layout and moves f into
+ * the hot cache once it has been entered -cache_hot_threshold times.  This
+ * catches hot fragments that are not linked to, such as indirect branch
+ * targets missing from the ibl tables; traces are placed in the hot cache
+ * when they are built.  Returns the fragment to enter.
+ */
+static fragment_t *
+hot_layout_cache_enter(dcontext_t *dcontext, fragment_t *f)
+{
+    monitor_data_t *md = (monitor_data_t *) dcontext->monitor_field;
+    trace_head_counter_t *ctr;
+    if (md->hot_table == NULL || !hot_layout_applies(dcontext, f) ||
+        fcache_fragment_is_hot(dcontext, f))
+        return f;
+    ctr = (trace_head_counter_t *)
+        generic_hash_lookup(dcontext, md->hot_table, (ptr_uint_t) f->tag);
+    if (ctr == NULL) {
+        ctr = COUNTER_ALLOC(dcontext, sizeof(trace_head_counter_t)
+                            HEAPACCT(ACCT_THCOUNTER));
+        ctr->tag = f->tag;
+        ctr->counter = 0;
+        generic_hash_add(dcontext, md->hot_table, (ptr_uint_t) f->tag, ctr);
+    }
+    ctr->counter++;
+    /* last_exit may point into the fragment we just left, which must stay */
+    if (ctr->counter < DYNAMO_OPTION(cache_hot_threshold) ||
+        f == dcontext->last_fragment)
+        return f;
+    generic_hash_remove(dcontext, md->hot_table, (ptr_uint_t) f->tag);
+    return move_to_hot_cache(dcontext, f);
+}
+
+/* The -trace_reform_window profile of a shared trace.  The trace is unlinked
+ * for every thread, so exits taken by any of them are counted here, under
+ * change_linking_lock; private traces are profiled in monitor_data_t.
+ */
+static trace_reform_t shared_reform;
+
+/* Returns whether l leaves trace f from a block before its last one. */
+static bool
+trace_exit_is_early(dcontext_t *dcontext, fragment_t *f, linkstub_t *l)
+{
+    trace_only_t *t = TRACE_FIELDS(f);
+    linkstub_t *stub;
+    uint i, exitnum, early_exits = 0;
+    ASSERT(TEST(FRAG_IS_TRACE, f->flags));
+    if (t->bbs == NULL || t->num_bbs < 2)
+        return false;
+    /* exits are laid out in block order: see get_trace_exit_component_tag() */
+    for (i = 0; i < t->num_bbs - 1; i++)
+        early_exits += t->bbs[i].num_exits;
+    for (stub = FRAGMENT_EXIT_STUBS(f), exitnum = 0;
+         stub != NULL && exitnum < early_exits;
+         stub = LINKSTUB_NEXT_EXIT(stub), exitnum++) {
+        if (stub == l)
+            return true;
+    }
+    return false;
+}
+
+static void
+trace_reform_lock(trace_reform_t *r)
+{
+    if (r == &shared_reform)
+        acquire_recursive_lock(&change_linking_lock);
+}
+
+static void
+trace_reform_unlock(trace_reform_t *r)
+{
+    if (r == &shared_reform)
+        release_recursive_lock(&change_linking_lock);
+}
+
+/* Returns whether r is still measuring a live trace.  A trace can be
+ * flushed without telling the profile, so its tag is looked up again.
+ */
+static bool
+trace_reform_is_live(dcontext_t *dcontext, trace_reform_t *r)
+{
+    if (r->trace == NULL)
+        return false;
+    if (fragment_lookup_trace(dcontext, r->tag) == r->trace)
+        return true;
+    r->trace = NULL;
+    STATS_INC(trace_reform_lost);
+    return false;
+}
+
+/* Unlinks the outgoing branches of trace f so that every exit from it comes
+ * back to dispatch, where trace_reform_cache_enter() counts it.
+ */
+static void
+trace_reform_start(dcontext_t *dcontext, fragment_t *f, bool after)
+{
+    monitor_data_t *md = (monitor_data_t *) dcontext->monitor_field;
+    trace_reform_t *r = TEST(FRAG_SHARED, f->flags) ? &shared_reform : &md->reform;
+    trace_reform_lock(r);
+    /* One trace at a time per profile; a shared trace may also have been
+     * unlinked already by another thread.
+     */
+    if (trace_reform_is_live(dcontext, r) ||
+        !TEST(FRAG_LINKED_OUTGOING, f->flags) || TEST(FRAG_WAS_DELETED, f->flags)) {
+        trace_reform_unlock(r);
+        return;
+    }
+    unlink_fragment_outgoing(dcontext, f);
+    r->trace = f;
+    r->tag = f->tag;
+    r->early = 0;
+    r->final = 0;
+    r->after = after;
+    trace_reform_unlock(r);
+    SELF_PROTECT_CACHE(dcontext, NULL, READONLY);
+    LOG(THREAD, LOG_MONITOR, 2, "profiling exits of %strace F%d("PFX")\n",
+        after ? "re-formed " : "", f->id, f->tag);
+    STATS_INC(trace_reform_windows);
+}
+
+/* Relinks the trace whose exits were being counted. */
+static void
+trace_reform_relink(dcontext_t *dcontext, fragment_t *f)
+{
+    bool need_lock = NEED_SHARED_LOCK(f->flags);
+    if (need_lock)
+        acquire_recursive_lock(&change_linking_lock);
+    if (!TEST(FRAG_LINKED_OUTGOING, f->flags) && !TEST(FRAG_WAS_DELETED, f->flags))
+        link_fragment_outgoing(dcontext, f, false);
+    if (need_lock)
+        release_recursive_lock(&change_linking_lock);
+    SELF_PROTECT_CACHE(dcontext, NULL, READONLY);
+}
+
+/* Called when a secondary trace is about to be built from the target of the
+ * last exit.  If that exit left a trace before its last block, the trace's
+ * exits are profiled for -trace_reform_window to see whether its path has
+ * gone cold.
+ */
+static void
+trace_reform_side_exit(dcontext_t *dcontext)
+{
+    fragment_t *f = dcontext->last_fragment;
+    if (f == NULL || LINKSTUB_FAKE(dcontext->last_exit) ||
+        !TEST(FRAG_IS_TRACE, f->flags) ||
+        TESTANY(FRAG_COARSE_GRAIN | FRAG_TEMP_PRIVATE | FRAG_CANNOT_DELETE, f->flags))
+        return;
+    /* fragment_remove_shared_no_flush() cannot remove from private ibt tables */
+    if (TEST(FRAG_SHARED, f->flags) && IS_IBL_TARGET(f->flags) &&
+        !DYNAMO_OPTION(shared_trace_ibt_tables))
+        return;
+    if (trace_exit_is_early(dcontext, f, dcontext->last_exit))
+        trace_reform_start(dcontext, f, false);
+}
+
+/* Counts the last exit in profile r if it left the trace being measured.
+ * The caller must have made the local heap writable.
+ * Once the window is full, a trace whose exits are mostly side exits is
+ * deleted, so that its head is re-counted and a new trace is selected along
+ * the now-hot path; any other trace is relinked.  A re-formed trace is itself
+ * profiled once, for the before/after statistics.  Returns the fragment to
+ * enter, which is NULL if f was deleted.
+ */
+static fragment_t *
+trace_reform_count(dcontext_t *dcontext, fragment_t *f, trace_reform_t *r)
+{
+    fragment_t *trace_f;
+    uint early_exits, total;
+    bool early, after, retire;
+
+    trace_reform_lock(r);
+    trace_f = r->trace;
+    if (trace_f == NULL) {
+        bool measure = (f->tag == r->next_tag && TEST(FRAG_IS_TRACE, f->flags));
+        if (measure)
+            r->next_tag = NULL;
+        trace_reform_unlock(r);
+        if (measure)
+            trace_reform_start(dcontext, f, true);
+        return f;
+    }
+    if (dcontext->last_fragment != trace_f || LINKSTUB_FAKE(dcontext->last_exit) ||
+        !trace_reform_is_live(dcontext, r)) {
+        trace_reform_unlock(r);
+        return f;
+    }
+    early = trace_exit_is_early(dcontext, trace_f, dcontext->last_exit);
+    if (early)
+        r->early++;
+    else
+        r->final++;
+    DOSTATS({
+        if (r->after && early)
+            STATS_INC(trace_reform_early_after);
+        else if (r->after)
+            STATS_INC(trace_reform_final_after);
+        else if (early)
+            STATS_INC(trace_reform_early_before);
+        else
+            STATS_INC(trace_reform_final_before);
+    });
+    total = r->early + r->final;
+    if (total < DYNAMO_OPTION(trace_reform_window)) {
+        trace_reform_unlock(r);
+        return f;
+    }
+
+    /* Only this thread acts on the full window: the profile is released
+     * before deleting or relinking the trace, which take their own locks.
+     */
+    r->trace = NULL;
+    early_exits = r->early;
+    after = r->after;
+    retire = !after &&
+        (uint64)early_exits * 100 >= (uint64)DYNAMO_OPTION(trace_reform_percent) * total;
+    if (retire)
+        r->next_tag = trace_f->tag;
+    trace_reform_unlock(r);
+
+    if (retire) {
+        LOG(THREAD, LOG_MONITOR, 2,
+            "re-forming trace F%d("PFX"): %d of %d exits are side exits\n",
+            trace_f->id, trace_f->tag, early_exits, total);
+        if (f == trace_f)
+            f = NULL;
+        /* The head's counter is lazily reset (TH_COUNTER_CREATED_TRACE_VALUE)
+         * so it must become hot again before a new trace is built.
+         */
+        if (TEST(FRAG_SHARED, trace_f->flags)) {
+            last_exit_deleted(dcontext);
+            fragment_remove_shared_no_flush(dcontext, trace_f);
+        } else
+            fragment_delete(dcontext, trace_f, FRAGDEL_ALL);
+        STATS_INC(trace_reform_retired);
+    } else {
+        LOG(THREAD, LOG_MONITOR, 2,
+            "keeping trace F%d("PFX"): %d of %d exits are side exits\n",
+            trace_f->id, trace_f->tag, early_exits, total);
+        trace_reform_relink(dcontext, trace_f);
+        if (!after)
+            STATS_INC(trace_reform_kept);
+    }
+    return f;
+}
+
+/* Counts the last exit for -trace_reform_window in this thread's profile and
+ * in the shared one.  The shared profile is peeked at without the lock: a
+ * stale view only delays counting until the next entry.
+ */
+static fragment_t *
+trace_reform_cache_enter(dcontext_t *dcontext, fragment_t *f)
+{
+    monitor_data_t *md = (monitor_data_t *) dcontext->monitor_field;
+    bool mine = (md->reform.trace != NULL || md->reform.next_tag != NULL);
+    bool shared = (shared_reform.trace != NULL || shared_reform.next_tag != NULL);
+    if (!mine && !shared)
+        return f;
+    SELF_PROTECT_LOCAL(dcontext, WRITABLE);
+    if (mine)
+        f = trace_reform_count(dcontext, f, &md->reform);
+    if (f != NULL && shared)
+        f = trace_reform_count(dcontext, f, &shared_reform);
+    SELF_PROTECT_LOCAL(dcontext, READONLY);
+    return f;
+}
+
 /* This routine maintains the statistics that identify hot code
  * regions, and it controls the building and installation of trace
  * fragments.
@@ -1915,6 +2833,17 @@ monitor_cache_enter(dcontext_t *dcontext, fragment_t *f)
     trace_head_counter_t *ctr;
     uint add_size = 0, prev_mangle_size = 0; /* NOTE these aren't set if end_trace */
 
+    if (DYNAMO_OPTION(cache_hot_layout) && f != NULL && md->trace_tag == NULL)
+        f = hot_layout_cache_enter(dcontext, f);
+#ifdef ASYNC_OPTIMIZE
+    if (md->async_done != NULL && md->trace_tag == NULL)
+        f = async_optimize_swap(dcontext, f);
+#endif
+    if (md->ibl_demote_tag != NULL && md->trace_tag == NULL)
+        f = ibl_inline_cache_demote(dcontext, f);
+    if (DYNAMO_OPTION(trace_reform_window) > 0 && f != NULL && md->trace_tag == NULL)
+        f = trace_reform_cache_enter(dcontext, f);
+
     if (DYNAMO_OPTION(disable_traces) || f == NULL) {
         /* nothing to do */
         ASSERT(md->trace_tag == NULL);
@@ -2288,6 +3217,8 @@ monitor_cache_enter(dcontext_t *dcontext, fragment_t *f)
            for end of trace condition here. */
         /* unprotect local heap */
         SELF_PROTECT_LOCAL(dcontext, WRITABLE);
+        if (DYNAMO_OPTION(trace_reform_window) > 0)
+            trace_reform_side_exit(dcontext);
 #ifdef TRACE_HEAD_CACHE_INCR
         /* we don't have to worry about skipping the cache incr routine link
          * in the future since we can only encounter the trace head in our
@@ -47,10 +47,22 @@
 /* synchronization of shared traces */
 extern mutex_t trace_building_lock;
 
+#if defined(INTERNAL) && defined(CLIENT_SIDELINE) && defined(FRAG_UNOPTIMIZED)
+/* -optimize_async runs optimize_trace() on a client-style helper thread */
+# define ASYNC_OPTIMIZE
+#endif
+
 void monitor_init(void);
 void monitor_exit(void);
 void monitor_thread_init(dcontext_t *dcontext);
 void monitor_thread_exit(dcontext_t *dcontext);
+#ifdef ASYNC_OPTIMIZE
+/* starts the -optimize_async helper thread, once a dcontext exists */
+void monitor_async_optimize_init(void);
+# ifdef UNIX
+void monitor_async_optimize_fork_reset(void);
+# endif
+#endif
 
 /* re-initializes non-persistent memory */
 void monitor_thread_reset_init(dcontext_t *dcontext);
@@ -104,6 +116,14 @@ void trace_abort_and_delete(dcontext_t *dcontext);
 void
 thcounter_range_remove(dcontext_t *dcontext, app_pc start, app_pc end);
 
+void
+monitor_ibl_profile_exit(dcontext_t *dcontext, fragment_t *f, linkstub_t *l,
+                         app_pc target);
+
+uint
+monitor_ibl_inline_cache_targets(dcontext_t *dcontext, app_pc site_tag,
+                                 app_pc *targets/*OUT*/, uint max_targets);
+
 bool
 mangle_trace_at_end(void);
 
@@ -120,6 +140,41 @@ typedef struct _trace_head_counter_t {
     uint   counter;
 } trace_head_counter_t;
 
+/* The most targets -ibl_inline_cache will compare against inline. */
+#define IBL_INLINE_CACHE_MAX_TARGETS 4
+/* Distinct targets tracked per site; the rest are only counted in samples. */
+#define IBL_PROFILE_TARGETS 8
+
+/* Per-site indirect branch target profile for -ibl_inline_cache.  A site is
+ * identified by the tag of the basic block ending in the indirect branch.
+ * Unlike the trace head counters the profiles are process-wide, so a shared
+ * block gathers the targets seen by every thread.
+ */
+typedef struct _ibl_site_profile_t {
+    app_pc tag;
+    uint   samples;     /* ibl misses seen, including untracked targets */
+    uint   num_targets; /* valid entries in target and count */
+    /* set once the site has missed to more than -ibl_inline_cache distinct
+     * targets: it is then left to the ibl hashtable lookup
+     */
+    bool   megamorphic;
+    app_pc target[IBL_PROFILE_TARGETS];
+    uint   count[IBL_PROFILE_TARGETS];
+} ibl_site_profile_t;
+
+/* A -trace_reform_window profile of the exits of one trace, which is unlinked
+ * while it is measured.  A shared trace is unlinked for every thread, so its
+ * profile is kept process-wide and counts exits taken by any thread.
+ */
+typedef struct _trace_reform_t {
+    fragment_t *trace;    /* trace being measured, or NULL */
+    app_pc      tag;
+    uint        early;    /* exits from blocks before the last */
+    uint        final;    /* exits from the last block */
+    bool        after;    /* trace was re-formed from an earlier profile */
+    app_pc      next_tag; /* re-formed trace to measure next */
+} trace_reform_t;
+
 typedef struct _trace_bb_build_t {
     trace_bb_info_t info;
     /* PR 299808: we need to check bb bounds at emit time.  Also used
@@ -162,6 +217,20 @@ typedef struct _monitor_data_t {
      * separate table and not in the fragment_t structure.
      */
     generic_table_t  *thead_table;
+    /* -ibl_inline_cache: tag of a trace whose inline cache site has turned
+     * megamorphic, deleted at the next cache entry
+     */
+    app_pc           ibl_demote_tag;
+    /* -cache_hot_layout entry counts of private fragments, keyed by tag */
+    generic_table_t  *hot_table;
+    /* -trace_reform_window exit profile of a private trace */
+    trace_reform_t   reform;
+#ifdef ASYNC_OPTIMIZE
+    /* optimized copies of this thread's traces, appended by the
+     * -optimize_async helper thread under async_opt_lock
+     */
+    struct _async_opt_t *async_done;
+#endif
 
 #ifdef CLIENT_INTERFACE
     /* PR 299808: we re-build each bb and pass to the client */
@@ -1485,6 +1485,76 @@ check_option_compatibility_helper(int recurse_count)
         changed_options = true;
     }
 #endif
+    if (DYNAMO_OPTION(shadow_ret_stack)) {
+        if (!DYNAMO_OPTION(disable_traces) || DYNAMO_OPTION(coarse_units) ||
+            !DYNAMO_OPTION(ibl_table_in_tls)
+            IF_RETURN_AFTER_CALL(|| DYNAMO_OPTION(ret_after_call))) {
+            USAGE_ERROR("-shadow_ret_stack requires -disable_traces, -no_coarse_units, "
+                        "-ibl_table_in_tls, and -no_ret_after_call, disabling");
+            dynamo_options.shadow_ret_stack = false;
+            changed_options = true;
+        }
+    }
+#ifdef ARM
+    if (DYNAMO_OPTION(shadow_ret_stack)) {
+        /* FIXME i#1551: NYI on 32-bit ARM */
+        USAGE_ERROR("-shadow_ret_stack is not supported on ARM, disabling");
+        dynamo_options.shadow_ret_stack = false;
+        changed_options = true;
+    }
+#endif
+    if (DYNAMO_OPTION(ibl_inline_cache) > 0 && DYNAMO_OPTION(disable_traces)) {
+        /* the profiles are only consumed when building traces */
+        USAGE_ERROR("-ibl_inline_cache requires traces, disabling");
+        dynamo_options.ibl_inline_cache = 0;
+        changed_options = true;
+    }
+#ifndef X86
+    if (DYNAMO_OPTION(cache_hot_layout)) {
+        /* relies on re-encoding decoded fragments at a new address */
+        USAGE_ERROR("-cache_hot_layout is only supported on x86, disabling");
+        dynamo_options.cache_hot_layout = false;
+        changed_options = true;
+    }
+#endif
+    if (DYNAMO_OPTION(cache_hot_layout) &&
+        (DYNAMO_OPTION(cache_hot_max) < 16*PAGE_SIZE ||
+         !ALIGNED(DYNAMO_OPTION(cache_hot_max), PAGE_SIZE))) {
+        USAGE_ERROR("-cache_hot_max must be a multiple of the page size and at "
+                    "least 16 pages, adjusting");
+        dynamo_options.cache_hot_max =
+            (uint) ALIGN_FORWARD(MAX(DYNAMO_OPTION(cache_hot_max), 16*PAGE_SIZE),
+                                 PAGE_SIZE);
+        changed_options = true;
+    }
+    if (DYNAMO_OPTION(bb_build_claims) && DYNAMO_OPTION(coarse_units)) {
+        /* coarse bbs are emitted through a temporary fragment_t that is only
+         * protected by holding bb_building_lock across the whole build
+         */
+        USAGE_ERROR("-bb_build_claims is not supported with -coarse_units, disabling");
+        dynamo_options.bb_build_claims = false;
+        changed_options = true;
+    }
+    if (DYNAMO_OPTION(flush_epoch) &&
+        ((SHARED_BB_IB_TARGETS() && !DYNAMO_OPTION(shared_bb_ibt_tables)) ||
+         (DYNAMO_OPTION(shared_traces) && !DYNAMO_OPTION(shared_trace_ibt_tables)))) {
+        /* unlinking a shared fragment must not touch other threads' private
+         * ibt tables, as those threads are not stopped
+         */
+        USAGE_ERROR("-flush_epoch requires -shared_bb_ibt_tables and "
+                    "-shared_trace_ibt_tables, disabling");
+        dynamo_options.flush_epoch = false;
+        changed_options = true;
+    }
+    if (DYNAMO_OPTION(compact_translations) && !SHARED_FRAGMENTS_ENABLED()) {
+        /* the tables are keyed by fragment_t and only removed when a shared
+         * fragment is freed
+         */
+        USAGE_ERROR("-compact_translations only applies to shared fragments, "
+                    "disabling");
+        dynamo_options.compact_translations = false;
+        changed_options = true;
+    }
     if (DYNAMO_OPTION(IAT_elide) && !DYNAMO_OPTION(IAT_convert)) {
         USAGE_ERROR("-IAT_elide requires -IAT_convert, enabling");
         dynamo_options.IAT_convert = true;
@@ -642,6 +642,28 @@
     /* PR 304708: we intercept all signals for a better client interface */
     OPTION_DEFAULT(bool, intercept_all_signals, true, "intercept all signals")
 
+    /* Signals in this ,-separated list of signal numbers, real-time signals
+     * included, whose app handlers are known to be async-signal-safe, such as
+     * SIGPROF sample collectors, are delivered as soon as they interrupt a shared
+     * fragment instead of being delayed until the fragment exits, which requires
+     * unlinking and relinking it.  As with -compact_translations, a translation
+     * table is recorded for every shared fragment at emit time, so that the
+     * signal handler only looks one up.  Signals in fragments without a table, or
+     * arriving while the table is being updated, take the delayed path.
+     */
+    OPTION_DEFAULT(liststring_t, fast_signals, EMPTY_STRING,
+                   "async-signal-safe signal numbers to deliver without unlinking")
+
+    /* For pre-forking servers: a child of fork() already inherits the parent's
+     * code cache and fragment tables, and this keeps the child from placing new
+     * fragments in the inherited cache pages so they stay shared among all the
+     * children.  The child still writes to an inherited page, and so gets its own
+     * copy of it, when it links a new fragment to an inherited fragment's exit
+     * and when it deletes an inherited fragment (free list header or empty slot).
+     */
+    OPTION_DEFAULT(bool, zygote, false,
+                   "keep code cache inherited across fork shared with the parent")
+
     /* i#2080: we have had some problems using sigreturn to set a thread's
      * context to a given state.  Turning this off will instead use a direct
      * mechanism that will set only the GPR's and will assume the target stack
@@ -786,6 +808,14 @@
     /* PR 361894: if no TLS available, we fall back to thread-private */
     PC_OPTION_DEFAULT(bool, shared_bbs, IF_HAVE_TLS_ELSE(true, false),
                       "use thread-shared basic blocks")
+    /* Lets threads decode, instrument, and mangle different shared bbs in
+     * parallel, holding bb_building_lock only to emit and link them, while
+     * per-tag claims keep two threads from building the same bb.  The client bb
+     * event may then be called concurrently for different tags, even in the
+     * same module.
+     */
+    OPTION_DEFAULT(bool, bb_build_claims, false,
+                   "build shared bbs for different tags in parallel")
     /* Note that if we want traces off by default we would have to turn
      * off -shared_traces to avoid tripping over un-initialized ibl tables
      * PR 361894: if no TLS available, we fall back to thread-private
@@ -837,6 +867,8 @@
     OPTION_DEFAULT(bool, syscalls_synch_flush, true, "syscalls are flush synch points (currently for shared_deletion only)")
     OPTION_DEFAULT(uint, lazy_deletion_max_pending, 128,
         "maximum size of lazy shared deletion list before moving to normal list")
+    OPTION_DEFAULT(bool, flush_epoch, false,
+        "flush shared fragments without stopping threads, freeing them once every thread has passed a synch point (requires shared ibt tables)")
 
     OPTION_DEFAULT(bool, free_unmapped_futures, true,
         "free futures on app mem dealloc (potential perf hit)")
@@ -981,8 +1013,29 @@
                    "share ibl routine for traces")
     OPTION_DEFAULT(bool, speculate_last_exit, false,
         "enable speculative linking of trace last IB exit")
+    OPTION_DEFAULT(uint, ibl_inline_cache, 0,
+        /* The targets of each indirect branch that miss in the ibl table are
+         * counted per site, process-wide, without unlinking anything.  A trace
+         * ending in that block then compares the target against the most
+         * frequent ones, up to this many (at most 4), and jumps straight to
+         * their fragments.  A site that misses to more distinct targets is
+         * megamorphic and only uses the ibl hashtable lookup; traces already
+         * built with a compare chain for it are deleted and rebuilt.
+         */
+        "inline up to this many profiled targets at a trace's last IB exit")
 
     OPTION_DEFAULT(uint, max_trace_bbs, 128, "maximum number of basic blocks in a trace")
+    OPTION_DEFAULT(uint, trace_reform_window, 0,
+        /* When a secondary trace is started from a side exit of a trace, that
+         * trace is unlinked until this many of its exits have been counted.
+         * If exits from blocks before its final block make up at least
+         * -trace_reform_percent of them, the trace is deleted so that its
+         * head is re-counted and a new trace is selected along the current
+         * hot path.  Otherwise it is relinked unchanged.
+         */
+        "profile this many exits of a trace whose side exit became hot")
+    OPTION_DEFAULT(uint, trace_reform_percent, 50,
+        "percentage of side exits at which -trace_reform_window re-forms a trace")
 
     /* FIXME: case 8023 covers re-enabling on linux */
     OPTION_DEFAULT(uint, protect_mask,
@@ -1007,6 +1060,25 @@
         /* Ignore LSB bits for indcall hashtables. */
         "mask out lower bits in indcall IBL table hash function")
 
+    OPTION_DEFAULT(bool, ibl_buckets, false,
+        /* x64 only: lookups in IBL tables outside the code cache compare the tags
+         * of a cache line's worth of entries at once with SSE2, rather than
+         * probing one entry at a time.  The table layout and the in-cache lookup
+         * routines are unchanged.
+         */
+        "compare IBL table tags a cache line at a time in C lookups")
+
+    OPTION_DEFAULT(bool, shadow_ret_stack, false,
+        /* Each mangled call records its return address and the cache address of
+         * an exit to it on a per-thread shadow stack, and each mangled return
+         * compares its target against the top entry and jumps straight there on
+         * a match, only falling back to the ibl on a mismatch.  The landing
+         * addresses are absolute and are not updated by trace building or
+         * coarse-grain freezing, so this requires -disable_traces and
+         * -no_coarse_units.
+         */
+        "predict returns with a per-thread shadow stack of fcache return sites")
+
     OPTION_DEFAULT_INTERNAL(uint, shared_bb_load,
         /* FIXME: since resizing is costly (no delete) this used to be up to 65 but that
          * hurt us lot (case 1677) when we hit a bad hash function distribution -
@@ -1146,8 +1218,42 @@
     OPTION_DEFAULT_INTERNAL(uint_size, max_heap_unit_size, 256*1024, "maximum heap unit size")
     /* heap_commit_increment may be adjusted by adjust_defaults_for_page_size(). */
     OPTION_DEFAULT(uint_size, heap_commit_increment, 4*1024, "heap commit increment")
+    /* Gives each thread a bounded free list per bucket size in front of the
+     * global and global non-persistent heaps, which it refills from and
+     * drains to them half a magazine at a time under global_alloc_lock.
+     * 0 disables.
+     */
+    OPTION_DEFAULT(uint, heap_magazine_size, 0,
+                   "blocks cached per thread and size in front of the global heap")
+    /* Carves the instr_t, operand, raw byte and instrlist_t storage of each bb
+     * being built for the code cache out of a per-thread arena of chunks of this
+     * size, which is reset as a whole once the bb is emitted, rather than
+     * freeing each allocation.  0 disables.  Off by default, as clients that
+     * keep bb IR beyond the bb event must first call dr_keep_bb_ir().
+     */
+    OPTION_DEFAULT(uint_size, bb_ir_arena, 0,
+                   "per-thread arena chunk size for the IR of bbs being built")
     /* cache_commit_increment may be adjusted by adjust_defaults_for_page_size(). */
     OPTION_DEFAULT(uint, cache_commit_increment, 4*1024, "cache commit increment")
+    /* Places each shared cache unit on a 2MB boundary, fully committed, and
+     * asks the kernel to back it with transparent huge pages to reduce iTLB
+     * misses.  Shared unit sizes are rounded up to 2MB multiples; thread-private
+     * units are left alone.  See fcache_check_option_compatibility().
+     */
+    OPTION_DEFAULT(bool, cache_huge_pages, false,
+                   "back shared code cache units with 2MB huge pages")
+    /* Packs hot thread-private code into dedicated hot caches of
+     * -cache_hot_max bytes rather than interleaving it with cold fragments.
+     * New traces, whose heads have just become hot, are emitted there
+     * directly.  Linked fragments are not counted, but other fragments
+     * entered from dispatch -cache_hot_threshold times are re-emitted there.
+     */
+    OPTION_DEFAULT(bool, cache_hot_layout, false,
+                   "move hot private fragments into a separate contiguous cache")
+    OPTION_DEFAULT(uint, cache_hot_threshold, 50,
+                   "cache entries from dispatch after which a fragment is hot")
+    OPTION_DEFAULT(uint_size, cache_hot_max, (128*1024),
+                   "size of each -cache_hot_layout hot cache, in KB or MB")
 
     /* cache capacity control
      * FIXME: these are external for now while we study the right way to
@@ -1247,6 +1353,12 @@
         "adaptive working set shared trace cache management")
     OPTION_DEFAULT(bool, finite_coarse_bb_cache, false,
         "adaptive working set shared bb cache management")
+    /* Replaces private FIFO cache fragments in second-chance (clock) order
+     * rather than plain FIFO order, sampling references by unlinking fragments
+     * the hand passes; see clock_second_chance() in fcache.c.
+     */
+    OPTION_DEFAULT(bool, cache_clock_replace, false,
+        "second-chance replacement for finite private caches")
     OPTION_DEFAULT(uint_size, cache_bb_unit_upgrade, (64*1024),
         "bb cache units are always upgraded to this size, in KB or MB")
         /* default size is in Kilobytes, Examples: 4, 4k, 4m, or 0 for unlimited */
@@ -1988,6 +2100,14 @@ IF_RCT_IND_BRANCH(options->rct_ind_jump = OPTION_DISABLED;)
         "store info at flush time for safe post-flush translation")
     PC_OPTION_INTERNAL(bool, store_translations,
         "store info at emit time for fragment translation")
+    /* Unlike -store_translations, keeps a compact table on the side for each
+     * shared fragment, trading memory for cheap repeated translation in apps
+     * that take many faults or signals in the cache.  Thread-private fragments
+     * get no table, so this has no effect with -thread_private.
+     */
+    OPTION_DEFAULT(bool, compact_translations, false,
+        "record compact translation tables for all shared fragments at emit time "
+        "(no effect on thread-private fragments)")
     /* i#698: our fpu state xl8 is a perf hit for some apps */
     PC_OPTION(bool, translate_fpu_pc,
         "translate the saved last floating-point pc when FPU state is saved")
@@ -2749,6 +2869,8 @@ IF_RCT_IND_BRANCH(options->rct_ind_jump = OPTION_DISABLED;)
     /* FIXME: case 4471 should start smaller and double instead */
     OPTION_DEFAULT_INTERNAL(uint, vmarea_increment_size, 100,
         "incremental vmarea vector size")
+    OPTION_DEFAULT(bool, vmarea_lockless_reads, false,
+        "look up executable and DR areas without taking their locks")
     OPTION_INTERNAL(uint_addr, stress_fake_userva,
         "pretend system address space starts at this address (case 9022)")
 
@@ -2805,6 +2927,12 @@ IF_RCT_IND_BRANCH(options->rct_ind_jump = OPTION_DISABLED;)
 # ifdef SIDELINE
     OPTION(bool, sideline, "use sideline thread for optimization")
 # endif
+    /* Only thread-private traces are optimized asynchronously: a shared trace
+     * cannot be swapped by one thread, so with -shared_traces this warns and
+     * traces are optimized in place.
+     */
+    OPTION(bool, optimize_async,
+        "run the -optimize passes on a helper thread and swap the optimized traces in")
     /* optimizations */
 
 # if 0 /* this flag does nothing yet...disable so people don't try to use it */
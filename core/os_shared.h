@@ -146,6 +146,11 @@ bool os_heap_systemwide_overcommit(heap_error_code_t last_error_code);
 
 bool os_heap_get_commit_limit(size_t *commit_used, size_t *commit_limit);
 
+/* Asks the OS to back the committed region [p, p+size) with huge pages.  Returns
+ * false if the request is not supported or was refused.
+ */
+bool os_heap_advise_huge_pages(void *p, size_t size);
+
 thread_id_t get_thread_id(void);
 process_id_t get_process_id(void);
 void os_thread_yield(void);
@@ -111,38 +111,32 @@ coarse_unit_mark_primary(coarse_info_t *info)
 {
     if (!info->in_use)
         return;
-#ifdef WINDOWS
-    /* FIXME PR 295529: put in for Linux once we have per-module flags */
     /* Go ahead and get write lock up front; else have to check again; not
      * frequently called so don't need perf opt here.
      */
     os_get_module_info_write_lock();
     if (!os_module_get_flag(info->base_pc, MODULE_HAS_PRIMARY_COARSE)) {
-        os_module_set_flag(info->base_pc, MODULE_HAS_PRIMARY_COARSE);
-        ASSERT(os_module_get_flag(info->base_pc, MODULE_HAS_PRIMARY_COARSE));
+        /* An ELF module can have several +x segments, each its own unit */
+        if (os_module_set_flag(info->base_pc, MODULE_HAS_PRIMARY_COARSE)) {
+            ASSERT(os_module_get_flag(info->base_pc, MODULE_HAS_PRIMARY_COARSE));
+        } else {
+            /* Not in the module list (e.g., came in late): nothing to share */
+            ASSERT_CURIOSITY(false && "coarse unit outside of any module");
+        }
         info->primary_for_module = true;
         LOG(GLOBAL, LOG_CACHE, 1, "marking "PFX"-"PFX" as primary coarse for %s\n",
             info->base_pc, info->end_pc, info->module);
     }
     os_get_module_info_write_unlock();
-#else
-    info->primary_for_module = true;
-#endif
 }
 
 static void
 coarse_unit_unmark_primary(coarse_info_t *info)
 {
-#ifdef WINDOWS
-    /* FIXME PR 295529: put in for Linux once we have per-module flags */
     if (info->primary_for_module && info->in_use) {
-        ASSERT(os_module_get_flag(info->base_pc, MODULE_HAS_PRIMARY_COARSE));
         os_module_clear_flag(info->base_pc, MODULE_HAS_PRIMARY_COARSE);
         info->primary_for_module = false;
     }
-#else
-    info->primary_for_module = false;
-#endif
 }
 
 void
@@ -3135,6 +3129,18 @@ coarse_unit_persist_rename(dcontext_t *dcontext, const char *filename,
                            const char *tmpname)
 {
     bool success = false;
+#ifdef UNIX
+    /* rename(2) atomically replaces any existing file, and processes that have
+     * the old file mapped keep using it, so we do not need the rename-aside
+     * sequence below.  That sequence leaves a window with no file in place
+     * where a concurrent writer in a shared cache dir can win and discard our
+     * file.  Here the last writer wins and readers always see a complete file.
+     */
+    if (os_rename_file(tmpname, filename, true/*replace*/))
+        success = true;
+    else
+        STATS_INC(persist_rename_fail);
+#else
     char rename[MAXIMUM_PATH];
     if (os_rename_file(tmpname, filename, false/*do not replace*/)) {
         success = true;
@@ -3176,6 +3182,7 @@ coarse_unit_persist_rename(dcontext_t *dcontext, const char *filename,
             }
         }
     }
+#endif
     return success;
 }
 
@@ -95,6 +95,8 @@ typedef struct _translate_walk_t {
     bool in_mangle_region;
     /* What is the translation target of the current mangle region */
     app_pc translation;
+    /* Are we inside a -shadow_ret_stack push or check sequence */
+    bool in_shadow_ret;
 } translate_walk_t;
 
 static void
@@ -158,6 +160,20 @@ instr_is_seg_ref_load(dcontext_t *dcontext, instr_t *inst)
 }
 #endif /* UNIX */
 
+/* Both the -shadow_ret_stack push and check start by loading the stack index,
+ * which nothing else touches.
+ */
+static inline bool
+instr_is_shadow_ret_index_load(dcontext_t *dcontext, instr_t *inst)
+{
+    if (!DYNAMO_OPTION(shadow_ret_stack) || !instr_is_our_mangling(inst))
+        return false;
+    return (instr_get_opcode(inst) == IF_X86_ELSE(OP_movzx, OP_ldrb) &&
+            opnd_same(instr_get_src(inst, 0),
+                      opnd_create_sized_tls_slot
+                      (os_tls_offset(TLS_SHADOW_RET_INDEX_SLOT), OPSZ_1)));
+}
+
 #ifdef ARM
 static bool
 instr_is_mov_PC_immed(dcontext_t *dcontext, instr_t *inst)
@@ -187,6 +203,7 @@ translate_walk_track(dcontext_t *tdcontext, instr_t *inst, translate_walk_t *wal
          */
         walk->in_mangle_region = false;
         walk->unsupported_mangle = false;
+        walk->in_shadow_ret = false;
         walk->xsp_adjust = 0;
         for (r = 0; r < REG_SPILL_NUM; r++) {
             /* we should have seen a restore for every spill, unless at
@@ -235,7 +252,19 @@ translate_walk_track(dcontext_t *tdcontext, instr_t *inst, translate_walk_t *wal
          * comment above for post-mangling traces), and so for local
          * spills like rip-rel and ind branches this is fine.
          */
-        if (instr_is_cti(inst)
+        if (instr_is_shadow_ret_index_load(tdcontext, inst))
+            walk->in_shadow_ret = true;
+        if (walk->in_shadow_ret && instr_is_cti(inst)) {
+            /* The -shadow_ret_stack ctis lead to out-of-line copies of the
+             * final restores (the landing or the hit path), which this linear
+             * walk would track wrongly.  Up to the first unconditional one,
+             * though, we are on the straight-line path and the spills are
+             * accurate: a relocated thread then just redoes the push or check
+             * when it re-executes the call or return.
+             */
+            if (!instr_is_cbr(inst))
+                walk->unsupported_mangle = true;
+        } else if (instr_is_cti(inst)
 #ifdef X86
             &&
             /* Do not reset for a trace-cmp jecxz or jmp (32-bit) or
@@ -319,6 +348,12 @@ translate_walk_track(dcontext_t *tdcontext, instr_t *inst, translate_walk_t *wal
         else if (instr_check_xsp_mangling(tdcontext, inst, &walk->xsp_adjust)) {
             /* walk->xsp_adjust is now adjusted */
         }
+        else if (walk->in_shadow_ret) {
+            /* Nothing to do: the rest of the -shadow_ret_stack sequence only
+             * touches TLS and DR heap, so it cannot fault, and its ctis were
+             * handled above.
+             */
+        }
         else if (instr_is_trace_cmp(tdcontext, inst)) {
             /* nothing to do */
             /* We don't support restoring a fault in the middle, but we
@@ -563,6 +598,8 @@ recreate_app_state_from_info(dcontext_t *tdcontext, const translation_info_t *in
         DOCHECK(1, {
             if (!(res == RECREATE_SUCCESS_STATE /* clean call */ ||
                   tdcontext != get_thread_private_dcontext() ||
+                  /* -fast_signals: an asynchronous signal can land anywhere */
+                  IF_UNIX(tdcontext->xl8_nowait ||)
                   INTERNAL_OPTION(stress_recreate_pc) ||
                   /* we can currently fail for flushed code (PR 208037/i#399)
                    * (and hotpatch, native_exec, and sysenter: but too rare to check) */
@@ -593,6 +630,77 @@ recreate_app_state_from_info(dcontext_t *tdcontext, const translation_info_t *in
     return res;
 }
 
+static translation_info_t *
+translation_info_alloc(dcontext_t *dcontext, uint num_entries);
+
+static inline app_pc
+compact_translation_app(const compact_translation_info_t *info, uint i, app_pc tag)
+{
+    if (TEST(TRANSLATE_NULL_APP, info->translation[i].flags))
+        return NULL;
+    return tag + info->translation[i].app_offs;
+}
+
+/* Like recreate_app_state_from_info() but for the compact table of f.
+ * A pc-only translation is a binary search of the table.  Recreating the
+ * full state must still walk f to track spilled registers, so we expand the
+ * table and hand it to recreate_app_state_from_info().
+ */
+/* Use THREAD_GET instead of THREAD so log messages go to calling thread */
+static recreate_success_t
+recreate_app_state_from_compact(dcontext_t *tdcontext,
+                                const compact_translation_info_t *info,
+                                fragment_t *f, priv_mcontext_t *mc, bool just_pc)
+{
+    recreate_success_t res;
+    uint i;
+    if (just_pc) {
+        uint lo = 0, hi = info->num_entries;
+        ptr_uint_t offs = mc->pc - f->start_pc;
+        app_pc answer;
+        ASSERT(info->num_entries > 0 && info->translation[0].cache_offs == 0);
+        /* find the last change point at or before the target */
+        while (hi - lo > 1) {
+            uint mid = (lo + hi) / 2;
+            if (info->translation[mid].cache_offs <= offs)
+                lo = mid;
+            else
+                hi = mid;
+        }
+        answer = compact_translation_app(info, lo, f->tag);
+        if (answer == NULL) {
+            /* As in recreate_app_state_from_info(), for client meta-code we use
+             * the next app instr's translation.
+             */
+            for (i = lo + 1; i < info->num_entries; i++) {
+                answer = compact_translation_app(info, i, f->tag);
+                if (answer != NULL)
+                    break;
+            }
+            ASSERT(answer != NULL);
+        } else if (!TEST(TRANSLATE_IDENTICAL, info->translation[lo].flags))
+            answer += offs - info->translation[lo].cache_offs;
+        LOG(THREAD_GET, LOG_INTERP, 2,
+            "recreate_app -- found ok pc "PFX" via compact table entry %d\n",
+            answer, lo);
+        mc->pc = answer;
+        return RECREATE_SUCCESS_PC;
+    } else {
+        translation_info_t *full = translation_info_alloc(tdcontext, info->num_entries);
+        for (i = 0; i < info->num_entries; i++) {
+            full->translation[i].cache_offs = info->translation[i].cache_offs;
+            full->translation[i].flags =
+                info->translation[i].flags & ~TRANSLATE_NULL_APP;
+            full->translation[i].app = compact_translation_app(info, i, f->tag);
+        }
+        res = recreate_app_state_from_info(tdcontext, full, (byte *) f->start_pc,
+                                           (byte *) f->start_pc + f->size,
+                                           mc, false _IF_DEBUG(f->flags));
+        translation_info_free(tdcontext, full);
+        return res;
+    }
+}
+
 /* Returns a success code, but makes a best effort regardless.
  * If just_pc is true, only recreates pc.
  * Modifies mc with the recreated state.
@@ -1005,6 +1113,8 @@ recreate_app_state_internal(dcontext_t *tdcontext, priv_mcontext_t *mcontext,
         cache_pc cti_pc;
         instrlist_t *ilist = NULL;
         fragment_t *f = owning_f;
+        const translation_info_t *info = NULL;
+        const compact_translation_info_t *cinfo = NULL;
         bool alloc = false, ok;
         dr_isa_mode_t old_mode;
 #ifdef WINDOWS
@@ -1049,11 +1159,31 @@ recreate_app_state_internal(dcontext_t *tdcontext, priv_mcontext_t *mcontext,
             alloc = true;
         }
 
+        if (f != NULL) {
+            info = FRAGMENT_TRANSLATION_INFO(f);
+            /* -compact_translations or -fast_signals may have cached a table
+             * for f.  We hold it until we're done with it.
+             */
+            if (info == NULL) {
+                cinfo = fragment_acquire_cached_translation_info
+                    (f, IF_UNIX_ELSE(!tdcontext->xl8_nowait, true));
+#ifdef UNIX
+                if (cinfo == NULL && tdcontext->xl8_nowait) {
+                    /* Rebuilding f would allocate and could block. */
+                    res = RECREATE_FAILURE;
+                    goto recreate_app_state_done;
+                }
+#endif
+            }
+        }
+
         /* Whether a bb or trace, this routine will recreate the entire ilist. */
         if (f == NULL) {
             ilist = recreate_fragment_ilist(tdcontext, mcontext->pc, &f, &alloc,
                                             true/*mangle*/ _IF_CLIENT(true/*client*/));
-        } else if (FRAGMENT_TRANSLATION_INFO(f) == NULL) {
+            if (ilist == NULL && f != NULL)
+                info = FRAGMENT_TRANSLATION_INFO(f);
+        } else if (info == NULL && cinfo == NULL) {
             if (TEST(FRAG_SELFMOD_SANDBOXED, f->flags)) {
                 ilist = recreate_selfmod_ilist(tdcontext, f);
             } else {
@@ -1067,7 +1197,7 @@ recreate_app_state_internal(dcontext_t *tdcontext, priv_mcontext_t *mcontext,
                 ASSERT(!new_alloc);
             }
         }
-        if (ilist == NULL && (f == NULL || FRAGMENT_TRANSLATION_INFO(f) == NULL)) {
+        if (ilist == NULL && (f == NULL || (info == NULL && cinfo == NULL))) {
             /* It is problematic if this routine fails.  Many places assume that
              * recreate_app_pc() will work.
              */
@@ -1130,11 +1260,18 @@ recreate_app_state_internal(dcontext_t *tdcontext, priv_mcontext_t *mcontext,
         client_info.raw_mcontext = &raw_mcontext;
         client_info.raw_mcontext_valid = true;
 #endif
-        if (ilist == NULL) {
-            ASSERT(f != NULL && FRAGMENT_TRANSLATION_INFO(f) != NULL);
+        if (ilist == NULL && info == NULL) {
+            ASSERT(f != NULL && cinfo != NULL);
+            /* the table stays valid while we hold it */
+            res = recreate_app_state_from_compact(tdcontext, cinfo, f, mcontext,
+                                                  just_pc);
+            fragment_release_cached_translation_info();
+            STATS_INC(recreate_via_cached_info);
+        } else if (ilist == NULL) {
+            ASSERT(f != NULL && info != NULL);
             ASSERT(!TEST(FRAG_WAS_DELETED, f->flags) ||
                    INTERNAL_OPTION(safe_translate_flushed));
-            res = recreate_app_state_from_info(tdcontext, FRAGMENT_TRANSLATION_INFO(f),
+            res = recreate_app_state_from_info(tdcontext, info,
                                                (byte *) f->start_pc,
                                                (byte *) f->start_pc + f->size,
                                                mcontext, just_pc _IF_DEBUG(f->flags));
@@ -1388,6 +1525,55 @@ translation_info_print(const translation_info_t *info, cache_pc start, file_t fi
     }
 }
 
+static inline uint
+compact_translation_info_alloc_size(uint num_entries)
+{
+    return (sizeof(compact_translation_info_t) +
+            sizeof(compact_translation_entry_t)*num_entries);
+}
+
+/* Returns a compact copy of info for the fragment with the given tag, or NULL if
+ * some app pc is too far from tag to be encoded.
+ */
+compact_translation_info_t *
+translation_info_compact(dcontext_t *dcontext, const translation_info_t *info,
+                         app_pc tag)
+{
+    compact_translation_info_t *cinfo;
+    uint i;
+    for (i = 0; i < info->num_entries; i++) {
+        if (info->translation[i].app != NULL &&
+            !REL32_REACHABLE(tag, info->translation[i].app))
+            return NULL;
+    }
+    cinfo = global_heap_alloc(compact_translation_info_alloc_size(info->num_entries)
+                              HEAPACCT(ACCT_XL8_TABLE));
+    cinfo->num_entries = info->num_entries;
+    for (i = 0; i < info->num_entries; i++) {
+        cinfo->translation[i].cache_offs = info->translation[i].cache_offs;
+        cinfo->translation[i].flags = info->translation[i].flags;
+        if (info->translation[i].app == NULL) {
+            cinfo->translation[i].flags |= TRANSLATE_NULL_APP;
+            cinfo->translation[i].app_offs = 0;
+        } else {
+            cinfo->translation[i].app_offs =
+                (int) (info->translation[i].app - tag);
+        }
+    }
+    STATS_ADD_PEAK(compact_translation_bytes,
+                   compact_translation_info_alloc_size(cinfo->num_entries));
+    return cinfo;
+}
+
+void
+compact_translation_info_free(dcontext_t *dcontext, compact_translation_info_t *info)
+{
+    STATS_SUB(compact_translation_bytes,
+              compact_translation_info_alloc_size(info->num_entries));
+    global_heap_free(info, compact_translation_info_alloc_size(info->num_entries)
+                     HEAPACCT(ACCT_XL8_TABLE));
+}
+
 /* With our weak flushing consistency we must store translation info
  * for any fragment that may outlive its original app code (case
  * 3559).  Here we store actual translation info.  An alternative is
@@ -53,6 +53,7 @@ enum {
      */
     TRANSLATE_IDENTICAL      = 0x0001, /* otherwise contiguous */
     TRANSLATE_OUR_MANGLING   = 0x0002, /* added by our own mangling (PR 267260) */
+    TRANSLATE_NULL_APP       = 0x0004, /* compact tables only: NULL app pc */
 }; /* no typedef b/c we need ushort not int */
 
 /* Translation table entry (case 3559).
@@ -81,6 +82,24 @@ typedef struct _translation_info_t {
     translation_entry_t translation[1]; /* variable-sized */
 } translation_info_t;
 
+/* Compact form of translation_info_t used for -compact_translations, with each
+ * app pc stored as a 32-bit offset from the fragment tag, making entries half the
+ * size of translation_entry_t on 64-bit.  Since the entries are fixed-size and
+ * sorted by cache_offs, a pc can be looked up with a binary search.
+ */
+typedef struct _compact_translation_entry_t {
+    ushort cache_offs;
+    ushort flags;
+    /* app pc minus the fragment tag, unless TRANSLATE_NULL_APP is set */
+    int app_offs;
+} compact_translation_entry_t;
+
+typedef struct _compact_translation_info_t {
+    uint num_entries;
+    /* an array of num_entries elements */
+    compact_translation_entry_t translation[1]; /* variable-sized */
+} compact_translation_info_t;
+
 /* PR 244737: all generated code is thread-shared on x64 */
 #define IS_SHARED_SYSCALL_THREAD_SHARED IF_X64_ELSE(true, false)
 
@@ -101,6 +120,11 @@ void translation_info_free(dcontext_t *tdcontext, translation_info_t *info);
 translation_info_t *record_translation_info(dcontext_t *dcontext, fragment_t *f,
                                             instrlist_t *ilist);
 void translation_info_print(const translation_info_t *info, cache_pc start, file_t file);
+compact_translation_info_t *
+translation_info_compact(dcontext_t *dcontext, const translation_info_t *info,
+                         app_pc tag);
+void compact_translation_info_free(dcontext_t *dcontext,
+                                   compact_translation_info_t *info);
 #ifdef INTERNAL
 void stress_test_recreate_state(dcontext_t *dcontext, fragment_t *f, instrlist_t *ilist);
 #endif
@@ -42,6 +42,8 @@ void unit_test_os(void);
 #endif
 void unit_test_options(void);
 void unit_test_vmareas(void);
+void unit_test_heap(void);
+void unit_test_fragment(void);
 void unit_test_utils(void);
 #ifdef WINDOWS
 void unit_test_drwinapi(void);
@@ -67,6 +69,8 @@ main(int argc, char **argv, char **envp)
     unit_test_utils();
     unit_test_options();
     unit_test_vmareas();
+    unit_test_heap();
+    unit_test_fragment();
 #ifdef WINDOWS
     unit_test_drwinapi();
 #endif
@@ -188,7 +188,8 @@ os_module_area_init(module_area_t *ma, app_pc base, size_t view_size,
 
     /* Fields for pcaches (PR 295534).  These entries are not present in
      * all libs: I see DT_CHECKSUM and the prelink field on FC12 but not
-     * on Ubuntu 9.04.
+     * on Ubuntu 9.04.  Most current libs do have a GNU build id, which
+     * module_walk_program_headers() uses as the checksum when present.
      */
     if (ma->os_data.checksum == 0 &&
         (DYNAMO_OPTION(coarse_enable_freeze) || DYNAMO_OPTION(use_persisted))) {
@@ -482,6 +482,35 @@ module_fill_os_data(ELF_PROGRAM_HEADER_TYPE *prog_hdr, /* PT_DYNAMIC entry */
     return res;
 }
 
+/* Returns a checksum of the GNU build id in the PT_NOTE segment prog_hdr, or 0
+ * if it has none or it is not within the view.  The build id identifies the
+ * exact binary, making it a better persisted cache key (PR 295534) than
+ * DT_CHECKSUM, which few libraries have, or a checksum of the first page.
+ */
+static size_t
+module_build_id_checksum(ELF_PROGRAM_HEADER_TYPE *prog_hdr, app_pc base,
+                         size_t view_size, ptr_int_t load_delta)
+{
+    byte *note = (byte *) prog_hdr->p_vaddr + load_delta;
+    byte *end = note + prog_hdr->p_filesz;
+    if (note < base || end < note || end > base + view_size)
+        return 0;
+    while (note + sizeof(ELF_NOTE_HEADER_TYPE) <= end) {
+        ELF_NOTE_HEADER_TYPE *nhdr = (ELF_NOTE_HEADER_TYPE *) note;
+        byte *name = note + sizeof(*nhdr);
+        /* name and desc are each padded to 4 bytes for both classes */
+        byte *desc = name + ALIGN_FORWARD(nhdr->n_namesz, 4);
+        byte *next = desc + ALIGN_FORWARD(nhdr->n_descsz, 4);
+        if (next > end || next <= note)
+            break;
+        if (nhdr->n_type == NT_GNU_BUILD_ID && nhdr->n_namesz == sizeof("GNU") &&
+            memcmp(name, "GNU", sizeof("GNU")) == 0 && nhdr->n_descsz > 0)
+            return crc32((const char *) desc, nhdr->n_descsz);
+        note = next;
+    }
+    return 0;
+}
+
 /* Returned addresses out_base and out_end are relative to the actual
  * loaded module base, so the "base" param should be added to produce
  * absolute addresses.
@@ -500,6 +529,7 @@ module_walk_program_headers(app_pc base, size_t view_size, bool at_map, bool dyn
     app_pc mod_base = NULL, first_end = NULL, max_end = NULL;
     char *soname = NULL;
     bool found_load = false;
+    size_t build_id_checksum = 0;
     ELF_HEADER_TYPE *elf_hdr = (ELF_HEADER_TYPE *) base;
     ptr_int_t load_delta; /* delta loaded at relative to base */
     ASSERT(is_elf_so_header(base, view_size));
@@ -557,6 +587,19 @@ module_walk_program_headers(app_pc base, size_t view_size, bool at_map, bool dyn
                     }
                 });
             }
+            if (out_data != NULL && prog_hdr->p_type == PT_NOTE &&
+                build_id_checksum == 0) {
+                build_id_checksum =
+                    module_build_id_checksum(prog_hdr, base, view_size, load_delta);
+            }
+        }
+        /* The build id takes precedence over DT_CHECKSUM regardless of which
+         * program header came first.
+         */
+        if (build_id_checksum != 0) {
+            LOG(GLOBAL, LOG_VMAREAS, 2, "%s "PFX": build id checksum "PFX"\n",
+                __FUNCTION__, base, build_id_checksum);
+            out_data->checksum = build_id_checksum;
         }
     }
     ASSERT_CURIOSITY(found_load && mod_base != (app_pc)POINTER_MAX &&
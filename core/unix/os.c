@@ -58,6 +58,9 @@
 #ifndef MAP_ANONYMOUS
 # define MAP_ANONYMOUS MAP_ANON /* MAP_ANON on Mac */
 #endif
+#ifndef MADV_HUGEPAGE /* in linux 2.6.38+ */
+# define MADV_HUGEPAGE 14
+#endif
 /* for open */
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -3253,6 +3256,25 @@ os_heap_get_commit_limit(size_t *commit_used, size_t *commit_limit)
     return false;
 }
 
+bool
+os_heap_advise_huge_pages(void *p, size_t size)
+{
+#ifdef LINUX
+    /* Transparent huge pages: the kernel backs each 2MB-aligned piece of the
+     * region with a huge page on fault (or later via khugepaged) as long as the
+     * piece has uniform protection, so a later mprotect of part of it just
+     * splits that huge page.
+     */
+    long res = dynamorio_syscall(SYS_madvise, 3, p, size, MADV_HUGEPAGE);
+    LOG(GLOBAL, LOG_HEAP, 2, "os_heap_advise_huge_pages: %d bytes @ "PFX" => %d\n",
+        size, p, res);
+    return (res == 0);
+#else
+    /* FIXME: NYI on Mac */
+    return false;
+#endif
+}
+
 /* yield the current thread */
 void
 os_thread_yield()
@@ -5083,11 +5105,10 @@ const reg_id_t syscall_regparms[MAX_SYSCALL_ARGS] = {
 
 #ifndef NOT_DYNAMORIO_CORE_PROPER
 
+/* was_int is only consulted for 32-bit x86 */
 static inline reg_t *
-sys_param_addr(dcontext_t *dcontext, int num)
+mc_sys_param_addr(priv_mcontext_t *mc, int num, bool was_int)
 {
-    /* we force-inline get_mcontext() and so don't take it as a param */
-    priv_mcontext_t *mc = get_mcontext(dcontext);
 #if defined(X86) && defined(X64)
     switch (num) {
     case 0: return &mc->xdi;
@@ -5129,8 +5150,7 @@ sys_param_addr(dcontext_t *dcontext, int num)
     case 4: return &mc->IF_X86_ELSE(xdi, r4);
     /* FIXME: do a safe_read: but what about performance?
      * See the #if 0 below, as well. */
-    case 5: return IF_X86_ELSE((dcontext->sys_was_int ? &mc->xbp : ((reg_t*)mc->xsp)),
-                               &mc->r5);
+    case 5: return IF_X86_ELSE((was_int ? &mc->xbp : ((reg_t*)mc->xsp)), &mc->r5);
 # ifdef ARM
     /* AArch32 supposedly has 7 args in some cases. */
     case 6: return &mc->r6;
@@ -5141,6 +5161,13 @@ sys_param_addr(dcontext_t *dcontext, int num)
     return 0;
 }
 
+static inline reg_t *
+sys_param_addr(dcontext_t *dcontext, int num)
+{
+    /* we force-inline get_mcontext() and so don't take it as a param */
+    return mc_sys_param_addr(get_mcontext(dcontext), num, dcontext->sys_was_int);
+}
+
 static inline reg_t
 sys_param(dcontext_t *dcontext, int num)
 {
@@ -5210,6 +5237,30 @@ set_failure_return_val(dcontext_t *dcontext, uint errno_val)
 }
 
 #ifdef CLIENT_INTERFACE
+/* Clean call targets inserted by bb building around inlined syscalls that a
+ * client selected via dr_register_filter_inline_syscall_event().  The app
+ * state is on the dstack, not in the dcontext, as we never left the cache.
+ */
+void
+inline_syscall_pre_hook(int sysnum, bool was_int)
+{
+    dcontext_t *dcontext = get_thread_private_dcontext();
+    priv_mcontext_t *mc = get_priv_mcontext_from_dstack(dcontext);
+    reg_t params[DR_INLINE_SYSCALL_NUM_PARAMS];
+    int i;
+    for (i = 0; i < DR_INLINE_SYSCALL_NUM_PARAMS; i++)
+        params[i] = *mc_sys_param_addr(mc, i, was_int);
+    instrument_pre_inline_syscall(dcontext, sysnum, params);
+}
+
+void
+inline_syscall_post_hook(int sysnum)
+{
+    dcontext_t *dcontext = get_thread_private_dcontext();
+    priv_mcontext_t *mc = get_priv_mcontext_from_dstack(dcontext);
+    instrument_post_inline_syscall(dcontext, sysnum, MCXT_SYSCALL_RES(mc));
+}
+
 DR_API
 reg_t
 dr_syscall_get_param(void *drcontext, int param_num)
@@ -7852,6 +7903,16 @@ process_mmap(dcontext_t *dcontext, app_pc base, size_t size, uint prot,
 
     IF_NO_MEMQUERY(memcache_handle_mmap(dcontext, base, size, memprot, image));
 
+    /* Newer loaders map the whole file read-only and then map each segment
+     * over it with MAP_FIXED, so the pre-syscall overlap handling (i#1175)
+     * already added a +x segment as a plain protection change.  Nothing has
+     * been built from it yet: drop it so it is re-added below as an image
+     * area, which is what makes it eligible for coarse-grain units.
+     */
+    if (image && TEST(MEMPROT_EXEC, memprot) &&
+        executable_vm_area_overlap(base, base + size, false/*have no lock*/))
+        remove_executable_region(base, size, false/*have no lock*/);
+
     /* app_memory_allocation() expects to not see an overlap -- exec areas
      * doesn't expect one.  We have yet to see a +x mmap into a previously
      * mapped +x region, but we do check and handle in pre-syscall (i#1175).
@@ -8846,6 +8907,23 @@ find_executable_vm_areas(void)
     count = find_vm_areas_via_probe();
 #else
     memquery_iter_t iter;
+# ifndef HAVE_MEMINFO_QUERY
+    if (DYNAMO_OPTION(use_persisted)) {
+        /* Loading a persisted unit for a module we find below digests all of the
+         * module's read-only segments, including those after the code segment
+         * which the walk has not reached yet: add the file-backed regions up
+         * front.  The walk below updates each of them again.
+         */
+        memquery_iterator_start(&iter, NULL, true/*may alloc*/);
+        while (memquery_iterator_next(&iter)) {
+            if (iter.inode != 0 && !dynamo_vm_area_overlap(iter.vm_start, iter.vm_end)) {
+                memcache_update_locked(iter.vm_start, iter.vm_end, iter.prot,
+                                       DR_MEMTYPE_IMAGE, false/*!exists*/);
+            }
+        }
+        memquery_iterator_stop(&iter);
+    }
+# endif
     memquery_iterator_start(&iter, NULL, true/*may alloc*/);
     while (memquery_iterator_next(&iter)) {
         bool image = false;
@@ -10278,6 +10356,55 @@ test_uint64_divmod(void)
 #endif /* X86_32 */
 }
 
+/* Threads that unit tests create with pthread_create() inherit our TLS segment,
+ * so they would share the id and dcontext of the initial thread, confusing lock
+ * ownership.  Bracketing their creation with unit_test_thread_create_{pre,post}
+ * instead hands them a copy with invalid magic, as os_swap_dr_tls() does for
+ * app threads (i#2089).  Each thread then calls unit_test_thread_init() to set
+ * up its own TLS, which has its own id and no dcontext, like a DR thread prior
+ * to dynamo_thread_init(), and unit_test_thread_exit() before returning.
+ * The standalone dcontext has no os_thread_data_t, so we keep our own copy.
+ */
+static os_local_state_t unit_test_clone_tls;
+static os_local_state_t *unit_test_real_tls;
+
+dcontext_t *
+unit_test_thread_create_pre(void)
+{
+    dcontext_t *dcontext = get_thread_private_dcontext();
+    ASSERT(dcontext != NULL);
+#ifdef X86
+    unit_test_real_tls = get_os_tls();
+    memcpy(&unit_test_clone_tls, unit_test_real_tls, sizeof(unit_test_clone_tls));
+    unit_test_clone_tls.magic = TLS_MAGIC_INVALID;
+    unit_test_clone_tls.self = &unit_test_clone_tls;
+    os_set_dr_tls_base(dcontext, unit_test_real_tls, (byte *)&unit_test_clone_tls);
+#endif
+    return dcontext;
+}
+
+void
+unit_test_thread_create_post(dcontext_t *dcontext)
+{
+#ifdef X86
+    ASSERT(get_segment_base(SEG_TLS) == (byte *)&unit_test_clone_tls);
+    os_set_dr_tls_base(dcontext, unit_test_real_tls, (byte *)unit_test_real_tls);
+#endif
+}
+
+void
+unit_test_thread_init(void)
+{
+    os_tls_init();
+    ASSERT(get_thread_private_dcontext() == NULL);
+}
+
+void
+unit_test_thread_exit(void)
+{
+    os_tls_exit((local_state_t *)&get_os_tls()->state, false/*self*/);
+}
+
 void
 unit_test_os(void)
 {
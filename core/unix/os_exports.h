@@ -297,6 +297,10 @@ bool was_thread_create_syscall(dcontext_t *dcontext);
 bool is_sigreturn_syscall(dcontext_t *dcontext);
 bool was_sigreturn_syscall(dcontext_t *dcontext);
 bool ignorable_system_call(int num, instr_t *gateway, dcontext_t *dcontext_live);
+#ifdef CLIENT_INTERFACE
+void inline_syscall_pre_hook(int sysnum, bool was_int);
+void inline_syscall_post_hook(int sysnum);
+#endif
 
 bool kernel_is_64bit(void);
 
@@ -402,6 +406,20 @@ set_app_lib_tls_base_from_clone_record(dcontext_t *dcontext, void *record);
 void
 os_clone_post(dcontext_t *dcontext);
 
+#ifdef STANDALONE_UNIT_TEST
+dcontext_t *
+unit_test_thread_create_pre(void);
+
+void
+unit_test_thread_create_post(dcontext_t *dcontext);
+
+void
+unit_test_thread_init(void);
+
+void
+unit_test_thread_exit(void);
+#endif
+
 app_pc
 signal_thread_inherit(dcontext_t *dcontext, void *clone_record);
 
@@ -419,6 +419,37 @@ os_itimers_thread_shared(void)
     return itimers_shared;
 }
 
+/* -fast_signals parsed into a set */
+static kernel_sigset_t fast_sigset;
+
+static void
+fast_signals_init(void)
+{
+    const char *s;
+    bool valid = true;
+    kernel_sigemptyset(&fast_sigset);
+    if (IS_STRING_OPTION_EMPTY(fast_signals))
+        return;
+    string_option_read_lock();
+    s = DYNAMO_OPTION(fast_signals);
+    while (*s != '\0') {
+        uint64 sig;
+        const char *end = parse_int(s, &sig, 0, 0, false);
+        if (end == NULL || (*end != ',' && *end != '\0') || sig < 1 || sig > MAX_SIGNUM) {
+            valid = false;
+            break;
+        }
+        kernel_sigaddset(&fast_sigset, (int) sig);
+        s = (*end == ',') ? end + 1 : end;
+    }
+    string_option_read_unlock();
+    if (!valid) {
+        USAGE_ERROR("-fast_signals takes a ,-separated list of signal numbers "
+                    "from 1 to %d", MAX_SIGNUM);
+        kernel_sigemptyset(&fast_sigset);
+    }
+}
+
 void
 signal_init()
 {
@@ -439,6 +470,7 @@ signal_init()
     intercept_signal(GLOBAL_DCONTEXT, &init_info, SIGSEGV);
     intercept_signal(GLOBAL_DCONTEXT, &init_info, SIGBUS);
     unblock_all_signals(&init_sigmask);
+    fast_signals_init();
 
     IF_LINUX(signalfd_init());
 }
@@ -2286,7 +2318,12 @@ translate_sigcontext(dcontext_t *dcontext, kernel_ucontext_t *uc, bool avoid_fai
      * initexit lock (to keep someone from flushing current fragment), the
      * initexit lock is easier
      */
-    mutex_lock(&thread_initexit_lock);
+    if (dcontext->xl8_nowait) {
+        /* -fast_signals: the caller delays the signal if we fail */
+        if (!mutex_trylock(&thread_initexit_lock))
+            return false;
+    } else
+        mutex_lock(&thread_initexit_lock);
     /* PR 214962: we assume we're going to relocate to this stored context,
      * so we restore memory now
      */
@@ -3445,6 +3482,32 @@ interrupted_inlined_syscall(dcontext_t *dcontext, fragment_t *f,
     return pre_or_post_syscall;
 }
 
+/* Returns whether sig, which interrupted the fine-grained fragment f, should be
+ * delivered right away per -fast_signals.  We require f to have translation
+ * info recorded at emit time, as rebuilding f here would allocate and could
+ * block.  For the same reason we never wait for a lock: if one is held we fall
+ * back to delaying the signal.
+ */
+static bool
+signal_is_fast(dcontext_t *dcontext, int sig, fragment_t *f)
+{
+    thread_sig_info_t *info = (thread_sig_info_t *) dcontext->signal_field;
+    if (!kernel_sigismember(&fast_sigset, sig))
+        return false;
+    if (info->app_sigaction[sig] == NULL ||
+        info->app_sigaction[sig]->handler == (handler_t)SIG_DFL ||
+        info->app_sigaction[sig]->handler == (handler_t)SIG_IGN)
+        return false;
+    if (FRAGMENT_TRANSLATION_INFO(f) != NULL)
+        return true;
+    if (fragment_has_cached_translation_info_nowait(f))
+        return true;
+    /* We cannot build the table in a signal handler: have dispatch do it. */
+    info->interrupted_needs_xl8 = TEST(FRAG_SHARED, f->flags);
+    STATS_INC(num_fast_signals_delayed);
+    return false;
+}
+
 /* i#1145: auto-restart syscalls interrupted by signals */
 static bool
 adjust_syscall_for_restart(dcontext_t *dcontext, thread_sig_info_t *info, int sig,
@@ -3604,6 +3667,7 @@ record_pending_signal(dcontext_t *dcontext, int sig, kernel_ucontext_t *ucxt,
     bool blocked = false;
     bool handled = false;
     bool at_syscall = false;
+    bool fast = false;
     sigpending_t *pend;
     fragment_t *f = NULL;
     fragment_t wrapper;
@@ -3721,6 +3785,13 @@ record_pending_signal(dcontext_t *dcontext, int sig, kernel_ucontext_t *ucxt,
                     LOG(THREAD, LOG_ASYNCH, 2,
                         "signal interrupted pre/post syscall itself so delivering now\n");
                     at_syscall = true;
+                } else if (!forged && signal_is_fast(dcontext, sig, f)) {
+                    /* The handler is safe to run at any point in the cache and we
+                     * can translate cheaply, so skip the unlink and wait.
+                     */
+                    receive_now = true;
+                    fast = true;
+                    LOG(THREAD, LOG_ASYNCH, 2, "\tfast signal so delivering now\n");
                 } else {
                     /* could get another signal but should be in same fragment */
                     ASSERT(info->interrupted == NULL || info->interrupted == f);
@@ -3857,7 +3928,10 @@ record_pending_signal(dcontext_t *dcontext, int sig, kernel_ucontext_t *ucxt,
         ASSERT(!forged);
         /* cache the fragment since pclookup is expensive for coarse (i#658) */
         f = fragment_pclookup(dcontext, (cache_pc)sc->SC_XIP, &wrapper);
+        /* a fast signal is delayed rather than waiting on a lock to translate */
+        dcontext->xl8_nowait = fast;
         xl8_success = translate_sigcontext(dcontext, ucxt, !can_always_delay[sig], f);
+        dcontext->xl8_nowait = false;
 
         if (can_always_delay[sig] && !xl8_success) {
             /* delay: we expect this for coarse fragments if alarm arrives
@@ -3866,7 +3940,17 @@ record_pending_signal(dcontext_t *dcontext, int sig, kernel_ucontext_t *ucxt,
             LOG(THREAD, LOG_ASYNCH, 2,
                 "signal is in un-translatable spot in coarse fragment: delaying\n");
             receive_now = false;
-        }
+            if (fast) {
+                /* Fall back to the regular delay (e.g., we're in client meta code) */
+                STATS_INC(num_fast_signals_delayed);
+                ASSERT(f != NULL && !TEST(FRAG_COARSE_GRAIN, f->flags));
+                if (unlink_fragment_for_signal(dcontext, f, pc)) {
+                    info->interrupted = f;
+                    info->interrupted_pc = pc;
+                }
+            }
+        } else if (fast)
+            STATS_INC(num_signals_fast);
     }
 
     if (receive_now) {
@@ -5394,6 +5478,14 @@ receive_pending_signal(dcontext_t *dcontext)
     if (info->interrupted != NULL) {
         LOG(THREAD, LOG_ASYNCH, 3, "\tre-linking outgoing for interrupted F%d\n",
             info->interrupted->id);
+        if (info->interrupted_needs_xl8) {
+            /* -fast_signals: so the next signal in this fragment is fast.
+             * We are couldbelinking, so it cannot be flushed meanwhile.
+             */
+            ASSERT(is_couldbelinking(dcontext));
+            fragment_cache_translation_info(dcontext, info->interrupted, NULL);
+            info->interrupted_needs_xl8 = false;
+        }
         SHARED_FLAGS_RECURSIVE_LOCK(info->interrupted->flags, acquire,
                                     change_linking_lock);
         link_fragment_outgoing(dcontext, info->interrupted, false);
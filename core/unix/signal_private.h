@@ -423,6 +423,10 @@ typedef struct _thread_sig_info_t {
     void *sigheap; /* special heap */
     fragment_t *interrupted; /* frag we unlinked for delaying signal */
     cache_pc interrupted_pc; /* pc within frag we unlinked for delaying signal */
+    /* -fast_signals: interrupted has no translation table yet, so build one at
+     * dispatch where it is safe to do so
+     */
+    bool interrupted_needs_xl8;
 
 #ifdef RETURN_AFTER_CALL
     app_pc signal_restorer_retaddr;     /* last signal restorer, known ret exception */
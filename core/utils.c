@@ -587,7 +587,9 @@ deadlock_avoidance_lock(mutex_t *lock, bool acquired, bool ownable)
          */
         ASSERT(lock != &thread_initexit_lock || !is_self_couldbelinking());
 
-        if (INTERNAL_OPTION(deadlock_avoidance) && get_thread_private_dcontext() != NULL) {
+        /* A standalone library thread without TLS gets GLOBAL_DCONTEXT. */
+        if (INTERNAL_OPTION(deadlock_avoidance) && get_thread_private_dcontext() != NULL &&
+            get_thread_private_dcontext() != GLOBAL_DCONTEXT) {
             dcontext_t *dcontext = get_thread_private_dcontext();
             if (dcontext->thread_owned_locks != NULL) {
 #ifdef CLIENT_INTERFACE
@@ -1259,6 +1261,23 @@ bool write_trylock(read_write_lock_t *rw)
     return false;
 }
 
+/* Like read_lock() but returns false rather than waiting while a writer holds rw,
+ * for contexts such as signal handlers that must not block.
+ */
+bool read_trylock(read_write_lock_t *rw)
+{
+    if (mutex_testlock(&rw->lock))
+        return false;
+    ATOMIC_INC(int, rw->num_readers);
+    DEADLOCK_AVOIDANCE_LOCK(&rw->lock, true, LOCK_NOT_OWNABLE);
+    if (mutex_testlock(&rw->lock)) {
+        /* raced with a writer, which may already be waiting for us */
+        read_unlock(rw);
+        return false;
+    }
+    return true;
+}
+
 void read_unlock(read_write_lock_t *rw)
 {
     if (INTERNAL_OPTION(spin_yield_rwlock)) {
@@ -474,6 +474,8 @@ enum {
     LOCK_RANK(sigfdtable_lock), /* < table_rwlock */
 #endif
     LOCK_RANK(table_rwlock), /* > dr_client_mutex */
+    LOCK_RANK(xl8_cache_lock), /* > table_rwlock, < global_alloc_lock */
+    LOCK_RANK(async_opt_lock), /* < global_alloc_lock */
     LOCK_RANK(loaded_module_areas),  /* < dynamo_areas < global_alloc_lock */
     LOCK_RANK(aslr_areas), /* < dynamo_areas < global_alloc_lock */
     LOCK_RANK(aslr_pad_areas), /* < dynamo_areas < global_alloc_lock */
@@ -753,6 +755,7 @@ bool self_owns_recursive_lock(recursive_lock_t *lock);
 
 /* A read write lock allows multiple readers or alternatively a single writer */
 void read_lock(read_write_lock_t *rw);
+bool read_trylock(read_write_lock_t *rw);
 void write_lock(read_write_lock_t *rw);
 bool write_trylock(read_write_lock_t *rw);
 void read_unlock(read_write_lock_t *rw);
@@ -258,6 +258,18 @@ typedef struct thread_data_t {
     }                                                       \
 } while (0);
 
+/* For VECTOR_LOCKLESS_READS: a buffer outgrown by a resize */
+typedef struct _vm_area_retired_t {
+    vm_area_t *buf;
+    int size;
+    struct _vm_area_retired_t *next;
+} vm_area_retired_t;
+
+/* How many times a lockless search that races with writers is retried before
+ * the reader gives up and takes the vector's lock.
+ */
+#define LOCKLESS_READ_RETRIES 8
+
 /* these two global vectors store all executable areas and all dynamo
  * areas (executable or otherwise).
  * executable_areas' custom field is used to store coarse unit info.
@@ -831,6 +843,31 @@ writelock_if_not_already(vm_area_vector_t *v)
     return false;
 }
 
+/* For VECTOR_LOCKLESS_READS: makes v->seq odd for the duration of a change to
+ * v's areas.  Changes can nest (remove_vm_area() calls add_vm_area()), so only
+ * the outermost begin bumps the count; it returns whether it did, which must be
+ * passed to vector_seq_write_end().  Writers are serialized by v's write lock.
+ */
+static inline bool
+vector_seq_write_begin(vm_area_vector_t *v)
+{
+    if (!TEST(VECTOR_LOCKLESS_READS, v->flags) || TEST(1, v->seq))
+        return false;
+    v->seq++;
+    MEMORY_STORE_BARRIER();
+    return true;
+}
+
+static inline void
+vector_seq_write_end(vm_area_vector_t *v, bool began)
+{
+    if (!began)
+        return;
+    ASSERT(TEST(1, v->seq));
+    MEMORY_STORE_BARRIER();
+    v->seq++;
+}
+
 static void
 vm_area_vector_check_size(vm_area_vector_t *v)
 {
@@ -838,7 +875,33 @@ vm_area_vector_check_size(vm_area_vector_t *v)
      * protected */
     /* check if at capacity */
     if (v->size == v->length){
-        if (v->length == 0) {
+        if (TEST(VECTOR_LOCKLESS_READS, v->flags)) {
+            /* A lockless reader may still be searching the old buffer, so we
+             * retire it rather than freeing it, and double the size to bound
+             * the retired memory by the final size.  We publish the new
+             * buffer before its size so that a reader never pairs a larger
+             * size with a smaller buffer.
+             */
+            int new_size = (v->length == 0) ? INTERNAL_OPTION(vmarea_initial_size) :
+                v->size * 2;
+            vm_area_t *new_buf = (vm_area_t *)
+                global_heap_alloc(new_size*sizeof(struct vm_area_t)
+                                  HEAPACCT(ACCT_VMAREAS));
+            if (v->buf != NULL) {
+                vm_area_retired_t *old =
+                    HEAP_TYPE_ALLOC(GLOBAL_DCONTEXT, vm_area_retired_t,
+                                    ACCT_VMAREAS, PROTECTED);
+                memcpy(new_buf, v->buf, v->length*sizeof(struct vm_area_t));
+                old->buf = v->buf;
+                old->size = v->size;
+                old->next = v->retired;
+                v->retired = old;
+                STATS_INC(num_vmareas_resized);
+            }
+            v->buf = new_buf;
+            MEMORY_STORE_BARRIER();
+            v->size = new_size;
+        } else if (v->length == 0) {
             v->size = INTERNAL_OPTION(vmarea_initial_size);
             v->buf = (vm_area_t*) global_heap_alloc(v->size*sizeof(struct vm_area_t)
                                                   HEAPACCT(ACCT_VMAREAS));
@@ -910,12 +973,14 @@ add_vm_area(vm_area_vector_t *v, app_pc start, app_pc end,
     int i, j, diff;
     /* if we have overlap, we extend an existing area -- else we add a new area */
     int overlap_start = -1, overlap_end = -1;
+    bool seq_began;
     DEBUG_DECLARE(uint flagignore;)
     IF_UNIX(IF_DEBUG(IF_NO_MEMQUERY(extern vm_area_vector_t *all_memory_areas;)))
 
     ASSERT(start < end);
 
     ASSERT_VMAREA_VECTOR_PROTECTED(v, WRITE);
+    seq_began = vector_seq_write_begin(v);
     LOG(GLOBAL, LOG_VMAREAS, 4, "in add_vm_area%s "PFX" "PFX" %s\n",
         (v == executable_areas ? " executable_areas" :
          (v == IF_LINUX_ELSE(all_memory_areas, NULL) ? " all_memory_areas" :
@@ -1240,6 +1305,7 @@ add_vm_area(vm_area_vector_t *v, app_pc start, app_pc end,
             vm_area_clean_fraglist(dcontext, &v->buf[i]);
         }
     }
+    vector_seq_write_end(v, seq_began);
     DOLOG(5, LOG_VMAREAS, { print_vm_areas(v, GLOBAL); });
 }
 
@@ -1298,6 +1364,7 @@ remove_vm_area(vm_area_vector_t *v, app_pc start, app_pc end, bool restore_prot)
     int i, diff;
     int overlap_start = -1, overlap_end = -1;
     bool add_new_area = false;
+    bool seq_began;
     vm_area_t new_area = {0};     /* used only when add_new_area, wimpy compiler */
     /* FIXME: cleaner test? shared_data copies flags, but uses
      * custom.frags and not custom.client
@@ -1322,6 +1389,7 @@ remove_vm_area(vm_area_vector_t *v, app_pc start, app_pc end, bool restore_prot)
         return false;
     if (overlap_end == -1)
         overlap_end = v->length;
+    seq_began = vector_seq_write_begin(v);
     /* since it's sorted and there are no overlaps, we do not have to re-sort.
      * we just delete entire intervals affected, and shorten non-entire
      */
@@ -1454,6 +1522,7 @@ remove_vm_area(vm_area_vector_t *v, app_pc start, app_pc end, bool restore_prot)
                     new_area.frag_flags, new_area.custom.client
                     _IF_DEBUG(new_area.comment));
     }
+    vector_seq_write_end(v, seq_began);
     DOLOG(5, LOG_VMAREAS, { print_vm_areas(v, GLOBAL); });
     return true;
 }
@@ -1547,6 +1616,83 @@ vm_area_overlap(vm_area_vector_t *v, app_pc start, app_pc end)
     return binary_search(v, start, end, NULL, NULL, false);
 }
 
+/* Searches a VECTOR_LOCKLESS_READS vector for an area overlapping start..end
+ * without taking v->lock.  Writers make v->seq odd while they change the
+ * areas, so a search that sees the same even value before and after saw a
+ * consistent vector.  Since the areas can change as soon as we are done, the
+ * bounds and client data of the area found are copied out to the optional
+ * OUT params rather than returning a pointer.  Buffers outgrown by a resize
+ * are kept until the vector is freed, so a racing search never touches freed
+ * memory: it just retries.
+ * Returns false if the search kept racing with writers, or if the caller is
+ * the writer, in which case the caller must do a locked search instead.
+ * Otherwise sets *found to whether an overlapping area exists.
+ */
+static bool
+lockless_lookup(vm_area_vector_t *v, app_pc start, app_pc end, bool *found /*OUT*/,
+                app_pc *area_start /*OUT*/, app_pc *area_end /*OUT*/,
+                void **data /*OUT*/)
+{
+    int tries;
+    ASSERT(TEST(VECTOR_LOCKLESS_READS, v->flags));
+    ASSERT(start < end || end == NULL /* wraparound */);
+    for (tries = 0; tries < LOCKLESS_READ_RETRIES; tries++) {
+        uint seq = v->seq;
+        vm_area_t *buf;
+        int size, min, max;
+        bool hit = false;
+        app_pc hit_start = NULL, hit_end = NULL;
+        void *hit_data = NULL;
+        if (TEST(1, seq)) {
+            if (self_owns_write_lock(&v->lock))
+                return false;
+            continue;
+        }
+        MEMORY_LOAD_BARRIER();
+        /* resizes publish the new buffer before its size */
+        size = v->size;
+        MEMORY_LOAD_BARRIER();
+        buf = v->buf;
+        max = v->length;
+        /* a torn read could pair a new length with an old buffer */
+        if (max > size)
+            max = size;
+        max--;
+        min = 0;
+        while (max >= min) {
+            int i = (min + max) / 2;
+            app_pc area_s = buf[i].start, area_e = buf[i].end;
+            if (end != NULL && end <= area_s)
+                max = i - 1;
+            else if (start >= area_e)
+                min = i + 1;
+            else {
+                hit = true;
+                hit_start = area_s;
+                hit_end = area_e;
+                hit_data = buf[i].custom.client;
+                break;
+            }
+        }
+        MEMORY_LOAD_BARRIER();
+        if (v->seq == seq) {
+            *found = hit;
+            if (hit) {
+                if (area_start != NULL)
+                    *area_start = hit_start;
+                if (area_end != NULL)
+                    *area_end = hit_end;
+                if (data != NULL)
+                    *data = hit_data;
+            }
+            return true;
+        }
+        STATS_INC(vmarea_lockless_retries);
+    }
+    STATS_INC(vmarea_lockless_fallbacks);
+    return false;
+}
+
 /*********************** EXPORTED ROUTINES **********************/
 
 /* thread-shared initialization that should be repeated after a reset */
@@ -1561,7 +1707,9 @@ vm_areas_reset_init(void)
 void
 dynamo_vm_areas_init()
 {
-    VMVECTOR_ALLOC_VECTOR(dynamo_areas, GLOBAL_DCONTEXT, VECTOR_SHARED,
+    VMVECTOR_ALLOC_VECTOR(dynamo_areas, GLOBAL_DCONTEXT, VECTOR_SHARED |
+                          (DYNAMO_OPTION(vmarea_lockless_reads) ?
+                           VECTOR_LOCKLESS_READS : 0),
                           dynamo_areas);
 }
 
@@ -1578,7 +1726,9 @@ vm_areas_init()
      * We're already paying the indirection cost by passing their addresses
      * to generic routines, after all.
      */
-    VMVECTOR_ALLOC_VECTOR(executable_areas, GLOBAL_DCONTEXT, VECTOR_SHARED,
+    VMVECTOR_ALLOC_VECTOR(executable_areas, GLOBAL_DCONTEXT, VECTOR_SHARED |
+                          (DYNAMO_OPTION(vmarea_lockless_reads) ?
+                           VECTOR_LOCKLESS_READS : 0),
                           executable_areas);
     VMVECTOR_ALLOC_VECTOR(pretend_writable_areas, GLOBAL_DCONTEXT, VECTOR_SHARED,
                           pretend_writable_areas);
@@ -1948,6 +2098,9 @@ vmvector_overlap(vm_area_vector_t *v, app_pc start, app_pc end)
     bool release_lock; /* 'true' means this routine needs to unlock */
     if (vmvector_empty(v))
         return false;
+    if (TEST(VECTOR_LOCKLESS_READS, v->flags) &&
+        lockless_lookup(v, start, end, &overlap, NULL, NULL, NULL))
+        return overlap;
     LOCK_VECTOR(v, release_lock, read);
     ASSERT_OWN_READWRITE_LOCK(SHOULD_LOCK_VECTOR(v), &v->lock);
     overlap = vm_area_overlap(v, start, end);
@@ -1980,6 +2133,9 @@ vmvector_lookup_data(vm_area_vector_t *v, app_pc pc,
     vm_area_t *area = NULL;
     bool release_lock; /* 'true' means this routine needs to unlock */
 
+    if (TEST(VECTOR_LOCKLESS_READS, v->flags) &&
+        lockless_lookup(v, pc, pc+1/*open end*/, &overlap, start, end, data))
+        return overlap;
     LOCK_VECTOR(v, release_lock, read);
     ASSERT_OWN_READWRITE_LOCK(SHOULD_LOCK_VECTOR(v), &v->lock);
     overlap = lookup_addr(v, pc, &area);
@@ -2099,6 +2255,13 @@ vmvector_reset_vector(dcontext_t *dcontext, vm_area_vector_t *v)
                              HEAPACCT(ACCT_VMAREAS));
         }
     });
+    while (v->retired != NULL) {
+        vm_area_retired_t *old = v->retired;
+        v->retired = old->next;
+        global_heap_free(old->buf, old->size*sizeof(struct vm_area_t)
+                         HEAPACCT(ACCT_VMAREAS));
+        HEAP_TYPE_FREE(GLOBAL_DCONTEXT, old, vm_area_retired_t, ACCT_VMAREAS, PROTECTED);
+    }
     /* with thread shared cache it is in fact possible to have no thread local vmareas */
     if (v->buf != NULL) {
         /* FIXME: walk through and make sure frags lists are all freed */
@@ -2417,6 +2580,7 @@ add_executable_vm_area_check_IAT(app_pc *start /*IN/OUT*/, app_pc *end /*IN/OUT*
             vm_area_t *area = NULL;
             bool all_new = !executable_vm_area_overlap(orig_start, orig_end-1,
                                                        true/*wlock*/);
+            bool seq_began;
             ASSERT(IAT_start != NULL); /* should have found bounds above */
             if (all_new && /* elseif assumes next call happened */
                 lookup_addr(executable_areas, *end, &area) &&
@@ -2441,7 +2605,9 @@ add_executable_vm_area_check_IAT(app_pc *start /*IN/OUT*/, app_pc *end /*IN/OUT*
                 ASSERT(IAT_end > orig_start && IAT_end < area->start);
                 ASSERT(*start == IAT_end); /* set up above */
                 *end = area->end;
+                seq_began = vector_seq_write_begin(executable_areas);
                 area->start = *start;
+                vector_seq_write_end(executable_areas, seq_began);
                 *existing_area = area;
                 STATS_INC(coarse_merge_IAT);
                 /* If info was loaded prior to rebinding just use it.
@@ -2935,6 +3101,10 @@ bool
 is_executable_address(app_pc addr)
 {
     bool found;
+    if (TEST(VECTOR_LOCKLESS_READS, executable_areas->flags) &&
+        lockless_lookup(executable_areas, addr, addr+1/*open end*/, &found,
+                        NULL, NULL, NULL))
+        return found;
     read_lock(&executable_areas->lock);
     found = lookup_addr(executable_areas, addr, NULL);
     read_unlock(&executable_areas->lock);
@@ -3699,6 +3869,11 @@ is_dynamo_address(app_pc addr)
     /* case 3045: areas inside the vmheap reservation are not added to the list */
     if (is_vmm_reserved_address(addr, 1))
         return true;
+    /* a stale list must be brought up to date under the write lock */
+    if (TEST(VECTOR_LOCKLESS_READS, dynamo_areas->flags) && dynamo_areas_uptodate &&
+        lockless_lookup(dynamo_areas, addr, addr+1/*open end*/, &found,
+                        NULL, NULL, NULL))
+        return found;
     dynamo_vm_areas_start_reading();
     found = lookup_addr(dynamo_areas, addr, NULL);
     dynamo_vm_areas_done_reading();
@@ -11504,6 +11679,10 @@ aslr_report_violation(app_pc execution_fault_pc,
 #endif /* PROGRAM_SHEPHERDING */
 
 #ifdef STANDALONE_UNIT_TEST
+# ifdef UNIX
+#  include <pthread.h>
+# endif
+
 # define INT_TO_PC(x) ((app_pc)(ptr_uint_t)(x))
 
 static void
@@ -11564,6 +11743,125 @@ vmvector_tests()
     vmvector_print(&v, STDERR);
 }
 
+/* Lookups on a shared vector while writer threads keep adding and removing
+ * areas, locked and with VECTOR_LOCKLESS_READS, for 1 to MAX_RACE_READERS
+ * reader threads.  The permanent areas must always be found with their exact
+ * bounds, and a transient area must be found either whole or not at all.
+ */
+# define MAX_RACE_READERS 8
+# define RACE_WRITERS 2
+# define RACE_AREAS 64
+# define RACE_LOOKUPS 200000
+static vm_area_vector_t race_vec;
+static volatile bool race_done;
+
+/* permanent areas are [0x1000*(i+1), +0x800); transient ones are
+ * [0x1000*(i+1) + 0x900, +0x600), not adjacent to anything so never merged
+ */
+# define RACE_AREA_START(i) INT_TO_PC(0x1000 * ((i) + 1))
+# define RACE_TRANSIENT_START(i) (RACE_AREA_START(i) + 0x900)
+
+static IF_UNIX_ELSE(void *, DWORD WINAPI)
+race_reader(void *arg)
+{
+    int i;
+    IF_UNIX(unit_test_thread_init());
+    for (i = 0; i < RACE_LOOKUPS; i++) {
+        int idx = (i * 7) % RACE_AREAS;
+        app_pc start = NULL, end = NULL;
+        bool found = vmvector_lookup_data(&race_vec, RACE_AREA_START(idx) + 0x10,
+                                          &start, &end, NULL);
+        EXPECT(found, true);
+        EXPECT(start == RACE_AREA_START(idx), true);
+        EXPECT(end == RACE_AREA_START(idx) + 0x800, true);
+        if (vmvector_lookup_data(&race_vec, RACE_TRANSIENT_START(idx) + 0x10,
+                                 &start, &end, NULL)) {
+            EXPECT(start == RACE_TRANSIENT_START(idx), true);
+            EXPECT(end == RACE_TRANSIENT_START(idx) + 0x600, true);
+        }
+        EXPECT(vmvector_overlap(&race_vec, RACE_AREA_START(idx) + 0x800,
+                                RACE_AREA_START(idx) + 0x900), false);
+    }
+    IF_UNIX(unit_test_thread_exit());
+    return 0;
+}
+
+/* writer w owns the transient areas whose index is w modulo RACE_WRITERS */
+static IF_UNIX_ELSE(void *, DWORD WINAPI)
+race_writer(void *arg)
+{
+    int w = (int)(ptr_int_t) arg;
+    int i = w;
+    IF_UNIX(unit_test_thread_init());
+    while (!race_done) {
+        app_pc start = RACE_TRANSIENT_START(i % RACE_AREAS);
+        vmvector_add(&race_vec, start, start + 0x600, NULL);
+        vmvector_remove(&race_vec, start, start + 0x600);
+        i += RACE_WRITERS;
+        /* don't starve the readers on a single core */
+        os_thread_yield();
+    }
+    IF_UNIX(unit_test_thread_exit());
+    return 0;
+}
+
+static void
+vmvector_lockless_race(uint flags, int num_readers)
+{
+    int i;
+# ifdef UNIX
+    dcontext_t *dcontext;
+    pthread_t readers[MAX_RACE_READERS], writers[RACE_WRITERS];
+# else
+    HANDLE readers[MAX_RACE_READERS], writers[RACE_WRITERS];
+# endif
+    vmvector_init_vector(&race_vec, flags);
+    ASSIGN_INIT_READWRITE_LOCK_FREE(race_vec.lock, thread_vm_areas);
+    for (i = 0; i < RACE_AREAS; i++) {
+        vmvector_add(&race_vec, RACE_AREA_START(i), RACE_AREA_START(i) + 0x800,
+                     NULL);
+    }
+    race_done = false;
+# ifdef UNIX
+    dcontext = unit_test_thread_create_pre();
+    for (i = 0; i < RACE_WRITERS; i++)
+        pthread_create(&writers[i], NULL, race_writer, (void *)(ptr_int_t) i);
+    for (i = 0; i < num_readers; i++)
+        pthread_create(&readers[i], NULL, race_reader, NULL);
+    unit_test_thread_create_post(dcontext);
+    for (i = 0; i < num_readers; i++)
+        pthread_join(readers[i], NULL);
+    race_done = true;
+    for (i = 0; i < RACE_WRITERS; i++)
+        pthread_join(writers[i], NULL);
+# else /* WINDOWS */
+    for (i = 0; i < RACE_WRITERS; i++) {
+        writers[i] = CreateThread(NULL, 0, race_writer, (void *)(ptr_int_t) i, 0,
+                                  NULL);
+    }
+    for (i = 0; i < num_readers; i++)
+        readers[i] = CreateThread(NULL, 0, race_reader, NULL, 0, NULL);
+    WaitForMultipleObjects(num_readers, readers, TRUE, INFINITE);
+    race_done = true;
+    WaitForMultipleObjects(RACE_WRITERS, writers, TRUE, INFINITE);
+# endif /* UNIX/WINDOWS */
+    /* every transient area was removed again */
+    EXPECT(race_vec.length, RACE_AREAS);
+    vmvector_reset_vector(GLOBAL_DCONTEXT, &race_vec);
+    DELETE_READWRITE_LOCK(race_vec.lock);
+}
+
+static void
+vmvector_lockless_tests(void)
+{
+    int num_readers;
+    print_file(STDERR, "\nvm_area_vector_t lockless read tests\n");
+    for (num_readers = 1; num_readers <= MAX_RACE_READERS; num_readers *= 2) {
+        vmvector_lockless_race(VECTOR_SHARED, num_readers);
+        vmvector_lockless_race(VECTOR_SHARED | VECTOR_LOCKLESS_READS, num_readers);
+    }
+}
+
 /* initial vector tests
  * FIXME: should add a lot more, esp. wrt other flags -- these only
  * test no flags or interactions w/ selfmod flag
@@ -11685,5 +11983,6 @@ unit_test_vmareas(void)
     check_vec(&v, 2, INT_TO_PC(3), INT_TO_PC(4), 0, 0, NULL);
 
     vmvector_tests();
+    vmvector_lockless_tests();
 }
 #endif  /* STANDALONE_UNIT_TEST */
@@ -67,6 +67,10 @@ enum {
      * flag to avoid the redundant vector-level lock
      */
     VECTOR_NO_LOCK       = 0x0010,
+    /* lookups search the vector without its lock, under a sequence count
+     * that writers bump, falling back to the lock only on repeated races
+     */
+    VECTOR_LOCKLESS_READS = 0x0020,
 };
 
 #define VECTOR_NEVER_MERGE (VECTOR_NEVER_MERGE_ADJACENT | VECTOR_NEVER_OVERLAP)
@@ -89,6 +93,14 @@ struct vm_area_vector_t {
      * to perform a read (don't need full recursive lock)
      */
     read_write_lock_t lock;
+    /* For VECTOR_LOCKLESS_READS: odd while a writer is changing the areas.
+     * Lockless readers retry if it is odd or changes across their search.
+     */
+    volatile uint seq;
+    /* For VECTOR_LOCKLESS_READS: buffers outgrown by a resize, which a
+     * lockless reader may still be searching.  Freed with the vector.
+     */
+    struct _vm_area_retired_t *retired;
 
     /* Callbacks to support payloads */
     /* Frees a payload */
@@ -4781,6 +4781,16 @@ os_heap_get_commit_limit(size_t *commit_used, size_t *commit_limit)
     }
 }
 
+bool
+os_heap_advise_huge_pages(void *p, size_t size)
+{
+    /* FIXME: Windows large pages can only be requested (with MEM_LARGE_PAGES and
+     * SeLockMemoryPrivilege) when the memory is first allocated, and are never
+     * pageable, so we do not support converting a reservation.
+     */
+    return false;
+}
+
 /* i#939: for win8 wow64, x64 ntdll is up high but the kernel won't let us
  * allocate new memory within rel32 distance.  Thus we clobber the padding at
  * the end of x64 ntdll.dll's +rx section.  For typical x64 landing pads w/
@@ -46,7 +46,10 @@
         FUNCTION(callpic_pop) \
         FUNCTION(callpic_mov) \
         FUNCTION(nonleaf) \
+        FUNCTION(nonleaf_simd) \
         FUNCTION(cond_br) \
+        FUNCTION(small_loop) \
+        FUNCTION(fast_path) \
         FUNCTION(tls_clobber) \
         FUNCTION(aflags_clobber) \
         FUNCTION(compiler_inscount) \
@@ -52,7 +52,10 @@
         FUNCTION(callpic_pop) \
         FUNCTION(callpic_mov) \
         FUNCTION(nonleaf) \
+        FUNCTION(nonleaf_simd) \
         FUNCTION(cond_br) \
+        FUNCTION(small_loop) \
+        FUNCTION(fast_path) \
         FUNCTION(tls_clobber) \
         FUNCTION(aflags_clobber) \
         FUNCTION(compiler_inscount) \
@@ -115,6 +118,7 @@ static void free_instrumentation_funcs(void);
 static void compiler_inscount(ptr_uint_t count);
 static void test_inlined_call_args(void *dc, instrlist_t *bb, instr_t *where,
                                    int fn_idx);
+static void test_slow_path(void *dc, instrlist_t *bb, instr_t *where);
 
 DR_EXPORT void
 dr_init(client_id_t id)
@@ -430,8 +434,10 @@ after_callee(app_pc start_inline, app_pc end_inline, bool inline_expected,
         dump_inlined_code(dc, start_inline, end_inline, func_index);
     }
 
-    /* Now that we use the mcontext in dcontext, we expect no stack usage. */
-    if (inline_expected) {
+    /* Now that we use the mcontext in dcontext, we expect no stack usage.
+     * fast_path is the exception: its rare path makes the full clean call.
+     */
+    if (inline_expected && func_index != FN_fast_path) {
         app_pc pc, next_pc;
         instr_t instr;
         bool found_xsp = false;
@@ -454,7 +460,9 @@ after_callee(app_pc start_inline, app_pc end_inline, bool inline_expected,
         dr_fprintf(STDERR, "Function %s was not inlined!\n",
                    func_names[func_index]);
         dump_inlined_code(dc, start_inline, end_inline, func_index);
-    } else if (!inline_expected && callee_inlined) {
+    } else if (!inline_expected && callee_inlined &&
+               /* checked below: its rare path runs the real callee */
+               func_index != FN_fast_path) {
         dr_fprintf(STDERR, "Function %s was inlined unexpectedly!\n",
                    func_names[func_index]);
         dump_inlined_code(dc, start_inline, end_inline, func_index);
@@ -469,6 +477,21 @@ after_callee(app_pc start_inline, app_pc end_inline, bool inline_expected,
             dump_inlined_code(dc, start_inline, end_inline, func_index);
         }
         break;
+    case FN_small_loop:
+        if (global_count != 4) {
+            dr_fprintf(STDERR, "global_count not updated properly after small_loop!\n");
+            dump_inlined_code(dc, start_inline, end_inline, func_index);
+        }
+        break;
+    case FN_fast_path:
+        if (inline_expected && global_count != 0xF00D) {
+            dr_fprintf(STDERR, "global_count not updated properly after fast_path!\n");
+            dump_inlined_code(dc, start_inline, end_inline, func_index);
+        } else if (!inline_expected && global_count != 0x510) {
+            dr_fprintf(STDERR, "fast_path's rare path did not run out of line!\n");
+            dump_inlined_code(dc, start_inline, end_inline, func_index);
+        }
+        break;
     default:
         break;
     }
@@ -617,8 +640,7 @@ event_basic_block(void *dc, void *tag, instrlist_t *bb,
                              OPND_CREATE_INT32(0xDEAD));
         PRE(bb, entry, after_label);
         break;
-    case FN_nonleaf:
-    case FN_cond_br:
+    case FN_nonleaf_simd:
         /* These functions cannot be inlined (yet). */
         PRE(bb, entry, before_label);
         dr_insert_clean_call(dc, bb, entry, func_ptrs[i], false, 0);
@@ -652,6 +674,8 @@ event_basic_block(void *dc, void *tag, instrlist_t *bb,
     if (i == FN_inscount || i == FN_empty_1arg) {
         test_inlined_call_args(dc, bb, entry, i);
     }
+    if (i == FN_fast_path)
+        test_slow_path(dc, bb, entry);
 
     return DR_EMIT_DEFAULT;
 }
@@ -758,6 +782,40 @@ test_inlined_call_args(void *dc, instrlist_t *bb, instr_t *where, int fn_idx)
     }
 }
 
+/* Unlike before_callee(), puts back the real fast_path, so that the full clean
+ * call made by its inlined rare path runs the rare path for real, and sets
+ * global_count so that the rare path is taken.
+ */
+static void
+before_slow_path(void)
+{
+    void *dc = dr_get_current_drcontext();
+    instrlist_t *ilist = codegen_fast_path(dc);
+    instrlist_encode(dc, ilist, func_ptrs[FN_fast_path], true);
+    instrlist_clear_and_destroy(dc, ilist);
+    dr_get_mcontext(dc, &before_mcontext);
+    global_count = 1;
+}
+
+/* Make fast_path take its rare path, which must make the full clean call. */
+static void
+test_slow_path(void *dc, instrlist_t *bb, instr_t *where)
+{
+    instr_t *before_label = INSTR_CREATE_label(dc);
+    instr_t *after_label = INSTR_CREATE_label(dc);
+
+    dr_insert_clean_call(dc, bb, where, (void*)before_slow_path, false, 0);
+    PRE(bb, where, before_label);
+    dr_insert_clean_call(dc, bb, where, func_ptrs[FN_fast_path], false, 0);
+    PRE(bb, where, after_label);
+    dr_insert_clean_call(dc, bb, where, (void*)after_callee, false, 5,
+                         opnd_create_instr(before_label),
+                         opnd_create_instr(after_label),
+                         OPND_CREATE_INT32(false),
+                         OPND_CREATE_INT32(FN_fast_path),
+                         OPND_CREATE_INTPTR(0));
+}
+
 /*****************************************************************************/
 /* Instrumentation function code generation. */
 
@@ -900,7 +958,8 @@ codegen_callpic_mov(void *dc)
     return ilist;
 }
 
-/* Non-leaf functions cannot be inlined.
+/* Non-leaf functions can be inlined if they only call small leaf functions
+ * that do not use the stack.
 nonleaf:
     push REG_XBP
     mov REG_XBP, REG_XSP
@@ -923,7 +982,39 @@ codegen_nonleaf(void *dc)
     return ilist;
 }
 
-/* Conditional branches cannot be inlined.  Avoid flags usage to make test case
+/* The xmm regs used by a non-leaf function's callees must still be saved
+ * when the other xmm saves are skipped.  other_func uses the stack so that it
+ * is not inlined into nonleaf_simd.
+nonleaf_simd:
+    push REG_XBP
+    mov REG_XBP, REG_XSP
+    call other_func
+    leave
+    ret
+other_func:
+    push REG_XAX
+    pcmpeqd xmm1, xmm1
+    pop REG_XAX
+    ret
+*/
+static instrlist_t *
+codegen_nonleaf_simd(void *dc)
+{
+    instrlist_t *ilist = instrlist_create(dc);
+    instr_t *other_func = INSTR_CREATE_label(dc);
+    opnd_t xmm1 = opnd_create_reg(DR_REG_XMM1);
+    codegen_prologue(dc, ilist);
+    APP(ilist, INSTR_CREATE_call(dc, opnd_create_instr(other_func)));
+    codegen_epilogue(dc, ilist);
+    APP(ilist, other_func);
+    APP(ilist, INSTR_CREATE_push(dc, opnd_create_reg(DR_REG_XAX)));
+    APP(ilist, INSTR_CREATE_pcmpeqd(dc, xmm1, xmm1));
+    APP(ilist, INSTR_CREATE_pop(dc, opnd_create_reg(DR_REG_XAX)));
+    APP(ilist, INSTR_CREATE_ret(dc));
+    return ilist;
+}
+
+/* Conditional branches can be inlined.  Avoid flags usage to make test case
  * more specific.
 cond_br:
     push REG_XBP
@@ -954,6 +1045,86 @@ codegen_cond_br(void *dc)
     return ilist;
 }
 
+/* Small loops can be inlined.
+small_loop:
+    push REG_XBP
+    mov REG_XBP, REG_XSP
+    mov REG_XCX, 4
+    Lloop:
+        inc SYMREF(global_count)
+        dec REG_XCX
+        jnz Lloop
+    leave
+    ret
+*/
+static instrlist_t *
+codegen_small_loop(void *dc)
+{
+    instrlist_t *ilist = instrlist_create(dc);
+    instr_t *loop = INSTR_CREATE_label(dc);
+    opnd_t xcx = opnd_create_reg(DR_REG_XCX);
+    codegen_prologue(dc, ilist);
+    APP(ilist, INSTR_CREATE_mov_imm(dc, xcx, OPND_CREATE_INTPTR(4)));
+    APP(ilist, loop);
+    APP(ilist, INSTR_CREATE_inc(dc, OPND_CREATE_ABSMEM(&global_count, OPSZ_PTR)));
+    APP(ilist, INSTR_CREATE_dec(dc, xcx));
+    APP(ilist, INSTR_CREATE_jcc(dc, OP_jnz, opnd_create_instr(loop)));
+    codegen_epilogue(dc, ilist);
+    return ilist;
+}
+
+/* A function whose common case returns early can have that fast path inlined,
+ * while its rare path still makes the full clean call.  The rare path marks
+ * global_count with 0x510 so that the test can tell it ran.
+fast_path:
+    mov REG_XAX, SYMREF(global_count)
+    test REG_XAX, REG_XAX
+    jnz Lslow_path
+        mov REG_XAX, HEX(F00D)
+        mov SYMREF(global_count), REG_XAX
+        ret
+    Lslow_path:
+    push REG_XBP
+    mov REG_XBP, REG_XSP
+    call other_func
+    leave
+    ret
+other_func:
+    push REG_XAX
+    mov REG_XAX, HEX(510)
+    mov SYMREF(global_count), REG_XAX
+    pop REG_XAX
+    ret
+*/
+static instrlist_t *
+codegen_fast_path(void *dc)
+{
+    instrlist_t *ilist = instrlist_create(dc);
+    instr_t *slow_path = INSTR_CREATE_label(dc);
+    instr_t *other_func = INSTR_CREATE_label(dc);
+    opnd_t xax = opnd_create_reg(DR_REG_XAX);
+    APP(ilist, INSTR_CREATE_mov_ld
+        (dc, xax, OPND_CREATE_ABSMEM(&global_count, OPSZ_PTR)));
+    APP(ilist, INSTR_CREATE_test(dc, xax, xax));
+    APP(ilist, INSTR_CREATE_jcc(dc, OP_jnz, opnd_create_instr(slow_path)));
+    APP(ilist, INSTR_CREATE_mov_imm(dc, xax, OPND_CREATE_INTPTR(0xF00D)));
+    APP(ilist, INSTR_CREATE_mov_st
+        (dc, OPND_CREATE_ABSMEM(&global_count, OPSZ_PTR), xax));
+    APP(ilist, INSTR_CREATE_ret(dc));
+    APP(ilist, slow_path);
+    codegen_prologue(dc, ilist);
+    APP(ilist, INSTR_CREATE_call(dc, opnd_create_instr(other_func)));
+    codegen_epilogue(dc, ilist);
+    APP(ilist, other_func);
+    APP(ilist, INSTR_CREATE_push(dc, xax));
+    APP(ilist, INSTR_CREATE_mov_imm(dc, xax, OPND_CREATE_INTPTR(0x510)));
+    APP(ilist, INSTR_CREATE_mov_st
+        (dc, OPND_CREATE_ABSMEM(&global_count, OPSZ_PTR), xax));
+    APP(ilist, INSTR_CREATE_pop(dc, xax));
+    APP(ilist, INSTR_CREATE_ret(dc));
+    return ilist;
+}
+
 /* A function that uses 2 registers and 1 local variable, which should fill all
  * of the scratch slots that the inliner uses.  This used to clobber the scratch
  * slots exposed to the client.
@@ -0,0 +1,123 @@
+/* **********************************************************
+ * Copyright (c) 2017 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of VMware, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Tests that dr_keep_bb_ir() lets a client keep the IR of a basic block
+ * beyond the bb event when -bb_ir_arena is on.  Each thread keeps a clone of
+ * the last block it saw and checks it is intact at the next event.
+ */
+
+#include "dr_api.h"
+#include <string.h>
+
+typedef struct _kept_bb_t {
+    instrlist_t *ilist;
+    uint num_instrs;
+    app_pc first_pc;
+} kept_bb_t;
+
+static uint num_verified;
+static bool kept_ok = true;
+
+static uint
+count_instrs(instrlist_t *ilist)
+{
+    instr_t *instr;
+    uint count = 0;
+    for (instr = instrlist_first(ilist); instr != NULL; instr = instr_get_next(instr))
+        count++;
+    return count;
+}
+
+static void
+release_kept(void *drcontext, kept_bb_t *kept, bool verify)
+{
+    if (kept->ilist == NULL)
+        return;
+    if (verify) {
+        if (count_instrs(kept->ilist) != kept->num_instrs ||
+            instr_get_app_pc(instrlist_first(kept->ilist)) != kept->first_pc)
+            kept_ok = false;
+        else
+            num_verified++;
+    }
+    instrlist_clear_and_destroy(drcontext, kept->ilist);
+    kept->ilist = NULL;
+}
+
+static dr_emit_flags_t
+event_basic_block(void *drcontext, void *tag, instrlist_t *bb,
+                  bool for_trace, bool translating)
+{
+    kept_bb_t *kept = (kept_bb_t *) dr_get_tls_field(drcontext);
+    if (for_trace || translating)
+        return DR_EMIT_DEFAULT;
+    release_kept(drcontext, kept, true);
+    kept->ilist = instrlist_clone(drcontext, bb);
+    kept->num_instrs = count_instrs(bb);
+    kept->first_pc = instr_get_app_pc(instrlist_first(bb));
+    return DR_EMIT_DEFAULT;
+}
+
+static void
+event_thread_init(void *drcontext)
+{
+    kept_bb_t *kept = (kept_bb_t *) dr_thread_alloc(drcontext, sizeof(*kept));
+    memset(kept, 0, sizeof(*kept));
+    dr_set_tls_field(drcontext, kept);
+}
+
+static void
+event_thread_exit(void *drcontext)
+{
+    kept_bb_t *kept = (kept_bb_t *) dr_get_tls_field(drcontext);
+    release_kept(drcontext, kept, true);
+    dr_thread_free(drcontext, kept, sizeof(*kept));
+}
+
+static void
+event_exit(void)
+{
+    if (kept_ok && num_verified > 0)
+        dr_fprintf(STDERR, "kept bb IR is intact\n");
+    else
+        dr_fprintf(STDERR, "kept bb IR was reclaimed\n");
+}
+
+DR_EXPORT void
+dr_init(client_id_t id)
+{
+    dr_keep_bb_ir(id);
+    dr_register_exit_event(event_exit);
+    dr_register_thread_init_event(event_thread_init);
+    dr_register_thread_exit_event(event_thread_exit);
+    dr_register_bb_event(event_basic_block);
+}
@@ -0,0 +1,96 @@
+/* **********************************************************
+ * Copyright (c) 2017 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of VMware, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Checks at exit that each DR statistic named in the client options was
+ * incremented.  Many options only change performance, so their tests run a
+ * regular app with this client: it prints nothing on success, which lets the
+ * app's own .expect file be used.  A statistic that is not kept in this build
+ * is reported too, so tests of debug-only statistics must only be registered
+ * for debug builds.  A name prefixed with "child:" is only checked in forked
+ * children, and one prefixed with "none:" must instead never be incremented,
+ * so that two runs of an app can check opposite sides of the same statistic.
+ */
+
+#include "dr_api.h"
+
+#include <string.h>
+
+#define CHILD_PREFIX "child:"
+#define NONE_PREFIX "none:"
+
+static client_id_t client_id;
+static bool is_child;
+
+static void
+event_exit(void)
+{
+    const char *opts = dr_get_options(client_id);
+    char name[128];
+    while ((opts = dr_get_token(opts, name, sizeof(name))) != NULL) {
+        const char *stat = name;
+        int64 val;
+        bool none = false;
+        if (strncmp(stat, CHILD_PREFIX, strlen(CHILD_PREFIX)) == 0) {
+            if (!is_child)
+                continue;
+            stat += strlen(CHILD_PREFIX);
+        }
+        if (strncmp(stat, NONE_PREFIX, strlen(NONE_PREFIX)) == 0) {
+            none = true;
+            stat += strlen(NONE_PREFIX);
+        }
+        if (!dr_get_statistic(stat, &val))
+            dr_fprintf(STDERR, "statistic %s is not kept in this build\n", stat);
+        else if (none && val != 0)
+            dr_fprintf(STDERR, "statistic %s was incremented\n", stat);
+        else if (!none && val == 0)
+            dr_fprintf(STDERR, "statistic %s was never incremented\n", stat);
+    }
+}
+
+#ifdef UNIX
+static void
+event_fork_init(void *drcontext)
+{
+    is_child = true;
+}
+#endif
+
+DR_EXPORT void
+dr_init(client_id_t id)
+{
+    client_id = id;
+    dr_register_exit_event(event_exit);
+#ifdef UNIX
+    dr_register_fork_init_event(event_fork_init);
+#endif
+}
@@ -0,0 +1,70 @@
+/* **********************************************************
+ * Copyright (c) 2017 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of VMware, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <stdio.h>
+#if defined(MACOS) || defined(ANDROID)
+# include <sys/syscall.h>
+#else
+# include <syscall.h>
+#endif
+
+#define EXPANDSTR(x) #x
+#define STRINGIFY(x) EXPANDSTR(x)
+
+int main()
+{
+    int res;
+    fprintf(stderr, "starting\n");
+    /* We invoke the syscalls directly so that the number is in the same bb,
+     * and we pick ones libc is unlikely to invoke on its own.
+     */
+#ifdef X64
+    asm("mov $" STRINGIFY(SYS_getppid) ", %%eax; syscall; mov %%eax, %0"
+        : "=m"(res) : : "rax", "rcx", "r11");
+#else
+    asm("mov $" STRINGIFY(SYS_getppid) ", %%eax; int $0x80; mov %%eax, %0"
+        : "=m"(res) : : "eax");
+#endif
+    fprintf(stderr, "getppid %s\n", res > 0 ? "ok" : "failed");
+    /* getpriority(PRIO_PROCESS, 0) */
+#ifdef X64
+    asm("mov $0, %%edi; mov $0, %%esi; mov $" STRINGIFY(SYS_getpriority) ", %%eax;"
+        "syscall; mov %%eax, %0"
+        : "=m"(res) : : "rax", "rdi", "rsi", "rcx", "r11");
+#else
+    asm("push %%ebx; mov $0, %%ebx; mov $0, %%ecx; mov $" STRINGIFY(SYS_getpriority)
+        ", %%eax; int $0x80; pop %%ebx; mov %%eax, %0"
+        : "=m"(res) : : "eax", "ecx");
+#endif
+    fprintf(stderr, "getpriority %s\n", res >= 0 ? "ok" : "failed");
+    return 0;
+}
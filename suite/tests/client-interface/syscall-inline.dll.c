@@ -0,0 +1,112 @@
+/* **********************************************************
+ * Copyright (c) 2017 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of VMware, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include "dr_api.h"
+#ifdef MACOS
+# include <sys/syscall.h>
+#else
+# include <syscall.h>
+#endif
+
+/* Tests the inline syscall events, which are invoked from the code cache. */
+
+static int pre_getppid, post_getppid, pre_getpriority, post_getpriority;
+static bool params_ok = true, results_ok = true;
+
+static bool
+event_pre_syscall(void *drcontext, int sysnum)
+{
+    /* These should be executed inline and not reach the regular events. */
+    if (sysnum == SYS_getppid || sysnum == SYS_getpriority)
+        dr_fprintf(STDERR, "regular pre-syscall event for inlined syscall\n");
+    return true;
+}
+
+static bool
+event_filter_inline_syscall(void *drcontext, int sysnum)
+{
+    return sysnum == SYS_getppid || sysnum == SYS_getpriority;
+}
+
+static void
+event_pre_inline_syscall(void *drcontext, int sysnum, reg_t *params)
+{
+    if (sysnum == SYS_getppid)
+        pre_getppid++;
+    else if (sysnum == SYS_getpriority) {
+        if (params[0] != 0 || params[1] != 0)
+            params_ok = false;
+        pre_getpriority++;
+    }
+}
+
+static void
+event_post_inline_syscall(void *drcontext, int sysnum, reg_t result)
+{
+    if (sysnum == SYS_getppid) {
+        if ((ptr_int_t)result <= 0)
+            results_ok = false;
+        post_getppid++;
+    } else if (sysnum == SYS_getpriority) {
+        /* The kernel returns 20 - nice, in [1, 40]. */
+        if ((ptr_int_t)result < 1 || (ptr_int_t)result > 40)
+            results_ok = false;
+        post_getpriority++;
+    }
+}
+
+static void
+event_exit(void)
+{
+    dr_fprintf(STDERR, "getppid: %s\n",
+               (pre_getppid > 0 && pre_getppid == post_getppid) ?
+               "pre and post invoked" : "MISMATCH");
+    dr_fprintf(STDERR, "getpriority: %s\n",
+               (pre_getpriority > 0 && pre_getpriority == post_getpriority) ?
+               "pre and post invoked" : "MISMATCH");
+    dr_fprintf(STDERR, "params %s, results %s\n", params_ok ? "ok" : "WRONG",
+               results_ok ? "ok" : "WRONG");
+    if (!dr_unregister_filter_inline_syscall_event(event_filter_inline_syscall) ||
+        !dr_unregister_pre_inline_syscall_event(event_pre_inline_syscall) ||
+        !dr_unregister_post_inline_syscall_event(event_post_inline_syscall))
+        dr_fprintf(STDERR, "unregister failed\n");
+}
+
+DR_EXPORT
+void dr_init(client_id_t id)
+{
+    dr_register_exit_event(event_exit);
+    dr_register_pre_syscall_event(event_pre_syscall);
+    dr_register_filter_inline_syscall_event(event_filter_inline_syscall);
+    dr_register_pre_inline_syscall_event(event_pre_inline_syscall);
+    dr_register_post_inline_syscall_event(event_post_inline_syscall);
+}
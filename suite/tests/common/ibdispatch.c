@@ -0,0 +1,138 @@
+/* **********************************************************
+ * Copyright (c) 2017 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Indirect branch microbenchmark: virtual-dispatch-style calls through a table
+ * of many targets, plus a switch-based bytecode interpreter.  Both stress the
+ * indirect branch lookup tables with a large, colliding set of targets.
+ */
+
+/* undefine this for a performance test */
+#ifndef NIGHTLY_REGRESSION
+# define NIGHTLY_REGRESSION
+#endif
+
+#include "tools.h"
+
+#ifdef NIGHTLY_REGRESSION
+#  define ITER 20*1000
+#else
+#  define ITER 20*1000*1000
+#endif
+
+#define NUM_TARGETS 256
+#define PROGRAM_LEN 64
+
+typedef unsigned int (*handler_t)(unsigned int);
+
+#define HANDLER(n) \
+    static unsigned int handler##n(unsigned int x) { return x * 31 + n; }
+#define HANDLER4(n) HANDLER(n##0) HANDLER(n##1) HANDLER(n##2) HANDLER(n##3)
+#define HANDLER16(n) HANDLER4(n##0) HANDLER4(n##1) HANDLER4(n##2) HANDLER4(n##3)
+#define HANDLER64(n) \
+    HANDLER16(n##0) HANDLER16(n##1) HANDLER16(n##2) HANDLER16(n##3)
+/* Base-4 names: handler1000 through handler1333. */
+HANDLER64(1)
+HANDLER64(2)
+HANDLER64(3)
+HANDLER64(4)
+
+#define ENTRY(n) handler##n,
+#define ENTRY4(n) ENTRY(n##0) ENTRY(n##1) ENTRY(n##2) ENTRY(n##3)
+#define ENTRY16(n) ENTRY4(n##0) ENTRY4(n##1) ENTRY4(n##2) ENTRY4(n##3)
+#define ENTRY64(n) ENTRY16(n##0) ENTRY16(n##1) ENTRY16(n##2) ENTRY16(n##3)
+
+static handler_t handlers[NUM_TARGETS] = {
+    ENTRY64(1) ENTRY64(2) ENTRY64(3) ENTRY64(4)
+};
+
+/* Calls every target in a scattered order so that consecutive lookups do not
+ * hit neighboring table entries.
+ */
+static unsigned int
+dispatch(unsigned int iters)
+{
+    unsigned int i, x = 1;
+    for (i = 0; i < iters; i++)
+        x = handlers[(i * 97) % NUM_TARGETS](x);
+    return x;
+}
+
+enum {
+    OP_ADD, OP_SUB, OP_MUL, OP_XOR, OP_SHL, OP_SHR, OP_AND, OP_OR,
+    OP_INC, OP_DEC, OP_NEG, OP_NOT, OP_ROL, OP_ROR, OP_SWAP, OP_DUP,
+    OP_LAST
+};
+
+static unsigned int
+interpret(const unsigned char *program, unsigned int iters)
+{
+    unsigned int i, pc, a = 1, b = 2, t;
+    for (i = 0; i < iters; i++) {
+        for (pc = 0; pc < PROGRAM_LEN; pc++) {
+            switch (program[pc]) {
+            case OP_ADD: a += b; break;
+            case OP_SUB: a -= b; break;
+            case OP_MUL: a *= b | 1; break;
+            case OP_XOR: a ^= b; break;
+            case OP_SHL: a <<= 1; break;
+            case OP_SHR: a >>= 1; break;
+            case OP_AND: a &= b | 0xff; break;
+            case OP_OR:  a |= b & 0xf; break;
+            case OP_INC: a++; break;
+            case OP_DEC: a--; break;
+            case OP_NEG: a = 0 - a; break;
+            case OP_NOT: a = ~a; break;
+            case OP_ROL: a = (a << 3) | (a >> 29); break;
+            case OP_ROR: a = (a >> 3) | (a << 29); break;
+            case OP_SWAP: t = a; a = b; b = t; break;
+            case OP_DUP: b = a; break;
+            }
+        }
+    }
+    return a ^ b;
+}
+
+int
+main(int argc, char** argv)
+{
+    unsigned char program[PROGRAM_LEN];
+    int i;
+
+    INIT();
+
+    for (i = 0; i < PROGRAM_LEN; i++)
+        program[i] = (unsigned char)((i * 7 + 3) % OP_LAST);
+
+    print("dispatch: 0x%08x\n", dispatch(ITER));
+    print("interpret: 0x%08x\n", interpret(program, ITER / PROGRAM_LEN));
+    return 0;
+}
@@ -0,0 +1,90 @@
+/* **********************************************************
+ * Copyright (c) 2017 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Simulates a sampling profiler: a 1ms ITIMER_PROF timer interrupts a
+ * compute loop, whose result must not be perturbed by signal delivery.
+ * With VERBOSE set this doubles as a benchmark of signal delivery cost.
+ */
+
+#include "tools.h"
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define ITERS 100000000
+
+static volatile int samples;
+
+static void
+handler(int sig)
+{
+    samples++;
+}
+
+int
+main(void)
+{
+    struct sigaction act;
+    struct itimerval timer;
+    unsigned int i, sum = 0;
+
+    memset(&act, 0, sizeof(act));
+    act.sa_handler = handler;
+    if (sigaction(SIGPROF, &act, NULL) != 0)
+        print("sigaction failed\n");
+
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = 1000;
+    timer.it_value = timer.it_interval;
+    if (setitimer(ITIMER_PROF, &timer, NULL) != 0)
+        print("setitimer failed\n");
+
+    for (i = 0; i < ITERS; i++)
+        sum += (i * i) ^ (sum >> 3);
+
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, NULL);
+
+#if VERBOSE
+    print("%d samples, sum %u\n", samples, sum);
+#endif
+    if (samples > 0)
+        print("samples received\n");
+    /* Compare against a second run with the timer off to catch corruption. */
+    {
+        unsigned int check = 0;
+        for (i = 0; i < ITERS; i++)
+            check += (i * i) ^ (check >> 3);
+        print("%s\n", check == sum ? "sum matches" : "sum mismatch");
+    }
+    return 0;
+}
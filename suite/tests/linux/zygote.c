@@ -0,0 +1,126 @@
+/* **********************************************************
+ * Copyright (c) 2017 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* A pre-forking server: the parent warms up by running the workers' code,
+ * then forks workers that each run it again.  linux.zygote-statcheck checks
+ * that the workers inherit the parent's fragments and cache units.  With
+ * VERBOSE set each worker also reports its run time and how much of its
+ * memory is shared, which is how -zygote is measured.
+ */
+
+#include "tools.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define NUM_WORKERS 4
+#define ITERS 100000
+
+static int
+handle_request(int i)
+{
+    char buf[64];
+    int j, sum = 0;
+    snprintf(buf, sizeof(buf), "request %d", i);
+    for (j = 0; buf[j] != '\0'; j++)
+        sum += buf[j] * (j + 1);
+    return sum % 97;
+}
+
+static int
+serve(void)
+{
+    int i, res = 0;
+    for (i = 0; i < ITERS; i++)
+        res += handle_request(i);
+    return res;
+}
+
+#if VERBOSE
+static void
+print_memory(int worker)
+{
+    /* Added in Linux 4.14; we simply print nothing on older kernels. */
+    FILE *f = fopen("/proc/self/smaps_rollup", "r");
+    char line[256];
+    if (f == NULL)
+        return;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (strncmp(line, "Rss:", 4) == 0 || strncmp(line, "Shared_", 7) == 0 ||
+            strncmp(line, "Private_", 8) == 0)
+            print("worker %d %s", worker, line);
+    }
+    fclose(f);
+}
+#endif
+
+int
+main(void)
+{
+    int i, expect;
+    pid_t pids[NUM_WORKERS];
+
+    expect = serve();
+    print("parent warmed up\n");
+
+    for (i = 0; i < NUM_WORKERS; i++) {
+        pids[i] = fork();
+        if (pids[i] < 0) {
+            perror("fork");
+            return 1;
+        }
+        if (pids[i] == 0) {
+#if VERBOSE
+            struct timeval start, end;
+            gettimeofday(&start, NULL);
+#endif
+            if (serve() != expect)
+                print("worker %d got a wrong result\n", i);
+#if VERBOSE
+            gettimeofday(&end, NULL);
+            print("worker %d took %d us\n", i,
+                  (int)((end.tv_sec - start.tv_sec) * 1000000 +
+                        end.tv_usec - start.tv_usec));
+            print_memory(i);
+#endif
+            return 0;
+        }
+        /* Wait for each worker in turn to keep the output deterministic. */
+        if (waitpid(pids[i], NULL, 0) != pids[i])
+            perror("waitpid");
+        print("worker %d done\n", i);
+    }
+    return 0;
+}
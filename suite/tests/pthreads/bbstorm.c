@@ -0,0 +1,182 @@
+/* **********************************************************
+ * Copyright (c) 2017 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Startup scalability benchmark for shared bb building: many threads start at
+ * once and each executes the same large set of functions, so that they all
+ * build shared bbs at the same time, both for the same tags and for different
+ * ones.  For a performance run, undefine NIGHTLY_REGRESSION and pass the
+ * thread count as the argument; the cold pass time is the time to reach steady
+ * state, and comparing runs with and without -bb_build_claims for increasing
+ * thread counts shows how bb building scales.
+ */
+
+/* undefine this for a performance test */
+#ifndef NIGHTLY_REGRESSION
+# define NIGHTLY_REGRESSION
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#ifndef NIGHTLY_REGRESSION
+# include <sys/time.h>
+#endif
+
+#define DEFAULT_THREADS 8
+#define MAX_THREADS 256
+#define NUM_FUNCS 1024
+
+typedef unsigned int (*func_t)(unsigned int);
+
+/* Each function is several bbs. */
+#define FUNC(n)                                         \
+    static unsigned int func##n(unsigned int x)         \
+    {                                                   \
+        if (x & 1)                                      \
+            x = x * 3 + n;                              \
+        else                                            \
+            x = (x >> 1) ^ n;                           \
+        return x + 0x##n;                               \
+    }
+#define FUNC4(n) FUNC(n##0) FUNC(n##1) FUNC(n##2) FUNC(n##3)
+#define FUNC16(n) FUNC4(n##0) FUNC4(n##1) FUNC4(n##2) FUNC4(n##3)
+#define FUNC64(n) FUNC16(n##0) FUNC16(n##1) FUNC16(n##2) FUNC16(n##3)
+#define FUNC256(n) FUNC64(n##0) FUNC64(n##1) FUNC64(n##2) FUNC64(n##3)
+/* Base-4 names: func10000 through func13333. */
+FUNC256(1)
+FUNC256(2)
+FUNC256(3)
+FUNC256(4)
+
+#define ENTRY(n) func##n,
+#define ENTRY4(n) ENTRY(n##0) ENTRY(n##1) ENTRY(n##2) ENTRY(n##3)
+#define ENTRY16(n) ENTRY4(n##0) ENTRY4(n##1) ENTRY4(n##2) ENTRY4(n##3)
+#define ENTRY64(n) ENTRY16(n##0) ENTRY16(n##1) ENTRY16(n##2) ENTRY16(n##3)
+#define ENTRY256(n) ENTRY64(n##0) ENTRY64(n##1) ENTRY64(n##2) ENTRY64(n##3)
+
+static func_t funcs[NUM_FUNCS] = {
+    ENTRY256(1) ENTRY256(2) ENTRY256(3) ENTRY256(4)
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t start_cond = PTHREAD_COND_INITIALIZER;
+static int started;
+static unsigned int checksum;
+
+/* Calls every function once, starting at a thread-specific point so that
+ * threads begin on different tags and then run into each other's.
+ */
+static unsigned int
+pass(unsigned int idx)
+{
+    unsigned int i, x = 1, sum = 0;
+    for (i = 0; i < NUM_FUNCS; i++) {
+        x = funcs[(idx * 37 + i) % NUM_FUNCS](i);
+        sum += x;
+    }
+    return sum;
+}
+
+static void *
+thread_func(void *arg)
+{
+    unsigned int idx = (unsigned int)(long) arg;
+    unsigned int sum;
+    pthread_mutex_lock(&lock);
+    while (!started)
+        pthread_cond_wait(&start_cond, &lock);
+    pthread_mutex_unlock(&lock);
+    sum = pass(idx);
+    pthread_mutex_lock(&lock);
+    checksum += sum;
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+#ifndef NIGHTLY_REGRESSION
+static double
+now(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+#endif
+
+/* Starts the threads together and waits for all of them to finish one pass. */
+static void
+run_pass(pthread_t *threads, int num_threads)
+{
+    int i;
+    started = 0;
+    for (i = 0; i < num_threads; i++) {
+        if (pthread_create(&threads[i], NULL, thread_func, (void *)(long) i) != 0) {
+            fprintf(stderr, "failed to create thread\n");
+            exit(1);
+        }
+    }
+    pthread_mutex_lock(&lock);
+    started = 1;
+    pthread_cond_broadcast(&start_cond);
+    pthread_mutex_unlock(&lock);
+    for (i = 0; i < num_threads; i++)
+        pthread_join(threads[i], NULL);
+}
+
+int
+main(int argc, char **argv)
+{
+    pthread_t threads[MAX_THREADS];
+    int num_threads = DEFAULT_THREADS;
+#ifndef NIGHTLY_REGRESSION
+    double start;
+    if (argc > 1)
+        num_threads = atoi(argv[1]);
+    if (num_threads < 1 || num_threads > MAX_THREADS) {
+        fprintf(stderr, "thread count must be between 1 and %d\n", MAX_THREADS);
+        return 1;
+    }
+    start = now();
+#endif
+    /* the first pass builds the code; the second runs it from the cache */
+    run_pass(threads, num_threads);
+#ifndef NIGHTLY_REGRESSION
+    fprintf(stderr, "%d threads: cold pass %.3fs\n", num_threads, now() - start);
+    start = now();
+#endif
+    run_pass(threads, num_threads);
+#ifndef NIGHTLY_REGRESSION
+    fprintf(stderr, "%d threads: warm pass %.3fs\n", num_threads, now() - start);
+#endif
+    printf("checksum: 0x%08x\n", checksum);
+    return 0;
+}
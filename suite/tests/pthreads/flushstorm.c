@@ -0,0 +1,137 @@
+/* **********************************************************
+ * Copyright (c) 2017 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Cache consistency flushes while other threads run: the main thread keeps
+ * rewriting a generated function that several worker threads keep calling, so
+ * every rewrite flushes a region that other threads are executing in the
+ * cache.  One more thread spends nearly all its time blocked in a system call,
+ * so that most flushes find a thread at a syscall.  Each worker checks that it
+ * only ever sees the current version of the function or one it has not yet
+ * caught up from, and the main thread waits for every worker to see each
+ * version, so a stale fragment that survives a flush hangs the test.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define NUM_WORKERS 4
+#define NUM_VERSIONS 200
+
+typedef int (*func_t)(void);
+
+static unsigned char *code;
+static volatile int version;
+static volatile int seen[NUM_WORKERS];
+static volatile int done;
+static volatile int bad;
+
+/* Writes "mov $v, %eax; ret" with the immediate aligned so that it is
+ * replaced by a single store.
+ */
+static void
+write_version(int v)
+{
+    version = v;
+    *(volatile int *)(code + 4) = v;
+}
+
+static void *
+worker(void *arg)
+{
+    int idx = (int)(long) arg;
+    func_t func = (func_t)(code + 3);
+    while (!done) {
+        int v = func();
+        if (v < seen[idx] || v > version)
+            bad = 1;
+        seen[idx] = v;
+    }
+    return NULL;
+}
+
+static void *
+sleeper(void *arg)
+{
+    while (!done)
+        usleep(1000);
+    return NULL;
+}
+
+int
+main(int argc, char **argv)
+{
+    pthread_t workers[NUM_WORKERS], sleep_thread;
+    int i, v;
+
+    code = mmap(NULL, 4096, PROT_READ|PROT_WRITE|PROT_EXEC,
+                MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    code[3] = 0xb8; /* mov imm32 -> eax */
+    code[8] = 0xc3; /* ret */
+    write_version(1);
+
+    if (pthread_create(&sleep_thread, NULL, sleeper, NULL) != 0) {
+        fprintf(stderr, "failed to create thread\n");
+        return 1;
+    }
+    for (i = 0; i < NUM_WORKERS; i++) {
+        if (pthread_create(&workers[i], NULL, worker, (void *)(long) i) != 0) {
+            fprintf(stderr, "failed to create thread\n");
+            return 1;
+        }
+    }
+    for (v = 1; v <= NUM_VERSIONS; v++) {
+        if (v > 1)
+            write_version(v);
+        for (i = 0; i < NUM_WORKERS; i++) {
+            while (seen[i] != v)
+                sched_yield();
+        }
+    }
+    done = 1;
+    for (i = 0; i < NUM_WORKERS; i++)
+        pthread_join(workers[i], NULL);
+    pthread_join(sleep_thread, NULL);
+    munmap(code, 4096);
+    if (bad)
+        printf("saw a stale version\n");
+    printf("all %d versions seen by all threads\n", NUM_VERSIONS);
+    return 0;
+}